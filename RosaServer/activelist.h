@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "sol/sol.hpp"
+
+// Tracks which slots of a fixed engine array are in use, so walking active
+// objects doesn't have to touch every slot, and caches one Lua object per
+// slot so handing them to Lua doesn't allocate a new userdata each time.
+//
+// Slots are inserted and erased by the create and delete hooks. The engine
+// deactivates some objects without going through a hook, so slots found
+// inactive while iterating are dropped lazily.
+template <typename T, size_t N>
+class ActiveList {
+	static constexpr size_t wordCount = (N + 63) / 64;
+	uint64_t words[wordCount] = {};
+	sol::object* objects[N] = {};
+	uint32_t version = 0;
+
+ public:
+	void insert(int index) {
+		if (index < 0) return;
+		words[index >> 6] |= 1ULL << (index & 63);
+		version++;
+	}
+
+	void erase(int index) {
+		if (index < 0) return;
+		words[index >> 6] &= ~(1ULL << (index & 63));
+	}
+
+	void rebuild(const T* array) {
+		for (size_t i = 0; i < wordCount; i++) {
+			words[i] = 0;
+		}
+		for (size_t i = 0; i < N; i++) {
+			if (array[i].active) insert(i);
+		}
+	}
+
+	// Returns the first active index at or after from, or -1
+	int next(const T* array, int from) {
+		if (from < 0) from = 0;
+		if ((size_t)from >= N) return -1;
+
+		size_t word = from >> 6;
+		uint64_t bits = words[word] & (~0ULL << (from & 63));
+
+		while (true) {
+			while (bits) {
+				int index = (word << 6) + __builtin_ctzll(bits);
+				if (array[index].active) return index;
+
+				erase(index);
+				bits &= bits - 1;
+			}
+
+			if (++word == wordCount) return -1;
+			bits = words[word];
+		}
+	}
+
+	// Changes whenever a slot is inserted, so structures derived from the list
+	// can tell when they're missing objects
+	uint32_t getVersion() const { return version; }
+
+	int count(const T* array) {
+		int count = 0;
+		for (int i = next(array, 0); i != -1; i = next(array, i + 1)) {
+			count++;
+		}
+		return count;
+	}
+
+	const sol::object& getObject(lua_State* state, T* array, int index) {
+		if (!objects[index]) {
+			objects[index] = new sol::object(sol::make_object(state, &array[index]));
+		}
+		return *objects[index];
+	}
+
+	// Must be called before the Lua state the objects belong to is destroyed
+	void clearObjects() {
+		for (size_t i = 0; i < N; i++) {
+			if (objects[i]) {
+				delete objects[i];
+				objects[i] = nullptr;
+			}
+		}
+	}
+};
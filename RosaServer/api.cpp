@@ -3,11 +3,15 @@
 #include <sys/mman.h>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <filesystem>
 #include <limits>
+#include <unordered_map>
 
 #include "console.h"
+#include "engineuserdata.h"
+#include "threadpool.h"
 
 bool initialized = false;
 bool shouldReset = false;
@@ -15,17 +19,25 @@ bool shouldReset = false;
 sol::state* lua;
 std::string hookMode;
 
-sol::table* accountDataTables[maxNumberOfAccounts] = {0};
-sol::table* playerDataTables[maxNumberOfPlayers] = {0};
-sol::table* humanDataTables[maxNumberOfHumans] = {0};
-sol::table* itemDataTables[maxNumberOfItems] = {0};
-sol::table* vehicleDataTables[maxNumberOfVehicles] = {0};
-sol::table* bodyDataTables[maxNumberOfRigidBodies] = {0};
+DataTables accountDataTables;
+DataTables playerDataTables;
+DataTables humanDataTables;
+DataTables itemDataTables;
+DataTables vehicleDataTables;
+DataTables bodyDataTables;
+
+ActiveList<Player, maxNumberOfPlayers> activePlayers;
+ActiveList<Human, maxNumberOfHumans> activeHumans;
+ActiveList<Item, maxNumberOfItems> activeItems;
+ActiveList<Vehicle, maxNumberOfVehicles> activeVehicles;
+ActiveList<RigidBody, maxNumberOfRigidBodies> activeBodies;
 
 std::mutex stateResetMutex;
 
 static constexpr const char* errorOutOfRange = "Index out of range";
 static constexpr const char* missingArgument = "Missing argument";
+static constexpr const char* errorNotSealed =
+    "Graph must be sealed before searching it on other threads";
 
 void printLuaError(sol::error* err) {
 	std::ostringstream stream;
@@ -51,26 +63,176 @@ bool noLuaCallError(sol::load_result* res) {
 	return false;
 }
 
+void rebuildActiveLists() {
+	activePlayers.rebuild(Engine::players);
+	activeHumans.rebuild(Engine::humans);
+	activeItems.rebuild(Engine::items);
+	activeVehicles.rebuild(Engine::vehicles);
+	activeBodies.rebuild(Engine::bodies);
+}
+
+void clearActiveObjects() {
+	activePlayers.clearObjects();
+	activeHumans.clearObjects();
+	activeItems.clearObjects();
+	activeVehicles.clearObjects();
+	activeBodies.clearObjects();
+}
+
+template <typename T, size_t N>
+static sol::table fillActiveTable(ActiveList<T, N>& list, T* array,
+                                  sol::optional<sol::table>& reuse) {
+	sol::table table = reuse ? *reuse : lua->create_table();
+
+	int length = 0;
+	for (int i = list.next(array, 0); i != -1; i = list.next(array, i + 1)) {
+		table.raw_set(++length, list.getObject(lua->lua_state(), array, i));
+	}
+
+	// Clear what's left over from a previous, longer fill
+	for (int i = length + 1; table.raw_get<sol::object>(i).valid(); i++) {
+		table.raw_set(i, sol::lua_nil);
+	}
+
+	return table;
+}
+
+template <typename T, size_t N>
+static std::tuple<sol::optional<int>, sol::object> nextActive(
+    ActiveList<T, N>& list, T* array, int previous) {
+	int index = list.next(array, previous + 1);
+	if (index == -1) {
+		return {sol::nullopt, sol::lua_nil};
+	}
+
+	return {index, list.getObject(lua->lua_state(), array, index)};
+}
+
+static std::tuple<sol::object, sol::lua_nil_t, int> activeIterator(
+    const char* tableName) {
+	sol::object next = (*lua)[tableName]["next"];
+	return {next, sol::lua_nil, -1};
+}
+
+// Generous half extents, since the grids only cull and the engine routines do
+// the exact tests. The vehicle one has to cover trains and helicopters.
+static constexpr float humanBoundsRadius = 2.5f;
+static constexpr float vehicleBoundsRadius = 16.f;
+
+SpatialGrid<maxNumberOfHumans> humanGrid;
+SpatialGrid<maxNumberOfVehicles> vehicleGrid;
+
+template <typename T, size_t N>
+static void rebuildGrid(SpatialGrid<N>& grid, ActiveList<T, N>& list,
+                        T* array, float radius) {
+	grid.clear();
+	for (int i = list.next(array, 0); i != -1; i = list.next(array, i + 1)) {
+		grid.add(i, array[i].pos, radius);
+	}
+	grid.build(list.getVersion());
+}
+
+void rebuildSpatialGrids() {
+	rebuildGrid(humanGrid, activeHumans, Engine::humans, humanBoundsRadius);
+	rebuildGrid(vehicleGrid, activeVehicles, Engine::vehicles,
+	            vehicleBoundsRadius);
+}
+
+static SpatialGrid<maxNumberOfHumans>& getHumanGrid() {
+	if (!humanGrid.isBuilt(activeHumans.getVersion())) {
+		rebuildGrid(humanGrid, activeHumans, Engine::humans, humanBoundsRadius);
+	}
+	return humanGrid;
+}
+
+static SpatialGrid<maxNumberOfVehicles>& getVehicleGrid() {
+	if (!vehicleGrid.isBuilt(activeVehicles.getVersion())) {
+		rebuildGrid(vehicleGrid, activeVehicles, Engine::vehicles,
+		            vehicleBoundsRadius);
+	}
+	return vehicleGrid;
+}
+
+template <typename T, size_t N, typename Filter>
+static sol::table findActiveInBox(SpatialGrid<N>& grid, ActiveList<T, N>& list,
+                                  T* array, const Vector& min,
+                                  const Vector& max, Filter&& filter) {
+	static int found[N];
+	int numFound = 0;
+
+	grid.queryBox(min, max, [&](int index) {
+		if (array[index].active && filter(array[index].pos)) {
+			found[numFound++] = index;
+		}
+	});
+
+	// Grid order depends on hashing, so hand them out by index instead
+	std::sort(found, found + numFound);
+
+	sol::table table = lua->create_table(numFound, 0);
+	for (int i = 0; i < numFound; i++) {
+		table.raw_set(i + 1, list.getObject(lua->lua_state(), array, found[i]));
+	}
+	return table;
+}
+
+template <typename T, size_t N>
+static sol::table findActiveInRadius(SpatialGrid<N>& grid,
+                                     ActiveList<T, N>& list, T* array,
+                                     Vector* pos, float radius) {
+	Vector min = {pos->x - radius, pos->y - radius, pos->z - radius};
+	Vector max = {pos->x + radius, pos->y + radius, pos->z + radius};
+	float radiusSquared = radius * radius;
+
+	return findActiveInBox(grid, list, array, min, max,
+	                       [pos, radiusSquared](const Vector& objectPos) {
+		                       float x = objectPos.x - pos->x;
+		                       float y = objectPos.y - pos->y;
+		                       float z = objectPos.z - pos->z;
+		                       return x * x + y * y + z * z <= radiusSquared;
+	                       });
+}
+
+template <typename T, size_t N>
+static sol::table findActiveInBox(SpatialGrid<N>& grid, ActiveList<T, N>& list,
+                                  T* array, Vector* min, Vector* max) {
+	return findActiveInBox(grid, list, array, *min, *max,
+	                       [min, max](const Vector& objectPos) {
+		                       return objectPos.x >= min->x &&
+		                              objectPos.x <= max->x &&
+		                              objectPos.y >= min->y &&
+		                              objectPos.y <= max->y &&
+		                              objectPos.z >= min->z &&
+		                              objectPos.z <= max->z;
+	                       });
+}
+
 void hookAndReset(int reason) {
 	if (Hooks::enabledKeys[Hooks::EnableKeys::ResetGame]) {
 		bool noParent = false;
-		if (Hooks::run != sol::nil) {
-			auto res = Hooks::run("ResetGame", reason);
+		if (Hooks::hasPre(Hooks::EnableKeys::ResetGame)) {
+			auto res =
+			    Hooks::callPre(Hooks::EnableKeys::ResetGame, "ResetGame", reason);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&Hooks::resetGameHook);
+				Hooks::ScopedOriginal remove(&Hooks::resetGameHook,
+				                             Hooks::EnableKeys::ResetGame);
 				Engine::resetGame();
 			}
-			if (Hooks::run != sol::nil) {
-				auto res = Hooks::run("PostResetGame", reason);
+			rebuildActiveLists();
+			if (Hooks::hasPost(Hooks::EnableKeys::ResetGame)) {
+				auto res = Hooks::callPost(Hooks::EnableKeys::ResetGame,
+				                           "PostResetGame", reason);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&Hooks::resetGameHook);
+		Hooks::ScopedOriginal remove(&Hooks::resetGameHook,
+		                             Hooks::EnableKeys::ResetGame);
 		Engine::resetGame();
+		rebuildActiveLists();
 	}
 }
 
@@ -125,17 +287,17 @@ RotMatrix RotMatrix_f(float x1, float y1, float z1, float x2, float y2,
 	return RotMatrix{x1, y1, z1, x2, y2, z2, x3, y3, z3};
 }
 
-static sol::object handleSyncHTTPResponse(httplib::Result& res,
-                                          sol::this_state s) {
-	sol::state_view lua(s);
+static sol::object responseToLua(lua_State* state,
+                                 const LuaHTTPResponse& res) {
+	sol::state_view lua(state);
 
-	if (res) {
+	if (res.responded) {
 		sol::table table = lua.create_table();
-		table["status"] = res->status;
-		table["body"] = res->body;
+		table["status"] = res.status;
+		table["body"] = res.body;
 
 		sol::table headers = lua.create_table();
-		for (const auto& h : res->headers) headers[h.first] = h.second;
+		for (const auto& h : res.headers) headers[h.first] = h.second;
 		table["headers"] = headers;
 
 		return sol::make_object(lua, table);
@@ -144,43 +306,274 @@ static sol::object handleSyncHTTPResponse(httplib::Result& res,
 	return sol::make_object(lua, sol::nil);
 }
 
-sol::object http::getSync(const char* scheme, const char* path,
-                          sol::table headers, sol::this_state s) {
-	httplib::Client client(scheme);
-	client.set_connection_timeout(6);
-	client.set_keep_alive(false);
-	client.set_follow_location(true);
+static LuaHTTPRequest makeHTTPRequest(LuaRequestType type, const char* scheme,
+                                      const char* path, sol::table& headers) {
+	LuaHTTPRequest request;
+	request.type = type;
+	request.id = 0;
+	request.scheme = scheme;
+	request.path = path;
 
-	httplib::Headers httpHeaders;
 	for (const auto& pair : headers)
-		httpHeaders.emplace(pair.first.as<std::string>(),
-		                    pair.second.as<std::string>());
+		request.headers.emplace(pair.first.as<std::string>(),
+		                        pair.second.as<std::string>());
 
-	httpHeaders.emplace("Connection", "close");
+	return request;
+}
 
-	auto res = client.Get(path, httpHeaders);
-	return handleSyncHTTPResponse(res, s);
+sol::object http::getSync(const char* scheme, const char* path,
+                          sol::table headers, sol::this_state s) {
+	auto request = makeHTTPRequest(LuaRequestType::get, scheme, path, headers);
+	return responseToLua(s, HTTPPool::perform(request));
 }
 
 sol::object http::postSync(const char* scheme, const char* path,
                            sol::table headers, std::string body,
                            const char* contentType, sol::this_state s) {
-	httplib::Client client(scheme);
-	client.set_connection_timeout(6);
-	client.set_keep_alive(false);
-	client.set_follow_location(true);
+	auto request = makeHTTPRequest(LuaRequestType::post, scheme, path, headers);
+	request.body = body;
+	request.contentType = contentType;
+	return responseToLua(s, HTTPPool::perform(request));
+}
 
-	httplib::Headers httpHeaders;
-	for (const auto& pair : headers)
-		httpHeaders.emplace(pair.first.as<std::string>(),
-		                    pair.second.as<std::string>());
+static std::unordered_map<unsigned int, sol::protected_function> httpCallbacks;
+static unsigned int nextHTTPRequestID = 1;
+
+static bool queueHTTPRequest(LuaHTTPRequest&& request,
+                             sol::protected_function& callback) {
+	unsigned int id = nextHTTPRequestID++;
+	request.id = id;
+
+	if (!HTTPPool::enqueue(std::move(request))) return false;
+
+	httpCallbacks[id] = callback;
+	return true;
+}
+
+bool http::get(const char* scheme, const char* path, sol::table headers,
+               sol::protected_function callback) {
+	return queueHTTPRequest(
+	    makeHTTPRequest(LuaRequestType::get, scheme, path, headers), callback);
+}
+
+bool http::post(const char* scheme, const char* path, sol::table headers,
+                std::string body, const char* contentType,
+                sol::protected_function callback) {
+	auto request = makeHTTPRequest(LuaRequestType::post, scheme, path, headers);
+	request.body = body;
+	request.contentType = contentType;
+	return queueHTTPRequest(std::move(request), callback);
+}
+
+void drainHTTPResponses() {
+	LuaHTTPResponse response;
+	while (HTTPPool::popResponse(response)) {
+		// Requests made by a previous state have no callback left
+		auto it = httpCallbacks.find(response.id);
+		if (it == httpCallbacks.end()) continue;
+
+		sol::protected_function callback = std::move(it->second);
+		httpCallbacks.erase(it);
+
+		auto res = callback(responseToLua(lua->lua_state(), response));
+		noLuaCallError(&res);
+	}
+}
+
+void clearHTTPCallbacks() { httpCallbacks.clear(); }
+
+std::string serializer::encode(sol::object value) {
+	return Serializer::encode<EngineUserdata>(value);
+}
+
+sol::object serializer::decode(std::string_view data, sol::this_state s) {
+	return Serializer::decode<EngineUserdata>(s, data);
+}
+
+static std::unordered_map<unsigned int, sol::protected_function>
+    threadCallbacks;
+static unsigned int nextThreadTaskID = 1;
+
+void threads::load(std::string fileName) { ThreadPool::load(fileName); }
+
+bool threads::submit(std::string functionName, sol::object argument,
+                     sol::protected_function callback) {
+	unsigned int id = nextThreadTaskID++;
+	if (!ThreadPool::submit({id, std::move(functionName),
+	                         Serializer::encode<EngineUserdata>(argument)}))
+		return false;
 
-	httpHeaders.emplace("Connection", "close");
+	threadCallbacks[id] = callback;
+	return true;
+}
+
+// Pool threads claim requests from the batch one at a time, and whichever
+// finishes last encodes every path as the batch's result
+struct PathBatch {
+	std::shared_ptr<const PointGraph> graph;
+	std::vector<std::pair<unsigned int, unsigned int>> requests;
+	std::vector<std::vector<unsigned int>> paths;
+	std::vector<char> found;
+	std::atomic<size_t> nextRequest = 0;
+	std::atomic<unsigned int> remainingWorkers;
+};
+
+// Fewer requests than this aren't worth waking another thread for
+static constexpr size_t pathRequestsPerWorker = 8;
+
+static bool workOnPathBatch(PathBatch& batch, std::string& value) {
+	size_t index;
+	while ((index = batch.nextRequest++) < batch.requests.size()) {
+		const auto& [startNodeId, goalNodeId] = batch.requests[index];
+		batch.found[index] =
+		    batch.graph->findPath(startNodeId, goalNodeId, batch.paths[index]);
+	}
+
+	if (--batch.remainingWorkers != 0) return false;
 
-	auto res = client.Post(path, httpHeaders, body, contentType);
-	return handleSyncHTTPResponse(res, s);
+	Serializer::writeTableHeader(value, batch.requests.size(), 0);
+	for (size_t i = 0; i < batch.requests.size(); i++) {
+		if (!batch.found[i]) {
+			Serializer::writeBoolean(value, false);
+			continue;
+		}
+
+		const auto& path = batch.paths[i];
+		Serializer::writeTableHeader(value, path.size(), 0);
+		for (unsigned int nodeId : path) {
+			Serializer::writeNumber(value, nodeId);
+		}
+	}
+	return true;
 }
 
+bool threads::findShortestPaths(PointGraph& graph, sol::table requests,
+                                sol::protected_function callback) {
+	// Sealing it here would quietly stop every later edit from Lua
+	if (!graph.isSealed()) {
+		throw std::runtime_error(errorNotSealed);
+	}
+
+	auto batch = std::make_shared<PathBatch>();
+
+	size_t numRequests = requests.size();
+	batch->requests.reserve(numRequests);
+	for (size_t i = 1; i <= numRequests; i++) {
+		sol::table request = requests[i];
+		unsigned int startNodeId = request[1];
+		unsigned int goalNodeId = request[2];
+		if (startNodeId >= (unsigned int)graph.getSize() ||
+		    goalNodeId >= (unsigned int)graph.getSize()) {
+			throw std::invalid_argument(errorOutOfRange);
+		}
+		batch->requests.emplace_back(startNodeId, goalNodeId);
+	}
+
+	size_t available = ThreadPool::maxPending - ThreadPool::getPending();
+	if (available == 0) return false;
+
+	// The pool threads search the graph while the main thread carries on
+	batch->graph = graph.shared_from_this();
+	batch->paths.resize(numRequests);
+	batch->found.resize(numRequests);
+
+	size_t numWorkers = std::max<size_t>(1, numRequests / pathRequestsPerWorker);
+	numWorkers = std::min<size_t>(
+	    {numWorkers, (size_t)ThreadPool::getThreadCount(), available});
+	batch->remainingWorkers = numWorkers;
+
+	// Only the main thread submits, so these can't fail after the check above
+	unsigned int id = nextThreadTaskID++;
+	for (size_t i = 0; i < numWorkers; i++) {
+		ThreadPool::Task task{id};
+		task.work = [batch](std::string& value) {
+			return workOnPathBatch(*batch, value);
+		};
+		ThreadPool::submit(std::move(task));
+	}
+
+	threadCallbacks[id] = callback;
+	return true;
+}
+
+int threads::getCount() { return ThreadPool::getThreadCount(); }
+
+int threads::getPending() { return ThreadPool::getPending(); }
+
+void drainThreadResults() {
+	ThreadPool::Result result;
+	while (ThreadPool::popResult(result)) {
+		// Tasks submitted by a previous state have no callback left
+		auto it = threadCallbacks.find(result.id);
+		if (it == threadCallbacks.end()) continue;
+
+		sol::protected_function callback = std::move(it->second);
+		threadCallbacks.erase(it);
+
+		// Failed tasks pass nil and the error message instead
+		sol::object value =
+		    result.success
+		        ? Serializer::decode<EngineUserdata>(lua->lua_state(), result.value)
+		        : sol::make_object(*lua, result.value);
+		auto res = result.success ? callback(value) : callback(sol::nil, value);
+		noLuaCallError(&res);
+	}
+}
+
+void clearThreadCallbacks() { threadCallbacks.clear(); }
+
+static std::unordered_map<unsigned int, sol::protected_function>
+    sqliteCallbacks;
+static unsigned int nextSQLiteWriteID = 1;
+
+void sqlite::queryAsync(SQLite& db, std::string sql,
+                        sol::optional<sol::table> arguments,
+                        sol::optional<sol::protected_function> callback) {
+	SQLiteWrite write{nextSQLiteWriteID++, std::move(sql)};
+
+	if (arguments) {
+		// Arguments can be nil, so the length operator can't be trusted
+		size_t numArguments = 0;
+		for (const auto& [key, value] : *arguments) {
+			if (key.get_type() == sol::type::number) {
+				double index = key.as<double>();
+				if (index >= 1 && index == std::floor(index)) {
+					numArguments = std::max(numArguments, (size_t)index);
+				}
+			}
+		}
+
+		write.arguments.reserve(numArguments);
+		for (size_t i = 1; i <= numArguments; i++) {
+			write.arguments.push_back(toSQLiteValue((*arguments)[i]));
+		}
+	}
+
+	unsigned int id = write.id;
+	db.queueWrite(std::move(write));
+
+	if (callback) {
+		sqliteCallbacks[id] = *callback;
+	}
+}
+
+void drainSQLiteWrites() {
+	SQLiteWriteResult result;
+	while (SQLiteWriter::popResult(result)) {
+		auto it = sqliteCallbacks.find(result.id);
+		if (it == sqliteCallbacks.end()) continue;
+
+		sol::protected_function callback = std::move(it->second);
+		sqliteCallbacks.erase(it);
+
+		auto res = result.success ? callback(result.changes)
+		                          : callback(sol::nil, result.error);
+		noLuaCallError(&res);
+	}
+}
+
+void clearSQLiteCallbacks() { sqliteCallbacks.clear(); }
+
 static inline std::string withoutPostPrefix(std::string name) {
 	if (name.rfind("Post", 0) == 0) {
 		return name.substr(4);
@@ -189,10 +582,15 @@ static inline std::string withoutPostPrefix(std::string name) {
 	return name;
 }
 
+static inline bool hasPostPrefix(const std::string& name) {
+	return name.rfind("Post", 0) == 0;
+}
+
 bool hook::enable(std::string name) {
 	auto search = Hooks::enableNames.find(withoutPostPrefix(name));
 	if (search != Hooks::enableNames.end()) {
-		Hooks::enabledKeys[search->second] = true;
+		Hooks::runEnabledKeys[search->second] = true;
+		Hooks::updateEnabledKey(search->second);
 		return true;
 	}
 	return false;
@@ -201,7 +599,8 @@ bool hook::enable(std::string name) {
 bool hook::disable(std::string name) {
 	auto search = Hooks::enableNames.find(withoutPostPrefix(name));
 	if (search != Hooks::enableNames.end()) {
-		Hooks::enabledKeys[search->second] = false;
+		Hooks::runEnabledKeys[search->second] = false;
+		Hooks::updateEnabledKey(search->second);
 		return true;
 	}
 	return false;
@@ -209,14 +608,96 @@ bool hook::disable(std::string name) {
 
 void hook::clear() {
 	for (size_t i = 0; i < Hooks::EnableKeys::SIZE; i++) {
-		Hooks::enabledKeys[i] = false;
+		Hooks::runEnabledKeys[i] = false;
+	}
+	Hooks::clearHandlers();
+}
+
+bool hook::on(std::string name, sol::protected_function handler) {
+	auto search = Hooks::enableNames.find(withoutPostPrefix(name));
+	if (search == Hooks::enableNames.end()) {
+		return false;
+	}
+
+	if (hasPostPrefix(name)) {
+		Hooks::postHandlers[search->second] = handler;
+	} else {
+		Hooks::preHandlers[search->second] = handler;
+	}
+	Hooks::updateEnabledKey(search->second);
+	return true;
+}
+
+bool hook::off(std::string name) {
+	auto search = Hooks::enableNames.find(withoutPostPrefix(name));
+	if (search == Hooks::enableNames.end()) {
+		return false;
+	}
+
+	if (hasPostPrefix(name)) {
+		Hooks::postHandlers[search->second] = sol::nil;
+	} else {
+		Hooks::preHandlers[search->second] = sol::nil;
+	}
+	Hooks::updateEnabledKey(search->second);
+	return true;
+}
+
+void profiler::enable() { Profiler::enabled = true; }
+
+void profiler::disable() { Profiler::enabled = false; }
+
+bool profiler::isEnabled() { return Profiler::enabled; }
+
+void profiler::reset() { Profiler::reset(); }
+
+static sol::table histogramStats(const Profiler::Histogram& histogram) {
+	sol::table table = lua->create_table();
+	uint64_t count = histogram.getCount();
+
+	// Times are in microseconds
+	table["count"] = count;
+	table["total"] = histogram.getTotal() / 1000.0;
+	table["mean"] = count ? histogram.getTotal() / count / 1000.0 : 0.0;
+	table["p50"] = histogram.getPercentile(50) / 1000.0;
+	table["p90"] = histogram.getPercentile(90) / 1000.0;
+	table["p99"] = histogram.getPercentile(99) / 1000.0;
+	table["max"] = histogram.getMax() / 1000.0;
+	return table;
+}
+
+sol::table profiler::getStats() {
+	static constexpr const char* phaseKeys[Profiler::PHASE_SIZE] = {
+	    "pre", "original", "post"};
+
+	sol::table stats = lua->create_table();
+	stats["tick"] = histogramStats(Profiler::getTickHistogram());
+
+	sol::table hooks = lua->create_table();
+	for (const auto& [name, key] : Hooks::enableNames) {
+		sol::table phases = lua->create_table();
+		bool hasSamples = false;
+		for (int phase = 0; phase < Profiler::PHASE_SIZE; phase++) {
+			const auto& histogram =
+			    Profiler::getHistogram(key, (Profiler::Phase)phase);
+			if (histogram.getCount()) {
+				phases[phaseKeys[phase]] = histogramStats(histogram);
+				hasSamples = true;
+			}
+		}
+		if (hasSamples) {
+			hooks[name] = phases;
+		}
 	}
+	stats["hooks"] = hooks;
+
+	return stats;
 }
 
 sol::table physics::lineIntersectLevel(Vector* posA, Vector* posB,
                                        bool onlyCity) {
 	sol::table table = lua->create_table();
-	subhook::ScopedHookRemove remove(&Hooks::lineIntersectLevelHook);
+	Hooks::ScopedOriginal remove(&Hooks::lineIntersectLevelHook);
 	int res = Engine::lineIntersectLevel(posA, posB, !onlyCity);
 	if (res && (!onlyCity || Engine::lineIntersectResult->areaId != -1)) {
 		table["pos"] = Engine::lineIntersectResult->pos;
@@ -230,7 +711,7 @@ sol::table physics::lineIntersectLevel(Vector* posA, Vector* posB,
 sol::table physics::lineIntersectHuman(Human* man, Vector* posA, Vector* posB,
                                        float padding) {
 	sol::table table = lua->create_table();
-	subhook::ScopedHookRemove remove(&Hooks::lineIntersectHumanHook);
+	Hooks::ScopedOriginal remove(&Hooks::lineIntersectHumanHook);
 	int res = Engine::lineIntersectHuman(man->getIndex(), posA, posB, padding);
 	if (res) {
 		table["pos"] = Engine::lineIntersectResult->pos;
@@ -265,7 +746,7 @@ sol::object physics::lineIntersectLevelQuick(Vector* posA, Vector* posB,
                                              bool onlyCity, sol::this_state s) {
 	sol::state_view lua(s);
 
-	subhook::ScopedHookRemove remove(&Hooks::lineIntersectLevelHook);
+	Hooks::ScopedOriginal remove(&Hooks::lineIntersectLevelHook);
 	int res = Engine::lineIntersectLevel(posA, posB, !onlyCity);
 	if (res && (!onlyCity || Engine::lineIntersectResult->areaId != -1)) {
 		return sol::make_object(lua, Engine::lineIntersectResult->fraction);
@@ -278,7 +759,7 @@ sol::object physics::lineIntersectHumanQuick(Human* man, Vector* posA,
                                              sol::this_state s) {
 	sol::state_view lua(s);
 
-	subhook::ScopedHookRemove remove(&Hooks::lineIntersectHumanHook);
+	Hooks::ScopedOriginal remove(&Hooks::lineIntersectHumanHook);
 	int res = Engine::lineIntersectHuman(man->getIndex(), posA, posB, padding);
 	if (res) {
 		return sol::make_object(lua, Engine::lineIntersectResult->fraction);
@@ -311,7 +792,7 @@ std::tuple<sol::object, sol::object> physics::lineIntersectAnyQuick(
 	bool didHitLevel = false;
 
 	{
-		subhook::ScopedHookRemove remove(&Hooks::lineIntersectLevelHook);
+		Hooks::ScopedOriginal remove(&Hooks::lineIntersectLevelHook);
 		if (Engine::lineIntersectLevel(posA, posB, 1)) {
 			nearestFraction = Engine::lineIntersectResult->fraction;
 			didHitLevel = true;
@@ -319,21 +800,23 @@ std::tuple<sol::object, sol::object> physics::lineIntersectAnyQuick(
 	}
 
 	{
-		subhook::ScopedHookRemove remove(&Hooks::lineIntersectHumanHook);
-		for (int i = 0; i < maxNumberOfHumans; i++) {
-			Human* human = &Engine::humans[i];
-			if (i != ignoreHumanId && human->active &&
-			    Engine::lineIntersectHuman(i, posA, posB, humanPadding)) {
-				float fraction = Engine::lineIntersectResult->fraction;
-				if (fraction < nearestFraction) {
-					nearestFraction = fraction;
-					nearestObject = human;
-				}
-			}
-		}
-	}
-
-	for (int i = 0; i < maxNumberOfVehicles; i++) {
+		Hooks::ScopedOriginal remove(&Hooks::lineIntersectHumanHook);
+		getHumanGrid().queryRay(
+		    *posA, *posB, std::max(humanPadding, 0.f), [&](int i) {
+			    Human* human = &Engine::humans[i];
+			    if (i != ignoreHumanId && human->active &&
+			        Engine::lineIntersectHuman(i, posA, posB, humanPadding)) {
+				    float fraction = Engine::lineIntersectResult->fraction;
+				    if (fraction < nearestFraction) {
+					    nearestFraction = fraction;
+					    nearestObject = human;
+					    nearestIsVehicle = false;
+				    }
+			    }
+		    });
+	}
+
+	getVehicleGrid().queryRay(*posA, *posB, 0.f, [&](int i) {
 		Vehicle* vehicle = &Engine::vehicles[i];
 		if (vehicle->active &&
 		    Engine::lineIntersectVehicle(i, posA, posB, includeWheels)) {
@@ -344,7 +827,7 @@ std::tuple<sol::object, sol::object> physics::lineIntersectAnyQuick(
 				nearestIsVehicle = true;
 			}
 		}
-	}
+	});
 
 	if (nearestObject) {
 		if (nearestIsVehicle) {
@@ -364,6 +847,114 @@ std::tuple<sol::object, sol::object> physics::lineIntersectAnyQuick(
 	return std::make_tuple(sol::nil, sol::nil);
 }
 
+struct BatchRay {
+	Vector posA;
+	Vector posB;
+};
+
+struct BatchRayHit {
+	float fraction;
+	int type;
+	int index;
+};
+
+enum BatchHitType { NoHit, LevelHit, HumanHit, VehicleHit };
+
+static inline bool isNearSegment(const Vector& pos, const Vector& posA,
+                                 const Vector& posB, float radius) {
+	return pos.x >= std::min(posA.x, posB.x) - radius &&
+	       pos.x <= std::max(posA.x, posB.x) + radius &&
+	       pos.y >= std::min(posA.y, posB.y) - radius &&
+	       pos.y <= std::max(posA.y, posB.y) + radius &&
+	       pos.z >= std::min(posA.z, posB.z) - radius &&
+	       pos.z <= std::max(posA.z, posB.z) + radius;
+}
+
+int physics::lineIntersectAnyBatch(uintptr_t raysAddress,
+                                   uintptr_t resultsAddress, int count,
+                                   Human* ignoreHuman, float humanPadding,
+                                   bool includeWheels,
+                                   sol::optional<float> cullRadius) {
+	if (count < 0) {
+		throw std::invalid_argument(errorOutOfRange);
+	}
+
+	auto rays = reinterpret_cast<BatchRay*>(raysAddress);
+	auto results = reinterpret_cast<BatchRayHit*>(resultsAddress);
+	int ignoreHumanId = ignoreHuman ? ignoreHuman->getIndex() : -1;
+
+	auto& humanCandidates = getHumanGrid();
+	auto& vehicleCandidates = getVehicleGrid();
+	float humanMargin = std::max(humanPadding, 0.f);
+	int numHits = 0;
+
+	Hooks::ScopedOriginal removeLevel(&Hooks::lineIntersectLevelHook);
+	Hooks::ScopedOriginal removeHuman(&Hooks::lineIntersectHumanHook);
+
+	for (int r = 0; r < count; r++) {
+		Vector posA = rays[r].posA;
+		Vector posB = rays[r].posB;
+		BatchRayHit& hit = results[r];
+
+		hit.fraction = 1.f;
+		hit.type = NoHit;
+		hit.index = -1;
+
+		if (Engine::lineIntersectLevel(&posA, &posB, 1)) {
+			hit.fraction = Engine::lineIntersectResult->fraction;
+			hit.type = LevelHit;
+		}
+
+		// Nothing past the level hit can be nearer, so only the part of the ray
+		// in front of it is used to find candidates
+		Vector reachB = {posA.x + (posB.x - posA.x) * hit.fraction,
+		                 posA.y + (posB.y - posA.y) * hit.fraction,
+		                 posA.z + (posB.z - posA.z) * hit.fraction};
+
+		humanCandidates.queryRay(posA, reachB, humanMargin, [&](int i) {
+			Human* human = &Engine::humans[i];
+			if (i == ignoreHumanId || !human->active) return;
+			if (cullRadius &&
+			    !isNearSegment(human->pos, posA, reachB, *cullRadius)) {
+				return;
+			}
+
+			if (Engine::lineIntersectHuman(i, &posA, &posB, humanPadding)) {
+				float fraction = Engine::lineIntersectResult->fraction;
+				if (fraction < hit.fraction) {
+					hit.fraction = fraction;
+					hit.type = HumanHit;
+					hit.index = i;
+				}
+			}
+		});
+
+		vehicleCandidates.queryRay(posA, reachB, 0.f, [&](int i) {
+			Vehicle* vehicle = &Engine::vehicles[i];
+			if (!vehicle->active) return;
+			if (cullRadius &&
+			    !isNearSegment(vehicle->pos, posA, reachB, *cullRadius)) {
+				return;
+			}
+
+			if (Engine::lineIntersectVehicle(i, &posA, &posB, includeWheels)) {
+				float fraction = Engine::lineIntersectResult->fraction;
+				if (fraction < hit.fraction) {
+					hit.fraction = fraction;
+					hit.type = VehicleHit;
+					hit.index = i;
+				}
+			}
+		});
+
+		if (hit.type != NoHit) {
+			numHits++;
+		}
+	}
+
+	return numHits;
+}
+
 sol::object physics::lineIntersectTriangle(Vector* outPos, Vector* normal,
                                            Vector* posA, Vector* posB,
                                            Vector* triA, Vector* triB,
@@ -383,7 +974,7 @@ void physics::garbageCollectBullets() { Engine::bulletTimeToLive(); }
 void physics::createBlock(int blockX, int blockY, int blockZ,
                           unsigned int flags) {
 	short unk[8] = {15, 15, 15, 15, 15, 15, 15, 15};
-	subhook::ScopedHookRemove remove(&Hooks::areaCreateBlockHook);
+	Hooks::ScopedOriginal remove(&Hooks::areaCreateBlockHook);
 	Engine::areaCreateBlock(0, blockX, blockY, blockZ, flags, unk);
 }
 
@@ -392,7 +983,7 @@ unsigned int physics::getBlock(int blockX, int blockY, int blockZ) {
 }
 
 void physics::deleteBlock(int blockX, int blockY, int blockZ) {
-	subhook::ScopedHookRemove remove(&Hooks::areaDeleteBlockHook);
+	Hooks::ScopedOriginal remove(&Hooks::areaDeleteBlockHook);
 	Engine::areaDeleteBlock(0, blockX, blockY, blockZ);
 }
 
@@ -427,22 +1018,19 @@ ItemType* itemTypes::getByName(const char* name) {
 	return nullptr;
 }
 
-int items::getCount() {
-	int count = 0;
-	for (int i = 0; i < maxNumberOfItems; i++) {
-		if ((&Engine::items[i])->active) count++;
-	}
-	return count;
+int items::getCount() { return activeItems.count(Engine::items); }
+
+sol::table items::getAll(sol::optional<sol::table> reuse) {
+	return fillActiveTable(activeItems, Engine::items, reuse);
 }
 
-sol::table items::getAll() {
-	auto arr = lua->create_table();
-	for (int i = 0; i < maxNumberOfItems; i++) {
-		auto item = &Engine::items[i];
-		if (!item->active) continue;
-		arr.add(item);
-	}
-	return arr;
+std::tuple<sol::object, sol::lua_nil_t, int> items::iter() {
+	return activeIterator("items");
+}
+
+std::tuple<sol::optional<int>, sol::object> items::next(sol::object state,
+                                                     int previous) {
+	return nextActive(activeItems, Engine::items, previous);
 }
 
 Item* items::getByIndex(sol::table self, unsigned int idx) {
@@ -460,13 +1048,11 @@ Item* items::createVel(ItemType* type, Vector* pos, Vector* vel,
 		throw std::invalid_argument("Cannot create item with nil type");
 	}
 
-	subhook::ScopedHookRemove remove(&Hooks::createItemHook);
+	Hooks::ScopedOriginal remove(&Hooks::createItemHook);
 	int id = Engine::createItem(type->getIndex(), pos, vel, rot);
+	activeItems.insert(id);
 
-	if (id != -1 && itemDataTables[id]) {
-		delete itemDataTables[id];
-		itemDataTables[id] = nullptr;
-	}
+	if (id != -1) itemDataTables.clear(id);
 
 	return id == -1 ? nullptr : &Engine::items[id];
 }
@@ -502,44 +1088,53 @@ VehicleType* vehicleTypes::getByName(const char* name) {
 	return nullptr;
 }
 
-int vehicles::getCount() {
-	int count = 0;
-	for (int i = 0; i < maxNumberOfVehicles; i++) {
-		if ((&Engine::vehicles[i])->active) count++;
-	}
-	return count;
+int vehicles::getCount() { return activeVehicles.count(Engine::vehicles); }
+
+sol::table vehicles::getAll(sol::optional<sol::table> reuse) {
+	return fillActiveTable(activeVehicles, Engine::vehicles, reuse);
 }
 
-sol::table vehicles::getAll() {
-	auto arr = lua->create_table();
-	for (int i = 0; i < maxNumberOfVehicles; i++) {
-		auto vcl = &Engine::vehicles[i];
-		if (!vcl->active) continue;
-		arr.add(vcl);
-	}
-	return arr;
+std::tuple<sol::object, sol::lua_nil_t, int> vehicles::iter() {
+	return activeIterator("vehicles");
+}
+
+std::tuple<sol::optional<int>, sol::object> vehicles::next(sol::object state,
+                                                     int previous) {
+	return nextActive(activeVehicles, Engine::vehicles, previous);
 }
 
 sol::table vehicles::getNonTrafficCars() {
 	auto arr = lua->create_table();
-	for (int i = 0; i < maxNumberOfVehicles; i++) {
+	for (int i = activeVehicles.next(Engine::vehicles, 0); i != -1;
+	     i = activeVehicles.next(Engine::vehicles, i + 1)) {
 		auto vcl = &Engine::vehicles[i];
-		if (!vcl->active || vcl->trafficCarID > -1) continue;
-		arr.add(vcl);
+		if (vcl->trafficCarID > -1) continue;
+		arr.add(activeVehicles.getObject(lua->lua_state(), Engine::vehicles, i));
 	}
 	return arr;
 }
 
 sol::table vehicles::getTrafficCars() {
 	auto arr = lua->create_table();
-	for (int i = 0; i < maxNumberOfVehicles; i++) {
+	for (int i = activeVehicles.next(Engine::vehicles, 0); i != -1;
+	     i = activeVehicles.next(Engine::vehicles, i + 1)) {
 		auto vcl = &Engine::vehicles[i];
-		if (!vcl->active || vcl->trafficCarID == -1) continue;
-		arr.add(vcl);
+		if (vcl->trafficCarID == -1) continue;
+		arr.add(activeVehicles.getObject(lua->lua_state(), Engine::vehicles, i));
 	}
 	return arr;
 }
 
+sol::table vehicles::getInRadius(Vector* pos, float radius) {
+	return findActiveInRadius(getVehicleGrid(), activeVehicles, Engine::vehicles,
+	                          pos, radius);
+}
+
+sol::table vehicles::getInBox(Vector* min, Vector* max) {
+	return findActiveInBox(getVehicleGrid(), activeVehicles, Engine::vehicles,
+	                       min, max);
+}
+
 Vehicle* vehicles::getByIndex(sol::table self, unsigned int idx) {
 	if (idx >= maxNumberOfVehicles) throw std::invalid_argument(errorOutOfRange);
 	return &Engine::vehicles[idx];
@@ -556,13 +1151,11 @@ Vehicle* vehicles::createVel(VehicleType* type, Vector* pos, Vector* vel,
 		throw std::invalid_argument("Cannot create vehicle with nil type");
 	}
 
-	subhook::ScopedHookRemove remove(&Hooks::createVehicleHook);
+	Hooks::ScopedOriginal remove(&Hooks::createVehicleHook);
 	int id = Engine::createVehicle(type->getIndex(), pos, vel, rot, color);
+	activeVehicles.insert(id);
 
-	if (id != -1 && vehicleDataTables[id]) {
-		delete vehicleDataTables[id];
-		vehicleDataTables[id] = nullptr;
-	}
+	if (id != -1) vehicleDataTables.clear(id);
 
 	return id == -1 ? nullptr : &Engine::vehicles[id];
 }
@@ -576,7 +1169,7 @@ Event* chat::tellAdmins(const char* message) {
 }
 
 void accounts::save() {
-	subhook::ScopedHookRemove remove(&Hooks::saveAccountsServerHook);
+	Hooks::ScopedOriginal remove(&Hooks::saveAccountsServerHook);
 	Engine::saveAccountsServer();
 }
 
@@ -614,28 +1207,25 @@ Account* accounts::getByIndex(sol::table self, unsigned int idx) {
 	return &Engine::accounts[idx];
 }
 
-int players::getCount() {
-	int count = 0;
-	for (int i = 0; i < maxNumberOfPlayers; i++) {
-		if ((&Engine::players[i])->active) count++;
-	}
-	return count;
+int players::getCount() { return activePlayers.count(Engine::players); }
+
+sol::table players::getAll(sol::optional<sol::table> reuse) {
+	return fillActiveTable(activePlayers, Engine::players, reuse);
 }
 
-sol::table players::getAll() {
-	auto arr = lua->create_table();
-	for (int i = 0; i < maxNumberOfPlayers; i++) {
-		auto ply = &Engine::players[i];
-		if (!ply->active) continue;
-		arr.add(ply);
-	}
-	return arr;
+std::tuple<sol::object, sol::lua_nil_t, int> players::iter() {
+	return activeIterator("players");
+}
+
+std::tuple<sol::optional<int>, sol::object> players::next(sol::object state,
+                                                     int previous) {
+	return nextActive(activePlayers, Engine::players, previous);
 }
 
 Player* players::getByPhone(int phone) {
-	for (int i = 0; i < maxNumberOfPlayers; i++) {
+	for (int i = activePlayers.next(Engine::players, 0); i != -1;
+	     i = activePlayers.next(Engine::players, i + 1)) {
 		auto ply = &Engine::players[i];
-		if (!ply->active) continue;
 		if (ply->phoneNumber == phone) return ply;
 	}
 	return nullptr;
@@ -643,20 +1233,22 @@ Player* players::getByPhone(int phone) {
 
 sol::table players::getNonBots() {
 	auto arr = lua->create_table();
-	for (int i = 0; i < maxNumberOfPlayers; i++) {
+	for (int i = activePlayers.next(Engine::players, 0); i != -1;
+	     i = activePlayers.next(Engine::players, i + 1)) {
 		auto ply = &Engine::players[i];
-		if (!ply->active || !ply->subRosaID || ply->isBot) continue;
-		arr.add(ply);
+		if (!ply->subRosaID || ply->isBot) continue;
+		arr.add(activePlayers.getObject(lua->lua_state(), Engine::players, i));
 	}
 	return arr;
 }
 
 sol::table players::getBots() {
 	auto arr = lua->create_table();
-	for (int i = 0; i < maxNumberOfPlayers; i++) {
+	for (int i = activePlayers.next(Engine::players, 0); i != -1;
+	     i = activePlayers.next(Engine::players, i + 1)) {
 		auto ply = &Engine::players[i];
-		if (!ply->active || !ply->isBot) continue;
-		arr.add(ply);
+		if (!ply->isBot) continue;
+		arr.add(activePlayers.getObject(lua->lua_state(), Engine::players, i));
 	}
 	return arr;
 }
@@ -667,14 +1259,12 @@ Player* players::getByIndex(sol::table self, unsigned int idx) {
 }
 
 Player* players::createBot() {
-	subhook::ScopedHookRemove remove(&Hooks::createPlayerHook);
+	Hooks::ScopedOriginal remove(&Hooks::createPlayerHook);
 	int playerID = Engine::createPlayer();
+	activePlayers.insert(playerID);
 	if (playerID == -1) return nullptr;
 
-	if (playerDataTables[playerID]) {
-		delete playerDataTables[playerID];
-		playerDataTables[playerID] = nullptr;
-	}
+	playerDataTables.clear(playerID);
 
 	auto ply = &Engine::players[playerID];
 	ply->subRosaID = 0;
@@ -684,22 +1274,29 @@ Player* players::createBot() {
 	return ply;
 }
 
-int humans::getCount() {
-	int count = 0;
-	for (int i = 0; i < maxNumberOfHumans; i++) {
-		if ((&Engine::humans[i])->active) count++;
-	}
-	return count;
+int humans::getCount() { return activeHumans.count(Engine::humans); }
+
+sol::table humans::getAll(sol::optional<sol::table> reuse) {
+	return fillActiveTable(activeHumans, Engine::humans, reuse);
 }
 
-sol::table humans::getAll() {
-	auto arr = lua->create_table();
-	for (int i = 0; i < maxNumberOfHumans; i++) {
-		auto man = &Engine::humans[i];
-		if (!man->active) continue;
-		arr.add(man);
-	}
-	return arr;
+std::tuple<sol::object, sol::lua_nil_t, int> humans::iter() {
+	return activeIterator("humans");
+}
+
+std::tuple<sol::optional<int>, sol::object> humans::next(sol::object state,
+                                                     int previous) {
+	return nextActive(activeHumans, Engine::humans, previous);
+}
+
+sol::table humans::getInRadius(Vector* pos, float radius) {
+	return findActiveInRadius(getHumanGrid(), activeHumans, Engine::humans, pos,
+	                          radius);
+}
+
+sol::table humans::getInBox(Vector* min, Vector* max) {
+	return findActiveInBox(getHumanGrid(), activeHumans, Engine::humans, min,
+	                       max);
 }
 
 Human* humans::getByIndex(sol::table self, unsigned int idx) {
@@ -710,20 +1307,19 @@ Human* humans::getByIndex(sol::table self, unsigned int idx) {
 Human* humans::create(Vector* pos, RotMatrix* rot, Player* ply) {
 	int playerID = ply->getIndex();
 	if (ply->humanID != -1) {
-		subhook::ScopedHookRemove remove(&Hooks::deleteHumanHook);
+		Hooks::ScopedOriginal remove(&Hooks::deleteHumanHook);
 		Engine::deleteHuman(ply->humanID);
+		activeHumans.erase(ply->humanID);
 	}
 	int humanID;
 	{
-		subhook::ScopedHookRemove remove(&Hooks::createHumanHook);
+		Hooks::ScopedOriginal remove(&Hooks::createHumanHook);
 		humanID = Engine::createHuman(pos, rot, playerID);
+		activeHumans.insert(humanID);
 	}
 	if (humanID == -1) return nullptr;
 
-	if (humanDataTables[humanID]) {
-		delete humanDataTables[humanID];
-		humanDataTables[humanID] = nullptr;
-	}
+	humanDataTables.clear(humanID);
 
 	auto man = &Engine::humans[humanID];
 	man->playerID = playerID;
@@ -743,28 +1339,25 @@ sol::table bullets::getAll() {
 }
 
 Bullet* bullets::create(int type, Vector* pos, Vector* vel, Player* ply) {
-	subhook::ScopedHookRemove remove(&Hooks::createBulletHook);
+	Hooks::ScopedOriginal remove(&Hooks::createBulletHook);
 	int bulletID = Engine::createBullet(type, pos, vel,
 	                                    ply == nullptr ? -1 : ply->getIndex());
 	return bulletID == -1 ? nullptr : &Engine::bullets[bulletID];
 }
 
-int rigidBodies::getCount() {
-	int count = 0;
-	for (int i = 0; i < maxNumberOfRigidBodies; i++) {
-		if ((&Engine::bodies[i])->active) count++;
-	}
-	return count;
+int rigidBodies::getCount() { return activeBodies.count(Engine::bodies); }
+
+sol::table rigidBodies::getAll(sol::optional<sol::table> reuse) {
+	return fillActiveTable(activeBodies, Engine::bodies, reuse);
 }
 
-sol::table rigidBodies::getAll() {
-	auto arr = lua->create_table();
-	for (int i = 0; i < maxNumberOfRigidBodies; i++) {
-		auto body = &Engine::bodies[i];
-		if (!body->active) continue;
-		arr.add(body);
-	}
-	return arr;
+std::tuple<sol::object, sol::lua_nil_t, int> rigidBodies::iter() {
+	return activeIterator("rigidBodies");
+}
+
+std::tuple<sol::optional<int>, sol::object> rigidBodies::next(sol::object state,
+                                                     int previous) {
+	return nextActive(activeBodies, Engine::bodies, previous);
 }
 
 RigidBody* rigidBodies::getByIndex(sol::table self, unsigned int idx) {
@@ -845,7 +1438,7 @@ TrafficCar* trafficCars::getByIndex(sol::table self, unsigned int idx) {
 }
 
 void trafficCars::createMany(int amount) {
-	subhook::ScopedHookRemove remove(&Hooks::createTrafficHook);
+	Hooks::ScopedOriginal remove(&Hooks::createTrafficHook);
 	Engine::createTraffic(amount);
 }
 
@@ -882,21 +1475,21 @@ Event* events::getByIndex(sol::table self, unsigned int idx) {
 
 Event* events::createBullet(int bulletType, Vector* pos, Vector* vel,
                             Item* item) {
-	subhook::ScopedHookRemove remove(&Hooks::createEventBulletHook);
+	Hooks::ScopedOriginal remove(&Hooks::createEventBulletHook);
 	Engine::createEventBullet(bulletType, pos, vel,
 	                          item == nullptr ? -1 : item->getIndex());
 	return &Engine::events[*Engine::numEvents - 1];
 }
 
 Event* events::createBulletHit(int hitType, Vector* pos, Vector* normal) {
-	subhook::ScopedHookRemove remove(&Hooks::createEventBulletHitHook);
+	Hooks::ScopedOriginal remove(&Hooks::createEventBulletHitHook);
 	Engine::createEventBulletHit(0, hitType, pos, normal);
 	return &Engine::events[*Engine::numEvents - 1];
 }
 
 Event* events::createMessage(int messageType, const char* message,
                              int speakerID, int volumeLevel) {
-	subhook::ScopedHookRemove remove(&Hooks::createEventMessageHook);
+	Hooks::ScopedOriginal remove(&Hooks::createEventMessageHook);
 	Engine::createEventMessage(messageType, (char*)message, speakerID,
 	                           volumeLevel);
 	return &Engine::events[*Engine::numEvents - 1];
@@ -904,7 +1497,7 @@ Event* events::createMessage(int messageType, const char* message,
 
 Event* events::createSound(int soundType, Vector* pos, float volume,
                            float pitch) {
-	subhook::ScopedHookRemove remove(&Hooks::createEventSoundHook);
+	Hooks::ScopedOriginal remove(&Hooks::createEventSoundHook);
 	Engine::createEventSound(soundType, pos, volume, pitch);
 	return &Engine::events[*Engine::numEvents - 1];
 }
@@ -912,20 +1505,20 @@ Event* events::createSound(int soundType, Vector* pos, float volume,
 Event* events::createSoundItem(int soundType, Item* item, float volume,
                                float pitch) {
 	if (!item) throw std::invalid_argument(missingArgument);
-	subhook::ScopedHookRemove remove(&Hooks::createEventSoundHook);
+	Hooks::ScopedOriginal remove(&Hooks::createEventSoundHook);
 	Engine::createEventSoundItem(soundType, item->getIndex(), volume, pitch);
 	return &Engine::events[*Engine::numEvents - 1];
 }
 
 Event* events::createSoundItemSimple(int soundType, Item* item) {
 	if (!item) throw std::invalid_argument(missingArgument);
-	subhook::ScopedHookRemove remove(&Hooks::createEventSoundHook);
+	Hooks::ScopedOriginal remove(&Hooks::createEventSoundHook);
 	Engine::createEventSoundItem(soundType, item->getIndex(), 1.0f, 1.0f);
 	return &Engine::events[*Engine::numEvents - 1];
 }
 
 Event* events::createSoundSimple(int soundType, Vector* pos) {
-	subhook::ScopedHookRemove remove(&Hooks::createEventSoundHook);
+	Hooks::ScopedOriginal remove(&Hooks::createEventSoundHook);
 	Engine::createEventSound(soundType, pos, 1.0f, 1.0f);
 	return &Engine::events[*Engine::numEvents - 1];
 }
@@ -993,6 +1586,13 @@ void os::exitCode(int code) {
 	::exit(code);
 }
 
+bool console::addLogFile(std::string_view fileName,
+                         sol::optional<size_t> maxSize,
+                         sol::optional<int> maxFiles) {
+	return Console::addLogFile(fileName, maxSize.value_or(0),
+	                           maxFiles.value_or(defaultMaxLogFiles));
+}
+
 uintptr_t memory::baseAddress;
 
 uintptr_t memory::getBaseAddress() { return baseAddress; }
@@ -1342,13 +1942,7 @@ int Account::getIndex() const {
 }
 
 sol::table Account::getDataTable() const {
-	int index = getIndex();
-
-	if (!accountDataTables[index]) {
-		accountDataTables[index] = new sol::table(lua->lua_state(), sol::create);
-	}
-
-	return *accountDataTables[index];
+	return accountDataTables.get(lua->lua_state(), getIndex());
 }
 
 std::string Vector::__tostring() const {
@@ -1538,17 +2132,11 @@ int Player::getIndex() const {
 }
 
 sol::table Player::getDataTable() const {
-	int index = getIndex();
-
-	if (!playerDataTables[index]) {
-		playerDataTables[index] = new sol::table(lua->lua_state(), sol::create);
-	}
-
-	return *playerDataTables[index];
+	return playerDataTables.get(lua->lua_state(), getIndex());
 }
 
 Event* Player::update() const {
-	subhook::ScopedHookRemove remove(&Hooks::createEventUpdatePlayerHook);
+	Hooks::ScopedOriginal remove(&Hooks::createEventUpdatePlayerHook);
 	Engine::createEventUpdatePlayer(getIndex());
 	return &Engine::events[*Engine::numEvents - 1];
 }
@@ -1567,11 +2155,11 @@ Event* Player::updateElimState(int trackerVisible, int playerTeam,
 	}
 
 	if (saviorPos) {
-		subhook::ScopedHookRemove remove(&Hooks::createEventUpdateElimStateHook);
+		Hooks::ScopedOriginal remove(&Hooks::createEventUpdateElimStateHook);
 		Engine::createEventUpdateElimState(getIndex(), trackerVisible, playerTeam,
 		                                   playerIdx, saviorPos.value());
 	} else {
-		subhook::ScopedHookRemove remove(&Hooks::createEventUpdateElimStateHook);
+		Hooks::ScopedOriginal remove(&Hooks::createEventUpdateElimStateHook);
 		Engine::createEventUpdateElimState(getIndex(), trackerVisible, playerTeam,
 		                                   playerIdx, nullptr);
 	}
@@ -1582,17 +2170,15 @@ Event* Player::updateElimState(int trackerVisible, int playerTeam,
 void Player::remove() const {
 	int index = getIndex();
 
-	subhook::ScopedHookRemove remove(&Hooks::deletePlayerHook);
+	Hooks::ScopedOriginal remove(&Hooks::deletePlayerHook);
 	Engine::deletePlayer(index);
+	activePlayers.erase(index);
 
-	if (playerDataTables[index]) {
-		delete playerDataTables[index];
-		playerDataTables[index] = nullptr;
-	}
+	playerDataTables.clear(index);
 }
 
 void Player::sendMessage(const char* message) const {
-	subhook::ScopedHookRemove remove(&Hooks::createEventMessageHook);
+	Hooks::ScopedOriginal remove(&Hooks::createEventMessageHook);
 	Engine::createEventMessage(6, (char*)message, getIndex(), 0);
 }
 
@@ -1662,25 +2248,17 @@ int Human::getIndex() const {
 }
 
 sol::table Human::getDataTable() const {
-	int index = getIndex();
-
-	if (!humanDataTables[index]) {
-		humanDataTables[index] = new sol::table(lua->lua_state(), sol::create);
-	}
-
-	return *humanDataTables[index];
+	return humanDataTables.get(lua->lua_state(), getIndex());
 }
 
 void Human::remove() const {
 	int index = getIndex();
 
-	subhook::ScopedHookRemove remove(&Hooks::deleteHumanHook);
+	Hooks::ScopedOriginal remove(&Hooks::deleteHumanHook);
 	Engine::deleteHuman(index);
+	activeHumans.erase(index);
 
-	if (humanDataTables[index]) {
-		delete humanDataTables[index];
-		humanDataTables[index] = nullptr;
-	}
+	humanDataTables.clear(index);
 }
 
 Player* Human::getPlayer() const {
@@ -1731,7 +2309,7 @@ void Human::teleport(Vector* vec) {
 };
 
 void Human::speak(const char* message, int distance) const {
-	subhook::ScopedHookRemove remove(&Hooks::createEventMessageHook);
+	Hooks::ScopedOriginal remove(&Hooks::createEventMessageHook);
 	Engine::createEventMessage(1, (char*)message, getIndex(), distance);
 }
 
@@ -1772,12 +2350,12 @@ void Human::addVelocity(Vector* vel) const {
 }
 
 bool Human::mountItem(Item* childItem, unsigned int slot) const {
-	subhook::ScopedHookRemove remove(&Hooks::linkItemHook);
+	Hooks::ScopedOriginal remove(&Hooks::linkItemHook);
 	return Engine::linkItem(childItem->getIndex(), -1, getIndex(), slot);
 }
 
 void Human::applyDamage(int bone, int damage) const {
-	subhook::ScopedHookRemove remove(&Hooks::humanApplyDamageHook);
+	Hooks::ScopedOriginal remove(&Hooks::humanApplyDamageHook);
 	Engine::humanApplyDamage(getIndex(), bone, 0, damage);
 }
 
@@ -1818,13 +2396,7 @@ int Item::getIndex() const {
 }
 
 sol::table Item::getDataTable() const {
-	int index = getIndex();
-
-	if (!itemDataTables[index]) {
-		itemDataTables[index] = new sol::table(lua->lua_state(), sol::create);
-	}
-
-	return *itemDataTables[index];
+	return itemDataTables.get(lua->lua_state(), getIndex());
 }
 
 ItemType* Item::getType() { return &Engine::itemTypes[type]; }
@@ -1840,13 +2412,11 @@ void Item::setType(ItemType* itemType) {
 void Item::remove() const {
 	int index = getIndex();
 
-	subhook::ScopedHookRemove remove(&Hooks::deleteItemHook);
+	Hooks::ScopedOriginal remove(&Hooks::deleteItemHook);
 	Engine::deleteItem(index);
+	activeItems.erase(index);
 
-	if (itemDataTables[index]) {
-		delete itemDataTables[index];
-		itemDataTables[index] = nullptr;
-	}
+	itemDataTables.clear(index);
 }
 
 Player* Item::getGrenadePrimer() const {
@@ -1898,38 +2468,38 @@ void Item::setVehicle(Vehicle* vehicle) {
 }
 
 bool Item::mountItem(Item* childItem, unsigned int slot) const {
-	subhook::ScopedHookRemove remove(&Hooks::linkItemHook);
+	Hooks::ScopedOriginal remove(&Hooks::linkItemHook);
 	return Engine::linkItem(getIndex(), childItem->getIndex(), -1, slot);
 }
 
 bool Item::unmount() const {
-	subhook::ScopedHookRemove remove(&Hooks::linkItemHook);
+	Hooks::ScopedOriginal remove(&Hooks::linkItemHook);
 	return Engine::linkItem(getIndex(), -1, -1, 0);
 }
 
 Event* Item::update() const {
-	subhook::ScopedHookRemove remove(&Hooks::createEventUpdateItemInfoHook);
+	Hooks::ScopedOriginal remove(&Hooks::createEventUpdateItemInfoHook);
 	Engine::createEventUpdateItemInfo(getIndex());
 	return &Engine::events[*Engine::numEvents - 1];
 }
 
 void Item::speak(const char* message, int distance) const {
-	subhook::ScopedHookRemove remove(&Hooks::createEventMessageHook);
+	Hooks::ScopedOriginal remove(&Hooks::createEventMessageHook);
 	Engine::createEventMessage(2, (char*)message, getIndex(), distance);
 }
 
 void Item::explode() const {
-	subhook::ScopedHookRemove remove(&Hooks::grenadeExplosionHook);
+	Hooks::ScopedOriginal remove(&Hooks::grenadeExplosionHook);
 	Engine::grenadeExplosion(getIndex());
 }
 
 void Item::sound(int soundType, float volume, float pitch) const {
-	subhook::ScopedHookRemove remove(&Hooks::createEventSoundItemHook);
+	Hooks::ScopedOriginal remove(&Hooks::createEventSoundItemHook);
 	Engine::createEventSoundItem(soundType, getIndex(), volume, pitch);
 }
 
 void Item::soundSimple(int soundType) const {
-	subhook::ScopedHookRemove remove(&Hooks::createEventSoundItemHook);
+	Hooks::ScopedOriginal remove(&Hooks::createEventSoundItemHook);
 	Engine::createEventSoundItem(soundType, getIndex(), 1.0f, 1.0f);
 }
 
@@ -2006,13 +2576,7 @@ void Vehicle::setType(VehicleType* vehicleType) {
 }
 
 sol::table Vehicle::getDataTable() const {
-	int index = getIndex();
-
-	if (!vehicleDataTables[index]) {
-		vehicleDataTables[index] = new sol::table(lua->lua_state(), sol::create);
-	}
-
-	return *vehicleDataTables[index];
+	return vehicleDataTables.get(lua->lua_state(), getIndex());
 }
 
 Event* Vehicle::updateType() const {
@@ -2022,7 +2586,7 @@ Event* Vehicle::updateType() const {
 
 Event* Vehicle::updateDestruction(int updateType, int partID, Vector* pos,
                                   Vector* normal) const {
-	subhook::ScopedHookRemove remove(&Hooks::createEventUpdateVehicleHook);
+	Hooks::ScopedOriginal remove(&Hooks::createEventUpdateVehicleHook);
 	Engine::createEventUpdateVehicle(getIndex(), updateType, partID, pos, normal);
 	return &Engine::events[*Engine::numEvents - 1];
 }
@@ -2030,13 +2594,11 @@ Event* Vehicle::updateDestruction(int updateType, int partID, Vector* pos,
 void Vehicle::remove() const {
 	int index = getIndex();
 
-	subhook::ScopedHookRemove remove(&Hooks::deleteVehicleHook);
+	Hooks::ScopedOriginal remove(&Hooks::deleteVehicleHook);
 	Engine::deleteVehicle(index);
+	activeVehicles.erase(index);
 
-	if (vehicleDataTables[index]) {
-		delete vehicleDataTables[index];
-		vehicleDataTables[index] = nullptr;
-	}
+	vehicleDataTables.clear(index);
 }
 
 Player* Vehicle::getLastDriver() const {
@@ -2087,13 +2649,7 @@ int RigidBody::getIndex() const {
 }
 
 sol::table RigidBody::getDataTable() const {
-	int index = getIndex();
-
-	if (!bodyDataTables[index]) {
-		bodyDataTables[index] = new sol::table(lua->lua_state(), sol::create);
-	}
-
-	return *bodyDataTables[index];
+	return bodyDataTables.get(lua->lua_state(), getIndex());
 }
 
 Bond* RigidBody::bondTo(RigidBody* other, Vector* thisLocalPos,
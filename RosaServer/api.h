@@ -4,9 +4,15 @@
 #include <queue>
 #include <thread>
 
+#include "activelist.h"
+#include "datatables.h"
 #include "engine.h"
 #include "hooks.h"
+#include "httppool.h"
+#include "pointgraph.h"
 #include "sol/sol.hpp"
+#include "spatialgrid.h"
+#include "sqlite.h"
 
 #define CPPHTTPLIB_OPENSSL_SUPPORT
 #include "../cpp-httplib/httplib.h"
@@ -27,32 +33,27 @@ extern bool shouldReset;
 extern sol::state* lua;
 extern std::string hookMode;
 
-extern sol::table* accountDataTables[maxNumberOfAccounts];
-extern sol::table* playerDataTables[maxNumberOfPlayers];
-extern sol::table* humanDataTables[maxNumberOfHumans];
-extern sol::table* itemDataTables[maxNumberOfItems];
-extern sol::table* vehicleDataTables[maxNumberOfVehicles];
-extern sol::table* bodyDataTables[maxNumberOfRigidBodies];
-
-enum LuaRequestType { get, post };
-
-struct LuaHTTPRequest {
-	LuaRequestType type;
-	std::string scheme;
-	std::string path;
-	std::shared_ptr<sol::protected_function> callback;
-	std::string contentType;
-	std::string body;
-	httplib::Headers headers;
-};
-
-struct LuaHTTPResponse {
-	std::shared_ptr<sol::protected_function> callback;
-	bool responded;
-	int status;
-	std::string body;
-	httplib::Headers headers;
-};
+extern DataTables accountDataTables;
+extern DataTables playerDataTables;
+extern DataTables humanDataTables;
+extern DataTables itemDataTables;
+extern DataTables vehicleDataTables;
+extern DataTables bodyDataTables;
+
+extern ActiveList<Player, maxNumberOfPlayers> activePlayers;
+extern ActiveList<Human, maxNumberOfHumans> activeHumans;
+extern ActiveList<Item, maxNumberOfItems> activeItems;
+extern ActiveList<Vehicle, maxNumberOfVehicles> activeVehicles;
+extern ActiveList<RigidBody, maxNumberOfRigidBodies> activeBodies;
+
+void rebuildActiveLists();
+void clearActiveObjects();
+
+extern SpatialGrid<maxNumberOfHumans> humanGrid;
+extern SpatialGrid<maxNumberOfVehicles> vehicleGrid;
+
+// Rebuilt after every physics step, and lazily when objects are created
+void rebuildSpatialGrids();
 
 extern std::mutex stateResetMutex;
 
@@ -61,6 +62,19 @@ bool noLuaCallError(sol::protected_function_result* res);
 bool noLuaCallError(sol::load_result* res);
 void hookAndReset(int reason);
 
+// Calls the callbacks of finished async HTTP requests, once per tick
+void drainHTTPResponses();
+// Must be called before the Lua state the callbacks belong to is destroyed
+void clearHTTPCallbacks();
+// Calls the callbacks of finished thread pool tasks, once per tick
+void drainThreadResults();
+// Must be called before the Lua state the callbacks belong to is destroyed
+void clearThreadCallbacks();
+// Calls the callbacks of finished SQLite writer queries, once per tick
+void drainSQLiteWrites();
+// Must be called before the Lua state the callbacks belong to is destroyed
+void clearSQLiteCallbacks();
+
 void defineThreadSafeAPIs(sol::state* state);
 void luaInit(bool redo = false);
 
@@ -80,14 +94,51 @@ sol::object getSync(const char* scheme, const char* path, sol::table headers,
 sol::object postSync(const char* scheme, const char* path, sol::table headers,
                      std::string body, const char* contentType,
                      sol::this_state s);
+bool get(const char* scheme, const char* path, sol::table headers,
+         sol::protected_function callback);
+bool post(const char* scheme, const char* path, sol::table headers,
+          std::string body, const char* contentType,
+          sol::protected_function callback);
 };  // namespace http
 
+namespace serializer {
+std::string encode(sol::object value);
+sol::object decode(std::string_view data, sol::this_state s);
+};  // namespace serializer
+
+namespace threads {
+void load(std::string fileName);
+bool submit(std::string functionName, sol::object argument,
+            sol::protected_function callback);
+// The graph has to be sealed, since it's searched while Lua carries on
+bool findShortestPaths(PointGraph& graph, sol::table requests,
+                       sol::protected_function callback);
+int getCount();
+int getPending();
+};  // namespace threads
+
+namespace sqlite {
+void queryAsync(SQLite& db, std::string sql,
+                sol::optional<sol::table> arguments,
+                sol::optional<sol::protected_function> callback);
+};  // namespace sqlite
+
 namespace hook {
 bool enable(std::string name);
 bool disable(std::string name);
 void clear();
+bool on(std::string name, sol::protected_function handler);
+bool off(std::string name);
 };  // namespace hook
 
+namespace profiler {
+void enable();
+void disable();
+bool isEnabled();
+void reset();
+sol::table getStats();
+};  // namespace profiler
+
 namespace physics {
 sol::table lineIntersectLevel(Vector* posA, Vector* posB, bool onlyCity);
 sol::table lineIntersectHuman(Human* man, Vector* posA, Vector* posB,
@@ -103,6 +154,15 @@ sol::object lineIntersectVehicleQuick(Vehicle* vcl, Vector* posA, Vector* posB,
 std::tuple<sol::object, sol::object> lineIntersectAnyQuick(
     Vector* posA, Vector* posB, Human* ignoreHuman, float humanPadding,
     bool includeWheels, sol::this_state s);
+// Casts count rays read from raysAddress, each laid out as two packed float
+// vectors (posA, posB), and writes one { float fraction; int type; int index; }
+// per ray to resultsAddress. Type is 0 for no hit, 1 for the level, 2 for a
+// human and 3 for a vehicle; index is -1 unless an object was hit. If
+// cullRadius is given, objects whose position is further than it from the
+// part of a ray before the level hit are skipped. Returns the number of hits.
+int lineIntersectAnyBatch(uintptr_t raysAddress, uintptr_t resultsAddress,
+                          int count, Human* ignoreHuman, float humanPadding,
+                          bool includeWheels, sol::optional<float> cullRadius);
 sol::object lineIntersectTriangle(Vector* outPos, Vector* normal, Vector* posA,
                                   Vector* posB, Vector* triA, Vector* triB,
                                   Vector* triC, sol::this_state s);
@@ -123,7 +183,10 @@ ItemType* getByName(const char* name);
 
 namespace items {
 int getCount();
-sol::table getAll();
+sol::table getAll(sol::optional<sol::table> reuse);
+std::tuple<sol::object, sol::lua_nil_t, int> iter();
+std::tuple<sol::optional<int>, sol::object> next(sol::object state,
+                                                 int previous);
 Item* getByIndex(sol::table self, unsigned int idx);
 Item* create(ItemType* type, Vector* pos, RotMatrix* rot);
 Item* createVel(ItemType* typee, Vector* pos, Vector* vel, RotMatrix* rot);
@@ -139,9 +202,14 @@ VehicleType* getByName(const char* name);
 
 namespace vehicles {
 int getCount();
-sol::table getAll();
+sol::table getAll(sol::optional<sol::table> reuse);
+std::tuple<sol::object, sol::lua_nil_t, int> iter();
+std::tuple<sol::optional<int>, sol::object> next(sol::object state,
+                                                 int previous);
 sol::table getNonTrafficCars();
 sol::table getTrafficCars();
+sol::table getInRadius(Vector* pos, float radius);
+sol::table getInBox(Vector* min, Vector* max);
 Vehicle* getByIndex(sol::table self, unsigned int idx);
 Vehicle* create(VehicleType* type, Vector* pos, RotMatrix* rot, int color);
 Vehicle* createVel(VehicleType* type, Vector* pos, Vector* vel, RotMatrix* rot,
@@ -163,7 +231,10 @@ Account* getByIndex(sol::table self, unsigned int idx);
 
 namespace players {
 int getCount();
-sol::table getAll();
+sol::table getAll(sol::optional<sol::table> reuse);
+std::tuple<sol::object, sol::lua_nil_t, int> iter();
+std::tuple<sol::optional<int>, sol::object> next(sol::object state,
+                                                 int previous);
 Player* getByPhone(int phone);
 sol::table getNonBots();
 sol::table getBots();
@@ -173,7 +244,12 @@ Player* createBot();
 
 namespace humans {
 int getCount();
-sol::table getAll();
+sol::table getAll(sol::optional<sol::table> reuse);
+std::tuple<sol::object, sol::lua_nil_t, int> iter();
+std::tuple<sol::optional<int>, sol::object> next(sol::object state,
+                                                 int previous);
+sol::table getInRadius(Vector* pos, float radius);
+sol::table getInBox(Vector* min, Vector* max);
 Human* getByIndex(sol::table self, unsigned int idx);
 Human* create(Vector* pos, RotMatrix* rot, Player* ply);
 };  // namespace humans
@@ -186,7 +262,10 @@ Bullet* create(int type, Vector* pos, Vector* vel, Player* ply);
 
 namespace rigidBodies {
 int getCount();
-sol::table getAll();
+sol::table getAll(sol::optional<sol::table> reuse);
+std::tuple<sol::object, sol::lua_nil_t, int> iter();
+std::tuple<sol::optional<int>, sol::object> next(sol::object state,
+                                                 int previous);
 RigidBody* getByIndex(sol::table self, unsigned int idx);
 };  // namespace rigidBodies
 
@@ -251,6 +330,13 @@ void exit();
 void exitCode(int code);
 };  // namespace os
 
+namespace console {
+static constexpr int defaultMaxLogFiles = 5;
+// A nil maxSize never rotates
+bool addLogFile(std::string_view fileName, sol::optional<size_t> maxSize,
+                sol::optional<int> maxFiles);
+};  // namespace console
+
 namespace memory {
 extern uintptr_t baseAddress;
 uintptr_t getBaseAddress();
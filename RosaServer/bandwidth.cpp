@@ -0,0 +1,216 @@
+#include "bandwidth.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "api.h"
+
+static constexpr const char* errorInvalidBudget = "Budget must be positive";
+static constexpr const char* errorNoConnection = "Expected a connection";
+
+namespace {
+struct Totals {
+	Bandwidth::Counter sent;
+	Bandwidth::Counter received;
+};
+
+struct ConnectionState {
+	Bandwidth::Counter sent;
+	Bandwidth::Counter dropped;
+
+	// 0 if there's no budget
+	double bytesPerSecond = 0;
+	double available = 0;
+	std::chrono::steady_clock::time_point lastRefill;
+
+	bool hasBudget() const { return bytesPerSecond > 0; }
+};
+};  // namespace
+
+static Totals total;
+static Totals currentTick;
+static Totals lastTick;
+static Totals types[256];
+static std::unordered_map<uint64_t, ConnectionState> connectionStates;
+
+static uint64_t getKey(unsigned int address, unsigned short port) {
+	return (uint64_t)address << 16 | port;
+}
+
+static bool isConnected(uint64_t key) {
+	for (unsigned int i = 0; i < *Engine::numConnections; i++) {
+		const auto& connection = Engine::connections[i];
+		if (getKey(connection.address, connection.port) == key) return true;
+	}
+	return false;
+}
+
+static sol::table counterTable(const Bandwidth::Counter& counter) {
+	sol::table table = lua->create_table();
+	table["packets"] = counter.packets;
+	table["bytes"] = counter.bytes;
+	return table;
+}
+
+static sol::table totalsTable(const Totals& totals) {
+	sol::table table = lua->create_table();
+	table["sent"] = counterTable(totals.sent);
+	table["received"] = counterTable(totals.received);
+	return table;
+}
+
+static void countSent(uint8_t type, int size) {
+	total.sent.add(size);
+	currentTick.sent.add(size);
+	types[type].sent.add(size);
+}
+
+namespace Bandwidth {
+bool countSend(unsigned int address, unsigned short port, uint8_t type,
+               int size) {
+	// Anyone can query the server, so only connections get their own counts
+	uint64_t key = getKey(address, port);
+	auto it = connectionStates.find(key);
+	if (it == connectionStates.end()) {
+		if (!isConnected(key)) {
+			countSent(type, size);
+			return true;
+		}
+		it = connectionStates.emplace(key, ConnectionState()).first;
+	}
+	auto& state = it->second;
+
+	if (state.hasBudget()) {
+		auto now = std::chrono::steady_clock::now();
+		std::chrono::duration<double> elapsed = now - state.lastRefill;
+		state.lastRefill = now;
+		// Room for at least this packet, or one bigger than the budget would
+		// never get through
+		state.available = std::min(
+		    std::max(state.bytesPerSecond, (double)size),
+		    state.available + elapsed.count() * state.bytesPerSecond);
+
+		if (state.available < size) {
+			state.dropped.add(size);
+			return false;
+		}
+		state.available -= size;
+	}
+
+	state.sent.add(size);
+	countSent(type, size);
+	return true;
+}
+
+void countReceive(uint8_t type, int size) {
+	total.received.add(size);
+	currentTick.received.add(size);
+	types[type].received.add(size);
+}
+
+void endTick() {
+	lastTick = currentTick;
+	currentTick = {};
+
+	// Budgets are kept for when the connection comes back
+	for (auto it = connectionStates.begin(); it != connectionStates.end();) {
+		if (!it->second.hasBudget() && !isConnected(it->first)) {
+			it = connectionStates.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void reset() {
+	total = {};
+	currentTick = {};
+	lastTick = {};
+	for (auto& totals : types) {
+		totals = {};
+	}
+
+	// Budgets are kept, along with what they have left
+	for (auto it = connectionStates.begin(); it != connectionStates.end();) {
+		if (it->second.hasBudget()) {
+			it->second.sent = {};
+			it->second.dropped = {};
+			++it;
+		} else {
+			it = connectionStates.erase(it);
+		}
+	}
+}
+
+sol::table getStats() {
+	sol::table stats = lua->create_table();
+	stats["total"] = totalsTable(total);
+	stats["lastTick"] = totalsTable(lastTick);
+
+	sol::table typesTable = lua->create_table();
+	for (int type = 0; type < 256; type++) {
+		if (types[type].sent.packets || types[type].received.packets) {
+			typesTable[type] = totalsTable(types[type]);
+		}
+	}
+	stats["types"] = typesTable;
+
+	// Keyed by "address:port", the same as Connection.address plus the port
+	sol::table connectionsTable = lua->create_table();
+	for (const auto& [key, state] : connectionStates) {
+		sol::table table = lua->create_table();
+		table["sent"] = counterTable(state.sent);
+		table["dropped"] = counterTable(state.dropped);
+		if (state.hasBudget()) table["budget"] = state.bytesPerSecond;
+
+		connectionsTable[addressFromInteger(key >> 16) + ":" +
+		                 std::to_string(key & 0xffff)] = table;
+	}
+	stats["connections"] = connectionsTable;
+
+	return stats;
+}
+
+void setBudget(Connection* connection, sol::optional<double> bytesPerSecond) {
+	if (!connection) {
+		throw std::invalid_argument(errorNoConnection);
+	}
+
+	uint64_t key = getKey(connection->address, connection->port);
+
+	if (!bytesPerSecond) {
+		auto it = connectionStates.find(key);
+		if (it != connectionStates.end()) {
+			it->second.bytesPerSecond = 0;
+		}
+		return;
+	}
+
+	if (*bytesPerSecond <= 0) {
+		throw std::invalid_argument(errorInvalidBudget);
+	}
+
+	auto& state = connectionStates[key];
+	if (!state.hasBudget()) {
+		// Start with a full second to spend
+		state.available = *bytesPerSecond;
+		state.lastRefill = std::chrono::steady_clock::now();
+	}
+	state.bytesPerSecond = *bytesPerSecond;
+}
+
+sol::optional<double> getBudget(Connection* connection) {
+	if (!connection) {
+		throw std::invalid_argument(errorNoConnection);
+	}
+
+	auto it =
+	    connectionStates.find(getKey(connection->address, connection->port));
+	if (it == connectionStates.end() || !it->second.hasBudget()) {
+		return sol::nullopt;
+	}
+	return it->second.bytesPerSecond;
+}
+};  // namespace Bandwidth
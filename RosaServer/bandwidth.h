@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+#include "sol/sol.hpp"
+
+struct Connection;
+
+// Counts the packets and bytes going through sendPacket and packetReceive
+// natively, so watching bandwidth doesn't need the SendPacket hook calling
+// Lua for every packet. Sends to connections are also counted per address
+// and port, which is also where budgets are kept. Counts for a connection
+// without a budget go once it disconnects.
+//
+// A connection with a budget has its packets dropped once it's sent more
+// than its bytes per second allow, refilled continuously with up to one
+// second of burst. A packet bigger than that waits until the budget has
+// refilled by its size.
+namespace Bandwidth {
+struct Counter {
+	uint64_t packets = 0;
+	uint64_t bytes = 0;
+
+	void add(int size) {
+		packets++;
+		bytes += size;
+	}
+};
+
+// Called from the hooks. Returns false if the packet should be dropped.
+bool countSend(unsigned int address, unsigned short port, uint8_t type,
+               int size);
+void countReceive(uint8_t type, int size);
+// Called at the end of each logic tick
+void endTick();
+
+void reset();
+sol::table getStats();
+// A nil bytesPerSecond removes the connection's budget
+void setBudget(Connection* connection, sol::optional<double> bytesPerSecond);
+sol::optional<double> getBudget(Connection* connection);
+};  // namespace Bandwidth
@@ -0,0 +1,200 @@
+#include "blockregion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+
+#include "api.h"
+#include "hooks.h"
+
+static constexpr const char* errorInvalidSize = "Invalid region size";
+static constexpr const char* errorDataLength =
+    "Data must be 4 bytes per block in the region";
+static constexpr const char* errorInvalidBudget = "Budget must be positive";
+
+// 256 blocks on each axis
+static constexpr size_t maxBlocks = 1 << 24;
+// How many blocks are edited between checks of the clock
+static constexpr size_t blocksPerClockCheck = 256;
+
+namespace {
+struct Region {
+	int x, y, z;
+	int sizeX, sizeY, sizeZ;
+	std::string data;
+
+	size_t next = 0;
+	unsigned int created = 0;
+	unsigned int deleted = 0;
+
+	double budgetMs = 0;
+	sol::protected_function callback;
+
+	size_t getNumBlocks() const { return (size_t)sizeX * sizeY * sizeZ; }
+
+	// Edits blocks until they're all done or the deadline passes, returning
+	// true once they're all done
+	template <typename Deadline>
+	bool apply(Deadline&& deadlinePassed);
+};
+};  // namespace
+
+static std::deque<Region> queuedRegions;
+
+static size_t checkSize(int sizeX, int sizeY, int sizeZ) {
+	if (sizeX < 1 || sizeY < 1 || sizeZ < 1) {
+		throw std::invalid_argument(errorInvalidSize);
+	}
+
+	size_t numBlocks = (size_t)sizeX * sizeY * sizeZ;
+	if (numBlocks > maxBlocks) {
+		throw std::invalid_argument(errorInvalidSize);
+	}
+	return numBlocks;
+}
+
+template <typename Deadline>
+bool Region::apply(Deadline&& deadlinePassed) {
+	short unk[8] = {15, 15, 15, 15, 15, 15, 15, 15};
+
+	// Removing and reinstalling the hooks patches code, so it's done once for
+	// the whole run instead of per block
+	Hooks::ScopedOriginal removeCreate(&Hooks::areaCreateBlockHook);
+	Hooks::ScopedOriginal removeDelete(&Hooks::areaDeleteBlockHook);
+
+	size_t numBlocks = getNumBlocks();
+	while (next < numBlocks) {
+		size_t end = std::min(numBlocks, next + blocksPerClockCheck);
+		for (; next < end; next++) {
+			uint32_t flags;
+			std::memcpy(&flags, data.data() + next * sizeof(flags), sizeof(flags));
+			if (flags == BlockRegion::unchanged) continue;
+
+			int blockX = x + next % sizeX;
+			int blockY = y + next / sizeX % sizeY;
+			int blockZ = z + next / sizeX / sizeY;
+
+			if (flags) {
+				Engine::areaCreateBlock(0, blockX, blockY, blockZ, flags, unk);
+				created++;
+			} else if (Engine::areaGetBlock(0, blockX, blockY, blockZ)) {
+				Engine::areaDeleteBlock(0, blockX, blockY, blockZ);
+				deleted++;
+			}
+		}
+
+		if (next < numBlocks && deadlinePassed()) return false;
+	}
+	return true;
+}
+
+static bool runPre(const Region& region) {
+	if (!Hooks::enabledKeys[Hooks::EnableKeys::AreaBlockRegion] ||
+	    !Hooks::hasPre(Hooks::EnableKeys::AreaBlockRegion)) {
+		return false;
+	}
+
+	auto res = Hooks::callPre(Hooks::EnableKeys::AreaBlockRegion,
+	                          "AreaBlockRegion", region.x, region.y, region.z,
+	                          region.sizeX, region.sizeY, region.sizeZ);
+	return noLuaCallError(&res) && (bool)res;
+}
+
+static void runPost(const Region& region) {
+	if (!Hooks::enabledKeys[Hooks::EnableKeys::AreaBlockRegion] ||
+	    !Hooks::hasPost(Hooks::EnableKeys::AreaBlockRegion)) {
+		return;
+	}
+
+	auto res = Hooks::callPost(
+	    Hooks::EnableKeys::AreaBlockRegion, "PostAreaBlockRegion", region.x,
+	    region.y, region.z, region.sizeX, region.sizeY, region.sizeZ,
+	    region.created, region.deleted);
+	noLuaCallError(&res);
+}
+
+namespace BlockRegion {
+std::tuple<unsigned int, unsigned int> set(int x, int y, int z, int sizeX,
+                                           int sizeY, int sizeZ,
+                                           std::string_view data) {
+	size_t numBlocks = checkSize(sizeX, sizeY, sizeZ);
+	if (data.size() != numBlocks * sizeof(uint32_t)) {
+		throw std::invalid_argument(errorDataLength);
+	}
+
+	Region region{x, y, z, sizeX, sizeY, sizeZ, std::string(data)};
+	if (runPre(region)) return {0, 0};
+
+	region.apply([] { return false; });
+	runPost(region);
+	return {region.created, region.deleted};
+}
+
+bool queue(int x, int y, int z, int sizeX, int sizeY, int sizeZ,
+           std::string data, double budgetMs,
+           sol::optional<sol::protected_function> callback) {
+	size_t numBlocks = checkSize(sizeX, sizeY, sizeZ);
+	if (data.size() != numBlocks * sizeof(uint32_t)) {
+		throw std::invalid_argument(errorDataLength);
+	}
+	if (budgetMs <= 0) {
+		throw std::invalid_argument(errorInvalidBudget);
+	}
+	if (queuedRegions.size() >= maxQueued) {
+		return false;
+	}
+
+	Region region{x, y, z, sizeX, sizeY, sizeZ, std::move(data)};
+	if (runPre(region)) return false;
+
+	region.budgetMs = budgetMs;
+	if (callback) region.callback = std::move(*callback);
+	queuedRegions.push_back(std::move(region));
+	return true;
+}
+
+std::string get(int x, int y, int z, int sizeX, int sizeY, int sizeZ) {
+	size_t numBlocks = checkSize(sizeX, sizeY, sizeZ);
+
+	std::string data(numBlocks * sizeof(uint32_t), '\0');
+	char* out = data.data();
+	for (int blockZ = z; blockZ < z + sizeZ; blockZ++) {
+		for (int blockY = y; blockY < y + sizeY; blockY++) {
+			for (int blockX = x; blockX < x + sizeX; blockX++) {
+				uint32_t flags = Engine::areaGetBlock(0, blockX, blockY, blockZ);
+				std::memcpy(out, &flags, sizeof(flags));
+				out += sizeof(flags);
+			}
+		}
+	}
+	return data;
+}
+
+size_t getQueuedCount() { return queuedRegions.size(); }
+
+void clear() { queuedRegions.clear(); }
+
+void update() {
+	if (queuedRegions.empty()) return;
+
+	// Only the oldest edit runs, so they apply in the order they were queued
+	auto& region = queuedRegions.front();
+	auto deadline = std::chrono::steady_clock::now() +
+	                std::chrono::duration<double, std::milli>(region.budgetMs);
+	bool done = region.apply(
+	    [&deadline] { return std::chrono::steady_clock::now() >= deadline; });
+	if (!done) return;
+
+	// Popped first, since the callbacks can queue more
+	Region finished = std::move(region);
+	queuedRegions.pop_front();
+
+	runPost(finished);
+	if (finished.callback.valid()) {
+		auto res = finished.callback(finished.created, finished.deleted);
+		noLuaCallError(&res);
+	}
+}
+};  // namespace BlockRegion
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+#include "sol/sol.hpp"
+
+// Edits a box of blocks from one buffer instead of a call per block. The
+// buffer holds a native uint32 of flags per block with x varying fastest,
+// then y, then z. 0 deletes a block and 0xffffffff leaves it as it is.
+//
+// The per-block AreaCreateBlock and AreaDeleteBlock hooks are skipped for
+// the whole edit. AreaBlockRegion runs once before it, and can cancel it by
+// returning true. PostAreaBlockRegion runs once it's done with the number of
+// blocks created and deleted.
+namespace BlockRegion {
+static constexpr uint32_t unchanged = 0xffffffff;
+// Edits that were queued but haven't finished yet
+static constexpr size_t maxQueued = 256;
+
+// Returns the number of blocks created and deleted
+std::tuple<unsigned int, unsigned int> set(int x, int y, int z, int sizeX,
+                                           int sizeY, int sizeZ,
+                                           std::string_view data);
+// Applies the edit over as many ticks as it takes, spending at most budgetMs
+// on it each tick. The callback gets the same counts set returns. Returns
+// false if the pre hook cancelled it or too many edits are queued.
+bool queue(int x, int y, int z, int sizeX, int sizeY, int sizeZ,
+           std::string data, double budgetMs,
+           sol::optional<sol::protected_function> callback);
+std::string get(int x, int y, int z, int sizeX, int sizeY, int sizeZ);
+size_t getQueuedCount();
+// Drops every queued edit without finishing it, for when the Lua state their
+// callbacks belong to is about to go
+void clear();
+
+// Called once per tick
+void update();
+};  // namespace BlockRegion
@@ -0,0 +1,105 @@
+#include "bullethits.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+#include "api.h"
+#include "hooks.h"
+
+static constexpr const char* errorInvalidBone = "Bone must be from 0 to 31";
+
+namespace {
+struct Rules {
+	bool teamDamage = true;
+	bool godMode = false;
+	uint32_t ignoredBones = 0;
+
+	bool any() const { return !teamDamage || godMode || ignoredBones; }
+};
+};  // namespace
+
+namespace BulletHits {
+static bool batching = false;
+static Rules rules;
+// Reused between ticks so collecting doesn't allocate once it's grown
+static std::vector<Hit> hits;
+
+bool isBatching() { return batching; }
+
+bool isActive() { return batching || rules.any(); }
+
+bool allows(const Bullet* bullet, int humanID, int bone) {
+	if (bone >= 0 && bone < 32 && (rules.ignoredBones >> bone & 1)) {
+		return false;
+	}
+
+	int targetID = Engine::humans[humanID].playerID;
+	if (targetID == -1) return true;
+	const Player& target = Engine::players[targetID];
+
+	if (rules.godMode && target.isGodMode) {
+		return false;
+	}
+
+	int shooterID = bullet->playerID;
+	if (!rules.teamDamage && shooterID != -1 && shooterID != targetID &&
+	    Engine::players[shooterID].team == target.team) {
+		return false;
+	}
+
+	return true;
+}
+
+void record(const Hit& hit) { hits.push_back(hit); }
+
+void deliver() {
+	if (hits.empty()) return;
+
+	if (Hooks::enabledKeys[Hooks::EnableKeys::BulletHits] &&
+	    Hooks::hasPre(Hooks::EnableKeys::BulletHits)) {
+		sol::table array = lua->create_table(hits.size(), 0);
+		for (size_t i = 0; i < hits.size(); i++) {
+			const Hit& hit = hits[i];
+			sol::table entry = lua->create_table(0, 6);
+			entry["bullet"] = hit.bullet;
+			entry["human"] = &Engine::humans[hit.humanID];
+			entry["bone"] = hit.bone;
+			entry["pos"] = hit.pos;
+			entry["normal"] = hit.normal;
+			entry["fraction"] = hit.fraction;
+			array[i + 1] = entry;
+		}
+
+		auto res =
+		    Hooks::callPre(Hooks::EnableKeys::BulletHits, "BulletHits", array);
+		noLuaCallError(&res);
+	}
+
+	hits.clear();
+}
+
+void setBatching(bool enabled) {
+	batching = enabled;
+	if (!batching) hits.clear();
+}
+
+void setRules(sol::optional<sol::table> table) {
+	Rules newRules;
+	if (table) {
+		newRules.teamDamage = table->get_or("teamDamage", true);
+		newRules.godMode = table->get_or("godMode", false);
+
+		auto bones = table->get<sol::optional<sol::table>>("ignoredBones");
+		if (bones) {
+			for (auto& pair : *bones) {
+				int bone = pair.second.as<int>();
+				if (bone < 0 || bone > 31) {
+					throw std::invalid_argument(errorInvalidBone);
+				}
+				newRules.ignoredBones |= 1u << bone;
+			}
+		}
+	}
+	rules = newRules;
+}
+};  // namespace BulletHits
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include "sol/sol.hpp"
+#include "structs.h"
+
+// Handles bullets hitting humans natively during PhysicsBullets.
+//
+// Hit rules veto hits before any Lua is called: no team damage between
+// players on the same team, no hits on players in god mode, and bones that
+// can't be hit at all. When batching, the BulletMayHit, BulletMayHitHuman and
+// BulletHitHuman events aren't called, and the hits that got through are
+// passed as one array to BulletHits after the bullets have been simulated.
+namespace BulletHits {
+struct Hit {
+	int humanID;
+	int bone;
+	Vector pos;
+	Vector normal;
+	float fraction;
+	// A copy, since the engine can free or reuse the bullet's slot before the
+	// hits are delivered
+	Bullet bullet{};
+};
+
+// Called from the hooks
+bool isBatching();
+// Whether hits have to be checked natively at all
+bool isActive();
+// Returns false if a rule vetoes the hit
+bool allows(const Bullet* bullet, int humanID, int bone);
+void record(const Hit& hit);
+// Calls BulletHits with the hits recorded since the last call
+void deliver();
+
+void setBatching(bool batching);
+// A nil table removes every rule. Takes {teamDamage = true?, godMode = false?,
+// ignoredBones = {}?}, where godMode true means players in god mode aren't hit.
+void setRules(sol::optional<sol::table> rules);
+};  // namespace BulletHits
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+// Growable ring of bytes read from a socket. Capacity stays a power of two so
+// positions wrap with a mask, and reads go straight into the free space.
+class ByteRing {
+	static constexpr size_t initialCapacity = 4096;
+
+	std::unique_ptr<char[]> data;
+	size_t capacity = 0;
+	size_t head = 0;
+	size_t tail = 0;
+
+	void grow(size_t minCapacity) {
+		size_t newCapacity = capacity ? capacity : initialCapacity;
+		while (newCapacity < minCapacity) newCapacity *= 2;
+
+		auto newData = std::make_unique<char[]>(newCapacity);
+		size_t count = size();
+		copy(0, newData.get(), count);
+
+		data = std::move(newData);
+		capacity = newCapacity;
+		head = 0;
+		tail = count;
+	}
+
+ public:
+	static constexpr size_t npos = static_cast<size_t>(-1);
+
+	size_t size() const { return tail - head; }
+	bool empty() const { return head == tail; }
+
+	// Calls func with the one or two contiguous pieces making up count bytes
+	// starting offset bytes in
+	template <typename Func>
+	void forEachPiece(size_t offset, size_t count, Func&& func) const {
+		if (!count) return;
+
+		size_t start = (head + offset) & (capacity - 1);
+		size_t first = std::min(count, capacity - start);
+		func(std::string_view(data.get() + start, first));
+		if (first < count) {
+			func(std::string_view(data.get(), count - first));
+		}
+	}
+
+	void copy(size_t offset, char* out, size_t count) const {
+		forEachPiece(offset, count, [&out](std::string_view piece) {
+			std::memcpy(out, piece.data(), piece.size());
+			out += piece.size();
+		});
+	}
+
+	// Returns the offset of the first matching byte, or npos
+	size_t find(char byte) const {
+		size_t offset = 0;
+		size_t found = npos;
+		forEachPiece(0, size(), [&](std::string_view piece) {
+			if (found != npos) return;
+			auto match = std::memchr(piece.data(), byte, piece.size());
+			if (match) {
+				found = offset + (static_cast<const char*>(match) - piece.data());
+			}
+			offset += piece.size();
+		});
+		return found;
+	}
+
+	void consume(size_t count) {
+		head += count;
+		if (head == tail) head = tail = 0;
+	}
+
+	void clear() { head = tail = 0; }
+
+	// Reads until the descriptor would block, reaches EOF, or the ring holds
+	// maxSize bytes. Returns 1 if it stopped because the ring was full,
+	// otherwise the result of the last read.
+	ssize_t readFrom(int fd, size_t maxSize) {
+		while (size() < maxSize) {
+			if (size() == capacity) grow(capacity * 2);
+
+			size_t limit = std::min(capacity - size(), maxSize - size());
+			size_t start = tail & (capacity - 1);
+			size_t first = std::min(limit, capacity - start);
+
+			iovec pieces[2] = {{data.get() + start, first},
+			                   {data.get(), limit - first}};
+			ssize_t bytesRead = readv(fd, pieces, pieces[1].iov_len ? 2 : 1);
+			if (bytesRead <= 0) return bytesRead;
+
+			tail += bytesRead;
+		}
+		return 1;
+	}
+};
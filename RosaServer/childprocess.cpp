@@ -8,63 +8,113 @@
 
 #include <algorithm>
 
+#include "engineuserdata.h"
+
 static constexpr int defaultPipeBufferSize = 1024 * 256;
 
+static void closePipe(int fds[2]) {
+	for (int i = 0; i < 2; i++) {
+		if (fds[i] != -1) {
+			close(fds[i]);
+			fds[i] = -1;
+		}
+	}
+}
+
 // We're throwing an `EPERM` or `Operation not permitted` error?
 // It's probably pipe size - the default maximum permitted in bytes on Linux is
 // 16384 pages, or 67108864 bytes. This only fits ~256 of the above default
 // sized pipes.
+//
+// With a shared memory size, messages go through a ring of about that many
+// bytes in each direction instead, and no pipes are made.
 ChildProcess::ChildProcess(const char* fileName,
-                           sol::optional<int> pipeBufferSize) {
-	int actualBufferSize = defaultPipeBufferSize;
-	if (pipeBufferSize) {
-		actualBufferSize = std::clamp(pipeBufferSize.value(), 0, 1024 * 1024);
-	}
+                           sol::optional<int> pipeBufferSize,
+                           sol::optional<size_t> sharedMemorySize,
+                           bool serveJobs) {
+	uint64_t ringCapacity = 0;
+	Channel::SharedDescriptors descriptors{-1, -1, -1};
+
+	if (sharedMemorySize) {
+		ringCapacity = Channel::ringCapacityFor(sharedMemorySize.value());
+		descriptors = Channel::SharedTransport::create(ringCapacity);
+		shared = std::make_unique<Channel::SharedTransport>();
+		shared->open(descriptors, ringCapacity, true);
+	} else {
+		int actualBufferSize = defaultPipeBufferSize;
+		if (pipeBufferSize) {
+			actualBufferSize = std::clamp(pipeBufferSize.value(), 0, 1024 * 1024);
+		}
 
-	if (pipe(fdParentToChild) == -1) {
-		throw std::runtime_error(strerror(errno));
-	}
+		if (pipe(fdParentToChild) == -1) {
+			throw std::runtime_error(strerror(errno));
+		}
 
-	if (pipe(fdChildToParent) == -1 ||
-	    fcntl(fdParentToChild[1], F_SETPIPE_SZ, actualBufferSize) == -1 ||
-	    fcntl(fdChildToParent[1], F_SETPIPE_SZ, actualBufferSize) == -1) {
-		close(fdParentToChild[0]);
-		close(fdParentToChild[1]);
+		if (pipe(fdChildToParent) == -1 ||
+		    fcntl(fdParentToChild[1], F_SETPIPE_SZ, actualBufferSize) == -1 ||
+		    fcntl(fdChildToParent[1], F_SETPIPE_SZ, actualBufferSize) == -1) {
+			int error = errno;
+			closePipe(fdParentToChild);
+			closePipe(fdChildToParent);
 
-		throw std::runtime_error(strerror(errno));
+			throw std::runtime_error(strerror(error));
+		}
 	}
 
 	pid = fork();
 
 	if (pid == -1) {
-		close(fdParentToChild[0]);
-		close(fdParentToChild[1]);
-		close(fdChildToParent[0]);
-		close(fdChildToParent[1]);
+		int error = errno;
+		closePipe(fdParentToChild);
+		closePipe(fdChildToParent);
 
-		throw std::runtime_error(strerror(errno));
+		throw std::runtime_error(strerror(error));
 	}
 
 	if (pid != 0) {
-		close(fdParentToChild[0]);
-		close(fdChildToParent[1]);
+		if (!shared) {
+			close(fdParentToChild[0]);
+			close(fdChildToParent[1]);
+			fdParentToChild[0] = -1;
+			fdChildToParent[1] = -1;
 
-		fcntl(fdChildToParent[0], F_SETFL, O_NONBLOCK);
+			fcntl(fdChildToParent[0], F_SETFL, O_NONBLOCK);
+		}
 	} else {
-		close(fdParentToChild[1]);
-		close(fdChildToParent[0]);
-
-		// Set reading the pipe to not block execution
-		fcntl(fdParentToChild[0], F_SETFL, O_NONBLOCK);
-
-		char strFromParentFD[10];
-		char strToParentFD[10];
-
-		sprintf(strFromParentFD, "%i", fdParentToChild[0]);
-		sprintf(strToParentFD, "%i", fdChildToParent[1]);
+		char strFromParentFD[16] = "-1";
+		char strToParentFD[16] = "-1";
+		char strMemoryFD[16];
+		char strRingCapacity[24];
+		char strWakeParentFD[16];
+		char strWakeChildFD[16];
+
+		if (!shared) {
+			close(fdParentToChild[1]);
+			close(fdChildToParent[0]);
+
+			// Set reading the pipe to not block execution
+			fcntl(fdParentToChild[0], F_SETFL, O_NONBLOCK);
+
+			sprintf(strFromParentFD, "%i", fdParentToChild[0]);
+			sprintf(strToParentFD, "%i", fdChildToParent[1]);
+		}
 
-		char* args[] = {(char*)"./rosaserversatellite", strFromParentFD,
-		                strToParentFD, (char*)fileName, nullptr};
+		sprintf(strMemoryFD, "%i", descriptors.memory);
+		sprintf(strRingCapacity, "%llu", (unsigned long long)ringCapacity);
+		sprintf(strWakeParentFD, "%i", descriptors.wakeParent);
+		sprintf(strWakeChildFD, "%i", descriptors.wakeChild);
+
+		// Without shared memory the list ends after the mode
+		char* args[] = {(char*)"./rosaserversatellite",
+		                strFromParentFD,
+		                strToParentFD,
+		                (char*)fileName,
+		                (char*)(serveJobs ? "jobs" : "script"),
+		                shared ? strMemoryFD : nullptr,
+		                strRingCapacity,
+		                strWakeParentFD,
+		                strWakeChildFD,
+		                nullptr};
 
 		char workingDirectory[PATH_MAX];
 
@@ -127,8 +177,8 @@ void ChildProcess::terminate() {
 		}
 
 		// Close file handles
-		close(fdParentToChild[1]);
-		close(fdChildToParent[0]);
+		closePipe(fdParentToChild);
+		closePipe(fdChildToParent);
 
 		pid = -1;
 	}
@@ -146,49 +196,87 @@ sol::object ChildProcess::getExitCode(sol::this_state s) {
 	return sol::make_object(lua, sol::nil);
 }
 
+// Everything the child has sent is taken at once, so the messages after the
+// first in a batch are handed out without touching the pipe or ring
+bool ChildProcess::readMessage(std::string& message) {
+	if (incoming.next(message)) {
+		return true;
+	}
+
+	if (shared) {
+		shared->flush();
+		shared->receive(incoming);
+	} else if (fdChildToParent[0] != -1) {
+		Channel::readPipe(fdChildToParent[0], incoming);
+	}
+
+	return incoming.next(message);
+}
+
 sol::object ChildProcess::receiveMessage(sol::this_state s) {
 	sol::state_view lua(s);
 
-	unsigned int length;
-
-	auto bytesRead = read(fdChildToParent[0], &length, sizeof(length));
-	if (bytesRead == -1) {
-		if (errno != EAGAIN) {
-			throw std::runtime_error(strerror(errno));
-		}
-	} else if (bytesRead == sizeof(length)) {
-		std::string message(length, ' ');
-		bytesRead = read(fdChildToParent[0], message.data(), length);
-		if (bytesRead == -1) {
-			if (errno != EAGAIN) {
-				throw std::runtime_error(strerror(errno));
-			}
-		} else if (bytesRead == length) {
-			return sol::make_object(lua, message);
-		}
+	std::string message;
+	if (readMessage(message)) {
+		return sol::make_object(lua, message);
 	}
 
 	return sol::make_object(lua, sol::nil);
 }
 
+sol::object ChildProcess::receive(sol::this_state s) {
+	std::string message;
+	if (readMessage(message)) {
+		return Serializer::decode<EngineUserdata>(s, message);
+	}
+
+	return sol::make_object(sol::state_view(s), sol::nil);
+}
+
 void ChildProcess::sendMessage(std::string_view message) {
 	if (!isRunning()) return;
 
-	unsigned int length = static_cast<unsigned int>(message.length());
+	// The ring never blocks, and keeps what doesn't fit until there's room
+	if (shared) {
+		shared->send(message);
+	} else {
+		Channel::writePipe(fdParentToChild[1], message);
+	}
+}
+
+void ChildProcess::send(sol::object value) {
+	sendMessage(Serializer::encode<EngineUserdata>(value));
+}
+
+bool ChildProcess::flush() {
+	if (!shared || !isRunning()) return true;
+	return shared->flush();
+}
+
+size_t ChildProcess::getQueuedSize() const {
+	return shared ? shared->getBacklogSize() : 0;
+}
+
+size_t ChildProcess::getResidentSize() {
+	if (!isRunning()) return 0;
+
+	char path[32];
+	sprintf(path, "/proc/%i/statm", pid);
 
-	auto bytesWritten = write(fdParentToChild[1], &length, sizeof(length));
-	if (bytesWritten == -1) {
+	FILE* file = fopen(path, "r");
+	if (!file) {
 		throw std::runtime_error(strerror(errno));
-	} else if (bytesWritten != sizeof(length)) {
-		throw std::runtime_error("Couldn't write full message to pipe");
-	} else {
-		bytesWritten = write(fdParentToChild[1], message.data(), length);
-		if (bytesWritten == -1) {
-			throw std::runtime_error(strerror(errno));
-		} else if (bytesWritten != length) {
-			throw std::runtime_error("Couldn't write full message to pipe");
-		}
 	}
+
+	unsigned long totalPages, residentPages;
+	int numRead = fscanf(file, "%lu %lu", &totalPages, &residentPages);
+	fclose(file);
+
+	if (numRead != 2) {
+		throw std::runtime_error("Couldn't read process memory usage");
+	}
+
+	return residentPages * sysconf(_SC_PAGESIZE);
 }
 
 void ChildProcess::setLimit(__rlimit_resource resource, rlim_t softLimit,
@@ -1,28 +1,46 @@
 #pragma once
 #include <sys/resource.h>
 
+#include <memory>
 #include <string>
 
+#include "channel.h"
 #include "sol/sol.hpp"
 
 class ChildProcess {
-	int fdParentToChild[2];
-	int fdChildToParent[2];
+	friend class SatellitePool;
+
+	int fdParentToChild[2] = {-1, -1};
+	int fdChildToParent[2] = {-1, -1};
 	int pid;
 
+	// Set when messages go through shared memory instead of the pipes
+	std::unique_ptr<Channel::SharedTransport> shared;
+	Channel::Assembler incoming;
+
 	bool gotExitCode = false;
 	int exitCode;
 
 	void setLimit(__rlimit_resource resource, rlim_t softLimit, rlim_t hardLimit);
+	bool readMessage(std::string& message);
 
  public:
-	ChildProcess(const char* fileName, sol::optional<int> pipeBufferSize);
+	// serveJobs makes the satellite run SatellitePool jobs after its script
+	ChildProcess(const char* fileName, sol::optional<int> pipeBufferSize,
+	             sol::optional<size_t> sharedMemorySize, bool serveJobs = false);
 	~ChildProcess();
 	bool isRunning();
 	void terminate();
 	sol::object getExitCode(sol::this_state s);
 	sol::object receiveMessage(sol::this_state s);
 	void sendMessage(std::string_view message);
+	sol::object receive(sol::this_state s);
+	void send(sol::object value);
+	// Returns true once every queued message has been handed to the child
+	bool flush();
+	size_t getQueuedSize() const;
+	// Bytes of the child's memory that are resident, or 0 if it has exited
+	size_t getResidentSize();
 	void setCPULimit(rlim_t softLimit, rlim_t hardLimit);
 	void setMemoryLimit(rlim_t softLimit, rlim_t hardLimit);
 	void setFileSizeLimit(rlim_t softLimit, rlim_t hardLimit);
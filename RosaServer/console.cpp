@@ -6,10 +6,18 @@
 #include <termios.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
 #include <deque>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <thread>
+#include <vector>
+
+#include "mpscring.h"
 
 namespace Console {
 std::queue<std::string> commandQueue;
@@ -63,6 +71,45 @@ static int cursorCol = 0;
 
 static bool inputInitialized = false;
 
+// Lines logged once the output thread is running wait here for it, so no
+// thread ever blocks on the terminal
+static constexpr size_t logCapacity = 8192;
+// Written at once, with the prompt redrawn once after
+static constexpr size_t maxBatchSize = 64 * 1024;
+static std::atomic_bool outputStarted = false;
+static std::atomic<uint64_t> droppedCount = 0;
+static uint64_t reportedDroppedCount = 0;
+
+namespace {
+struct Output {
+	MPSCRing<std::string, logCapacity> queue;
+
+	std::mutex wakeMutex;
+	std::condition_variable wakeCondition;
+	std::atomic_bool waiting = false;
+};
+};  // namespace
+
+// Never destroyed, since the output thread is detached and outlives exit
+static Output& output = *new Output();
+
+// Held while popping from the queue, which only allows one consumer
+static std::mutex drainMutex;
+
+namespace {
+struct LogFile {
+	std::string fileName;
+	// 0 to never rotate
+	size_t maxSize;
+	int maxFiles;
+	std::ofstream stream;
+	size_t size = 0;
+};
+};  // namespace
+
+static std::mutex logFilesMutex;
+static std::vector<std::unique_ptr<LogFile>> logFiles;
+
 static std::string getBuffer() {
 	return std::string(buffer.begin(), buffer.end());
 }
@@ -79,6 +126,177 @@ static void redrawLine() {
 	std::cout << std::flush;
 }
 
+static void writeOutput(std::string_view text) {
+	std::lock_guard<std::mutex> guard(outputMutex);
+
+	// Erase current line, move cursor to start, print
+	std::cout << "\33[2K\r";
+	std::cout << text;
+
+	if (inputInitialized && !shouldExit) redrawLine();
+}
+
+// Log files get the text without colours or cursor movement
+static std::string stripEscapes(std::string_view text) {
+	std::string stripped;
+	stripped.reserve(text.size());
+
+	for (size_t i = 0; i < text.size(); i++) {
+		if (text[i] == '\033' && i + 1 < text.size() && text[i + 1] == '[') {
+			i += 2;
+			while (i < text.size() && (text[i] < 0x40 || text[i] > 0x7e)) i++;
+		} else if (text[i] != '\r') {
+			stripped += text[i];
+		}
+	}
+
+	return stripped;
+}
+
+static void rotate(LogFile& file) {
+	file.stream.close();
+
+	if (file.maxFiles > 0) {
+		for (int i = file.maxFiles - 1; i > 0; i--) {
+			std::rename((file.fileName + '.' + std::to_string(i)).c_str(),
+			            (file.fileName + '.' + std::to_string(i + 1)).c_str());
+		}
+		std::rename(file.fileName.c_str(), (file.fileName + ".1").c_str());
+	}
+
+	file.stream.open(file.fileName, std::ios::out | std::ios::trunc);
+	file.size = 0;
+}
+
+// Splits text at line ends, so a file can be rotated between lines
+static void writeLogFile(LogFile& file, std::string_view text) {
+	while (!text.empty()) {
+		size_t count = text.size();
+		if (file.maxSize && file.size + count > file.maxSize) {
+			size_t room = file.maxSize > file.size ? file.maxSize - file.size : 0;
+			size_t lineEnd = text.substr(0, room).rfind('\n');
+			if (lineEnd != std::string_view::npos) {
+				count = lineEnd + 1;
+			} else if (file.size) {
+				rotate(file);
+				continue;
+			} else {
+				// A line longer than maxSize gets a file to itself
+				lineEnd = text.find('\n');
+				count = lineEnd == std::string_view::npos ? text.size() : lineEnd + 1;
+			}
+		}
+
+		file.stream.write(text.data(), count);
+		file.size += count;
+		text.remove_prefix(count);
+	}
+	file.stream.flush();
+}
+
+static void writeLogFiles(std::string_view text) {
+	std::lock_guard<std::mutex> guard(logFilesMutex);
+	if (logFiles.empty()) return;
+
+	std::string stripped = stripEscapes(text);
+	for (auto& file : logFiles) {
+		writeLogFile(*file, stripped);
+	}
+}
+
+// Writes whatever is queued. Returns false if there was nothing.
+static bool drainLog() {
+	std::lock_guard<std::mutex> guard(drainMutex);
+
+	std::string batch;
+	std::string line;
+	while (batch.size() < maxBatchSize && output.queue.pop(line)) {
+		batch += line;
+	}
+
+	uint64_t dropped = droppedCount.load(std::memory_order_relaxed);
+	if (dropped != reportedDroppedCount) {
+		batch += "\033[33m" + std::to_string(dropped - reportedDroppedCount) +
+		         " log lines were dropped\033[0m\n";
+		reportedDroppedCount = dropped;
+	}
+
+	if (batch.empty()) return false;
+
+	writeOutput(batch);
+	writeLogFiles(batch);
+	return true;
+}
+
+static void outputMain() {
+	while (true) {
+		if (drainLog()) continue;
+
+		std::unique_lock<std::mutex> lock(output.wakeMutex);
+		output.waiting = true;
+		// Pairs with the fence in log, so either this sees the new line or log
+		// sees that it's waiting
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		output.wakeCondition.wait(lock, [] { return !output.queue.empty(); });
+		output.waiting = false;
+	}
+}
+
+void log(std::string_view line) {
+	if (!outputStarted) {
+		writeOutput(line);
+		writeLogFiles(line);
+		return;
+	}
+
+	if (!output.queue.push(std::string(line))) {
+		droppedCount.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (!output.waiting) return;
+
+	{ std::lock_guard<std::mutex> guard(output.wakeMutex); }
+	output.wakeCondition.notify_one();
+}
+
+void flushLog() {
+	while (drainLog()) {
+	}
+}
+
+bool addLogFile(std::string_view fileName, size_t maxSize, int maxFiles) {
+	auto file = std::make_unique<LogFile>();
+	file->fileName = fileName;
+	file->maxSize = maxSize;
+	file->maxFiles = maxFiles;
+	// Opened at the end, so tellp is the size it already has
+	file->stream.open(file->fileName,
+	                  std::ios::out | std::ios::app | std::ios::ate);
+	if (!file->stream) return false;
+	file->size = file->stream.tellp();
+
+	std::lock_guard<std::mutex> guard(logFilesMutex);
+	logFiles.push_back(std::move(file));
+	return true;
+}
+
+bool removeLogFile(std::string_view fileName) {
+	std::lock_guard<std::mutex> guard(logFilesMutex);
+	for (auto it = logFiles.begin(); it != logFiles.end(); ++it) {
+		if ((*it)->fileName == fileName) {
+			logFiles.erase(it);
+			return true;
+		}
+	}
+	return false;
+}
+
+uint64_t getDroppedLogCount() {
+	return droppedCount.load(std::memory_order_relaxed);
+}
+
 static bool awaitingAutoComplete = false;
 static std::string autoCompleteInput;
 
@@ -407,9 +625,17 @@ void init() {
 
 	std::thread thread(threadMain);
 	thread.detach();
+
+	outputStarted = true;
+	std::thread outputThread(outputMain);
+	outputThread.detach();
 }
 
 void cleanup() {
+	// Anything logged while exiting is written straight away
+	outputStarted = false;
+	flushLog();
+
 	struct termios mode;
 
 	tcgetattr(STDIN_FILENO, &mode);
@@ -417,16 +643,6 @@ void cleanup() {
 	tcsetattr(STDIN_FILENO, TCSANOW, &mode);
 }
 
-void log(std::string_view line) {
-	std::lock_guard<std::mutex> guard(outputMutex);
-
-	// Erase current line, move cursor to start, print
-	std::cout << "\33[2K\r";
-	std::cout << line;
-
-	if (inputInitialized && !shouldExit) redrawLine();
-}
-
 void handleInterruptSignal(int signal) { shouldExit = true; }
 
 void setTitle(const char* title) {
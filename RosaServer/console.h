@@ -1,6 +1,7 @@
 #pragma once
 
 #include <csignal>
+#include <cstdint>
 #include <mutex>
 #include <queue>
 #include <string>
@@ -18,7 +19,16 @@ void pushCommand(const std::string& input);
 void threadMain();
 void init();
 void cleanup();
+// Queues the line for the output thread once input is initialized, dropping
+// it if the queue is full
 void log(std::string_view line);
+// Writes everything queued before returning
+void flushLog();
+// Also writes the log to fileName. Once it would grow past maxSize it's
+// renamed to fileName.1 and so on, keeping maxFiles of them.
+bool addLogFile(std::string_view fileName, size_t maxSize, int maxFiles);
+bool removeLogFile(std::string_view fileName);
+uint64_t getDroppedLogCount();
 void handleInterruptSignal(int signal);
 void setTitle(const char* title);
 }  // namespace Console
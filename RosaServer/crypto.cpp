@@ -1,54 +1,142 @@
 #include "crypto.h"
 
-#include <openssl/evp.h>
+#include <openssl/core_names.h>
 
-#include <cstdio>
-#include <iomanip>
-#include <sstream>
+#include <memory>
+#include <stdexcept>
+
+static constexpr const char* errorDigest = "Digest failed";
+
+// Fetching looks the algorithm up by name, so each is only done once
+static const EVP_MD* getMD5() {
+	static EVP_MD* md = EVP_MD_fetch(NULL, "MD5", NULL);
+	return md;
+}
+
+static const EVP_MD* getSHA256() {
+	static EVP_MD* md = EVP_MD_fetch(NULL, "SHA256", NULL);
+	return md;
+}
+
+static EVP_MAC* getHMAC() {
+	static EVP_MAC* mac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+	return mac;
+}
+
+static std::string finishDigest(const unsigned char* hash,
+                                unsigned int hashLength,
+                                sol::optional<bool> binary) {
+	std::string_view raw(reinterpret_cast<const char*>(hash), hashLength);
+	if (binary.value_or(false)) {
+		return std::string(raw);
+	}
+	return Lua::crypto::toHex(raw);
+}
+
+static std::string digest(const EVP_MD* md, std::string_view input,
+                          sol::optional<bool> binary) {
+	struct ContextDeleter {
+		void operator()(EVP_MD_CTX* context) const { EVP_MD_CTX_free(context); }
+	};
+	thread_local std::unique_ptr<EVP_MD_CTX, ContextDeleter> context(
+	    EVP_MD_CTX_new());
+
+	unsigned char hash[EVP_MAX_MD_SIZE];
+	unsigned int hashLength;
+	if (!EVP_DigestInit_ex(context.get(), md, NULL) ||
+	    !EVP_DigestUpdate(context.get(), input.data(), input.length()) ||
+	    !EVP_DigestFinal_ex(context.get(), hash, &hashLength)) {
+		throw std::runtime_error(errorDigest);
+	}
+
+	return finishDigest(hash, hashLength, binary);
+}
 
 namespace Lua {
 namespace crypto {
-static void digest(std::stringstream& output, unsigned char* hash,
-                   size_t hashLength) {
-	output << std::hex << std::setfill('0');
+std::string md5(std::string_view input, sol::optional<bool> binary) {
+	return digest(getMD5(), input, binary);
+}
 
-	for (int i = 0; i < hashLength; i++) {
-		output << std::setw(2) << +hash[i];
-	}
+std::string sha256(std::string_view input, sol::optional<bool> binary) {
+	return digest(getSHA256(), input, binary);
 }
 
-std::string md5(std::string_view input) {
+std::string hmacSha256(std::string_view key, std::string_view input,
+                       sol::optional<bool> binary) {
+	struct ContextDeleter {
+		void operator()(EVP_MAC_CTX* context) const { EVP_MAC_CTX_free(context); }
+	};
+	thread_local std::unique_ptr<EVP_MAC_CTX, ContextDeleter> context(
+	    EVP_MAC_CTX_new(getHMAC()));
+
+	char digestName[] = "SHA256";
+	OSSL_PARAM params[] = {
+	    OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digestName, 0),
+	    OSSL_PARAM_construct_end()};
+
 	unsigned char hash[EVP_MAX_MD_SIZE];
-	EVP_MD_CTX* context = EVP_MD_CTX_create();
-	EVP_MD* md = EVP_MD_fetch(NULL, "MD5", NULL);
+	size_t hashLength;
+	if (!EVP_MAC_init(context.get(),
+	                  reinterpret_cast<const unsigned char*>(key.data()),
+	                  key.length(), params) ||
+	    !EVP_MAC_update(context.get(),
+	                    reinterpret_cast<const unsigned char*>(input.data()),
+	                    input.length()) ||
+	    !EVP_MAC_final(context.get(), hash, &hashLength, sizeof(hash))) {
+		throw std::runtime_error(errorDigest);
+	}
+
+	return finishDigest(hash, hashLength, binary);
+}
+
+std::string toHex(std::string_view data) {
+	static constexpr char digits[] = "0123456789abcdef";
+
+	std::string output(data.length() * 2, '\0');
+	for (size_t i = 0; i < data.length(); i++) {
+		unsigned char byte = data[i];
+		output[i * 2] = digits[byte >> 4];
+		output[i * 2 + 1] = digits[byte & 0xf];
+	}
+	return output;
+}
+}  // namespace crypto
+}  // namespace Lua
 
-	EVP_DigestInit_ex(context, md, NULL);
-	EVP_DigestUpdate(context, input.data(), input.length());
-	EVP_DigestFinal_ex(context, hash, NULL);
+Hasher::Hasher(const EVP_MD* md) : md(md), context(EVP_MD_CTX_new()) {
+	if (!context || !EVP_DigestInit_ex(context, md, NULL)) {
+		EVP_MD_CTX_free(context);
+		throw std::runtime_error(errorDigest);
+	}
+}
 
-	EVP_MD_free(md);
-	EVP_MD_CTX_free(context);
+Hasher::~Hasher() { EVP_MD_CTX_free(context); }
 
-	std::stringstream output;
-	digest(output, hash, 16);
-	return output.str();
+Hasher& Hasher::update(std::string_view input) {
+	if (!EVP_DigestUpdate(context, input.data(), input.length())) {
+		throw std::runtime_error(errorDigest);
+	}
+	return *this;
 }
 
-std::string sha256(std::string_view input) {
+std::string Hasher::final(sol::optional<bool> binary) {
 	unsigned char hash[EVP_MAX_MD_SIZE];
-	EVP_MD_CTX* context = EVP_MD_CTX_create();
-	EVP_MD* md = EVP_MD_fetch(NULL, "SHA256", NULL);
+	unsigned int hashLength;
+	if (!EVP_DigestFinal_ex(context, hash, &hashLength) ||
+	    !EVP_DigestInit_ex(context, md, NULL)) {
+		throw std::runtime_error(errorDigest);
+	}
 
-	EVP_DigestInit_ex(context, md, NULL);
-	EVP_DigestUpdate(context, input.data(), input.length());
-	EVP_DigestFinal_ex(context, hash, NULL);
+	return finishDigest(hash, hashLength, binary);
+}
 
-	EVP_MD_free(md);
-	EVP_MD_CTX_free(context);
+namespace Lua {
+namespace crypto {
+std::unique_ptr<Hasher> md5New() { return std::make_unique<Hasher>(getMD5()); }
 
-	std::stringstream output;
-	digest(output, hash, 32);
-	return output.str();
+std::unique_ptr<Hasher> sha256New() {
+	return std::make_unique<Hasher>(getSHA256());
 }
 }  // namespace crypto
 }  // namespace Lua
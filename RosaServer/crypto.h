@@ -1,9 +1,37 @@
 #pragma once
+#include <openssl/evp.h>
+
+#include <memory>
 #include <string>
+#include <string_view>
+
+#include "sol/sol.hpp"
+
+// Hashes input given in pieces, for when it's too big to have all at once
+class Hasher {
+	const EVP_MD* md;
+	EVP_MD_CTX* context;
+
+ public:
+	Hasher(const EVP_MD* md);
+	~Hasher();
+	Hasher(const Hasher&) = delete;
+
+	Hasher& update(std::string_view input);
+	// Returns the digest and starts over, so the hasher can be used again
+	std::string final(sol::optional<bool> binary);
+};
 
 namespace Lua {
 namespace crypto {
-std::string md5(std::string_view input);
-std::string sha256(std::string_view input);
+// Digests are lowercase hex unless binary is true
+std::string md5(std::string_view input, sol::optional<bool> binary);
+std::string sha256(std::string_view input, sol::optional<bool> binary);
+std::string hmacSha256(std::string_view key, std::string_view input,
+                       sol::optional<bool> binary);
+std::string toHex(std::string_view data);
+
+std::unique_ptr<Hasher> md5New();
+std::unique_ptr<Hasher> sha256New();
 }  // namespace crypto
 }  // namespace Lua
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "sol/sol.hpp"
+
+// Holds the data tables scripts attach to one engine array's objects. They
+// all live in a single Lua table indexed by slot, so clearing one is a rawset
+// and dropping every one on reset releases a single reference.
+class DataTables {
+	sol::table tables;
+
+ public:
+	sol::table get(lua_State* state, int index) {
+		if (!tables.valid()) {
+			tables = sol::table(state, sol::create);
+		}
+
+		auto table = tables.raw_get<sol::optional<sol::table>>(index);
+		if (table) return *table;
+
+		sol::table created(state, sol::create);
+		tables.raw_set(index, created);
+		return created;
+	}
+
+	void clear(int index) {
+		if (tables.valid()) tables.raw_set(index, sol::nil);
+	}
+
+	// Must be called before the Lua state the tables belong to is destroyed
+	void reset() { tables = sol::table(); }
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <algorithm>
+
+#include "serializer.h"
+#include "structs.h"
+
+// Lets the serializer carry Vector and RotMatrix userdata as themselves
+// rather than as tables of their fields
+struct EngineUserdata {
+	static Serializer::Tag read(lua_State* L, int index, float* floats) {
+		if (sol::stack::check<Vector>(L, index, sol::no_panic)) {
+			Vector* vector = sol::stack::get<Vector*>(L, index);
+			floats[0] = vector->x;
+			floats[1] = vector->y;
+			floats[2] = vector->z;
+			return Serializer::TagVector;
+		}
+
+		if (sol::stack::check<RotMatrix>(L, index, sol::no_panic)) {
+			RotMatrix* rot = sol::stack::get<RotMatrix*>(L, index);
+			const float values[] = {rot->x1, rot->y1, rot->z1, rot->x2, rot->y2,
+			                        rot->z2, rot->x3, rot->y3, rot->z3};
+			std::copy(values, values + Serializer::rotMatrixFloats, floats);
+			return Serializer::TagRotMatrix;
+		}
+
+		return Serializer::TagNil;
+	}
+
+	static void pushVector(lua_State* L, const float* floats) {
+		sol::stack::push(L, Vector{floats[0], floats[1], floats[2]});
+	}
+
+	static void pushRotMatrix(lua_State* L, const float* floats) {
+		sol::stack::push(L, RotMatrix{floats[0], floats[1], floats[2], floats[3],
+		                              floats[4], floats[5], floats[6], floats[7],
+		                              floats[8]});
+	}
+};
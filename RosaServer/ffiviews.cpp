@@ -0,0 +1,209 @@
+#include "ffiviews.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "api.h"
+#include "structs.h"
+
+// Spells out a member's type as a C declaration, arrays included
+template <typename T>
+struct CType;
+
+#define C_TYPE(type, name)                     \
+	template <>                                  \
+	struct CType<type> {                         \
+		static std::string base() { return name; } \
+		static std::string suffix() { return ""; } \
+	};
+
+C_TYPE(int, "int")
+C_TYPE(unsigned int, "unsigned int")
+C_TYPE(short, "short")
+C_TYPE(float, "float")
+C_TYPE(char, "char")
+C_TYPE(unsigned char, "unsigned char")
+C_TYPE(Vector, "rs_Vector")
+C_TYPE(RotMatrix, "rs_RotMatrix")
+#undef C_TYPE
+
+template <typename T, size_t N>
+struct CType<T[N]> {
+	static std::string base() { return CType<T>::base(); }
+	static std::string suffix() {
+		return "[" + std::to_string(N) + "]" + CType<T>::suffix();
+	}
+};
+
+namespace {
+struct Field {
+	const char* name;
+	size_t offset;
+	size_t size;
+	std::string base;
+	std::string suffix;
+};
+};  // namespace
+
+#define FIELD(type, member)                                   \
+	{                                                           \
+		#member, offsetof(type, member), sizeof(type::member),    \
+		    CType<decltype(type::member)>::base(),                \
+		    CType<decltype(type::member)>::suffix()               \
+	}
+
+static std::string defineStruct(const char* name, size_t size,
+                                std::vector<Field> fields) {
+	std::sort(fields.begin(), fields.end(),
+	          [](const Field& a, const Field& b) { return a.offset < b.offset; });
+
+	std::string out = "typedef struct ";
+	out += name;
+	out += " {\n";
+
+	size_t offset = 0;
+	int padCount = 0;
+	auto pad = [&](size_t to) {
+		if (to > offset) {
+			out += "\tuint8_t _pad" + std::to_string(padCount++) + "[" +
+			       std::to_string(to - offset) + "];\n";
+		}
+	};
+
+	for (const auto& field : fields) {
+		pad(field.offset);
+		out += "\t" + field.base + " " + field.name + field.suffix + ";\n";
+		offset = field.offset + field.size;
+	}
+	pad(size);
+
+	out += "} ";
+	out += name;
+	out += ";\n";
+	return out;
+}
+
+static std::string buildDefinitions() {
+	std::string out;
+
+	out += defineStruct("rs_Vector", sizeof(Vector),
+	                    {FIELD(Vector, x), FIELD(Vector, y), FIELD(Vector, z)});
+
+	out += defineStruct(
+	    "rs_RotMatrix", sizeof(RotMatrix),
+	    {FIELD(RotMatrix, x1), FIELD(RotMatrix, y1), FIELD(RotMatrix, z1),
+	     FIELD(RotMatrix, x2), FIELD(RotMatrix, y2), FIELD(RotMatrix, z2),
+	     FIELD(RotMatrix, x3), FIELD(RotMatrix, y3), FIELD(RotMatrix, z3)});
+
+	out += defineStruct(
+	    "rs_Player", sizeof(Player),
+	    {FIELD(Player, active),          FIELD(Player, name),
+	     FIELD(Player, subRosaID),       FIELD(Player, phoneNumber),
+	     FIELD(Player, isAdmin),         FIELD(Player, accountID),
+	     FIELD(Player, isReady),         FIELD(Player, money),
+	     FIELD(Player, teamMoney),       FIELD(Player, budget),
+	     FIELD(Player, corporateRating), FIELD(Player, criminalRating),
+	     FIELD(Player, isGodMode),       FIELD(Player, team),
+	     FIELD(Player, teamSwitchTimer), FIELD(Player, stocks),
+	     FIELD(Player, spawnTimer),      FIELD(Player, humanID),
+	     FIELD(Player, gearX),           FIELD(Player, leftRightInput),
+	     FIELD(Player, gearY),           FIELD(Player, forwardBackInput),
+	     FIELD(Player, viewYaw),         FIELD(Player, viewPitch),
+	     FIELD(Player, inputFlags),      FIELD(Player, lastInputFlags),
+	     FIELD(Player, zoomLevel),       FIELD(Player, inputType),
+	     FIELD(Player, menuTab)});
+
+	out += defineStruct(
+	    "rs_Human", sizeof(Human),
+	    {FIELD(Human, active),          FIELD(Human, physicsSim),
+	     FIELD(Human, playerID),        FIELD(Human, accountID),
+	     FIELD(Human, stamina),         FIELD(Human, maxStamina),
+	     FIELD(Human, vehicleID),       FIELD(Human, vehicleSeat),
+	     FIELD(Human, despawnTime),     FIELD(Human, oldHealth),
+	     FIELD(Human, isImmortal),      FIELD(Human, spawnProtection),
+	     FIELD(Human, isOnGround),      FIELD(Human, movementState),
+	     FIELD(Human, zoomLevel),       FIELD(Human, damage),
+	     FIELD(Human, isStanding),      FIELD(Human, pos),
+	     FIELD(Human, pos2),            FIELD(Human, viewYaw),
+	     FIELD(Human, viewPitch),       FIELD(Human, strafeInput),
+	     FIELD(Human, walkInput),       FIELD(Human, inputFlags),
+	     FIELD(Human, lastInputFlags),  FIELD(Human, health),
+	     FIELD(Human, bloodLevel),      FIELD(Human, isBleeding),
+	     FIELD(Human, chestHP),         FIELD(Human, headHP),
+	     FIELD(Human, leftArmHP),       FIELD(Human, rightArmHP),
+	     FIELD(Human, leftLegHP),       FIELD(Human, rightLegHP),
+	     FIELD(Human, gender),          FIELD(Human, model),
+	     FIELD(Human, suitColor),       FIELD(Human, tieColor)});
+
+	out += defineStruct(
+	    "rs_Item", sizeof(Item),
+	    {FIELD(Item, active),         FIELD(Item, physicsSim),
+	     FIELD(Item, physicsSettled), FIELD(Item, isStatic),
+	     FIELD(Item, type),           FIELD(Item, despawnTime),
+	     FIELD(Item, parentHumanID),  FIELD(Item, parentItemID),
+	     FIELD(Item, parentSlot),     FIELD(Item, bodyID),
+	     FIELD(Item, pos),            FIELD(Item, vel),
+	     FIELD(Item, rot),            FIELD(Item, cooldown),
+	     FIELD(Item, bullets),        FIELD(Item, phoneNumber),
+	     FIELD(Item, vehicleID),      FIELD(Item, computerTopLine),
+	     FIELD(Item, computerCursor), FIELD(Item, computerLines),
+	     FIELD(Item, computerLineColors)});
+
+	out += defineStruct(
+	    "rs_Vehicle", sizeof(Vehicle),
+	    {FIELD(Vehicle, active),       FIELD(Vehicle, type),
+	     FIELD(Vehicle, health),       FIELD(Vehicle, lastDriverPlayerID),
+	     FIELD(Vehicle, color),        FIELD(Vehicle, despawnTime),
+	     FIELD(Vehicle, isLocked),     FIELD(Vehicle, bodyID),
+	     FIELD(Vehicle, pos),          FIELD(Vehicle, pos2),
+	     FIELD(Vehicle, rot),          FIELD(Vehicle, vel),
+	     FIELD(Vehicle, gearX),        FIELD(Vehicle, steerControl),
+	     FIELD(Vehicle, gearY),        FIELD(Vehicle, gasControl),
+	     FIELD(Vehicle, trafficCarID), FIELD(Vehicle, acceleration)});
+
+	out += defineStruct(
+	    "rs_RigidBody", sizeof(RigidBody),
+	    {FIELD(RigidBody, active),   FIELD(RigidBody, type),
+	     FIELD(RigidBody, settled),  FIELD(RigidBody, linkedHumanOrItemID),
+	     FIELD(RigidBody, mass),     FIELD(RigidBody, pos),
+	     FIELD(RigidBody, vel),      FIELD(RigidBody, rot),
+	     FIELD(RigidBody, rotVel),   FIELD(RigidBody, scale)});
+
+	return out;
+}
+
+#undef FIELD
+
+namespace FFIViews {
+std::string getStructDefinitions() {
+	// The layouts can't change at runtime
+	static const std::string definitions = buildDefinitions();
+	return definitions;
+}
+
+sol::table getArrayAddresses() {
+	sol::table arrays = lua->create_table();
+
+	auto add = [&arrays](const char* name, const void* address, int count,
+	                     const char* type, size_t size) {
+		sol::table array = lua->create_table();
+		array["address"] = reinterpret_cast<uintptr_t>(address);
+		array["count"] = count;
+		array["type"] = type;
+		array["size"] = size;
+		arrays[name] = array;
+	};
+
+	add("players", Engine::players, maxNumberOfPlayers, "rs_Player",
+	    sizeof(Player));
+	add("humans", Engine::humans, maxNumberOfHumans, "rs_Human", sizeof(Human));
+	add("items", Engine::items, maxNumberOfItems, "rs_Item", sizeof(Item));
+	add("vehicles", Engine::vehicles, maxNumberOfVehicles, "rs_Vehicle",
+	    sizeof(Vehicle));
+	add("bodies", Engine::bodies, maxNumberOfRigidBodies, "rs_RigidBody",
+	    sizeof(RigidBody));
+
+	return arrays;
+}
+};  // namespace FFIViews
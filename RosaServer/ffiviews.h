@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+#include "sol/sol.hpp"
+
+// Declarations of the engine structs for LuaJIT's FFI, so hot loops can read
+// and write fields without going through the checked sol usertypes:
+//
+//   ffi.cdef(memory.getStructDefinitions())
+//   local arrays = memory.getArrayAddresses()
+//   local humans = ffi.cast("rs_Human*", arrays.humans.address)
+//
+// Each struct only declares the fields listed in ffiviews.cpp, at the offsets
+// and with the types they have in structs.h, padded out to the real size.
+// Nothing is checked, so indices have to be kept below the counts given.
+namespace FFIViews {
+std::string getStructDefinitions();
+sol::table getArrayAddresses();
+};  // namespace FFIViews
@@ -1,8 +1,15 @@
 #include "filewatcher.h"
 
+#include <unistd.h>
+
 #include <cerrno>
+#include <cstring>
+#include <filesystem>
+
+// Needed to notice new directories under a recursive watch
+static constexpr uint32_t recursiveMask = IN_CREATE | IN_MOVED_TO;
 
-FileWatcher::FileWatcher() {
+FileWatcher::FileWatcher() : buffer(std::make_unique<char[]>(bufferSize)) {
 	fd = inotify_init1(IN_NONBLOCK);
 	if (fd < 0) {
 		throw std::runtime_error(strerror(errno));
@@ -11,51 +18,174 @@ FileWatcher::FileWatcher() {
 
 FileWatcher::~FileWatcher() { close(fd); }
 
-void FileWatcher::addWatch(const char* path, uint32_t mask) {
-	int descriptor = inotify_add_watch(fd, path, mask);
+int FileWatcher::addSingleWatch(const std::string& path, uint32_t mask,
+                                bool recursive, const std::string& root) {
+	uint32_t watchMask = recursive ? mask | recursiveMask : mask;
+	int descriptor = inotify_add_watch(fd, path.c_str(), watchMask);
 	if (descriptor < 0) {
 		throw std::runtime_error(strerror(errno));
 	}
-	watchDescriptors.emplace(descriptor, path);
+
+	// Watching the same inode again returns the same descriptor
+	auto found = watches.find(descriptor);
+	if (found != watches.end()) {
+		pathDescriptors.erase(found->second.path);
+	}
+
+	watches[descriptor] = {path, mask, recursive, root};
+	pathDescriptors[path] = descriptor;
+	return descriptor;
+}
+
+void FileWatcher::addDirectories(const std::string& path, uint32_t mask,
+                                 const std::string& root) {
+	std::error_code error;
+	for (std::filesystem::recursive_directory_iterator it(path, error), end;
+	     !error && it != end; it.increment(error)) {
+		if (it->is_directory(error) && !it->is_symlink(error)) {
+			addSingleWatch(it->path().string(), mask, true, root);
+		}
+	}
+}
+
+void FileWatcher::addWatch(const char* path, uint32_t mask,
+                           sol::optional<bool> recursive) {
+	bool isRecursive = recursive.value_or(false);
+	addSingleWatch(path, mask, isRecursive, "");
+	if (isRecursive) {
+		addDirectories(path, mask, path);
+	}
+}
+
+void FileWatcher::forgetWatch(int descriptor) {
+	auto found = watches.find(descriptor);
+	if (found == watches.end()) return;
+
+	pathDescriptors.erase(found->second.path);
+	watches.erase(found);
 }
 
 bool FileWatcher::removeWatch(const char* path) {
-	auto foundDescriptor =
-	    std::find_if(std::begin(watchDescriptors), std::end(watchDescriptors),
-	                 [&](const std::pair<int, std::string>& pair) {
-		                 return pair.second == path;
-	                 });
-	if (foundDescriptor == std::end(watchDescriptors)) {
+	auto found = pathDescriptors.find(path);
+	if (found == pathDescriptors.end()) {
 		return false;
 	}
 
-	if (inotify_rm_watch(fd, foundDescriptor->first) < 0) {
+	int descriptor = found->second;
+	if (inotify_rm_watch(fd, descriptor) < 0) {
 		throw std::runtime_error(strerror(errno));
 	}
 
-	watchDescriptors.erase(foundDescriptor->first);
+	// Directories a recursive watch added go with it
+	if (watches.at(descriptor).recursive) {
+		for (auto it = watches.begin(); it != watches.end();) {
+			if (it->second.root == path) {
+				inotify_rm_watch(fd, it->first);
+				pathDescriptors.erase(it->second.path);
+				it = watches.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	forgetWatch(descriptor);
 	return true;
 }
 
-sol::object FileWatcher::receiveEvent(sol::this_state s) {
-	sol::state_view lua(s);
+void FileWatcher::readEvents() {
+	while (true) {
+		auto bytesRead = read(fd, buffer.get(), bufferSize);
+		if (bytesRead < 0) {
+			if (errno != EAGAIN) {
+				throw std::runtime_error(strerror(errno));
+			}
+			return;
+		}
+
+		for (char* position = buffer.get(); position < buffer.get() + bytesRead;) {
+			auto event = reinterpret_cast<const struct inotify_event*>(position);
+			position += sizeof(struct inotify_event) + event->len;
+
+			if (event->wd == -1) {
+				pendingEvents.push_back({"", event->mask, ""});
+				continue;
+			}
 
-	auto bytesRead = read(fd, buffer, sizeof(buffer));
+			// Removed watches still send IN_IGNORED
+			auto found = watches.find(event->wd);
+			if (found == watches.end()) continue;
+			Watch watch = found->second;
+			std::string name = event->len ? event->name : "";
 
-	if (bytesRead < 0) {
-		if (errno != EAGAIN) {
-			throw std::runtime_error(strerror(errno));
+			if (event->mask & IN_IGNORED) {
+				forgetWatch(event->wd);
+			}
+
+			if (watch.recursive && (event->mask & IN_ISDIR) &&
+			    (event->mask & recursiveMask)) {
+				std::string directory = watch.path + '/' + name;
+				const std::string& root = watch.root.empty() ? watch.path : watch.root;
+				try {
+					addSingleWatch(directory, watch.mask, true, root);
+					addDirectories(directory, watch.mask, root);
+				} catch (std::runtime_error&) {
+					// Already gone again
+				}
+			}
+
+			// Only what was asked for, not what recursion added
+			uint32_t mask = event->mask & (watch.mask | IN_ISDIR | IN_IGNORED |
+			                               IN_Q_OVERFLOW | IN_UNMOUNT);
+			if (mask & ~IN_ISDIR) {
+				pendingEvents.push_back({watch.path, mask, std::move(name)});
+			}
 		}
+	}
+}
 
-		return sol::make_object(lua, sol::nil);
+sol::table FileWatcher::eventToTable(sol::state_view& lua, const Event& event) {
+	sol::table table = lua.create_table();
+	table["descriptor"] = event.descriptor;
+	table["mask"] = event.mask;
+	table["name"] = event.name;
+	return table;
+}
+
+sol::object FileWatcher::receiveEvent(sol::this_state s) {
+	sol::state_view lua(s);
+
+	if (pendingEvents.empty()) {
+		readEvents();
 	}
 
-	const struct inotify_event* event =
-	    reinterpret_cast<const struct inotify_event*>(buffer);
+	if (pendingEvents.empty()) {
+		return sol::make_object(lua, sol::nil);
+	}
 
-	sol::table table = lua.create_table();
-	table["descriptor"] = watchDescriptors.at(event->wd);
-	table["mask"] = event->mask;
-	table["name"] = std::string(event->name);
+	sol::table table = eventToTable(lua, pendingEvents.front());
+	pendingEvents.pop_front();
 	return sol::make_object(lua, table);
 }
+
+sol::table FileWatcher::receiveEvents(sol::this_state s) {
+	sol::state_view lua(s);
+
+	readEvents();
+
+	// Only an event repeating the last one for the same file is dropped, so
+	// something like a create, delete and create keeps its order
+	sol::table events = lua.create_table();
+	std::unordered_map<std::string, uint32_t> lastMasks;
+	for (auto& event : pendingEvents) {
+		std::string key = event.descriptor + '\0' + event.name;
+		auto [it, inserted] = lastMasks.try_emplace(std::move(key), event.mask);
+		if (inserted || it->second != event.mask) {
+			it->second = event.mask;
+			events.add(eventToTable(lua, event));
+		}
+	}
+	pendingEvents.clear();
+
+	return events;
+}
@@ -1,23 +1,57 @@
 #pragma once
 #include <sys/inotify.h>
 
+#include <deque>
+#include <memory>
 #include <string>
 #include <unordered_map>
 
 #include "sol/sol.hpp"
 
-static constexpr int bufferSize = sizeof(struct inotify_event) + NAME_MAX + 1;
-
 class FileWatcher {
+	// Enough for hundreds of events per read
+	static constexpr size_t bufferSize = 64 * 1024;
+
+	struct Watch {
+		std::string path;
+		uint32_t mask;
+		bool recursive;
+		// The path given to addWatch, for directories added by a recursive watch
+		std::string root;
+	};
+
+	struct Event {
+		// Empty for events not about a watch, like IN_Q_OVERFLOW
+		std::string descriptor;
+		uint32_t mask;
+		std::string name;
+	};
+
 	int fd;
-	std::unordered_map<int, std::string> watchDescriptors;
-	char buffer[bufferSize]
-	    __attribute__((aligned(__alignof__(struct inotify_event))));
+	std::unordered_map<int, Watch> watches;
+	std::unordered_map<std::string, int> pathDescriptors;
+	std::unique_ptr<char[]> buffer;
+	// Read but not yet received
+	std::deque<Event> pendingEvents;
+
+	int addSingleWatch(const std::string& path, uint32_t mask, bool recursive,
+	                   const std::string& root);
+	void addDirectories(const std::string& path, uint32_t mask,
+	                    const std::string& root);
+	void forgetWatch(int descriptor);
+	// Reads everything inotify has queued into pendingEvents
+	void readEvents();
+	static sol::table eventToTable(sol::state_view& lua, const Event& event);
 
  public:
 	FileWatcher();
 	~FileWatcher();
-	void addWatch(const char* path, uint32_t mask);
+	// Recursive watches also watch every directory under path, including ones
+	// created later, with the same mask
+	void addWatch(const char* path, uint32_t mask, sol::optional<bool> recursive);
 	bool removeWatch(const char* path);
 	sol::object receiveEvent(sol::this_state s);
+	// Returns every event queued, dropping an event that repeats the one before
+	// it for the same file
+	sol::table receiveEvents(sol::this_state s);
 };
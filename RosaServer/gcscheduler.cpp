@@ -0,0 +1,152 @@
+#include "gcscheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "api.h"
+
+static constexpr const char* errorInvalidSlice =
+    "Slice and reserve times must not be negative";
+
+// The same as Server::TPS
+static constexpr int ticksPerSecond = 60;
+static constexpr std::chrono::nanoseconds tickPeriod =
+    std::chrono::nanoseconds(1'000'000'000 / ticksPerSecond);
+// Always step a little, so a tick that runs long doesn't starve the collector
+static constexpr std::chrono::nanoseconds minSlice =
+    std::chrono::microseconds(100);
+// How long each lua_gc call should take, between checks of the clock
+static constexpr std::chrono::nanoseconds stepTarget =
+    std::chrono::microseconds(100);
+static constexpr int minStepKB = 1;
+static constexpr int maxStepKB = 1 << 16;
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+struct Stats {
+	uint64_t slices = 0;
+	uint64_t steps = 0;
+	uint64_t cycles = 0;
+	// Ticks the heap grew too much and the collector was let run on its own
+	uint64_t overruns = 0;
+	std::chrono::nanoseconds lastSlice{0};
+	std::chrono::nanoseconds totalTime{0};
+};
+};  // namespace
+
+namespace GCScheduler {
+static bool enabled = false;
+static std::chrono::nanoseconds maxSlice;
+static std::chrono::nanoseconds reserve;
+
+static Clock::time_point tickStart;
+static int stepKB = 16;
+// What was live after the last finished cycle
+static size_t liveSize = 0;
+static Stats stats;
+
+static size_t getHeapSize(lua_State* L) {
+	return (size_t)lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+}
+
+static std::chrono::nanoseconds readTime(sol::table& options, const char* key,
+                                         double defaultMs) {
+	double ms = options.get_or(key, defaultMs);
+	if (ms < 0) {
+		throw std::invalid_argument(errorInvalidSlice);
+	}
+	return std::chrono::nanoseconds((int64_t)(ms * 1'000'000));
+}
+
+void startTick() {
+	if (enabled) tickStart = Clock::now();
+}
+
+void endTick() {
+	if (!enabled) return;
+
+	lua_State* L = lua->lua_state();
+	auto start = Clock::now();
+	auto budget = std::clamp(tickPeriod - (start - tickStart) - reserve,
+	                         std::chrono::nanoseconds(minSlice), maxSlice);
+	auto deadline = start + budget;
+
+	auto now = start;
+	while (now < deadline) {
+		bool finished = lua_gc(L, LUA_GCSTEP, stepKB);
+		auto stepEnd = Clock::now();
+		stats.steps++;
+
+		// Scales the step to take about stepTarget next time, by at most double
+		auto took = std::max(stepEnd - now, Clock::duration(1));
+		int64_t scaled = std::clamp<int64_t>(stepKB * stepTarget / took,
+		                                     stepKB / 2, stepKB * 2);
+		stepKB = std::clamp<int64_t>(scaled, minStepKB, maxStepKB);
+		now = stepEnd;
+
+		if (finished) {
+			stats.cycles++;
+			liveSize = getHeapSize(L);
+			break;
+		}
+	}
+
+	stats.slices++;
+	stats.lastSlice = now - start;
+	stats.totalTime += stats.lastSlice;
+
+	// Stepping sets the collector's threshold again
+	if (getHeapSize(L) > liveSize * growthLimit) {
+		stats.overruns++;
+		lua_gc(L, LUA_GCRESTART, 0);
+	} else {
+		lua_gc(L, LUA_GCSTOP, 0);
+	}
+}
+
+void reset() {
+	enabled = false;
+	stats = Stats();
+}
+
+void enable(sol::optional<sol::table> options) {
+	maxSlice = std::chrono::nanoseconds((int64_t)(defaultMaxSliceMs * 1'000'000));
+	reserve = std::chrono::nanoseconds((int64_t)(defaultReserveMs * 1'000'000));
+	if (options) {
+		maxSlice = readTime(*options, "maxSliceMs", defaultMaxSliceMs);
+		reserve = readTime(*options, "reserveMs", defaultReserveMs);
+	}
+	maxSlice = std::max(maxSlice, std::chrono::nanoseconds(minSlice));
+
+	lua_State* L = lua->lua_state();
+	enabled = true;
+	tickStart = Clock::now();
+	liveSize = getHeapSize(L);
+	lua_gc(L, LUA_GCSTOP, 0);
+}
+
+void disable() {
+	if (!enabled) return;
+	enabled = false;
+	lua_gc(lua->lua_state(), LUA_GCRESTART, 0);
+}
+
+bool isEnabled() { return enabled; }
+
+sol::table getStats() {
+	sol::table table = lua->create_table();
+	table["enabled"] = enabled;
+	table["heapSize"] = getHeapSize(lua->lua_state());
+	table["liveSize"] = liveSize;
+	table["stepSize"] = stepKB;
+	table["slices"] = stats.slices;
+	table["steps"] = stats.steps;
+	table["cycles"] = stats.cycles;
+	table["overruns"] = stats.overruns;
+	table["lastSliceMs"] = stats.lastSlice.count() / 1'000'000.0;
+	table["totalMs"] = stats.totalTime.count() / 1'000'000.0;
+	return table;
+}
+};  // namespace GCScheduler
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "sol/sol.hpp"
+
+// Runs the main state's garbage collector at the end of each logic tick
+// instead of wherever an allocation happens to trigger it.
+//
+// While enabled the collector is stopped, and after each tick it's stepped
+// until the time left in the tick runs out, leaving reserveMs for the rest of
+// the frame, and never for longer than maxSliceMs. Steps are sized from how
+// long the last ones took, so the clock is checked often enough to stay
+// within the slice. If the heap grows past growthLimit times what was live
+// after the last cycle anyway, the collector is let run on its own until it
+// catches up.
+namespace GCScheduler {
+static constexpr double defaultMaxSliceMs = 4;
+static constexpr double defaultReserveMs = 4;
+static constexpr double growthLimit = 4;
+
+// Called from the hooks, doing nothing unless enabled
+void startTick();
+void endTick();
+// The state is new after a reset, so this only forgets it was enabled
+void reset();
+
+void enable(sol::optional<sol::table> options);
+void disable();
+bool isEnabled();
+sol::table getStats();
+};  // namespace GCScheduler
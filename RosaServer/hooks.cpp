@@ -1,7 +1,13 @@
 #include "hooks.h"
 
 #include "api.h"
+#include "bandwidth.h"
+#include "blockregion.h"
+#include "bullethits.h"
 #include "console.h"
+#include "gcscheduler.h"
+#include "recorder.h"
+#include "satellitepool.h"
 
 namespace Hooks {
 sol::protected_function run;
@@ -15,6 +21,7 @@ const std::unordered_map<std::string, EnableKeys> enableNames(
      {"TrafficCarDestination", EnableKeys::TrafficCarDestination},
      {"AreaCreateBlock", EnableKeys::AreaCreateBlock},
      {"AreaDeleteBlock", EnableKeys::AreaDeleteBlock},
+     {"AreaBlockRegion", EnableKeys::AreaBlockRegion},
      {"Logic", EnableKeys::Logic},
      {"ConsoleInput", EnableKeys::ConsoleInput},
      {"ConsoleAutoComplete", EnableKeys::ConsoleAutoComplete},
@@ -76,8 +83,25 @@ const std::unordered_map<std::string, EnableKeys> enableNames(
      {"LineIntersectHuman", EnableKeys::LineIntersectHuman},
      {"BulletMayHit", EnableKeys::BulletMayHit},
      {"BulletMayHitHuman", EnableKeys::BulletMayHitHuman},
-     {"BulletHitHuman", EnableKeys::BulletHitHuman}});
+     {"BulletHitHuman", EnableKeys::BulletHitHuman},
+     {"BulletHits", EnableKeys::BulletHits}});
 bool enabledKeys[EnableKeys::SIZE] = {0};
+bool runEnabledKeys[EnableKeys::SIZE] = {0};
+sol::protected_function preHandlers[EnableKeys::SIZE];
+sol::protected_function postHandlers[EnableKeys::SIZE];
+
+void updateEnabledKey(EnableKeys key) {
+	enabledKeys[key] = runEnabledKeys[key] || preHandlers[key].valid() ||
+	                   postHandlers[key].valid();
+}
+
+void clearHandlers() {
+	for (size_t i = 0; i < EnableKeys::SIZE; i++) {
+		preHandlers[i] = sol::nil;
+		postHandlers[i] = sol::nil;
+		updateEnabledKey((EnableKeys)i);
+	}
+}
 
 subhook::Hook subRosaPutsHook;
 subhook::Hook subRosa__printf_chkHook;
@@ -230,10 +254,11 @@ void resetGame() {
 void createTraffic(int amount) {
 	if (enabledKeys[EnableKeys::CreateTraffic]) {
 		bool noParent = false;
-		if (run != sol::nil) {
+		if (hasPre(EnableKeys::CreateTraffic)) {
 			Integer wrappedAmount = {amount};
 
-			auto res = run("CreateTraffic", wrappedAmount);
+			auto res = callPre(EnableKeys::CreateTraffic, "CreateTraffic",
+			                   wrappedAmount);
 
 			if (noLuaCallError(&res)) noParent = (bool)res;
 
@@ -241,16 +266,17 @@ void createTraffic(int amount) {
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&createTrafficHook);
+				ScopedOriginal remove(&createTrafficHook, EnableKeys::CreateTraffic);
 				Engine::createTraffic(amount);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostCreateTraffic", amount);
+			if (hasPost(EnableKeys::CreateTraffic)) {
+				auto res = callPost(EnableKeys::CreateTraffic, "PostCreateTraffic",
+				                    amount);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&createTrafficHook);
+		ScopedOriginal remove(&createTrafficHook, EnableKeys::CreateTraffic);
 		Engine::createTraffic(amount);
 	}
 }
@@ -258,23 +284,26 @@ void createTraffic(int amount) {
 void trafficSimulation() {
 	if (enabledKeys[EnableKeys::TrafficSimulation]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("TrafficSimulation");
+		if (hasPre(EnableKeys::TrafficSimulation)) {
+			auto res = callPre(EnableKeys::TrafficSimulation, "TrafficSimulation");
 
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&trafficSimulationHook);
+				ScopedOriginal remove(&trafficSimulationHook,
+				                      EnableKeys::TrafficSimulation);
 				Engine::trafficSimulation();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostTrafficSimulation");
+			if (hasPost(EnableKeys::TrafficSimulation)) {
+				auto res = callPost(EnableKeys::TrafficSimulation,
+				                    "PostTrafficSimulation");
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&trafficSimulationHook);
+		ScopedOriginal remove(&trafficSimulationHook,
+		                      EnableKeys::TrafficSimulation);
 		Engine::trafficSimulation();
 	}
 }
@@ -282,23 +311,25 @@ void trafficSimulation() {
 void aiTrafficCar(int id) {
 	if (enabledKeys[EnableKeys::TrafficCarAI]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("TrafficCarAI", &Engine::trafficCars[id]);
+		if (hasPre(EnableKeys::TrafficCarAI)) {
+			auto res = callPre(EnableKeys::TrafficCarAI, "TrafficCarAI",
+			                   &Engine::trafficCars[id]);
 
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&aiTrafficCarHook);
+				ScopedOriginal remove(&aiTrafficCarHook, EnableKeys::TrafficCarAI);
 				Engine::aiTrafficCar(id);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostTrafficCarAI", &Engine::trafficCars[id]);
+			if (hasPost(EnableKeys::TrafficCarAI)) {
+				auto res = callPost(EnableKeys::TrafficCarAI, "PostTrafficCarAI",
+				                    &Engine::trafficCars[id]);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&aiTrafficCarHook);
+		ScopedOriginal remove(&aiTrafficCarHook, EnableKeys::TrafficCarAI);
 		Engine::aiTrafficCar(id);
 	}
 }
@@ -306,14 +337,15 @@ void aiTrafficCar(int id) {
 void aiTrafficCarDestination(int id, int a, int b, int c, int d) {
 	if (enabledKeys[EnableKeys::TrafficCarDestination]) {
 		bool noParent = false;
-		if (run != sol::nil) {
+		if (hasPre(EnableKeys::TrafficCarDestination)) {
 			Integer wrappedA = {a};
 			Integer wrappedB = {b};
 			Integer wrappedC = {c};
 			Integer wrappedD = {d};
 
-			auto res = run("TrafficCarDestination", &Engine::trafficCars[id],
-			               wrappedA, wrappedB, wrappedC, wrappedD);
+			auto res = callPre(EnableKeys::TrafficCarDestination,
+			                   "TrafficCarDestination", &Engine::trafficCars[id],
+			                   wrappedA, wrappedB, wrappedC, wrappedD);
 
 			if (noLuaCallError(&res)) noParent = (bool)res;
 
@@ -324,17 +356,20 @@ void aiTrafficCarDestination(int id, int a, int b, int c, int d) {
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&aiTrafficCarDestinationHook);
+				ScopedOriginal remove(&aiTrafficCarDestinationHook,
+				                      EnableKeys::TrafficCarDestination);
 				Engine::aiTrafficCarDestination(id, a, b, c, d);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostTrafficCarDestination", &Engine::trafficCars[id], a,
-				               b, c, d);
+			if (hasPost(EnableKeys::TrafficCarDestination)) {
+				auto res = callPost(EnableKeys::TrafficCarDestination,
+				                    "PostTrafficCarDestination",
+				                    &Engine::trafficCars[id], a, b, c, d);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&aiTrafficCarDestinationHook);
+		ScopedOriginal remove(&aiTrafficCarDestinationHook,
+		                      EnableKeys::TrafficCarDestination);
 		Engine::aiTrafficCarDestination(id, a, b, c, d);
 	}
 }
@@ -343,26 +378,29 @@ void areaCreateBlock(int zero, int blockX, int blockY, int blockZ,
                      unsigned int flags, short unk[8]) {
 	if (enabledKeys[EnableKeys::AreaCreateBlock]) {
 		bool noParent = false;
-		if (run != sol::nil) {
+		if (hasPre(EnableKeys::AreaCreateBlock)) {
 			UnsignedInteger wrappedFlags = {flags};
 
-			auto res = run("AreaCreateBlock", blockX, blockY, blockZ, &wrappedFlags);
+			auto res = callPre(EnableKeys::AreaCreateBlock, "AreaCreateBlock", blockX,
+			                   blockY, blockZ, &wrappedFlags);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 
 			flags = wrappedFlags.value;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&areaCreateBlockHook);
+				ScopedOriginal remove(&areaCreateBlockHook,
+				                      EnableKeys::AreaCreateBlock);
 				Engine::areaCreateBlock(zero, blockX, blockY, blockZ, flags, unk);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostAreaCreateBlock", blockX, blockY, blockZ, flags);
+			if (hasPost(EnableKeys::AreaCreateBlock)) {
+				auto res = callPost(EnableKeys::AreaCreateBlock, "PostAreaCreateBlock",
+				                    blockX, blockY, blockZ, flags);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&areaCreateBlockHook);
+		ScopedOriginal remove(&areaCreateBlockHook, EnableKeys::AreaCreateBlock);
 		Engine::areaCreateBlock(zero, blockX, blockY, blockZ, flags, unk);
 	}
 }
@@ -370,27 +408,33 @@ void areaCreateBlock(int zero, int blockX, int blockY, int blockZ,
 void areaDeleteBlock(int zero, int blockX, int blockY, int blockZ) {
 	if (enabledKeys[EnableKeys::AreaDeleteBlock]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("AreaDeleteBlock", blockX, blockY, blockZ);
+		if (hasPre(EnableKeys::AreaDeleteBlock)) {
+			auto res = callPre(EnableKeys::AreaDeleteBlock, "AreaDeleteBlock", blockX,
+			                   blockY, blockZ);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&areaDeleteBlockHook);
+				ScopedOriginal remove(&areaDeleteBlockHook,
+				                      EnableKeys::AreaDeleteBlock);
 				Engine::areaDeleteBlock(zero, blockX, blockY, blockZ);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostAreaDeleteBlock", blockX, blockY, blockZ);
+			if (hasPost(EnableKeys::AreaDeleteBlock)) {
+				auto res = callPost(EnableKeys::AreaDeleteBlock, "PostAreaDeleteBlock",
+				                    blockX, blockY, blockZ);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&areaDeleteBlockHook);
+		ScopedOriginal remove(&areaDeleteBlockHook, EnableKeys::AreaDeleteBlock);
 		Engine::areaDeleteBlock(zero, blockX, blockY, blockZ);
 	}
 }
 
 void logicSimulation() {
+	Profiler::markTick();
+	GCScheduler::startTick();
+
 	if (shouldReset) {
 		shouldReset = false;
 		luaInit(true);
@@ -401,8 +445,8 @@ void logicSimulation() {
 	bool noParent = false;
 
 	if (Console::shouldExit) {
-		if (enabledKeys[EnableKeys::InterruptSignal] && run != sol::nil) {
-			auto res = run("InterruptSignal");
+		if (hasPre(EnableKeys::InterruptSignal)) {
+			auto res = callPre(EnableKeys::InterruptSignal, "InterruptSignal");
 			noLuaCallError(&res);
 		}
 		Lua::os::exit();
@@ -410,28 +454,30 @@ void logicSimulation() {
 	}
 
 	if (enabledKeys[EnableKeys::Logic]) {
-		if (run != sol::nil) {
-			auto res = run("Logic");
+		if (hasPre(EnableKeys::Logic)) {
+			auto res = callPre(EnableKeys::Logic, "Logic");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&logicSimulationHook);
+				ScopedOriginal remove(&logicSimulationHook, EnableKeys::Logic);
 				Engine::logicSimulation();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostLogic");
+			if (hasPost(EnableKeys::Logic)) {
+				auto res = callPost(EnableKeys::Logic, "PostLogic");
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&logicSimulationHook);
+		ScopedOriginal remove(&logicSimulationHook, EnableKeys::Logic);
 		Engine::logicSimulation();
 	}
 
 	{
 		std::lock_guard<std::mutex> guard(Console::commandQueueMutex);
 		while (!Console::commandQueue.empty()) {
+			Recorder::recordCommand(Console::commandQueue.front());
+
 			if (Console::commandQueue.front() == "resetlua") {
 				Lua::flagStateForReset("");
 				Console::commandQueue.pop();
@@ -439,20 +485,33 @@ void logicSimulation() {
 				continue;
 			}
 
-			if (enabledKeys[EnableKeys::ConsoleInput] && run != sol::nil) {
-				auto res = run("ConsoleInput", Console::commandQueue.front());
+			if (Profiler::handleConsoleCommand(Console::commandQueue.front())) {
+				Console::commandQueue.pop();
+				continue;
+			}
+
+			if (hasPre(EnableKeys::ConsoleInput)) {
+				auto res = callPre(EnableKeys::ConsoleInput, "ConsoleInput",
+				                   Console::commandQueue.front());
 				noLuaCallError(&res);
 			}
 			Console::commandQueue.pop();
 		}
 	}
 
+	drainHTTPResponses();
+	drainThreadResults();
+	drainSQLiteWrites();
+	SatellitePool::updateAll();
+	BlockRegion::update();
+
 	if (Console::isAwaitingAutoComplete()) {
-		if (enabledKeys[EnableKeys::ConsoleAutoComplete] && run != sol::nil) {
+		if (hasPre(EnableKeys::ConsoleAutoComplete)) {
 			auto data = lua->create_table();
 			data["response"] = Console::getAutoCompleteInput();
 
-			auto res = run("ConsoleAutoComplete", data);
+			auto res = callPre(EnableKeys::ConsoleAutoComplete, "ConsoleAutoComplete",
+			                   data);
 			noLuaCallError(&res);
 
 			std::string response = data["response"];
@@ -461,27 +520,32 @@ void logicSimulation() {
 			Console::respondToAutoComplete(Console::getAutoCompleteInput());
 		}
 	}
+
+	Bandwidth::endTick();
+	Recorder::endTick();
+	// Last, so it gets whatever time is left
+	GCScheduler::endTick();
 }
 
 void logicSimulationRace() {
 	if (enabledKeys[EnableKeys::LogicRace]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("LogicRace");
+		if (hasPre(EnableKeys::LogicRace)) {
+			auto res = callPre(EnableKeys::LogicRace, "LogicRace");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&logicSimulationRaceHook);
+				ScopedOriginal remove(&logicSimulationRaceHook, EnableKeys::LogicRace);
 				Engine::logicSimulationRace();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostLogicRace");
+			if (hasPost(EnableKeys::LogicRace)) {
+				auto res = callPost(EnableKeys::LogicRace, "PostLogicRace");
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&logicSimulationRaceHook);
+		ScopedOriginal remove(&logicSimulationRaceHook, EnableKeys::LogicRace);
 		Engine::logicSimulationRace();
 	}
 }
@@ -489,22 +553,23 @@ void logicSimulationRace() {
 void logicSimulationRound() {
 	if (enabledKeys[EnableKeys::LogicRound]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("LogicRound");
+		if (hasPre(EnableKeys::LogicRound)) {
+			auto res = callPre(EnableKeys::LogicRound, "LogicRound");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&logicSimulationRoundHook);
+				ScopedOriginal remove(&logicSimulationRoundHook,
+				                      EnableKeys::LogicRound);
 				Engine::logicSimulationRound();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostLogicRound");
+			if (hasPost(EnableKeys::LogicRound)) {
+				auto res = callPost(EnableKeys::LogicRound, "PostLogicRound");
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&logicSimulationRoundHook);
+		ScopedOriginal remove(&logicSimulationRoundHook, EnableKeys::LogicRound);
 		Engine::logicSimulationRound();
 	}
 }
@@ -512,22 +577,23 @@ void logicSimulationRound() {
 void logicSimulationWorld() {
 	if (enabledKeys[EnableKeys::LogicWorld]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("LogicWorld");
+		if (hasPre(EnableKeys::LogicWorld)) {
+			auto res = callPre(EnableKeys::LogicWorld, "LogicWorld");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&logicSimulationWorldHook);
+				ScopedOriginal remove(&logicSimulationWorldHook,
+				                      EnableKeys::LogicWorld);
 				Engine::logicSimulationWorld();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostLogicWorld");
+			if (hasPost(EnableKeys::LogicWorld)) {
+				auto res = callPost(EnableKeys::LogicWorld, "PostLogicWorld");
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&logicSimulationWorldHook);
+		ScopedOriginal remove(&logicSimulationWorldHook, EnableKeys::LogicWorld);
 		Engine::logicSimulationWorld();
 	}
 }
@@ -535,22 +601,24 @@ void logicSimulationWorld() {
 void logicSimulationTerminator() {
 	if (enabledKeys[EnableKeys::LogicTerminator]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("LogicTerminator");
+		if (hasPre(EnableKeys::LogicTerminator)) {
+			auto res = callPre(EnableKeys::LogicTerminator, "LogicTerminator");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&logicSimulationTerminatorHook);
+				ScopedOriginal remove(&logicSimulationTerminatorHook,
+				                      EnableKeys::LogicTerminator);
 				Engine::logicSimulationTerminator();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostLogicTerminator");
+			if (hasPost(EnableKeys::LogicTerminator)) {
+				auto res = callPost(EnableKeys::LogicTerminator, "PostLogicTerminator");
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&logicSimulationTerminatorHook);
+		ScopedOriginal remove(&logicSimulationTerminatorHook,
+		                      EnableKeys::LogicTerminator);
 		Engine::logicSimulationTerminator();
 	}
 }
@@ -558,22 +626,22 @@ void logicSimulationTerminator() {
 void logicSimulationCoop() {
 	if (enabledKeys[EnableKeys::LogicCoop]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("LogicCoop");
+		if (hasPre(EnableKeys::LogicCoop)) {
+			auto res = callPre(EnableKeys::LogicCoop, "LogicCoop");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&logicSimulationCoopHook);
+				ScopedOriginal remove(&logicSimulationCoopHook, EnableKeys::LogicCoop);
 				Engine::logicSimulationCoop();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostLogicCoop");
+			if (hasPost(EnableKeys::LogicCoop)) {
+				auto res = callPost(EnableKeys::LogicCoop, "PostLogicCoop");
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&logicSimulationCoopHook);
+		ScopedOriginal remove(&logicSimulationCoopHook, EnableKeys::LogicCoop);
 		Engine::logicSimulationCoop();
 	}
 }
@@ -581,22 +649,23 @@ void logicSimulationCoop() {
 void logicSimulationVersus() {
 	if (enabledKeys[EnableKeys::LogicVersus]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("LogicVersus");
+		if (hasPre(EnableKeys::LogicVersus)) {
+			auto res = callPre(EnableKeys::LogicVersus, "LogicVersus");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&logicSimulationVersusHook);
+				ScopedOriginal remove(&logicSimulationVersusHook,
+				                      EnableKeys::LogicVersus);
 				Engine::logicSimulationVersus();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostLogicVersus");
+			if (hasPost(EnableKeys::LogicVersus)) {
+				auto res = callPost(EnableKeys::LogicVersus, "PostLogicVersus");
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&logicSimulationVersusHook);
+		ScopedOriginal remove(&logicSimulationVersusHook, EnableKeys::LogicVersus);
 		Engine::logicSimulationVersus();
 	}
 }
@@ -604,22 +673,25 @@ void logicSimulationVersus() {
 void logicPlayerActions(int playerID) {
 	if (enabledKeys[EnableKeys::PlayerActions]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("PlayerActions", &Engine::players[playerID]);
+		if (hasPre(EnableKeys::PlayerActions)) {
+			auto res = callPre(EnableKeys::PlayerActions, "PlayerActions",
+			                   &Engine::players[playerID]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&logicPlayerActionsHook);
+				ScopedOriginal remove(&logicPlayerActionsHook,
+				                      EnableKeys::PlayerActions);
 				Engine::logicPlayerActions(playerID);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostPlayerActions", &Engine::players[playerID]);
+			if (hasPost(EnableKeys::PlayerActions)) {
+				auto res = callPost(EnableKeys::PlayerActions, "PostPlayerActions",
+				                    &Engine::players[playerID]);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&logicPlayerActionsHook);
+		ScopedOriginal remove(&logicPlayerActionsHook, EnableKeys::PlayerActions);
 		Engine::logicPlayerActions(playerID);
 	}
 }
@@ -627,45 +699,52 @@ void logicPlayerActions(int playerID) {
 void physicsSimulation() {
 	if (enabledKeys[EnableKeys::Physics]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("Physics");
+		if (hasPre(EnableKeys::Physics)) {
+			auto res = callPre(EnableKeys::Physics, "Physics");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&physicsSimulationHook);
+				ScopedOriginal remove(&physicsSimulationHook, EnableKeys::Physics);
 				Engine::physicsSimulation();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostPhysics");
+			rebuildSpatialGrids();
+			if (hasPost(EnableKeys::Physics)) {
+				auto res = callPost(EnableKeys::Physics, "PostPhysics");
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&physicsSimulationHook);
-		Engine::physicsSimulation();
+		{
+			ScopedOriginal remove(&physicsSimulationHook, EnableKeys::Physics);
+			Engine::physicsSimulation();
+		}
+		rebuildSpatialGrids();
 	}
 }
 
 void rigidBodySimulation() {
 	if (enabledKeys[EnableKeys::PhysicsRigidBodies]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("PhysicsRigidBodies");
+		if (hasPre(EnableKeys::PhysicsRigidBodies)) {
+			auto res = callPre(EnableKeys::PhysicsRigidBodies, "PhysicsRigidBodies");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&rigidBodySimulationHook);
+				ScopedOriginal remove(&rigidBodySimulationHook,
+				                      EnableKeys::PhysicsRigidBodies);
 				Engine::rigidBodySimulation();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostPhysicsRigidBodies");
+			if (hasPost(EnableKeys::PhysicsRigidBodies)) {
+				auto res = callPost(EnableKeys::PhysicsRigidBodies,
+				                    "PostPhysicsRigidBodies");
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&rigidBodySimulationHook);
+		ScopedOriginal remove(&rigidBodySimulationHook,
+		                      EnableKeys::PhysicsRigidBodies);
 		Engine::rigidBodySimulation();
 	}
 }
@@ -673,22 +752,25 @@ void rigidBodySimulation() {
 void vehicleSimulateSuspensions() {
 	if (enabledKeys[EnableKeys::VehicleSuspensions]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("VehicleSuspensions");
+		if (hasPre(EnableKeys::VehicleSuspensions)) {
+			auto res = callPre(EnableKeys::VehicleSuspensions, "VehicleSuspensions");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&vehicleSimulateSuspensionsHook);
+				ScopedOriginal remove(&vehicleSimulateSuspensionsHook,
+				                      EnableKeys::VehicleSuspensions);
 				Engine::vehicleSimulateSuspensions();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostVehicleSuspensions");
+			if (hasPost(EnableKeys::VehicleSuspensions)) {
+				auto res = callPost(EnableKeys::VehicleSuspensions,
+				                    "PostVehicleSuspensions");
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&vehicleSimulateSuspensionsHook);
+		ScopedOriginal remove(&vehicleSimulateSuspensionsHook,
+		                      EnableKeys::VehicleSuspensions);
 		Engine::vehicleSimulateSuspensions();
 	}
 }
@@ -696,22 +778,26 @@ void vehicleSimulateSuspensions() {
 void itemWeaponSimulation(int itemID) {
 	if (enabledKeys[EnableKeys::ItemWeaponSimulation]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("ItemWeaponSimulation", &Engine::items[itemID]);
+		if (hasPre(EnableKeys::ItemWeaponSimulation)) {
+			auto res = callPre(EnableKeys::ItemWeaponSimulation,
+			                   "ItemWeaponSimulation", &Engine::items[itemID]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&itemWeaponSimulationHook);
+				ScopedOriginal remove(&itemWeaponSimulationHook,
+				                      EnableKeys::ItemWeaponSimulation);
 				Engine::itemWeaponSimulation(itemID);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostItemWeaponSimulation", &Engine::items[itemID]);
+			if (hasPost(EnableKeys::ItemWeaponSimulation)) {
+				auto res = callPost(EnableKeys::ItemWeaponSimulation,
+				                    "PostItemWeaponSimulation", &Engine::items[itemID]);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&itemWeaponSimulationHook);
+		ScopedOriginal remove(&itemWeaponSimulationHook,
+		                      EnableKeys::ItemWeaponSimulation);
 		Engine::itemWeaponSimulation(itemID);
 	}
 }
@@ -719,25 +805,25 @@ void itemWeaponSimulation(int itemID) {
 int serverReceive() {
 	if (enabledKeys[EnableKeys::ServerReceive]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("ServerReceive");
+		if (hasPre(EnableKeys::ServerReceive)) {
+			auto res = callPre(EnableKeys::ServerReceive, "ServerReceive");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			int ret;
 			{
-				subhook::ScopedHookRemove remove(&serverReceiveHook);
+				ScopedOriginal remove(&serverReceiveHook, EnableKeys::ServerReceive);
 				ret = Engine::serverReceive();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostServerReceive");
+			if (hasPost(EnableKeys::ServerReceive)) {
+				auto res = callPost(EnableKeys::ServerReceive, "PostServerReceive");
 				noLuaCallError(&res);
 			}
 			return ret;
 		}
 		return -1;
 	} else {
-		subhook::ScopedHookRemove remove(&serverReceiveHook);
+		ScopedOriginal remove(&serverReceiveHook, EnableKeys::ServerReceive);
 		return Engine::serverReceive();
 	}
 }
@@ -745,22 +831,22 @@ int serverReceive() {
 void serverSend() {
 	if (enabledKeys[EnableKeys::ServerSend]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("ServerSend");
+		if (hasPre(EnableKeys::ServerSend)) {
+			auto res = callPre(EnableKeys::ServerSend, "ServerSend");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&serverSendHook);
+				ScopedOriginal remove(&serverSendHook, EnableKeys::ServerSend);
 				Engine::serverSend();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostServerSend");
+			if (hasPost(EnableKeys::ServerSend)) {
+				auto res = callPost(EnableKeys::ServerSend, "PostServerSend");
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&serverSendHook);
+		ScopedOriginal remove(&serverSendHook, EnableKeys::ServerSend);
 		Engine::serverSend();
 	}
 }
@@ -774,39 +860,55 @@ int packetWrite(void* source, int elementSize, int elementCount) {
 		Connection* connection =
 		    reinterpret_cast<Connection*>(connectionPlus4c - 0x4c);
 
-		if (run != sol::nil) {
-			auto res = run("PacketBuilding", connection);
+		if (hasPre(EnableKeys::PacketBuilding)) {
+			auto res = callPre(EnableKeys::PacketBuilding, "PacketBuilding",
+			                   connection);
 			noLuaCallError(&res);
 		}
 	}
 
-	subhook::ScopedHookRemove remove(&packetWriteHook);
+	ScopedOriginal remove(&packetWriteHook);
 	return Engine::packetWrite(source, elementSize, elementCount);
 }
 
+static void onPacketReceived(int ret) {
+	if (ret <= 0) return;
+
+	Bandwidth::countReceive(Engine::packet[4], *Engine::packetSize);
+	if (Recorder::isRecording()) {
+		Recorder::recordPacket(Engine::packet, *Engine::packetSize);
+	}
+}
+
 int packetReceive() {
 	if (enabledKeys[EnableKeys::PacketReceive]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("PacketReceive");
+		if (hasPre(EnableKeys::PacketReceive)) {
+			auto res = callPre(EnableKeys::PacketReceive, "PacketReceive");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			int ret;
 			{
-				subhook::ScopedHookRemove remove(&packetReceiveHook);
+				ScopedOriginal remove(&packetReceiveHook, EnableKeys::PacketReceive);
 				ret = Engine::packetReceive();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostPacketReceive");
+			onPacketReceived(ret);
+			if (hasPost(EnableKeys::PacketReceive)) {
+				auto res = callPost(EnableKeys::PacketReceive, "PostPacketReceive");
 				noLuaCallError(&res);
 			}
 			return ret;
 		}
 		return 0;
 	} else {
-		subhook::ScopedHookRemove remove(&packetReceiveHook);
-		return Engine::packetReceive();
+		int ret;
+		{
+			ScopedOriginal remove(&packetReceiveHook, EnableKeys::PacketReceive);
+			ret = Engine::packetReceive();
+		}
+		onPacketReceived(ret);
+		return ret;
 	}
 }
 
@@ -817,22 +919,26 @@ void calculatePlayerVoice(int connectionID, int playerID) {
 		auto connection = &Engine::connections[connectionID];
 		auto player = &Engine::players[playerID];
 
-		if (run != sol::nil) {
-			auto res = run("CalculateEarShots", connection, player);
+		if (hasPre(EnableKeys::CalculateEarShots)) {
+			auto res = callPre(EnableKeys::CalculateEarShots, "CalculateEarShots",
+			                   connection, player);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&calculatePlayerVoiceHook);
+				ScopedOriginal remove(&calculatePlayerVoiceHook,
+				                      EnableKeys::CalculateEarShots);
 				Engine::calculatePlayerVoice(connectionID, playerID);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostCalculateEarShots", connection, player);
+			if (hasPost(EnableKeys::CalculateEarShots)) {
+				auto res = callPost(EnableKeys::CalculateEarShots,
+				                    "PostCalculateEarShots", connection, player);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&calculatePlayerVoiceHook);
+		ScopedOriginal remove(&calculatePlayerVoiceHook,
+		                      EnableKeys::CalculateEarShots);
 		Engine::calculatePlayerVoice(connectionID, playerID);
 	}
 }
@@ -845,26 +951,36 @@ int sendPacket(unsigned int address, unsigned short port) {
 		int packetType = Engine::packet[4];
 		int packetSize = *Engine::packetSize;
 
-		if (run != sol::nil) {
-			auto res = run("SendPacket", addressString, port, packetType, packetSize);
+		if (hasPre(EnableKeys::SendPacket)) {
+			auto res = callPre(EnableKeys::SendPacket, "SendPacket", addressString,
+			                   port, packetType, packetSize);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
+			if (!Bandwidth::countSend(address, port, packetType, packetSize)) {
+				return 0;
+			}
+
 			int ret;
 			{
-				subhook::ScopedHookRemove remove(&sendPacketHook);
+				ScopedOriginal remove(&sendPacketHook, EnableKeys::SendPacket);
 				ret = Engine::sendPacket(address, port);
 			}
-			if (run != sol::nil) {
-				auto res =
-				    run("PostSendPacket", addressString, port, packetType, packetSize);
+			if (hasPost(EnableKeys::SendPacket)) {
+				auto res = callPost(EnableKeys::SendPacket, "PostSendPacket",
+				                    addressString, port, packetType, packetSize);
 				noLuaCallError(&res);
 			}
 			return ret;
 		}
 		return 0;
 	} else {
-		subhook::ScopedHookRemove remove(&sendPacketHook);
+		if (!Bandwidth::countSend(address, port, Engine::packet[4],
+		                          *Engine::packetSize)) {
+			return 0;
+		}
+
+		ScopedOriginal remove(&sendPacketHook, EnableKeys::SendPacket);
 		return Engine::sendPacket(address, port);
 	}
 }
@@ -873,46 +989,51 @@ void bulletSimulation() {
 	isInBulletSimulation = true;
 	if (enabledKeys[EnableKeys::PhysicsBullets]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("PhysicsBullets");
+		if (hasPre(EnableKeys::PhysicsBullets)) {
+			auto res = callPre(EnableKeys::PhysicsBullets, "PhysicsBullets");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&bulletSimulationHook);
+				ScopedOriginal remove(&bulletSimulationHook,
+				                      EnableKeys::PhysicsBullets);
 				Engine::bulletSimulation();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostPhysicsBullets");
+			if (hasPost(EnableKeys::PhysicsBullets)) {
+				auto res = callPost(EnableKeys::PhysicsBullets, "PostPhysicsBullets");
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&bulletSimulationHook);
+		ScopedOriginal remove(&bulletSimulationHook, EnableKeys::PhysicsBullets);
 		Engine::bulletSimulation();
 	}
 	isInBulletSimulation = false;
+
+	BulletHits::deliver();
 }
 
 void economyCarMarket() {
 	if (enabledKeys[EnableKeys::EconomyCarMarket]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("EconomyCarMarket");
+		if (hasPre(EnableKeys::EconomyCarMarket)) {
+			auto res = callPre(EnableKeys::EconomyCarMarket, "EconomyCarMarket");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&economyCarMarketHook);
+				ScopedOriginal remove(&economyCarMarketHook,
+				                      EnableKeys::EconomyCarMarket);
 				Engine::economyCarMarket();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostEconomyCarMarket");
+			if (hasPost(EnableKeys::EconomyCarMarket)) {
+				auto res = callPost(EnableKeys::EconomyCarMarket,
+				                    "PostEconomyCarMarket");
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&economyCarMarketHook);
+		ScopedOriginal remove(&economyCarMarketHook, EnableKeys::EconomyCarMarket);
 		Engine::economyCarMarket();
 	}
 }
@@ -920,22 +1041,23 @@ void economyCarMarket() {
 void saveAccountsServer() {
 	if (enabledKeys[EnableKeys::AccountsSave]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("AccountsSave");
+		if (hasPre(EnableKeys::AccountsSave)) {
+			auto res = callPre(EnableKeys::AccountsSave, "AccountsSave");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&saveAccountsServerHook);
+				ScopedOriginal remove(&saveAccountsServerHook,
+				                      EnableKeys::AccountsSave);
 				Engine::saveAccountsServer();
 			}
-			if (run != sol::nil) {
-				auto res = run("PostAccountsSave");
+			if (hasPost(EnableKeys::AccountsSave)) {
+				auto res = callPost(EnableKeys::AccountsSave, "PostAccountsSave");
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&saveAccountsServerHook);
+		ScopedOriginal remove(&saveAccountsServerHook, EnableKeys::AccountsSave);
 		Engine::saveAccountsServer();
 	}
 }
@@ -945,35 +1067,39 @@ int createAccountByJoinTicket(int identifier, unsigned int ticket) {
 	    enabledKeys[EnableKeys::AccountTicketFound] ||
 	    enabledKeys[EnableKeys::AccountTicket]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("AccountTicketBegin", identifier, ticket);
+		if (hasPre(EnableKeys::AccountTicketBegin)) {
+			auto res = callPre(EnableKeys::AccountTicketBegin, "AccountTicketBegin",
+			                   identifier, ticket);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			int id;
 			{
-				subhook::ScopedHookRemove remove(&createAccountByJoinTicketHook);
+				ScopedOriginal remove(&createAccountByJoinTicketHook,
+				                      EnableKeys::AccountTicketBegin);
 				id = Engine::createAccountByJoinTicket(identifier, ticket);
 			}
-			if (run != sol::nil) {
-				auto res =
-				    run("AccountTicketFound", id < 0 ? nullptr : &Engine::accounts[id]);
+			if (hasPre(EnableKeys::AccountTicketFound)) {
+				auto res = callPre(EnableKeys::AccountTicketFound, "AccountTicketFound",
+				                   id < 0 ? nullptr : &Engine::accounts[id]);
 				noParent = false;
 				if (noLuaCallError(&res)) noParent = (bool)res;
 
-				if (!noParent) {
-					auto res = run("PostAccountTicket",
-					               id < 0 ? nullptr : &Engine::accounts[id]);
-					noLuaCallError(&res);
-					return id;
+				if (noParent) {
+					return -1;
 				}
-				return -1;
+			}
+			if (hasPost(EnableKeys::AccountTicket)) {
+				auto res = callPost(EnableKeys::AccountTicket, "PostAccountTicket",
+				                    id < 0 ? nullptr : &Engine::accounts[id]);
+				noLuaCallError(&res);
 			}
 			return id;
 		}
 		return -1;
 	} else {
-		subhook::ScopedHookRemove remove(&createAccountByJoinTicketHook);
+		ScopedOriginal remove(&createAccountByJoinTicketHook,
+		                      EnableKeys::AccountTicketBegin);
 		return Engine::createAccountByJoinTicket(identifier, ticket);
 	}
 }
@@ -989,8 +1115,9 @@ void serverSendConnectResponse(unsigned int address, unsigned int port, int unk,
 		data["message"] = message;
 		std::string newMessage;
 
-		if (run != sol::nil) {
-			auto res = run("SendConnectResponse", addressString, port, data);
+		if (hasPre(EnableKeys::SendConnectResponse)) {
+			auto res = callPre(EnableKeys::SendConnectResponse, "SendConnectResponse",
+			                   addressString, port, data);
 			if (noLuaCallError(&res)) {
 				noParent = (bool)res;
 				newMessage = data["message"];
@@ -999,16 +1126,20 @@ void serverSendConnectResponse(unsigned int address, unsigned int port, int unk,
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&serverSendConnectResponseHook);
+				ScopedOriginal remove(&serverSendConnectResponseHook,
+				                      EnableKeys::SendConnectResponse);
 				Engine::serverSendConnectResponse(address, port, unk, message);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostSendConnectResponse", addressString, port, data);
+			if (hasPost(EnableKeys::SendConnectResponse)) {
+				auto res = callPost(EnableKeys::SendConnectResponse,
+				                    "PostSendConnectResponse", addressString, port,
+				                    data);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&serverSendConnectResponseHook);
+		ScopedOriginal remove(&serverSendConnectResponseHook,
+		                      EnableKeys::SendConnectResponse);
 		Engine::serverSendConnectResponse(address, port, unk, message);
 	}
 }
@@ -1016,26 +1147,27 @@ void serverSendConnectResponse(unsigned int address, unsigned int port, int unk,
 int createBullet(int type, Vector* pos, Vector* vel, int playerID) {
 	if (enabledKeys[EnableKeys::BulletCreate]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res =
-			    run("BulletCreate", type, pos, vel, &Engine::players[playerID]);
+		if (hasPre(EnableKeys::BulletCreate)) {
+			auto res = callPre(EnableKeys::BulletCreate, "BulletCreate", type, pos,
+			                   vel, &Engine::players[playerID]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			int id;
 			{
-				subhook::ScopedHookRemove remove(&createBulletHook);
+				ScopedOriginal remove(&createBulletHook, EnableKeys::BulletCreate);
 				id = Engine::createBullet(type, pos, vel, playerID);
 			}
-			if (run != sol::nil && id != -1) {
-				auto res = run("PostBulletCreate", &Engine::bullets[id]);
+			if (hasPost(EnableKeys::BulletCreate) && id != -1) {
+				auto res = callPost(EnableKeys::BulletCreate, "PostBulletCreate",
+				                    &Engine::bullets[id]);
 				noLuaCallError(&res);
 			}
 			return id;
 		}
 		return -1;
 	} else {
-		subhook::ScopedHookRemove remove(&createBulletHook);
+		ScopedOriginal remove(&createBulletHook, EnableKeys::BulletCreate);
 		return Engine::createBullet(type, pos, vel, playerID);
 	}
 }
@@ -1043,36 +1175,33 @@ int createBullet(int type, Vector* pos, Vector* vel, int playerID) {
 int createPlayer() {
 	if (enabledKeys[EnableKeys::PlayerCreate]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("PlayerCreate");
+		if (hasPre(EnableKeys::PlayerCreate)) {
+			auto res = callPre(EnableKeys::PlayerCreate, "PlayerCreate");
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			int id;
 			{
-				subhook::ScopedHookRemove remove(&createPlayerHook);
+				ScopedOriginal remove(&createPlayerHook, EnableKeys::PlayerCreate);
 				id = Engine::createPlayer();
+				activePlayers.insert(id);
 
-				if (id != -1 && playerDataTables[id]) {
-					delete playerDataTables[id];
-					playerDataTables[id] = nullptr;
-				}
+				if (id != -1) playerDataTables.clear(id);
 			}
-			if (run != sol::nil && id != -1) {
-				auto res = run("PostPlayerCreate", &Engine::players[id]);
+			if (hasPost(EnableKeys::PlayerCreate) && id != -1) {
+				auto res = callPost(EnableKeys::PlayerCreate, "PostPlayerCreate",
+				                    &Engine::players[id]);
 				noLuaCallError(&res);
 			}
 			return id;
 		}
 		return -1;
 	} else {
-		subhook::ScopedHookRemove remove(&createPlayerHook);
+		ScopedOriginal remove(&createPlayerHook, EnableKeys::PlayerCreate);
 		int id = Engine::createPlayer();
+		activePlayers.insert(id);
 
-		if (id != -1 && playerDataTables[id]) {
-			delete playerDataTables[id];
-			playerDataTables[id] = nullptr;
-		}
+		if (id != -1) playerDataTables.clear(id);
 
 		return id;
 	}
@@ -1081,68 +1210,64 @@ int createPlayer() {
 void deletePlayer(int playerID) {
 	if (enabledKeys[EnableKeys::PlayerDelete]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("PlayerDelete", &Engine::players[playerID]);
+		if (hasPre(EnableKeys::PlayerDelete)) {
+			auto res = callPre(EnableKeys::PlayerDelete, "PlayerDelete",
+			                   &Engine::players[playerID]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&deletePlayerHook);
+				ScopedOriginal remove(&deletePlayerHook, EnableKeys::PlayerDelete);
 				Engine::deletePlayer(playerID);
+				activePlayers.erase(playerID);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostPlayerDelete", &Engine::players[playerID]);
+			if (hasPost(EnableKeys::PlayerDelete)) {
+				auto res = callPost(EnableKeys::PlayerDelete, "PostPlayerDelete",
+				                    &Engine::players[playerID]);
 				noLuaCallError(&res);
 			}
-			if (playerDataTables[playerID]) {
-				delete playerDataTables[playerID];
-				playerDataTables[playerID] = nullptr;
-			}
+			playerDataTables.clear(playerID);
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&deletePlayerHook);
+		ScopedOriginal remove(&deletePlayerHook, EnableKeys::PlayerDelete);
 		Engine::deletePlayer(playerID);
+		activePlayers.erase(playerID);
 
-		if (playerDataTables[playerID]) {
-			delete playerDataTables[playerID];
-			playerDataTables[playerID] = nullptr;
-		}
+		playerDataTables.clear(playerID);
 	}
 }
 
 int createHuman(Vector* pos, RotMatrix* rot, int playerID) {
 	if (enabledKeys[EnableKeys::HumanCreate]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("HumanCreate", pos, rot, &Engine::players[playerID]);
+		if (hasPre(EnableKeys::HumanCreate)) {
+			auto res = callPre(EnableKeys::HumanCreate, "HumanCreate", pos, rot,
+			                   &Engine::players[playerID]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			int id;
 			{
-				subhook::ScopedHookRemove remove(&createHumanHook);
+				ScopedOriginal remove(&createHumanHook, EnableKeys::HumanCreate);
 				id = Engine::createHuman(pos, rot, playerID);
+				activeHumans.insert(id);
 
-				if (id != -1 && humanDataTables[id]) {
-					delete humanDataTables[id];
-					humanDataTables[id] = nullptr;
-				}
+				if (id != -1) humanDataTables.clear(id);
 			}
-			if (run != sol::nil && id != -1) {
-				auto res = run("PostHumanCreate", &Engine::humans[id]);
+			if (hasPost(EnableKeys::HumanCreate) && id != -1) {
+				auto res = callPost(EnableKeys::HumanCreate, "PostHumanCreate",
+				                    &Engine::humans[id]);
 				noLuaCallError(&res);
 			}
 			return id;
 		}
 		return -1;
 	} else {
-		subhook::ScopedHookRemove remove(&createHumanHook);
+		ScopedOriginal remove(&createHumanHook, EnableKeys::HumanCreate);
 		int id = Engine::createHuman(pos, rot, playerID);
+		activeHumans.insert(id);
 
-		if (id != -1 && humanDataTables[id]) {
-			delete humanDataTables[id];
-			humanDataTables[id] = nullptr;
-		}
+		if (id != -1) humanDataTables.clear(id);
 
 		return id;
 	}
@@ -1151,67 +1276,63 @@ int createHuman(Vector* pos, RotMatrix* rot, int playerID) {
 void deleteHuman(int humanID) {
 	if (enabledKeys[EnableKeys::HumanDelete]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("HumanDelete", &Engine::humans[humanID]);
+		if (hasPre(EnableKeys::HumanDelete)) {
+			auto res = callPre(EnableKeys::HumanDelete, "HumanDelete",
+			                   &Engine::humans[humanID]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&deleteHumanHook);
+				ScopedOriginal remove(&deleteHumanHook, EnableKeys::HumanDelete);
 				Engine::deleteHuman(humanID);
+				activeHumans.erase(humanID);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostHumanDelete", &Engine::humans[humanID]);
+			if (hasPost(EnableKeys::HumanDelete)) {
+				auto res = callPost(EnableKeys::HumanDelete, "PostHumanDelete",
+				                    &Engine::humans[humanID]);
 				noLuaCallError(&res);
 			}
-			if (humanDataTables[humanID]) {
-				delete humanDataTables[humanID];
-				humanDataTables[humanID] = nullptr;
-			}
+			humanDataTables.clear(humanID);
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&deleteHumanHook);
+		ScopedOriginal remove(&deleteHumanHook, EnableKeys::HumanDelete);
 		Engine::deleteHuman(humanID);
+		activeHumans.erase(humanID);
 
-		if (humanDataTables[humanID]) {
-			delete humanDataTables[humanID];
-			humanDataTables[humanID] = nullptr;
-		}
+		humanDataTables.clear(humanID);
 	}
 }
 
 int createItem(int type, Vector* pos, Vector* vel, RotMatrix* rot) {
 	if (enabledKeys[EnableKeys::ItemCreate]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("ItemCreate", &Engine::itemTypes[type], pos, rot);
+		if (hasPre(EnableKeys::ItemCreate)) {
+			auto res = callPre(EnableKeys::ItemCreate, "ItemCreate",
+			                   &Engine::itemTypes[type], pos, rot);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			int id;
 			{
-				subhook::ScopedHookRemove remove(&createItemHook);
+				ScopedOriginal remove(&createItemHook, EnableKeys::ItemCreate);
 				id = Engine::createItem(type, pos, vel, rot);
+				activeItems.insert(id);
 			}
-			if (id != -1 && run != sol::nil) {
-				auto res = run("PostItemCreate", &Engine::items[id]);
+			if (id != -1 && hasPost(EnableKeys::ItemCreate)) {
+				auto res = callPost(EnableKeys::ItemCreate, "PostItemCreate",
+				                    &Engine::items[id]);
 				noLuaCallError(&res);
 			}
-			if (id != -1 && itemDataTables[id]) {
-				delete itemDataTables[id];
-				itemDataTables[id] = nullptr;
-			}
+			if (id != -1) itemDataTables.clear(id);
 			return id;
 		}
 		return -1;
 	} else {
-		subhook::ScopedHookRemove remove(&createItemHook);
+		ScopedOriginal remove(&createItemHook, EnableKeys::ItemCreate);
 		int id = Engine::createItem(type, pos, vel, rot);
+		activeItems.insert(id);
 
-		if (id != -1 && itemDataTables[id]) {
-			delete itemDataTables[id];
-			itemDataTables[id] = nullptr;
-		}
+		if (id != -1) itemDataTables.clear(id);
 
 		return id;
 	}
@@ -1220,32 +1341,30 @@ int createItem(int type, Vector* pos, Vector* vel, RotMatrix* rot) {
 void deleteItem(int itemID) {
 	if (enabledKeys[EnableKeys::ItemDelete]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("ItemDelete", &Engine::items[itemID]);
+		if (hasPre(EnableKeys::ItemDelete)) {
+			auto res = callPre(EnableKeys::ItemDelete, "ItemDelete",
+			                   &Engine::items[itemID]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&deleteItemHook);
+				ScopedOriginal remove(&deleteItemHook, EnableKeys::ItemDelete);
 				Engine::deleteItem(itemID);
+				activeItems.erase(itemID);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostItemDelete", &Engine::items[itemID]);
+			if (hasPost(EnableKeys::ItemDelete)) {
+				auto res = callPost(EnableKeys::ItemDelete, "PostItemDelete",
+				                    &Engine::items[itemID]);
 				noLuaCallError(&res);
 			}
-			if (itemDataTables[itemID]) {
-				delete itemDataTables[itemID];
-				itemDataTables[itemID] = nullptr;
-			}
+			itemDataTables.clear(itemID);
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&deleteItemHook);
+		ScopedOriginal remove(&deleteItemHook, EnableKeys::ItemDelete);
 		Engine::deleteItem(itemID);
+		activeItems.erase(itemID);
 
-		if (itemDataTables[itemID]) {
-			delete itemDataTables[itemID];
-			itemDataTables[itemID] = nullptr;
-		}
+		itemDataTables.clear(itemID);
 	}
 }
 
@@ -1253,37 +1372,34 @@ int createVehicle(int type, Vector* pos, Vector* vel, RotMatrix* rot,
                   int color) {
 	if (enabledKeys[EnableKeys::VehicleCreate]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res =
-			    run("VehicleCreate", &Engine::vehicleTypes[type], pos, rot, color);
+		if (hasPre(EnableKeys::VehicleCreate)) {
+			auto res = callPre(EnableKeys::VehicleCreate, "VehicleCreate",
+			                   &Engine::vehicleTypes[type], pos, rot, color);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			int id;
 			{
-				subhook::ScopedHookRemove remove(&createVehicleHook);
+				ScopedOriginal remove(&createVehicleHook, EnableKeys::VehicleCreate);
 				id = Engine::createVehicle(type, pos, vel, rot, color);
+				activeVehicles.insert(id);
 
-				if (id != -1 && vehicleDataTables[id]) {
-					delete vehicleDataTables[id];
-					vehicleDataTables[id] = nullptr;
-				}
+				if (id != -1) vehicleDataTables.clear(id);
 			}
-			if (id != -1 && run != sol::nil) {
-				auto res = run("PostVehicleCreate", &Engine::vehicles[id]);
+			if (id != -1 && hasPost(EnableKeys::VehicleCreate)) {
+				auto res = callPost(EnableKeys::VehicleCreate, "PostVehicleCreate",
+				                    &Engine::vehicles[id]);
 				noLuaCallError(&res);
 			}
 			return id;
 		}
 		return -1;
 	} else {
-		subhook::ScopedHookRemove remove(&createVehicleHook);
+		ScopedOriginal remove(&createVehicleHook, EnableKeys::VehicleCreate);
 		int id = Engine::createVehicle(type, pos, vel, rot, color);
+		activeVehicles.insert(id);
 
-		if (id != -1 && vehicleDataTables[id]) {
-			delete vehicleDataTables[id];
-			vehicleDataTables[id] = nullptr;
-		}
+		if (id != -1) vehicleDataTables.clear(id);
 
 		return id;
 	}
@@ -1292,32 +1408,30 @@ int createVehicle(int type, Vector* pos, Vector* vel, RotMatrix* rot,
 void deleteVehicle(int vehicleID) {
 	if (enabledKeys[EnableKeys::VehicleDelete]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("VehicleDelete", &Engine::vehicles[vehicleID]);
+		if (hasPre(EnableKeys::VehicleDelete)) {
+			auto res = callPre(EnableKeys::VehicleDelete, "VehicleDelete",
+			                   &Engine::vehicles[vehicleID]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&deleteVehicleHook);
+				ScopedOriginal remove(&deleteVehicleHook, EnableKeys::VehicleDelete);
 				Engine::deleteVehicle(vehicleID);
+				activeVehicles.erase(vehicleID);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostVehicleDelete", &Engine::vehicles[vehicleID]);
+			if (hasPost(EnableKeys::VehicleDelete)) {
+				auto res = callPost(EnableKeys::VehicleDelete, "PostVehicleDelete",
+				                    &Engine::vehicles[vehicleID]);
 				noLuaCallError(&res);
 			}
-			if (vehicleDataTables[vehicleID]) {
-				delete vehicleDataTables[vehicleID];
-				vehicleDataTables[vehicleID] = nullptr;
-			}
+			vehicleDataTables.clear(vehicleID);
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&deleteVehicleHook);
+		ScopedOriginal remove(&deleteVehicleHook, EnableKeys::VehicleDelete);
 		Engine::deleteVehicle(vehicleID);
+		activeVehicles.erase(vehicleID);
 
-		if (vehicleDataTables[vehicleID]) {
-			delete vehicleDataTables[vehicleID];
-			vehicleDataTables[vehicleID] = nullptr;
-		}
+		vehicleDataTables.clear(vehicleID);
 	}
 }
 
@@ -1325,22 +1439,20 @@ int createRigidBody(int type, Vector* pos, RotMatrix* rot, Vector* vel,
                     float mass, Vector* scale) {
 	int id;
 	{
-		subhook::ScopedHookRemove remove(&createRigidBodyHook);
+		ScopedOriginal remove(&createRigidBodyHook);
 		id = Engine::createRigidBody(type, pos, rot, vel, mass, scale);
+		activeBodies.insert(id);
 	}
-	if (id != -1 && bodyDataTables[id]) {
-		delete bodyDataTables[id];
-		bodyDataTables[id] = nullptr;
-	}
+	if (id != -1) bodyDataTables.clear(id);
 	return id;
 }
 
 int linkItem(int itemID, int childItemID, int parentHumanID, int slot) {
 	if (enabledKeys[EnableKeys::ItemLink]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run(
-			    "ItemLink", &Engine::items[itemID],
+		if (hasPre(EnableKeys::ItemLink)) {
+			auto res = callPre(
+			    EnableKeys::ItemLink, "ItemLink", &Engine::items[itemID],
 			    childItemID == -1 ? nullptr : &Engine::items[childItemID],
 			    parentHumanID == -1 ? nullptr : &Engine::humans[parentHumanID], slot);
 			if (noLuaCallError(&res)) noParent = (bool)res;
@@ -1348,22 +1460,22 @@ int linkItem(int itemID, int childItemID, int parentHumanID, int slot) {
 		if (!noParent) {
 			int worked;
 			{
-				subhook::ScopedHookRemove remove(&linkItemHook);
+				ScopedOriginal remove(&linkItemHook, EnableKeys::ItemLink);
 				worked = Engine::linkItem(itemID, childItemID, parentHumanID, slot);
 			}
-			if (run != sol::nil) {
-				auto res =
-				    run("PostItemLink", &Engine::items[itemID],
-				        childItemID == -1 ? nullptr : &Engine::items[childItemID],
-				        parentHumanID == -1 ? nullptr : &Engine::humans[parentHumanID],
-				        slot, (bool)worked);
+			if (hasPost(EnableKeys::ItemLink)) {
+				auto res = callPost(
+				    EnableKeys::ItemLink, "PostItemLink", &Engine::items[itemID],
+				    childItemID == -1 ? nullptr : &Engine::items[childItemID],
+				    parentHumanID == -1 ? nullptr : &Engine::humans[parentHumanID],
+				    slot, (bool)worked);
 				noLuaCallError(&res);
 			}
 			return worked;
 		}
 		return 0;
 	} else {
-		subhook::ScopedHookRemove remove(&linkItemHook);
+		ScopedOriginal remove(&linkItemHook, EnableKeys::ItemLink);
 		return Engine::linkItem(itemID, childItemID, parentHumanID, slot);
 	}
 }
@@ -1371,23 +1483,27 @@ int linkItem(int itemID, int childItemID, int parentHumanID, int slot) {
 void itemComputerInput(int itemID, unsigned int character) {
 	if (enabledKeys[EnableKeys::ItemComputerInput]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("ItemComputerInput", &Engine::items[itemID], character);
+		if (hasPre(EnableKeys::ItemComputerInput)) {
+			auto res = callPre(EnableKeys::ItemComputerInput, "ItemComputerInput",
+			                   &Engine::items[itemID], character);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&itemComputerInputHook);
+				ScopedOriginal remove(&itemComputerInputHook,
+				                      EnableKeys::ItemComputerInput);
 				Engine::itemComputerInput(itemID, character);
 			}
-			if (run != sol::nil) {
-				auto res =
-				    run("PostItemComputerInput", &Engine::items[itemID], character);
+			if (hasPost(EnableKeys::ItemComputerInput)) {
+				auto res = callPost(EnableKeys::ItemComputerInput,
+				                    "PostItemComputerInput", &Engine::items[itemID],
+				                    character);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&itemComputerInputHook);
+		ScopedOriginal remove(&itemComputerInputHook,
+		                      EnableKeys::ItemComputerInput);
 		Engine::itemComputerInput(itemID, character);
 	}
 }
@@ -1395,23 +1511,24 @@ void itemComputerInput(int itemID, unsigned int character) {
 void humanApplyDamage(int humanID, int bone, int unk, int damage) {
 	if (enabledKeys[EnableKeys::HumanDamage]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("HumanDamage", &Engine::humans[humanID], bone, damage);
+		if (hasPre(EnableKeys::HumanDamage)) {
+			auto res = callPre(EnableKeys::HumanDamage, "HumanDamage",
+			                   &Engine::humans[humanID], bone, damage);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&humanApplyDamageHook);
+				ScopedOriginal remove(&humanApplyDamageHook, EnableKeys::HumanDamage);
 				Engine::humanApplyDamage(humanID, bone, unk, damage);
 			}
-			if (run != sol::nil) {
-				auto res =
-				    run("PostHumanDamage", &Engine::humans[humanID], bone, damage);
+			if (hasPost(EnableKeys::HumanDamage)) {
+				auto res = callPost(EnableKeys::HumanDamage, "PostHumanDamage",
+				                    &Engine::humans[humanID], bone, damage);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&humanApplyDamageHook);
+		ScopedOriginal remove(&humanApplyDamageHook, EnableKeys::HumanDamage);
 		Engine::humanApplyDamage(humanID, bone, unk, damage);
 	}
 }
@@ -1419,24 +1536,29 @@ void humanApplyDamage(int humanID, int bone, int unk, int damage) {
 void humanCollisionVehicle(int humanID, int vehicleID) {
 	if (enabledKeys[EnableKeys::HumanCollisionVehicle]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("HumanCollisionVehicle", &Engine::humans[humanID],
-			               &Engine::vehicles[vehicleID]);
+		if (hasPre(EnableKeys::HumanCollisionVehicle)) {
+			auto res = callPre(EnableKeys::HumanCollisionVehicle,
+			                   "HumanCollisionVehicle", &Engine::humans[humanID],
+			                   &Engine::vehicles[vehicleID]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&humanCollisionVehicleHook);
+				ScopedOriginal remove(&humanCollisionVehicleHook,
+				                      EnableKeys::HumanCollisionVehicle);
 				Engine::humanCollisionVehicle(humanID, vehicleID);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostHumanCollisionVehicle", &Engine::humans[humanID],
-				               &Engine::vehicles[vehicleID]);
+			if (hasPost(EnableKeys::HumanCollisionVehicle)) {
+				auto res = callPost(EnableKeys::HumanCollisionVehicle,
+				                    "PostHumanCollisionVehicle",
+				                    &Engine::humans[humanID],
+				                    &Engine::vehicles[vehicleID]);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&humanCollisionVehicleHook);
+		ScopedOriginal remove(&humanCollisionVehicleHook,
+		                      EnableKeys::HumanCollisionVehicle);
 		Engine::humanCollisionVehicle(humanID, vehicleID);
 	}
 }
@@ -1450,16 +1572,17 @@ void humanLimbInverseKinematics(int humanID, int trunkBoneID, int branchBoneID,
 	if (enabledKeys[EnableKeys::HumanLimbInverseKinematics]) {
 		bool noParent = false;
 
-		if (run != sol::nil) {
+		if (hasPre(EnableKeys::HumanLimbInverseKinematics)) {
 			Float wrappedA = {a};
 			Float wrappedRot = {rot};
 			Float wrappedStrength = {strength};
 			Integer wrappedFlags = {+flags};
 
-			auto res = run("HumanLimbInverseKinematics", &Engine::humans[humanID],
-			               trunkBoneID, branchBoneID, destination, destinationAxis,
-			               vecA, &wrappedA, &wrappedRot, &wrappedStrength, vecB, vecC,
-			               vecD, &wrappedFlags);
+			auto res = callPre(EnableKeys::HumanLimbInverseKinematics,
+			                   "HumanLimbInverseKinematics", &Engine::humans[humanID],
+			                   trunkBoneID, branchBoneID, destination,
+			                   destinationAxis, vecA, &wrappedA, &wrappedRot,
+			                   &wrappedStrength, vecB, vecC, vecD, &wrappedFlags);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 
 			a = wrappedA.value;
@@ -1468,13 +1591,15 @@ void humanLimbInverseKinematics(int humanID, int trunkBoneID, int branchBoneID,
 			flags = wrappedFlags.value;
 		}
 		if (!noParent) {
-			subhook::ScopedHookRemove remove(&humanLimbInverseKinematicsHook);
+			ScopedOriginal remove(&humanLimbInverseKinematicsHook,
+			                      EnableKeys::HumanLimbInverseKinematics);
 			Engine::humanLimbInverseKinematics(
 			    humanID, trunkBoneID, branchBoneID, destination, destinationAxis,
 			    vecA, a, rot, strength, d, vecB, vecC, vecD, flags);
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&humanLimbInverseKinematicsHook);
+		ScopedOriginal remove(&humanLimbInverseKinematicsHook,
+		                      EnableKeys::HumanLimbInverseKinematics);
 		Engine::humanLimbInverseKinematics(
 		    humanID, trunkBoneID, branchBoneID, destination, destinationAxis, vecA,
 		    a, rot, strength, d, vecB, vecC, vecD, flags);
@@ -1484,22 +1609,25 @@ void humanLimbInverseKinematics(int humanID, int trunkBoneID, int branchBoneID,
 void grenadeExplosion(int itemID) {
 	if (enabledKeys[EnableKeys::GrenadeExplode]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("GrenadeExplode", &Engine::items[itemID]);
+		if (hasPre(EnableKeys::GrenadeExplode)) {
+			auto res = callPre(EnableKeys::GrenadeExplode, "GrenadeExplode",
+			                   &Engine::items[itemID]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&grenadeExplosionHook);
+				ScopedOriginal remove(&grenadeExplosionHook,
+				                      EnableKeys::GrenadeExplode);
 				Engine::grenadeExplosion(itemID);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostGrenadeExplode", &Engine::items[itemID]);
+			if (hasPost(EnableKeys::GrenadeExplode)) {
+				auto res = callPost(EnableKeys::GrenadeExplode, "PostGrenadeExplode",
+				                    &Engine::items[itemID]);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&grenadeExplosionHook);
+		ScopedOriginal remove(&grenadeExplosionHook, EnableKeys::GrenadeExplode);
 		Engine::grenadeExplosion(itemID);
 	}
 }
@@ -1507,23 +1635,25 @@ void grenadeExplosion(int itemID) {
 void vehicleApplyDamage(int vehicleID, int damage) {
 	if (enabledKeys[EnableKeys::VehicleDamage]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("VehicleDamage", &Engine::vehicles[vehicleID], damage);
+		if (hasPre(EnableKeys::VehicleDamage)) {
+			auto res = callPre(EnableKeys::VehicleDamage, "VehicleDamage",
+			                   &Engine::vehicles[vehicleID], damage);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&vehicleApplyDamageHook);
+				ScopedOriginal remove(&vehicleApplyDamageHook,
+				                      EnableKeys::VehicleDamage);
 				Engine::vehicleApplyDamage(vehicleID, damage);
 			}
-			if (run != sol::nil) {
-				auto res =
-				    run("PostVehicleDamage", &Engine::vehicles[vehicleID], damage);
+			if (hasPost(EnableKeys::VehicleDamage)) {
+				auto res = callPost(EnableKeys::VehicleDamage, "PostVehicleDamage",
+				                    &Engine::vehicles[vehicleID], damage);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&vehicleApplyDamageHook);
+		ScopedOriginal remove(&vehicleApplyDamageHook, EnableKeys::VehicleDamage);
 		Engine::vehicleApplyDamage(vehicleID, damage);
 	}
 }
@@ -1531,17 +1661,18 @@ void vehicleApplyDamage(int vehicleID, int damage) {
 int serverPlayerMessage(int playerID, char* message) {
 	if (enabledKeys[EnableKeys::PlayerChat]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("PlayerChat", &Engine::players[playerID], message);
+		if (hasPre(EnableKeys::PlayerChat)) {
+			auto res = callPre(EnableKeys::PlayerChat, "PlayerChat",
+			                   &Engine::players[playerID], message);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
-			subhook::ScopedHookRemove remove(&serverPlayerMessageHook);
+			ScopedOriginal remove(&serverPlayerMessageHook, EnableKeys::PlayerChat);
 			return Engine::serverPlayerMessage(playerID, message);
 		}
 		return 1;
 	} else {
-		subhook::ScopedHookRemove remove(&serverPlayerMessageHook);
+		ScopedOriginal remove(&serverPlayerMessageHook, EnableKeys::PlayerChat);
 		return Engine::serverPlayerMessage(playerID, message);
 	}
 }
@@ -1549,22 +1680,24 @@ int serverPlayerMessage(int playerID, char* message) {
 void playerAI(int playerID) {
 	if (enabledKeys[EnableKeys::PlayerAI]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("PlayerAI", &Engine::players[playerID]);
+		if (hasPre(EnableKeys::PlayerAI)) {
+			auto res = callPre(EnableKeys::PlayerAI, "PlayerAI",
+			                   &Engine::players[playerID]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&playerAIHook);
+				ScopedOriginal remove(&playerAIHook, EnableKeys::PlayerAI);
 				Engine::playerAI(playerID);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostPlayerAI", &Engine::players[playerID]);
+			if (hasPost(EnableKeys::PlayerAI)) {
+				auto res = callPost(EnableKeys::PlayerAI, "PostPlayerAI",
+				                    &Engine::players[playerID]);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&playerAIHook);
+		ScopedOriginal remove(&playerAIHook, EnableKeys::PlayerAI);
 		Engine::playerAI(playerID);
 	}
 }
@@ -1572,22 +1705,24 @@ void playerAI(int playerID) {
 void playerDeathTax(int playerID) {
 	if (enabledKeys[EnableKeys::PlayerDeathTax]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("PlayerDeathTax", &Engine::players[playerID]);
+		if (hasPre(EnableKeys::PlayerDeathTax)) {
+			auto res = callPre(EnableKeys::PlayerDeathTax, "PlayerDeathTax",
+			                   &Engine::players[playerID]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&playerDeathTaxHook);
+				ScopedOriginal remove(&playerDeathTaxHook, EnableKeys::PlayerDeathTax);
 				Engine::playerDeathTax(playerID);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostPlayerDeathTax", &Engine::players[playerID]);
+			if (hasPost(EnableKeys::PlayerDeathTax)) {
+				auto res = callPost(EnableKeys::PlayerDeathTax, "PostPlayerDeathTax",
+				                    &Engine::players[playerID]);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&playerDeathTaxHook);
+		ScopedOriginal remove(&playerDeathTaxHook, EnableKeys::PlayerDeathTax);
 		Engine::playerDeathTax(playerID);
 	}
 }
@@ -1595,22 +1730,25 @@ void playerDeathTax(int playerID) {
 void accountDeathTax(int accountID) {
 	if (enabledKeys[EnableKeys::AccountDeathTax]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("AccountDeathTax", &Engine::accounts[accountID]);
+		if (hasPre(EnableKeys::AccountDeathTax)) {
+			auto res = callPre(EnableKeys::AccountDeathTax, "AccountDeathTax",
+			                   &Engine::accounts[accountID]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&accountDeathTaxHook);
+				ScopedOriginal remove(&accountDeathTaxHook,
+				                      EnableKeys::AccountDeathTax);
 				Engine::accountDeathTax(accountID);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostAccountDeathTax", &Engine::accounts[accountID]);
+			if (hasPost(EnableKeys::AccountDeathTax)) {
+				auto res = callPost(EnableKeys::AccountDeathTax, "PostAccountDeathTax",
+				                    &Engine::accounts[accountID]);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&accountDeathTaxHook);
+		ScopedOriginal remove(&accountDeathTaxHook, EnableKeys::AccountDeathTax);
 		Engine::accountDeathTax(accountID);
 	}
 }
@@ -1618,28 +1756,33 @@ void accountDeathTax(int accountID) {
 void playerGiveWantedLevel(int playerID, int victimPlayerID, int basePoints) {
 	if (enabledKeys[EnableKeys::PlayerGiveWantedLevel]) {
 		bool noParent = false;
-		if (run != sol::nil) {
+		if (hasPre(EnableKeys::PlayerGiveWantedLevel)) {
 			Integer wrappedBasePoints = {basePoints};
 
-			auto res = run("PlayerGiveWantedLevel", &Engine::players[playerID],
-			               &Engine::players[victimPlayerID], &wrappedBasePoints);
+			auto res = callPre(EnableKeys::PlayerGiveWantedLevel,
+			                   "PlayerGiveWantedLevel", &Engine::players[playerID],
+			                   &Engine::players[victimPlayerID], &wrappedBasePoints);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 
 			basePoints = wrappedBasePoints.value;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&playerGiveWantedLevelHook);
+				ScopedOriginal remove(&playerGiveWantedLevelHook,
+				                      EnableKeys::PlayerGiveWantedLevel);
 				Engine::playerGiveWantedLevel(playerID, victimPlayerID, basePoints);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostPlayerGiveWantedLevel", &Engine::players[playerID],
-				               &Engine::players[victimPlayerID], basePoints);
+			if (hasPost(EnableKeys::PlayerGiveWantedLevel)) {
+				auto res = callPost(EnableKeys::PlayerGiveWantedLevel,
+				                    "PostPlayerGiveWantedLevel",
+				                    &Engine::players[playerID],
+				                    &Engine::players[victimPlayerID], basePoints);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&playerGiveWantedLevelHook);
+		ScopedOriginal remove(&playerGiveWantedLevelHook,
+		                      EnableKeys::PlayerGiveWantedLevel);
 		Engine::playerGiveWantedLevel(playerID, victimPlayerID, basePoints);
 	}
 }
@@ -1650,19 +1793,21 @@ void addCollisionRigidBodyOnRigidBody(int aBodyID, int bBodyID,
                                       float d) {
 	if (enabledKeys[EnableKeys::CollideBodies]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("CollideBodies", &Engine::bodies[aBodyID],
-			               &Engine::bodies[bBodyID], aLocalPos, bLocalPos, normal, a,
-			               b, c, d);
+		if (hasPre(EnableKeys::CollideBodies)) {
+			auto res = callPre(EnableKeys::CollideBodies, "CollideBodies",
+			                   &Engine::bodies[aBodyID], &Engine::bodies[bBodyID],
+			                   aLocalPos, bLocalPos, normal, a, b, c, d);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
-			subhook::ScopedHookRemove remove(&addCollisionRigidBodyOnRigidBodyHook);
+			ScopedOriginal remove(&addCollisionRigidBodyOnRigidBodyHook,
+			                      EnableKeys::CollideBodies);
 			Engine::addCollisionRigidBodyOnRigidBody(aBodyID, bBodyID, aLocalPos,
 			                                         bLocalPos, normal, a, b, c, d);
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&addCollisionRigidBodyOnRigidBodyHook);
+		ScopedOriginal remove(&addCollisionRigidBodyOnRigidBodyHook,
+		                      EnableKeys::CollideBodies);
 		Engine::addCollisionRigidBodyOnRigidBody(aBodyID, bBodyID, aLocalPos,
 		                                         bLocalPos, normal, a, b, c, d);
 	}
@@ -1682,23 +1827,25 @@ void createEventMessage(int speakerType, char* message, int speakerID,
                         int distance) {
 	if (enabledKeys[EnableKeys::EventMessage]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("EventMessage", speakerType, message, speakerID, distance);
+		if (hasPre(EnableKeys::EventMessage)) {
+			auto res = callPre(EnableKeys::EventMessage, "EventMessage", speakerType,
+			                   message, speakerID, distance);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&createEventMessageHook);
+				ScopedOriginal remove(&createEventMessageHook,
+				                      EnableKeys::EventMessage);
 				Engine::createEventMessage(speakerType, message, speakerID, distance);
 			}
-			if (run != sol::nil) {
-				auto res =
-				    run("PostEventMessage", speakerType, message, speakerID, distance);
+			if (hasPost(EnableKeys::EventMessage)) {
+				auto res = callPost(EnableKeys::EventMessage, "PostEventMessage",
+				                    speakerType, message, speakerID, distance);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&createEventMessageHook);
+		ScopedOriginal remove(&createEventMessageHook, EnableKeys::EventMessage);
 		Engine::createEventMessage(speakerType, message, speakerID, distance);
 	}
 }
@@ -1711,22 +1858,26 @@ void createEventUpdateItemInfo(int id) {
 
 	if (enabledKeys[EnableKeys::EventUpdateItemInfo]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("EventUpdateItemInfo", &Engine::items[id]);
+		if (hasPre(EnableKeys::EventUpdateItemInfo)) {
+			auto res = callPre(EnableKeys::EventUpdateItemInfo, "EventUpdateItemInfo",
+			                   &Engine::items[id]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&createEventUpdateItemInfoHook);
+				ScopedOriginal remove(&createEventUpdateItemInfoHook,
+				                      EnableKeys::EventUpdateItemInfo);
 				Engine::createEventUpdateItemInfo(id);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostEventUpdateItemInfo", &Engine::items[id]);
+			if (hasPost(EnableKeys::EventUpdateItemInfo)) {
+				auto res = callPost(EnableKeys::EventUpdateItemInfo,
+				                    "PostEventUpdateItemInfo", &Engine::items[id]);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&createEventUpdateItemInfoHook);
+		ScopedOriginal remove(&createEventUpdateItemInfoHook,
+		                      EnableKeys::EventUpdateItemInfo);
 		Engine::createEventUpdateItemInfo(id);
 	}
 
@@ -1736,22 +1887,26 @@ void createEventUpdateItemInfo(int id) {
 void createEventUpdatePlayer(int id) {
 	if (enabledKeys[EnableKeys::EventUpdatePlayer]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("EventUpdatePlayer", &Engine::players[id]);
+		if (hasPre(EnableKeys::EventUpdatePlayer)) {
+			auto res = callPre(EnableKeys::EventUpdatePlayer, "EventUpdatePlayer",
+			                   &Engine::players[id]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&createEventUpdatePlayerHook);
+				ScopedOriginal remove(&createEventUpdatePlayerHook,
+				                      EnableKeys::EventUpdatePlayer);
 				Engine::createEventUpdatePlayer(id);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostEventUpdatePlayer", &Engine::players[id]);
+			if (hasPost(EnableKeys::EventUpdatePlayer)) {
+				auto res = callPost(EnableKeys::EventUpdatePlayer,
+				                    "PostEventUpdatePlayer", &Engine::players[id]);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&createEventUpdatePlayerHook);
+		ScopedOriginal remove(&createEventUpdatePlayerHook,
+		                      EnableKeys::EventUpdatePlayer);
 		Engine::createEventUpdatePlayer(id);
 	}
 }
@@ -1760,25 +1915,30 @@ void createEventUpdateVehicle(int vehicleID, int updateType, int partID,
                               Vector* pos, Vector* normal) {
 	if (enabledKeys[EnableKeys::EventUpdateVehicle]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("EventUpdateVehicle", &Engine::vehicles[vehicleID],
-			               updateType, partID, pos, normal);
+		if (hasPre(EnableKeys::EventUpdateVehicle)) {
+			auto res = callPre(EnableKeys::EventUpdateVehicle, "EventUpdateVehicle",
+			                   &Engine::vehicles[vehicleID], updateType, partID, pos,
+			                   normal);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&createEventUpdateVehicleHook);
+				ScopedOriginal remove(&createEventUpdateVehicleHook,
+				                      EnableKeys::EventUpdateVehicle);
 				Engine::createEventUpdateVehicle(vehicleID, updateType, partID, pos,
 				                                 normal);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostEventUpdateVehicle", &Engine::vehicles[vehicleID],
-				               updateType, partID, pos, normal);
+			if (hasPost(EnableKeys::EventUpdateVehicle)) {
+				auto res = callPost(EnableKeys::EventUpdateVehicle,
+				                    "PostEventUpdateVehicle",
+				                    &Engine::vehicles[vehicleID], updateType, partID,
+				                    pos, normal);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&createEventUpdateVehicleHook);
+		ScopedOriginal remove(&createEventUpdateVehicleHook,
+		                      EnableKeys::EventUpdateVehicle);
 		Engine::createEventUpdateVehicle(vehicleID, updateType, partID, pos,
 		                                 normal);
 	}
@@ -1797,14 +1957,15 @@ void createEventSoundItem(unsigned int soundType, int itemID, float volume,
 
 	if (enabledKeys[EnableKeys::EventSoundItem]) {
 		bool noParent = false;
-		if (run != sol::nil) {
+		if (hasPre(EnableKeys::EventSoundItem)) {
 			Float wrappedVolume = {volume};
 			Float wrappedPitch = {pitch};
 			UnsignedInteger wrappedType = {soundType};
 
-			auto res = run("EventSoundItem", wrappedType,
-			               itemID == -1 ? nullptr : &Engine::items[itemID],
-			               wrappedVolume, wrappedPitch);
+			auto res = callPre(EnableKeys::EventSoundItem, "EventSoundItem",
+			                   wrappedType,
+			                   itemID == -1 ? nullptr : &Engine::items[itemID],
+			                   wrappedVolume, wrappedPitch);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 
 			soundType = wrappedType.value;
@@ -1813,16 +1974,19 @@ void createEventSoundItem(unsigned int soundType, int itemID, float volume,
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&createEventSoundItemHook);
+				ScopedOriginal remove(&createEventSoundItemHook,
+				                      EnableKeys::EventSoundItem);
 				Engine::createEventSoundItem(soundType, itemID, volume, pitch);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostEventSoundItem", soundType, itemID, volume, pitch);
+			if (hasPost(EnableKeys::EventSoundItem)) {
+				auto res = callPost(EnableKeys::EventSoundItem, "PostEventSoundItem",
+				                    soundType, itemID, volume, pitch);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&createEventSoundItemHook);
+		ScopedOriginal remove(&createEventSoundItemHook,
+		                      EnableKeys::EventSoundItem);
 		Engine::createEventSoundItem(soundType, itemID, volume, pitch);
 	}
 
@@ -1838,11 +2002,12 @@ void createEventSound(int soundType, Vector* pos, float volume, float pitch) {
 
 	if (enabledKeys[EnableKeys::EventSound]) {
 		bool noParent = false;
-		if (run != sol::nil) {
+		if (hasPre(EnableKeys::EventSound)) {
 			Float wrappedVolume = {volume};
 			Float wrappedPitch = {pitch};
 
-			auto res = run("EventSound", soundType, pos, wrappedVolume, wrappedPitch);
+			auto res = callPre(EnableKeys::EventSound, "EventSound", soundType, pos,
+			                   wrappedVolume, wrappedPitch);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 
 			volume = wrappedVolume.value;
@@ -1850,16 +2015,17 @@ void createEventSound(int soundType, Vector* pos, float volume, float pitch) {
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&createEventSoundHook);
+				ScopedOriginal remove(&createEventSoundHook, EnableKeys::EventSound);
 				Engine::createEventSound(soundType, pos, volume, pitch);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostEventSound", soundType, pos, volume, pitch);
+			if (hasPost(EnableKeys::EventSound)) {
+				auto res = callPost(EnableKeys::EventSound, "PostEventSound", soundType,
+				                    pos, volume, pitch);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&createEventSoundHook);
+		ScopedOriginal remove(&createEventSoundHook, EnableKeys::EventSound);
 		Engine::createEventSound(soundType, pos, volume, pitch);
 	}
 
@@ -1869,24 +2035,24 @@ void createEventSound(int soundType, Vector* pos, float volume, float pitch) {
 void createEventBullet(int bulletType, Vector* pos, Vector* vel, int itemID) {
 	if (enabledKeys[EnableKeys::EventBullet]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res =
-			    run("EventBullet", bulletType, pos, vel, &Engine::items[itemID]);
+		if (hasPre(EnableKeys::EventBullet)) {
+			auto res = callPre(EnableKeys::EventBullet, "EventBullet", bulletType,
+			                   pos, vel, &Engine::items[itemID]);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&createEventBulletHook);
+				ScopedOriginal remove(&createEventBulletHook, EnableKeys::EventBullet);
 				Engine::createEventBullet(bulletType, pos, vel, itemID);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostEventBullet", bulletType, pos, vel,
-				               &Engine::items[itemID]);
+			if (hasPost(EnableKeys::EventBullet)) {
+				auto res = callPost(EnableKeys::EventBullet, "PostEventBullet",
+				                    bulletType, pos, vel, &Engine::items[itemID]);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&createEventBulletHook);
+		ScopedOriginal remove(&createEventBulletHook, EnableKeys::EventBullet);
 		Engine::createEventBullet(bulletType, pos, vel, itemID);
 	}
 }
@@ -1894,22 +2060,26 @@ void createEventBullet(int bulletType, Vector* pos, Vector* vel, int itemID) {
 void createEventBulletHit(int unk, int hitType, Vector* pos, Vector* normal) {
 	if (enabledKeys[EnableKeys::EventBulletHit]) {
 		bool noParent = false;
-		if (run != sol::nil) {
-			auto res = run("EventBulletHit", hitType, pos, normal);
+		if (hasPre(EnableKeys::EventBulletHit)) {
+			auto res = callPre(EnableKeys::EventBulletHit, "EventBulletHit", hitType,
+			                   pos, normal);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&createEventBulletHitHook);
+				ScopedOriginal remove(&createEventBulletHitHook,
+				                      EnableKeys::EventBulletHit);
 				Engine::createEventBulletHit(unk, hitType, pos, normal);
 			}
-			if (run != sol::nil) {
-				auto res = run("PostEventBulletHit", hitType, pos, normal);
+			if (hasPost(EnableKeys::EventBulletHit)) {
+				auto res = callPost(EnableKeys::EventBulletHit, "PostEventBulletHit",
+				                    hitType, pos, normal);
 				noLuaCallError(&res);
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&createEventBulletHitHook);
+		ScopedOriginal remove(&createEventBulletHitHook,
+		                      EnableKeys::EventBulletHit);
 		Engine::createEventBulletHit(unk, hitType, pos, normal);
 	}
 }
@@ -1919,16 +2089,16 @@ void createEventUpdateElimState(int playerID, int trackerVisible,
                                 Vector* saviorPos) {
 	if (enabledKeys[EnableKeys::EventUpdateElimState]) {
 		bool noParent = false;
-		if (run != sol::nil) {
+		if (hasPre(EnableKeys::EventUpdateElimState)) {
 			Integer wrappedVisible = {trackerVisible};
 			Integer wrappedTeam = {playerTeam};
 
-			auto res =
-			    run("EventUpdateElimState",
-			        playerID == -1 ? nullptr : &Engine::players[playerID],
-			        wrappedVisible, wrappedTeam,
-			        saviorPlayerID == -1 ? nullptr : &Engine::players[saviorPlayerID],
-			        saviorPos);
+			auto res = callPre(
+			    EnableKeys::EventUpdateElimState, "EventUpdateElimState",
+			    playerID == -1 ? nullptr : &Engine::players[playerID],
+			    wrappedVisible, wrappedTeam,
+			    saviorPlayerID == -1 ? nullptr : &Engine::players[saviorPlayerID],
+			    saviorPos);
 			if (noLuaCallError(&res)) noParent = (bool)res;
 
 			trackerVisible = wrappedVisible.value;
@@ -1936,13 +2106,14 @@ void createEventUpdateElimState(int playerID, int trackerVisible,
 		}
 		if (!noParent) {
 			{
-				subhook::ScopedHookRemove remove(&createEventUpdateElimStateHook);
+				ScopedOriginal remove(&createEventUpdateElimStateHook,
+				                      EnableKeys::EventUpdateElimState);
 				Engine::createEventUpdateElimState(playerID, trackerVisible, playerTeam,
 				                                   saviorPlayerID, saviorPos);
 			}
-			if (run != sol::nil) {
-				auto res = run(
-				    "PostEventUpdateElimState",
+			if (hasPost(EnableKeys::EventUpdateElimState)) {
+				auto res = callPost(
+				    EnableKeys::EventUpdateElimState, "PostEventUpdateElimState",
 				    playerID == -1 ? nullptr : &Engine::players[playerID],
 				    trackerVisible, playerTeam,
 				    saviorPlayerID == -1 ? nullptr : &Engine::players[saviorPlayerID],
@@ -1951,30 +2122,37 @@ void createEventUpdateElimState(int playerID, int trackerVisible,
 			}
 		}
 	} else {
-		subhook::ScopedHookRemove remove(&createEventUpdateElimStateHook);
+		ScopedOriginal remove(&createEventUpdateElimStateHook,
+		                      EnableKeys::EventUpdateElimState);
 		Engine::createEventUpdateElimState(playerID, trackerVisible, playerTeam,
 		                                   saviorPlayerID, saviorPos);
 	}
 }
 
 int lineIntersectHuman(int humanID, Vector* posA, Vector* posB, float padding) {
-	Bullet* bullet;
+	Bullet* bullet = nullptr;
+	bool batching = false;
+	bool checkHit = false;
 
 	if (isInBulletSimulation) {
+		// posA is Bullet.pos in this case
 		bullet =
 		    reinterpret_cast<Bullet*>(reinterpret_cast<uintptr_t>(posA) - 0x20);
-		if (run != sol::nil && enabledKeys[EnableKeys::BulletMayHitHuman]) {
-			// posA is Bullet.pos in this case
-			auto res = run("BulletMayHitHuman", bullet);
+		batching = BulletHits::isBatching();
+		checkHit = BulletHits::isActive();
+		if (!batching && hasPre(EnableKeys::BulletMayHitHuman)) {
+			auto res = callPre(EnableKeys::BulletMayHitHuman, "BulletMayHitHuman",
+			                   bullet);
 			noLuaCallError(&res);
 		}
 	}
 
 	if (enabledKeys[EnableKeys::LineIntersectHuman] ||
-	    enabledKeys[EnableKeys::BulletHitHuman]) {
+	    enabledKeys[EnableKeys::BulletHitHuman] || checkHit) {
 		int didHit;
 		{
-			subhook::ScopedHookRemove remove(&lineIntersectHumanHook);
+			ScopedOriginal remove(&lineIntersectHumanHook,
+			                      EnableKeys::LineIntersectHuman);
 			didHit = Engine::lineIntersectHuman(humanID, posA, posB, padding);
 		}
 
@@ -1983,54 +2161,67 @@ int lineIntersectHuman(int humanID, Vector* posA, Vector* posB, float padding) {
 		}
 
 		auto lineResult = Engine::lineIntersectResult;
-		auto result = lua->create_table();
-		result["pos"] = lineResult->pos;
-		result["normal"] = lineResult->normal;
-		result["fraction"] = lineResult->fraction;
-		result["bone"] = lineResult->humanBone;
-		result["hit"] = true;
+		if (checkHit &&
+		    !BulletHits::allows(bullet, humanID, lineResult->humanBone)) {
+			return 0;
+		}
+
+		// Copied before Lua gets a chance to cast another line
+		BulletHits::Hit hit{humanID, lineResult->humanBone, lineResult->pos,
+		                    lineResult->normal, lineResult->fraction};
 
 		bool noParent = false;
-		if (run != sol::nil) {
-			if (enabledKeys[EnableKeys::LineIntersectHuman]) {
-				auto res = run("LineIntersectHuman", &Engine::humans[humanID], posA,
-				               posB, padding, result);
-				if (noLuaCallError(&res)) noParent = (bool)res;
-			}
+		if (hasPre(EnableKeys::LineIntersectHuman)) {
+			auto result = lua->create_table();
+			result["pos"] = hit.pos;
+			result["normal"] = hit.normal;
+			result["fraction"] = hit.fraction;
+			result["bone"] = hit.bone;
+			result["hit"] = true;
+
+			auto res = callPre(EnableKeys::LineIntersectHuman, "LineIntersectHuman",
+			                   &Engine::humans[humanID], posA, posB, padding, result);
+			if (noLuaCallError(&res)) noParent = (bool)res;
+		}
 
-			if (isInBulletSimulation && bullet && !noParent &&
-			    enabledKeys[EnableKeys::BulletHitHuman]) {
-				if (Engine::humans[humanID].playerID != bullet->playerID ||
-				    ((lineResult->humanBone - 8 > 1 && lineResult->humanBone - 5 > 1) &&
-				     (Engine::humans[humanID].playerID == -1 ||
-				      Engine::players[Engine::humans[humanID].playerID].isGodMode ==
-				          0))) {
-					auto res = run("BulletHitHuman", &Engine::humans[humanID], bullet);
+		if (isInBulletSimulation && bullet && !noParent && !batching &&
+		    hasPre(EnableKeys::BulletHitHuman)) {
+			if (Engine::humans[humanID].playerID != bullet->playerID ||
+			    ((hit.bone - 8 > 1 && hit.bone - 5 > 1) &&
+			     (Engine::humans[humanID].playerID == -1 ||
+			      Engine::players[Engine::humans[humanID].playerID].isGodMode ==
+			          0))) {
+				auto res = callPre(EnableKeys::BulletHitHuman, "BulletHitHuman",
+				                   &Engine::humans[humanID], bullet);
 
-					if (noLuaCallError(&res)) noParent = (bool)res;
-				}
+				if (noLuaCallError(&res)) noParent = (bool)res;
 			}
 		}
 
+		if (batching && !noParent) {
+			hit.bullet = *bullet;
+			BulletHits::record(hit);
+		}
+
 		return !noParent;
 	} else {
-		subhook::ScopedHookRemove remove(&lineIntersectHumanHook);
+		ScopedOriginal remove(&lineIntersectHumanHook,
+		                      EnableKeys::LineIntersectHuman);
 		return Engine::lineIntersectHuman(humanID, posA, posB, padding);
 	}
 }
 
 int lineIntersectLevel(Vector* posA, Vector* posB, int unk) {
-	if (isInBulletSimulation) {
-		if (run != sol::nil) {
-			// posA is Bullet.pos in this case
-			Bullet* bullet =
-			    reinterpret_cast<Bullet*>(reinterpret_cast<uintptr_t>(posA) - 0x20);
-			auto res = run("BulletMayHit", bullet);
-			noLuaCallError(&res);
-		}
+	if (isInBulletSimulation && !BulletHits::isBatching() &&
+	    hasPre(EnableKeys::BulletMayHit)) {
+		// posA is Bullet.pos in this case
+		Bullet* bullet =
+		    reinterpret_cast<Bullet*>(reinterpret_cast<uintptr_t>(posA) - 0x20);
+		auto res = callPre(EnableKeys::BulletMayHit, "BulletMayHit", bullet);
+		noLuaCallError(&res);
 	}
 
-	subhook::ScopedHookRemove remove(&lineIntersectLevelHook);
+	ScopedOriginal remove(&lineIntersectLevelHook);
 	return Engine::lineIntersectLevel(posA, posB, unk);
 }
 
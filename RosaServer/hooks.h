@@ -1,6 +1,7 @@
 #pragma once
 #include <unordered_map>
 
+#include "profiler.h"
 #include "structs.h"
 #include "subhook.h"
 
@@ -15,6 +16,7 @@ enum EnableKeys {
 	TrafficCarDestination,
 	AreaCreateBlock,
 	AreaDeleteBlock,
+	AreaBlockRegion,
 	InterruptSignal,
 	Logic,
 	ConsoleInput,
@@ -78,11 +80,75 @@ enum EnableKeys {
 	BulletMayHit,
 	BulletMayHitHuman,
 	BulletHitHuman,
+	BulletHits,
 	SIZE
 };
 
 extern const std::unordered_map<std::string, EnableKeys> enableNames;
 extern bool enabledKeys[EnableKeys::SIZE];
+// Events forwarded to hook.run, set by hook.enable.
+extern bool runEnabledKeys[EnableKeys::SIZE];
+// Handlers set by hook.on, called without the event name. A registered
+// handler replaces hook.run for that event.
+extern sol::protected_function preHandlers[EnableKeys::SIZE];
+extern sol::protected_function postHandlers[EnableKeys::SIZE];
+
+void updateEnabledKey(EnableKeys key);
+void clearHandlers();
+
+inline bool hasPre(EnableKeys key) {
+	return preHandlers[key].valid() || (runEnabledKeys[key] && run.valid());
+}
+
+inline bool hasPost(EnableKeys key) {
+	return postHandlers[key].valid() || (runEnabledKeys[key] && run.valid());
+}
+
+template <typename... Args>
+inline sol::protected_function_result callPre(EnableKeys key,
+                                              const char* name,
+                                              Args&&... args) {
+	Profiler::Scope timer(key, Profiler::Pre);
+	if (preHandlers[key].valid()) {
+		return preHandlers[key](std::forward<Args>(args)...);
+	}
+	return run(name, std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+inline sol::protected_function_result callPost(EnableKeys key,
+                                               const char* name,
+                                               Args&&... args) {
+	Profiler::Scope timer(key, Profiler::Post);
+	if (postHandlers[key].valid()) {
+		return postHandlers[key](std::forward<Args>(args)...);
+	}
+	return run(name, std::forward<Args>(args)...);
+}
+
+// Makes Engine:: calls reach the original function for the current scope.
+// Hooks installed with a trampoline already point Engine:: at the original
+// code, so nothing is patched; otherwise the hook is removed until the guard
+// goes out of scope, like subhook::ScopedHookRemove. When given an event key,
+// the time spent in the scope is recorded by the profiler.
+class ScopedOriginal {
+	subhook::Hook* hook;
+	bool removed;
+	Profiler::Scope timer;
+
+ public:
+	explicit ScopedOriginal(subhook::Hook* hook, int key = -1)
+	    : hook(hook),
+	      removed(hook->GetTrampoline() == nullptr && hook->Remove()),
+	      timer(key, Profiler::Original) {}
+	~ScopedOriginal() {
+		if (removed) {
+			hook->Install();
+		}
+	}
+	ScopedOriginal(const ScopedOriginal&) = delete;
+	ScopedOriginal& operator=(const ScopedOriginal&) = delete;
+};
 
 extern subhook::Hook subRosaPutsHook;
 int subRosaPuts(const char* str);
@@ -0,0 +1,150 @@
+#include "httppool.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+
+namespace HTTPPool {
+static constexpr size_t maxClientsPerThread = 16;
+
+struct CachedClient {
+	std::unique_ptr<httplib::Client> client;
+	std::chrono::steady_clock::time_point lastUsed;
+};
+
+static thread_local std::unordered_map<std::string, CachedClient> clients;
+
+static std::mutex requestQueueMutex;
+static std::condition_variable requestQueueCondition;
+static std::queue<LuaHTTPRequest> requestQueue;
+
+static std::mutex responseQueueMutex;
+static std::queue<LuaHTTPResponse> responseQueue;
+
+static std::atomic<size_t> pending = 0;
+static std::once_flag startFlag;
+
+static httplib::Client& getClient(const std::string& scheme, bool& reused) {
+	auto now = std::chrono::steady_clock::now();
+
+	auto it = clients.find(scheme);
+	if (it != clients.end()) {
+		it->second.lastUsed = now;
+		reused = true;
+		return *it->second.client;
+	}
+
+	if (clients.size() >= maxClientsPerThread) {
+		auto oldest = clients.begin();
+		for (auto i = clients.begin(); i != clients.end(); i++) {
+			if (i->second.lastUsed < oldest->second.lastUsed) oldest = i;
+		}
+		clients.erase(oldest);
+	}
+
+	auto client = std::make_unique<httplib::Client>(scheme);
+	client->set_connection_timeout(6);
+	client->set_keep_alive(true);
+	client->set_follow_location(true);
+
+	reused = false;
+	auto& cached = clients[scheme];
+	cached.client = std::move(client);
+	cached.lastUsed = now;
+	return *cached.client;
+}
+
+static httplib::Result send(httplib::Client& client,
+                            const LuaHTTPRequest& request) {
+	if (request.type == post) {
+		return client.Post(request.path.c_str(), request.headers, request.body,
+		                   request.contentType.c_str());
+	}
+	return client.Get(request.path.c_str(), request.headers);
+}
+
+LuaHTTPResponse perform(const LuaHTTPRequest& request) {
+	bool reused;
+	auto res = send(getClient(request.scheme, reused), request);
+
+	if (!res) {
+		// The server may have closed an idle kept-alive connection, so a reused
+		// client gets one retry on a fresh connection. A POST may have reached
+		// the server before failing, so only a GET is safe to send twice.
+		clients.erase(request.scheme);
+		if (reused && request.type == get) {
+			res = send(getClient(request.scheme, reused), request);
+			if (!res) clients.erase(request.scheme);
+		}
+	}
+
+	LuaHTTPResponse response;
+	response.id = request.id;
+	response.responded = (bool)res;
+	if (res) {
+		response.status = res->status;
+		response.body = res->body;
+		response.headers = res->headers;
+	} else {
+		response.status = 0;
+	}
+	return response;
+}
+
+static void threadMain() {
+	while (true) {
+		LuaHTTPRequest request;
+		{
+			std::unique_lock<std::mutex> lock(requestQueueMutex);
+			requestQueueCondition.wait(lock, [] { return !requestQueue.empty(); });
+			request = std::move(requestQueue.front());
+			requestQueue.pop();
+		}
+
+		auto response = perform(request);
+
+		std::lock_guard<std::mutex> guard(responseQueueMutex);
+		responseQueue.push(std::move(response));
+	}
+}
+
+static void start() {
+	for (int i = 0; i < numThreads; i++) {
+		std::thread thread(threadMain);
+		thread.detach();
+	}
+}
+
+bool enqueue(LuaHTTPRequest&& request) {
+	size_t count = pending.load();
+	do {
+		if (count >= maxPending) return false;
+	} while (!pending.compare_exchange_weak(count, count + 1));
+
+	std::call_once(startFlag, start);
+
+	{
+		std::lock_guard<std::mutex> guard(requestQueueMutex);
+		requestQueue.push(std::move(request));
+	}
+	requestQueueCondition.notify_one();
+	return true;
+}
+
+bool popResponse(LuaHTTPResponse& response) {
+	std::lock_guard<std::mutex> guard(responseQueueMutex);
+	if (responseQueue.empty()) return false;
+
+	response = std::move(responseQueue.front());
+	responseQueue.pop();
+	pending--;
+	return true;
+}
+
+size_t getPending() { return pending; }
+}  // namespace HTTPPool
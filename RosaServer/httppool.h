@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+
+#ifndef CPPHTTPLIB_OPENSSL_SUPPORT
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#endif
+#include "../cpp-httplib/httplib.h"
+
+enum LuaRequestType { get, post };
+
+struct LuaHTTPRequest {
+	LuaRequestType type;
+	unsigned int id;
+	std::string scheme;
+	std::string path;
+	std::string contentType;
+	std::string body;
+	httplib::Headers headers;
+};
+
+struct LuaHTTPResponse {
+	unsigned int id;
+	bool responded;
+	int status;
+	std::string body;
+	httplib::Headers headers;
+};
+
+// Background HTTP workers. Each worker keeps one keep-alive client per
+// scheme and host, so repeated calls to the same API reuse the connection.
+namespace HTTPPool {
+static constexpr int numThreads = 4;
+// Requests that were queued but whose responses haven't been popped yet
+static constexpr size_t maxPending = 256;
+
+// Runs a request on the calling thread, reusing that thread's clients
+LuaHTTPResponse perform(const LuaHTTPRequest& request);
+
+// Returns false without queueing if maxPending requests are already pending
+bool enqueue(LuaHTTPRequest&& request);
+bool popResponse(LuaHTTPResponse& response);
+size_t getPending();
+};  // namespace HTTPPool
@@ -4,16 +4,26 @@
 #include "stb_image.h"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <stdexcept>
 
 #include "stb_image_write.h"
+#include "structs.h"
 
 static constexpr const char* errorCouldNotLoad = "Could not load image";
 static constexpr const char* errorCouldNotSave = "Could not save image";
 static constexpr const char* errorNoDataLoaded = "No image data loaded";
 static constexpr const char* errorOutOfRange = "Coordinates out of range";
 static constexpr const char* errorChannels = "Too few channels";
+static constexpr const char* errorRowLength = "Invalid row length";
+static constexpr const char* errorPalette =
+    "Palette must have between 1 and 256 colours";
+static constexpr const char* errorSize = "Size cannot be 0";
+
+static constexpr int computerColumns = 64;
+static constexpr int computerLines = 32;
 
 Image::Image() {}
 
@@ -144,11 +154,107 @@ void Image::setRGBA(unsigned int x, unsigned int y, unsigned char r,
 	data[index + 3] = a;
 }
 
-std::string Image::getPNG() {
+// Writes a PNG whose zlib stream is only stored blocks, trading size for not
+// having to compress anything
+static std::string writeStoredPNG(const uint8_t* data, int width, int height,
+                                  int numChannels) {
+	static const auto crcTable = [] {
+		std::array<uint32_t, 256> table;
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++) {
+				c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			}
+			table[i] = c;
+		}
+		return table;
+	}();
+
+	std::string out("\x89PNG\r\n\x1a\n", 8);
+
+	auto writeBigEndian = [&out](uint32_t value) {
+		char bytes[4] = {(char)(value >> 24), (char)(value >> 16),
+		                 (char)(value >> 8), (char)value};
+		out.append(bytes, 4);
+	};
+
+	size_t chunkStart;
+	auto beginChunk = [&](const char* type) {
+		// Length is filled in by endChunk
+		writeBigEndian(0);
+		chunkStart = out.size();
+		out.append(type, 4);
+	};
+	auto endChunk = [&] {
+		uint32_t length = out.size() - chunkStart - 4;
+		for (int i = 0; i < 4; i++) {
+			out[chunkStart - 4 + i] = (char)(length >> (24 - i * 8));
+		}
+
+		uint32_t crc = 0xffffffff;
+		for (size_t i = chunkStart; i < out.size(); i++) {
+			crc = crcTable[(crc ^ (uint8_t)out[i]) & 0xff] ^ (crc >> 8);
+		}
+		writeBigEndian(crc ^ 0xffffffff);
+	};
+
+	static constexpr char colorTypes[] = {0, 0, 4, 2, 6};
+	beginChunk("IHDR");
+	writeBigEndian(width);
+	writeBigEndian(height);
+	char header[5] = {8, colorTypes[numChannels], 0, 0, 0};
+	out.append(header, 5);
+	endChunk();
+
+	// Every row is its filter type (none) and then the pixels
+	size_t rowSize = (size_t)width * numChannels;
+	std::string raw;
+	raw.reserve((rowSize + 1) * height);
+	for (int y = 0; y < height; y++) {
+		raw.push_back(0);
+		raw.append(reinterpret_cast<const char*>(data) + y * rowSize, rowSize);
+	}
+
+	beginChunk("IDAT");
+	out.append("\x78\x01", 2);
+	for (size_t offset = 0; offset < raw.size();) {
+		size_t size = std::min<size_t>(raw.size() - offset, 0xffff);
+		bool last = offset + size == raw.size();
+		char block[5] = {(char)last, (char)size, (char)(size >> 8), (char)~size,
+		                 (char)(~size >> 8)};
+		out.append(block, 5);
+		out.append(raw, offset, size);
+		offset += size;
+	}
+
+	uint32_t a = 1, b = 0;
+	for (size_t offset = 0; offset < raw.size();) {
+		// The most bytes that can be summed before b could overflow
+		size_t end = std::min(raw.size(), offset + 5552);
+		for (; offset < end; offset++) {
+			a += (uint8_t)raw[offset];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	writeBigEndian(b << 16 | a);
+	endChunk();
+
+	beginChunk("IEND");
+	endChunk();
+	return out;
+}
+
+std::string Image::getPNG(sol::optional<bool> fast) {
 	if (!data) {
 		throw std::runtime_error(errorNoDataLoaded);
 	}
 
+	if (fast.value_or(false)) {
+		return writeStoredPNG(data, width, height, numChannels);
+	}
+
 	int length;
 	unsigned char* pngBuffer = stbi_write_png_to_mem(
 	    reinterpret_cast<const unsigned char*>(data), width * numChannels, width,
@@ -161,3 +267,236 @@ std::string Image::getPNG() {
 	std::free(pngBuffer);
 	return pngString;
 }
+
+void Image::checkLoaded() const {
+	if (!data) {
+		throw std::runtime_error(errorNoDataLoaded);
+	}
+}
+
+bool Image::clip(int& x, int& y, int& w, int& h) const {
+	if (x < 0) {
+		w += x;
+		x = 0;
+	}
+	if (y < 0) {
+		h += y;
+		y = 0;
+	}
+	w = std::min(w, width - x);
+	h = std::min(h, height - y);
+	return w > 0 && h > 0;
+}
+
+// Missing channels read as 255, like getRGBA
+static inline void readPixel(const uint8_t* pixel, int numChannels,
+                             uint8_t rgba[4]) {
+	for (int c = 0; c < 4; c++) {
+		rgba[c] = c < numChannels ? pixel[c] : 255;
+	}
+}
+
+std::string Image::getRow(unsigned int y) const {
+	checkLoaded();
+	if (y >= height) {
+		throw std::invalid_argument(errorOutOfRange);
+	}
+
+	size_t rowSize = (size_t)width * numChannels;
+	return std::string(reinterpret_cast<const char*>(data) + y * rowSize,
+	                   rowSize);
+}
+
+void Image::setRow(unsigned int y, std::string_view row) {
+	checkLoaded();
+	if (y >= height) {
+		throw std::invalid_argument(errorOutOfRange);
+	}
+
+	size_t rowSize = (size_t)width * numChannels;
+	if (row.size() != rowSize) {
+		throw std::invalid_argument(errorRowLength);
+	}
+	std::memcpy(data + y * rowSize, row.data(), rowSize);
+}
+
+uintptr_t Image::getDataAddress() const {
+	checkLoaded();
+	return reinterpret_cast<uintptr_t>(data);
+}
+
+void Image::fill(uint8_t r, uint8_t g, uint8_t b, sol::optional<uint8_t> a) {
+	checkLoaded();
+	fillRect(0, 0, width, height, r, g, b, a);
+}
+
+void Image::fillRect(int x, int y, int w, int h, uint8_t r, uint8_t g,
+                     uint8_t b, sol::optional<uint8_t> a) {
+	checkLoaded();
+	if (!clip(x, y, w, h)) return;
+
+	const uint8_t rgba[4] = {r, g, b, a.value_or(255)};
+	size_t rowSize = (size_t)w * numChannels;
+	uint8_t* first = data + ((size_t)y * width + x) * numChannels;
+
+	// Fill the first row pixel by pixel, then copy it down
+	for (size_t i = 0; i < rowSize; i++) {
+		first[i] = rgba[i % numChannels];
+	}
+	for (int row = 1; row < h; row++) {
+		std::memcpy(first + (size_t)row * width * numChannels, first, rowSize);
+	}
+}
+
+void Image::blit(const Image& source, int x, int y) {
+	checkLoaded();
+	source.checkLoaded();
+
+	int sourceX = x < 0 ? -x : 0;
+	int sourceY = y < 0 ? -y : 0;
+	int w = source.width;
+	int h = source.height;
+	if (!clip(x, y, w, h)) return;
+
+	for (int row = 0; row < h; row++) {
+		const uint8_t* in =
+		    source.data +
+		    ((size_t)(sourceY + row) * source.width + sourceX) * source.numChannels;
+		uint8_t* out = data + ((size_t)(y + row) * width + x) * numChannels;
+
+		if (source.numChannels == numChannels) {
+			std::memcpy(out, in, (size_t)w * numChannels);
+			continue;
+		}
+
+		for (int column = 0; column < w; column++) {
+			uint8_t rgba[4];
+			readPixel(in + column * source.numChannels, source.numChannels, rgba);
+			std::memcpy(out + column * numChannels, rgba, numChannels);
+		}
+	}
+}
+
+void Image::resize(unsigned int newWidth, unsigned int newHeight) {
+	checkLoaded();
+	if (newWidth == 0 || newHeight == 0) {
+		throw std::invalid_argument(errorSize);
+	}
+
+	auto resized = (uint8_t*)std::malloc((size_t)newWidth * newHeight *
+	                                     numChannels * sizeof(uint8_t));
+	if (!resized) {
+		throw std::runtime_error(errorCouldNotLoad);
+	}
+
+	// Sample at pixel centres so shrinking and growing both stay aligned
+	float scaleX = (float)width / newWidth;
+	float scaleY = (float)height / newHeight;
+
+	for (unsigned int y = 0; y < newHeight; y++) {
+		float sourceY = std::max(0.f, (y + 0.5f) * scaleY - 0.5f);
+		int y0 = std::min((int)sourceY, height - 1);
+		int y1 = std::min(y0 + 1, height - 1);
+		float fy = sourceY - y0;
+
+		const uint8_t* row0 = data + (size_t)y0 * width * numChannels;
+		const uint8_t* row1 = data + (size_t)y1 * width * numChannels;
+		uint8_t* out = resized + (size_t)y * newWidth * numChannels;
+
+		for (unsigned int x = 0; x < newWidth; x++) {
+			float sourceX = std::max(0.f, (x + 0.5f) * scaleX - 0.5f);
+			int x0 = std::min((int)sourceX, width - 1);
+			int x1 = std::min(x0 + 1, width - 1);
+			float fx = sourceX - x0;
+
+			for (int c = 0; c < numChannels; c++) {
+				float top = row0[x0 * numChannels + c] * (1 - fx) +
+				            row0[x1 * numChannels + c] * fx;
+				float bottom = row1[x0 * numChannels + c] * (1 - fx) +
+				               row1[x1 * numChannels + c] * fx;
+				out[x * numChannels + c] =
+				    (uint8_t)(top * (1 - fy) + bottom * fy + 0.5f);
+			}
+		}
+	}
+
+	std::free(data);
+	data = resized;
+	width = newWidth;
+	height = newHeight;
+}
+
+Image::Palette Image::readPalette(sol::table palette) {
+	Palette colors;
+	for (size_t i = 1; i <= palette.size(); i++) {
+		sol::table color = palette[i];
+		colors.push_back({color[1], color[2], color[3]});
+	}
+
+	if (colors.empty() || colors.size() > 256) {
+		throw std::invalid_argument(errorPalette);
+	}
+	return colors;
+}
+
+void Image::quantizeRow(int x, int y, int count, const Palette& palette,
+                        uint8_t* out) const {
+	const uint8_t* in = data + ((size_t)y * width + x) * numChannels;
+
+	// Neighbouring pixels are often the same colour
+	int lastColor = -1;
+	uint8_t lastIndex = 0;
+
+	for (int i = 0; i < count; i++, in += numChannels) {
+		uint8_t rgba[4];
+		readPixel(in, numChannels, rgba);
+		int color = rgba[0] << 16 | rgba[1] << 8 | rgba[2];
+
+		if (color != lastColor) {
+			int bestDistance = INT32_MAX;
+			for (size_t p = 0; p < palette.size(); p++) {
+				int dr = rgba[0] - palette[p][0];
+				int dg = rgba[1] - palette[p][1];
+				int db = rgba[2] - palette[p][2];
+				int distance = dr * dr + dg * dg + db * db;
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					lastIndex = p;
+				}
+			}
+			lastColor = color;
+		}
+
+		out[i] = lastIndex;
+	}
+}
+
+std::string Image::quantize(sol::table palette) const {
+	checkLoaded();
+	auto colors = readPalette(palette);
+
+	std::string indices((size_t)width * height, '\0');
+	for (int y = 0; y < height; y++) {
+		quantizeRow(0, y, width, colors,
+		            reinterpret_cast<uint8_t*>(indices.data()) + (size_t)y * width);
+	}
+	return indices;
+}
+
+void Image::renderToComputer(Item* item, sol::table palette,
+                             sol::optional<int> x, sol::optional<int> y) const {
+	checkLoaded();
+	auto colors = readPalette(palette);
+
+	int left = x.value_or(0);
+	int top = y.value_or(0);
+	int w = computerColumns;
+	int h = computerLines;
+	if (left < 0 || top < 0 || !clip(left, top, w, h)) {
+		throw std::invalid_argument(errorOutOfRange);
+	}
+
+	for (int line = 0; line < h; line++) {
+		quantizeRow(left, top + line, w, colors, item->computerLineColors[line]);
+	}
+}
@@ -1,15 +1,31 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <vector>
+
+#include "sol/sol.hpp"
+
+struct Item;
 
 class Image {
+	using Palette = std::vector<std::array<uint8_t, 3>>;
+
 	uint8_t* data = nullptr;
 	int width = 0;
 	int height = 0;
 	int numChannels = 0;
 
+	void checkLoaded() const;
+	// Clips a rectangle to the image, returning false if nothing is left
+	bool clip(int& x, int& y, int& w, int& h) const;
+	static Palette readPalette(sol::table palette);
+	void quantizeRow(int x, int y, int count, const Palette& palette,
+	                 uint8_t* out) const;
+
  public:
 	Image();
 	~Image();
@@ -26,5 +42,27 @@ class Image {
 	            unsigned char b);
 	void setRGBA(unsigned int x, unsigned int y, unsigned char r, unsigned char g,
 	             unsigned char b, unsigned char a);
-	std::string getPNG();
+	// Fast skips compression entirely, for previews that change often
+	std::string getPNG(sol::optional<bool> fast);
+
+	// Rows are width * numChannels bytes, laid out like the pixels are stored
+	std::string getRow(unsigned int y) const;
+	void setRow(unsigned int y, std::string_view row);
+	// For use with ffi.cast, valid until the image is freed or loaded again
+	uintptr_t getDataAddress() const;
+
+	void fill(uint8_t r, uint8_t g, uint8_t b, sol::optional<uint8_t> a);
+	void fillRect(int x, int y, int w, int h, uint8_t r, uint8_t g, uint8_t b,
+	              sol::optional<uint8_t> a);
+	// Copies source onto this image at x, y, converting channels as needed
+	void blit(const Image& source, int x, int y);
+	// Bilinear resampling
+	void resize(unsigned int newWidth, unsigned int newHeight);
+	// palette is a list of {r, g, b}. Returns one byte per pixel, the 0-based
+	// index of the nearest colour.
+	std::string quantize(sol::table palette) const;
+	// Quantizes the 64x32 pixels at x, y straight into a computer's line
+	// colours, so palette entry n is written as colour n - 1
+	void renderToComputer(Item* item, sol::table palette, sol::optional<int> x,
+	                      sol::optional<int> y) const;
 };
@@ -1,42 +1,207 @@
 #include "lz4impl.h"
 
+#include <algorithm>
 #include <stdexcept>
 
+#include "serializer.h"
+
+static constexpr size_t dictionarySize = 64 * 1024;
+
+static constexpr const char* errorCompress = "lz4 compression failed";
+static constexpr const char* errorUncompress = "lz4 decompress failed";
+static constexpr const char* errorTooLarge = "Input is too large";
+static constexpr const char* errorFrameTooLarge = "Frame is too large";
+static constexpr const char* errorInvalidSize = "Invalid uncompressed size";
+static constexpr const char* errorInvalidLevel =
+    "Compression level must be between 0 and 12";
+
+static int checkLevel(sol::optional<int> level) {
+	int value = level.value_or(0);
+	if (value < 0 || value > LZ4HC_CLEVEL_MAX) {
+		throw std::invalid_argument(errorInvalidLevel);
+	}
+	return value;
+}
+
+// Reserves room for the worst case at the end of out, and returns where it is
+static char* reserveBound(std::string& out, std::string_view input,
+                          int& bound) {
+	if (input.size() > LZ4_MAX_INPUT_SIZE) {
+		throw std::invalid_argument(errorTooLarge);
+	}
+
+	bound = LZ4_compressBound(input.size());
+	size_t start = out.size();
+	out.resize(start + bound);
+	return out.data() + start;
+}
+
+// Reads the varint at the front of a frame, leaving the block
+static size_t readFrameSize(std::string_view& frame, size_t maxSize) {
+	Serializer::detail::Reader reader{frame.data(), frame.data() + frame.size()};
+	size_t size = reader.varint();
+	if (size > maxSize || size > LZ4_MAX_INPUT_SIZE) {
+		throw std::runtime_error(errorFrameTooLarge);
+	}
+
+	frame.remove_prefix(reader.cursor - frame.data());
+	return size;
+}
+
 namespace Lua {
 namespace lz4 {
-std::string _compress(std::string_view input) {
-	int compressedSize = LZ4_compressBound(input.size());
-	char* compressed = new char[compressedSize];
+void compressTo(std::string& out, std::string_view input, int level) {
+	// Creating a state zeroes a large table, so each thread keeps one around
+	thread_local std::unique_ptr<LZ4_stream_t, StreamDeleter> fastState;
+	thread_local std::unique_ptr<LZ4_streamHC_t, StreamDeleter> hcState;
+
+	int bound;
+	size_t start = out.size();
+	char* destination = reserveBound(out, input, bound);
 
-	int finalLen =
-	    LZ4_compress_default(reinterpret_cast<const char*>(input.data()),
-	                         compressed, input.size(), compressedSize);
-	if (finalLen == 0) {
-		throw std::runtime_error("lz4 compression failed");
+	int finalLen;
+	if (level == 0) {
+		if (!fastState) fastState.reset(LZ4_createStream());
+		finalLen = LZ4_compress_fast_extState(fastState.get(), input.data(),
+		                                      destination, input.size(), bound, 1);
+	} else {
+		if (!hcState) hcState.reset(LZ4_createStreamHC());
+		finalLen = LZ4_compress_HC_extStateHC(hcState.get(), input.data(),
+		                                      destination, input.size(), bound,
+		                                      level);
 	}
 
-	std::string compressedString(reinterpret_cast<const char*>(compressed),
-	                             finalLen);
+	if (finalLen <= 0) {
+		out.resize(start);
+		throw std::runtime_error(errorCompress);
+	}
+	out.resize(start + finalLen);
+}
 
-	delete[] compressed;
-	return compressedString;
+void compressFrameTo(std::string& out, std::string_view input, int level) {
+	Serializer::detail::writeVarint(out, input.size());
+	compressTo(out, input, level);
+}
+
+std::string uncompressFrame(std::string_view frame, size_t maxSize) {
+	size_t size = readFrameSize(frame, maxSize);
+
+	std::string uncompressed(size, '\0');
+	int finalLen = LZ4_decompress_safe(frame.data(), uncompressed.data(),
+	                                   frame.size(), size);
+	if (finalLen != (int)size) {
+		throw std::runtime_error(errorUncompress);
+	}
+	return uncompressed;
+}
+
+std::string _compress(std::string_view input, sol::optional<int> level) {
+	std::string compressed;
+	compressTo(compressed, input, checkLevel(level));
+	return compressed;
 }
 
 std::string _uncompress(std::string_view compressed, int uncompressedSize) {
-	char* uncompressed = new char[uncompressedSize];
+	if (uncompressedSize < 0) {
+		throw std::invalid_argument(errorInvalidSize);
+	}
 
-	int finalLen =
-	    LZ4_decompress_safe(reinterpret_cast<const char*>(compressed.data()),
-	                        uncompressed, compressed.size(), uncompressedSize);
+	std::string uncompressed(uncompressedSize, '\0');
+	int finalLen = LZ4_decompress_safe(compressed.data(), uncompressed.data(),
+	                                   compressed.size(), uncompressedSize);
 	if (finalLen <= 0) {
-		throw std::runtime_error("lz4 decompress failed");
+		throw std::runtime_error(errorUncompress);
 	}
 
-	std::string uncompressedString(reinterpret_cast<const char*>(uncompressed),
-	                               finalLen);
+	uncompressed.resize(finalLen);
+	return uncompressed;
+}
 
-	delete[] uncompressed;
-	return uncompressedString;
+std::string _compressFrame(std::string_view input, sol::optional<int> level) {
+	std::string frame;
+	compressFrameTo(frame, input, checkLevel(level));
+	return frame;
+}
+
+std::string _uncompressFrame(std::string_view frame,
+                             sol::optional<size_t> maxSize) {
+	return uncompressFrame(frame, maxSize.value_or(defaultMaxFrameSize));
 }
 }  // namespace lz4
 }  // namespace Lua
+
+LZ4Compressor::LZ4Compressor(sol::optional<int> level)
+    : level(checkLevel(level)), dictionary(new char[dictionarySize]) {
+	if (this->level == 0) {
+		fastStream.reset(LZ4_createStream());
+	} else {
+		hcStream.reset(LZ4_createStreamHC());
+		LZ4_resetStreamHC_fast(hcStream.get(), this->level);
+	}
+}
+
+void LZ4Compressor::reset() {
+	if (fastStream) {
+		LZ4_resetStream_fast(fastStream.get());
+	} else {
+		LZ4_resetStreamHC_fast(hcStream.get(), level);
+	}
+}
+
+std::string LZ4Compressor::compress(std::string_view chunk) {
+	std::string frame;
+	Serializer::detail::writeVarint(frame, chunk.size());
+
+	int bound;
+	size_t start = frame.size();
+	char* destination = reserveBound(frame, chunk, bound);
+
+	int finalLen;
+	if (fastStream) {
+		finalLen = LZ4_compress_fast_continue(fastStream.get(), chunk.data(),
+		                                      destination, chunk.size(), bound, 1);
+	} else {
+		finalLen = LZ4_compress_HC_continue(hcStream.get(), chunk.data(),
+		                                    destination, chunk.size(), bound);
+	}
+	if (finalLen <= 0) {
+		throw std::runtime_error(errorCompress);
+	}
+	frame.resize(start + finalLen);
+
+	// The stream refers to the chunk, which the caller is about to free, so
+	// the end of it is copied somewhere that lasts until the next call
+	if (fastStream) {
+		LZ4_saveDict(fastStream.get(), dictionary.get(), dictionarySize);
+	} else {
+		LZ4_saveDictHC(hcStream.get(), dictionary.get(), dictionarySize);
+	}
+
+	return frame;
+}
+
+std::string LZ4Decompressor::uncompress(std::string_view frame,
+                                        sol::optional<size_t> maxSize) {
+	size_t size =
+	    readFrameSize(frame, maxSize.value_or(Lua::lz4::defaultMaxFrameSize));
+
+	std::string uncompressed(size, '\0');
+	int finalLen = LZ4_decompress_safe_usingDict(
+	    frame.data(), uncompressed.data(), frame.size(), size, dictionary.data(),
+	    dictionary.size());
+	if (finalLen != (int)size) {
+		throw std::runtime_error(errorUncompress);
+	}
+
+	// Keep the same last 64KB the compressor did
+	if (uncompressed.size() >= dictionarySize) {
+		dictionary.assign(uncompressed.end() - dictionarySize, uncompressed.end());
+	} else {
+		size_t keep = std::min(dictionary.size(),
+		                       dictionarySize - uncompressed.size());
+		dictionary.erase(0, dictionary.size() - keep);
+		dictionary.append(uncompressed);
+	}
+
+	return uncompressed;
+}
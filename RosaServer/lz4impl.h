@@ -1,11 +1,58 @@
 #pragma once
+#include <memory>
 #include <string>
+#include <string_view>
 
 #include "lz4.h"
+#include "lz4hc.h"
+#include "sol/sol.hpp"
 
 namespace Lua {
 namespace lz4 {
-std::string _compress(std::string_view input);
+// Frames bigger than this are rejected unless a larger limit is given
+static constexpr size_t defaultMaxFrameSize = 64 << 20;
+
+struct StreamDeleter {
+	void operator()(LZ4_stream_t* stream) const { LZ4_freeStream(stream); }
+	void operator()(LZ4_streamHC_t* stream) const { LZ4_freeStreamHC(stream); }
+};
+
+// Level 0 uses the fast compressor, 1 to 12 use LZ4 HC. Both append to out
+// using state kept per thread.
+void compressTo(std::string& out, std::string_view input, int level = 0);
+// A frame is a varint of the uncompressed size followed by the block
+void compressFrameTo(std::string& out, std::string_view input, int level = 0);
+std::string uncompressFrame(std::string_view frame, size_t maxSize);
+
+std::string _compress(std::string_view input, sol::optional<int> level);
 std::string _uncompress(std::string_view compressed, int uncompressedSize);
+std::string _compressFrame(std::string_view input, sol::optional<int> level);
+std::string _uncompressFrame(std::string_view frame,
+                             sol::optional<size_t> maxSize);
 }  // namespace lz4
 }  // namespace Lua
+
+// Compresses a stream of chunks into frames, each able to refer back to the
+// last 64KB of earlier chunks. They have to be uncompressed in order by an
+// LZ4Decompressor.
+class LZ4Compressor {
+	int level;
+	std::unique_ptr<LZ4_stream_t, Lua::lz4::StreamDeleter> fastStream;
+	std::unique_ptr<LZ4_streamHC_t, Lua::lz4::StreamDeleter> hcStream;
+	std::unique_ptr<char[]> dictionary;
+
+ public:
+	LZ4Compressor(sol::optional<int> level);
+	std::string compress(std::string_view chunk);
+	// Forgets earlier chunks, for starting a new stream
+	void reset();
+};
+
+class LZ4Decompressor {
+	std::string dictionary;
+
+ public:
+	std::string uncompress(std::string_view frame,
+	                       sol::optional<size_t> maxSize);
+	void reset() { dictionary.clear(); }
+};
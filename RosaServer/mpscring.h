@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded lock-free queue for any number of producer threads and exactly one
+// consumer thread. Like SPSCRing, a full ring refuses new values instead of
+// overwriting old ones.
+//
+// Each slot has a sequence number saying whose turn it is: a producer claims
+// the tail by compare-exchange and publishes the slot by bumping its
+// sequence, which is what the consumer waits on.
+template <typename T, size_t Capacity>
+class MPSCRing {
+	static_assert((Capacity & (Capacity - 1)) == 0,
+	              "Capacity must be a power of two");
+	static constexpr size_t mask = Capacity - 1;
+
+	struct Slot {
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	Slot slots[Capacity];
+
+	alignas(64) std::atomic<size_t> head = 0;
+	alignas(64) std::atomic<size_t> tail = 0;
+
+ public:
+	MPSCRing() {
+		for (size_t i = 0; i < Capacity; i++) {
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	// Any thread
+	bool push(T&& value) {
+		size_t position = tail.load(std::memory_order_relaxed);
+		Slot* slot;
+
+		while (true) {
+			slot = &slots[position & mask];
+			size_t sequence = slot->sequence.load(std::memory_order_acquire);
+			auto difference = (ptrdiff_t)sequence - (ptrdiff_t)position;
+
+			if (difference == 0) {
+				if (tail.compare_exchange_weak(position, position + 1,
+				                               std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (difference < 0) {
+				// The consumer hasn't freed this slot since the last lap
+				return false;
+			} else {
+				position = tail.load(std::memory_order_relaxed);
+			}
+		}
+
+		slot->value = std::move(value);
+		slot->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only
+	bool pop(T& value) {
+		size_t position = head.load(std::memory_order_relaxed);
+		Slot& slot = slots[position & mask];
+		if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+			return false;
+		}
+
+		value = std::move(slot.value);
+		slot.sequence.store(position + Capacity, std::memory_order_release);
+		head.store(position + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Consumer only, so a claimed slot that isn't published yet counts as empty
+	bool empty() const {
+		size_t position = head.load(std::memory_order_relaxed);
+		return slots[position & mask].sequence.load(std::memory_order_acquire) !=
+		       position + 1;
+	}
+};
@@ -0,0 +1,259 @@
+#include "opuspipeline.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include "structs.h"
+
+static constexpr int sampleRate = 48000;
+static constexpr int defaultBitRate = 16000;
+static constexpr int frameSize = 960;
+static constexpr int numVoiceFrames = 64;
+
+static constexpr const char* errorOutOfRange = "Index out of range";
+static constexpr const char* errorNotPlayer = "Expected a table of players";
+
+OpusPipeline::Shared::~Shared() { opus_encoder_destroy(encoder); }
+
+void OpusPipeline::Shared::wake() {
+	// Same handshake as Worker::Channel, so the main thread only takes the lock
+	// when the encoding thread is actually waiting
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (!waiting) return;
+
+	{ std::lock_guard<std::mutex> guard(mutex); }
+	wakeCondition.notify_all();
+}
+
+// Reads up to a frame of samples, marking the stream finished once it runs out
+static size_t readSamples(FILE* file, bool loop, bool& finished,
+                          uint8_t bytes[]) {
+	size_t samples = 0;
+	while (samples < frameSize) {
+		size_t read = fread(bytes + samples * sizeof(opus_int16),
+		                    sizeof(opus_int16), frameSize - samples, file);
+		samples += read;
+		if (samples == frameSize) break;
+
+		if (!loop || (!read && ftell(file) == 0)) {
+			// Out of samples, or an empty file that would loop forever
+			finished = true;
+			break;
+		}
+		std::rewind(file);
+	}
+	return samples;
+}
+
+bool OpusPipeline::Shared::mix(float pcm[],
+                               std::unique_lock<std::mutex>& lock) {
+	if (sources.empty()) return false;
+
+	std::vector<std::pair<std::shared_ptr<Stream>, float>> playing;
+	playing.reserve(sources.size());
+	for (const auto& source : sources) {
+		playing.emplace_back(source.stream, source.volume);
+	}
+	lock.unlock();
+
+	std::fill(pcm, pcm + frameSize, 0.f);
+
+	bool anyFinished = false;
+	for (const auto& [stream, volume] : playing) {
+		uint8_t bytes[frameSize * sizeof(opus_int16)];
+		size_t samples =
+		    readSamples(stream->file.get(), stream->loop, stream->finished, bytes);
+		anyFinished |= stream->finished;
+
+		// Convert from little-endian
+		float scale = volume / 32768.f;
+		for (size_t i = 0; i < samples; i++) {
+			opus_int16 sample = bytes[sizeof(opus_int16) * i + 1] << 8 |
+			                    bytes[sizeof(opus_int16) * i];
+			pcm[i] += sample * scale;
+		}
+	}
+
+	for (int i = 0; i < frameSize; i++) {
+		pcm[i] = std::clamp(pcm[i], -1.f, 1.f);
+	}
+
+	lock.lock();
+	if (anyFinished) {
+		std::erase_if(sources,
+		              [](const Source& source) { return source.stream->finished; });
+	}
+	return true;
+}
+
+void OpusPipeline::runThread(std::shared_ptr<Shared> shared) {
+	// The encoder is only touched by this thread, so bit rate changes are
+	// applied here. 0 is never valid, so the first frame always sets it.
+	opus_int32 bitRate = 0;
+	Frame frame;
+	bool havePending = false;
+
+	std::unique_lock<std::mutex> lock(shared->mutex);
+	while (!shared->stopped) {
+		if (!havePending) {
+			float pcm[frameSize];
+			if (shared->mix(pcm, lock)) {
+				lock.unlock();
+
+				if (bitRate != shared->bitRate) {
+					bitRate = shared->bitRate;
+					opus_encoder_ctl(shared->encoder, OPUS_SET_BITRATE(bitRate));
+				}
+
+				frame.size = opus_encode_float(shared->encoder, pcm, frameSize,
+				                               frame.data, maxPacketSize);
+				havePending = frame.size > 0;
+
+				lock.lock();
+				continue;
+			}
+		} else if (shared->frames.push(std::move(frame))) {
+			havePending = false;
+			continue;
+		}
+
+		// Wait for a source to be added or a frame to be taken. Sources can't
+		// change while the lock is held, but frames are taken without it, so
+		// the push is retried after saying we're waiting.
+		shared->waiting = true;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (havePending && shared->frames.push(std::move(frame))) {
+			havePending = false;
+		} else if (!shared->stopped) {
+			shared->wakeCondition.wait(lock);
+		}
+		shared->waiting = false;
+	}
+}
+
+OpusPipeline::OpusPipeline(sol::optional<opus_int32> bitRate)
+    : shared(std::make_shared<Shared>()) {
+	int error;
+	shared->encoder =
+	    opus_encoder_create(sampleRate, 1, OPUS_APPLICATION_AUDIO, &error);
+	if (error != OPUS_OK) {
+		throw std::runtime_error(opus_strerror(error));
+	}
+
+	setBitRate(bitRate.value_or(defaultBitRate));
+
+	std::thread thread(&OpusPipeline::runThread, shared);
+	thread.detach();
+}
+
+OpusPipeline::~OpusPipeline() {
+	shared->stopped = true;
+	{ std::lock_guard<std::mutex> guard(shared->mutex); }
+	shared->wakeCondition.notify_all();
+}
+
+void OpusPipeline::setBitRate(opus_int32 bitRate) {
+	// Checked here so a bad value throws, since the encoding thread is the one
+	// that applies it
+	if (bitRate <= 0 && bitRate != OPUS_AUTO && bitRate != OPUS_BITRATE_MAX) {
+		throw std::invalid_argument(opus_strerror(OPUS_BAD_ARG));
+	}
+	shared->bitRate = bitRate;
+}
+
+int OpusPipeline::addSource(const char* fileName, sol::optional<float> volume,
+                            sol::optional<bool> loop) {
+	FILE* file = fopen(fileName, "rb");
+	if (!file) {
+		throw std::runtime_error(strerror(errno));
+	}
+
+	int id = nextSourceID++;
+	{
+		std::lock_guard<std::mutex> guard(shared->mutex);
+		auto stream = std::make_shared<Stream>(
+		    Stream{std::unique_ptr<FILE, FileCloser>(file), loop.value_or(false)});
+		shared->sources.push_back({id, std::move(stream), volume.value_or(1.f)});
+	}
+	shared->wakeCondition.notify_all();
+	return id;
+}
+
+bool OpusPipeline::removeSource(int id) {
+	std::lock_guard<std::mutex> guard(shared->mutex);
+	auto& sources = shared->sources;
+	auto it =
+	    std::find_if(sources.begin(), sources.end(),
+	                 [id](const Source& source) { return source.id == id; });
+	if (it == sources.end()) return false;
+
+	sources.erase(it);
+	return true;
+}
+
+bool OpusPipeline::setSourceVolume(int id, float volume) {
+	std::lock_guard<std::mutex> guard(shared->mutex);
+	for (auto& source : shared->sources) {
+		if (source.id == id) {
+			source.volume = volume;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool OpusPipeline::hasSource(int id) {
+	std::lock_guard<std::mutex> guard(shared->mutex);
+	return std::any_of(shared->sources.begin(), shared->sources.end(),
+	                   [id](const Source& source) { return source.id == id; });
+}
+
+int OpusPipeline::getSourceCount() {
+	std::lock_guard<std::mutex> guard(shared->mutex);
+	return shared->sources.size();
+}
+
+bool OpusPipeline::popFrame(Frame& frame) {
+	if (!shared->frames.pop(frame)) return false;
+	shared->wake();
+	return true;
+}
+
+sol::object OpusPipeline::nextFrame(sol::this_state s) {
+	sol::state_view lua(s);
+
+	Frame frame;
+	if (!popFrame(frame)) {
+		return sol::make_object(lua, sol::nil);
+	}
+
+	return sol::make_object(
+	    lua, std::string(reinterpret_cast<const char*>(frame.data), frame.size));
+}
+
+bool OpusPipeline::writeVoices(sol::table players, unsigned int frameIndex,
+                               int volumeLevel) {
+	if (frameIndex >= numVoiceFrames) {
+		throw std::invalid_argument(errorOutOfRange);
+	}
+
+	// Checked before a frame is taken, so a bad table doesn't lose one
+	for (const auto& pair : players) {
+		if (!pair.second.is<Player*>()) {
+			throw std::invalid_argument(errorNotPlayer);
+		}
+	}
+
+	Frame frame;
+	if (!popFrame(frame)) return false;
+
+	for (const auto& pair : players) {
+		Voice* voice = pair.second.as<Player*>()->getVoice();
+		voice->frameVolumeLevels[frameIndex] = volumeLevel;
+		voice->frameSizes[frameIndex] = frame.size;
+		std::memcpy(voice->frames[frameIndex], frame.data, frame.size);
+	}
+	return true;
+}
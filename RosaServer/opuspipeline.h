@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "opus.h"
+#include "sol/sol.hpp"
+#include "spscring.h"
+
+// Mixes any number of raw PCM files (48kHz mono, signed 16-bit little-endian)
+// and encodes the result on a background thread, keeping a ring of frames
+// ready so the main thread only has to copy them into voices.
+class OpusPipeline {
+ public:
+	static constexpr int maxPacketSize = 2048;
+	// 64 frames is 1.28 seconds of audio
+	static constexpr size_t ringCapacity = 64;
+
+	struct Frame {
+		int size = 0;
+		unsigned char data[maxPacketSize];
+	};
+
+ private:
+	struct FileCloser {
+		void operator()(FILE* file) const { fclose(file); }
+	};
+
+	// Only read by the encoding thread, outside the lock
+	struct Stream {
+		std::unique_ptr<FILE, FileCloser> file;
+		bool loop;
+		bool finished = false;
+	};
+
+	struct Source {
+		int id;
+		// Shared so a source removed mid-read stays open until the read is done
+		std::shared_ptr<Stream> stream;
+		float volume;
+	};
+
+	// Shared with the encoding thread, which can outlive the OpusPipeline
+	struct Shared {
+		std::atomic_bool stopped = false;
+		std::atomic<opus_int32> bitRate;
+		OpusEncoder* encoder = nullptr;
+
+		// Guards sources, and is what the thread waits on
+		std::mutex mutex;
+		std::condition_variable wakeCondition;
+		std::atomic_bool waiting = false;
+		std::vector<Source> sources;
+
+		SPSCRing<Frame, ringCapacity> frames;
+
+		~Shared();
+		void wake();
+		// Called with the lock held, returning with it held again. The files are
+		// read without it, so the main thread never waits on the disk. Returns
+		// false if there's nothing to play.
+		bool mix(float pcm[], std::unique_lock<std::mutex>& lock);
+	};
+
+	std::shared_ptr<Shared> shared;
+	int nextSourceID = 1;
+
+	static void runThread(std::shared_ptr<Shared> shared);
+	bool popFrame(Frame& frame);
+
+ public:
+	OpusPipeline(sol::optional<opus_int32> bitRate);
+	~OpusPipeline();
+
+	void setBitRate(opus_int32 bitRate);
+	opus_int32 getBitRate() const { return shared->bitRate; }
+
+	// Sources that aren't looped are removed once they run out
+	int addSource(const char* fileName, sol::optional<float> volume,
+	              sol::optional<bool> loop);
+	bool removeSource(int id);
+	bool setSourceVolume(int id, float volume);
+	bool hasSource(int id);
+	int getSourceCount();
+
+	bool isReady() const { return !shared->frames.empty(); }
+	sol::object nextFrame(sol::this_state s);
+	// Pops one frame and writes it into slot frameIndex of every given player's
+	// voice, as Voice.setFrame would. Returns false if no frame was ready.
+	bool writeVoices(sol::table players, unsigned int frameIndex,
+	                 int volumeLevel);
+};
@@ -1,8 +1,39 @@
 #include "pointgraph.h"
 
-#include <queue>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <mutex>
 #include <stdexcept>
-#include <unordered_set>
+
+static constexpr const char* errorOpen = "Could not open graph file";
+static constexpr const char* errorWrite = "Could not write graph file";
+static constexpr const char* errorFormat = "Not a valid graph file";
+static constexpr const char* errorSealed = "Graph is sealed";
+
+// Saved graphs are the header followed directly by the points, link starts
+// and links arrays. Every field is 4 bytes so the arrays stay aligned when
+// the file is mapped.
+struct GraphFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t numNodes;
+	uint32_t numLinks;
+};
+
+static constexpr char graphFileMagic[4] = {'R', 'S', 'P', 'G'};
+static constexpr uint32_t graphFileVersion = 1;
+
+static_assert(sizeof(GraphFileHeader) == 16);
+static_assert(sizeof(NodePoint) == 12);
+static_assert(sizeof(Link) == 8);
 
 PointGraph::PointGraph(unsigned int squareRootCacheSize) {
 	squareRootCache = new double[squareRootCacheSize];
@@ -15,27 +46,99 @@ PointGraph::PointGraph(unsigned int squareRootCacheSize) {
 
 PointGraph::~PointGraph() { delete[] squareRootCache; }
 
-int PointGraph::getSize() const { return nodes.size(); }
+void PointGraph::setPathCacheSize(unsigned int size) {
+	pathCache.setCapacity(size);
+}
+
+std::shared_ptr<PointGraph> PointGraph::create(
+    unsigned int squareRootCacheSize) {
+	return std::make_shared<PointGraph>(squareRootCacheSize);
+}
+
+void PointGraph::checkNotSealed() const {
+	if (sealed) {
+		throw std::runtime_error(errorSealed);
+	}
+}
+
+void PointGraph::invalidateSearches() {
+	hierarchy.reset();
+	pathCache.clear();
+}
+
+int PointGraph::getSize() const { return points.size(); }
 
 void PointGraph::addNode(const int x, const int y, const int z) {
+	checkNotSealed();
+	invalidateSearches();
 	NodePoint point{x, y, z};
-	nodes.emplace_back(point);
-	nodeIdByPoint.insert({point, nodes.size() - 1});
+	points.push_back(point);
+	linkStarts.push_back(links.size());
+	nodeIdByPoint.insert({point, points.size() - 1});
 }
 
 std::tuple<int, int, int> PointGraph::getNodePoint(unsigned int index) const {
-	const Node& node = nodes.at(index);
-	return std::make_tuple(node.point.x, node.point.y, node.point.z);
+	const NodePoint& point = points.at(index);
+	return std::make_tuple(point.x, point.y, point.z);
 }
 
 void PointGraph::addLink(unsigned int fromId, unsigned int toId, int cost) {
-	Node& node = nodes.at(fromId);
-	if (toId >= nodes.size()) {
+	checkNotSealed();
+	invalidateSearches();
+	if (fromId >= points.size()) {
+		throw std::invalid_argument("Link isn't from a valid node");
+	}
+	if (toId >= points.size()) {
 		throw std::invalid_argument("Link isn't to a valid node");
 	}
-	node.links.emplace_back(toId, cost);
+	pendingLinks.emplace_back(fromId, Link(toId, cost));
+}
+
+void PointGraph::freeze() {
+	if (pendingLinks.empty()) {
+		return;
+	}
+
+	const size_t numNodes = points.size();
+
+	std::vector<unsigned int> newStarts(numNodes + 1, 0);
+	for (size_t i = 0; i < numNodes; i++) {
+		newStarts[i + 1] = linkStarts[i + 1] - linkStarts[i];
+	}
+	for (const auto& [fromId, link] : pendingLinks) {
+		newStarts[fromId + 1]++;
+	}
+	for (size_t i = 0; i < numNodes; i++) {
+		newStarts[i + 1] += newStarts[i];
+	}
+
+	// Existing links keep their order, and pending ones follow in the order
+	// they were added
+	std::vector<Link> newLinks(newStarts[numNodes]);
+	std::vector<unsigned int> cursors(newStarts.begin(), newStarts.end() - 1);
+	for (size_t i = 0; i < numNodes; i++) {
+		cursors[i] = std::copy(links.begin() + linkStarts[i],
+		                       links.begin() + linkStarts[i + 1],
+		                       newLinks.begin() + cursors[i]) -
+		             newLinks.begin();
+	}
+	for (const auto& [fromId, link] : pendingLinks) {
+		newLinks[cursors[fromId]++] = link;
+	}
+
+	linkStarts = std::move(newStarts);
+	links = std::move(newLinks);
+	pendingLinks.clear();
+	pendingLinks.shrink_to_fit();
+}
+
+void PointGraph::seal() {
+	freeze();
+	sealed = true;
 }
 
+bool PointGraph::isSealed() const { return sealed; }
+
 sol::object PointGraph::getNodeByPoint(int x, int y, int z,
                                        sol::this_state s) const {
 	sol::state_view lua(s);
@@ -48,117 +151,612 @@ sol::object PointGraph::getNodeByPoint(int x, int y, int z,
 	}
 }
 
-static inline double getHeuristicScore(const Node& node, const Node& goalNode,
-                                       const unsigned int numCachedSquareRoots,
-                                       const double* squareRootCache) {
-	const int deltaX = goalNode.point.x - node.point.x;
-	const int deltaY = goalNode.point.y - node.point.y;
-	const int deltaZ = goalNode.point.z - node.point.z;
+void SearchScratch::begin(size_t numNodes) {
+	if (stamps.size() < numNodes) {
+		stamps.resize(numNodes, 0);
+		gScores.resize(numNodes);
+		hScores.resize(numNodes);
+		cameFrom.resize(numNodes);
+	}
+
+	if (++generation == 0) {
+		std::fill(stamps.begin(), stamps.end(), 0);
+		generation = 1;
+	}
+
+	openSet.clear();
+}
+
+bool PathCache::find(uint64_t key, std::vector<unsigned int>& path,
+                     bool& found) {
+	std::lock_guard<std::mutex> guard(mutex);
+
+	const auto search = entryByKey.find(key);
+	if (search == entryByKey.end()) {
+		return false;
+	}
+
+	entries.splice(entries.begin(), entries, search->second);
+	path = search->second->second;
+	found = !path.empty();
+	return true;
+}
+
+void PathCache::insert(uint64_t key, const std::vector<unsigned int>& path) {
+	std::lock_guard<std::mutex> guard(mutex);
+	if (!capacity || entryByKey.count(key)) {
+		return;
+	}
+
+	entries.emplace_front(key, path);
+	entryByKey[key] = entries.begin();
+	if (entries.size() > capacity) {
+		entryByKey.erase(entries.back().first);
+		entries.pop_back();
+	}
+}
+
+void PathCache::clear() {
+	std::lock_guard<std::mutex> guard(mutex);
+	entries.clear();
+	entryByKey.clear();
+}
+
+void PathCache::setCapacity(size_t newCapacity) {
+	std::lock_guard<std::mutex> guard(mutex);
+	capacity = newCapacity;
+	while (entries.size() > capacity) {
+		entryByKey.erase(entries.back().first);
+		entries.pop_back();
+	}
+}
+
+double PointGraph::getHeuristicScore(const NodePoint& point,
+                                     const NodePoint& goalPoint) const {
+	const int64_t deltaX = (int64_t)goalPoint.x - point.x;
+	const int64_t deltaY = (int64_t)goalPoint.y - point.y;
+	const int64_t deltaZ = (int64_t)goalPoint.z - point.z;
 
-	const int square = deltaX * deltaX + deltaY * deltaY + deltaZ * deltaZ;
+	const int64_t square = deltaX * deltaX + deltaY * deltaY + deltaZ * deltaZ;
 	if (square < numCachedSquareRoots) {
 		return squareRootCache[square];
 	}
-	return square;
+	return std::sqrt((double)square);
 }
 
-static inline double getScoreOrInfinity(
-    const std::unordered_map<unsigned int, double>& scores,
-    const unsigned int nodeId) {
-	const auto search = scores.find(nodeId);
-	if (search != scores.end()) {
-		return search->second;
-	} else {
-		return std::numeric_limits<double>::infinity();
+// Hierarchical searches need several at once: from the start, towards the
+// goal, over the abstract graph, and for refining the abstract route
+static thread_local SearchScratch scratches[4];
+
+static constexpr unsigned int noNode = std::numeric_limits<unsigned int>::max();
+
+// Clusters are grid cells on the horizontal plane. Nodes linked to or from
+// another cluster are boundary nodes, and the abstract graph links each one
+// to the boundary nodes it can reach within its cluster and to the ones in
+// other clusters it links to directly. Every shortest path breaks down into
+// those pieces, so searching the abstract graph finds a truly shortest path.
+struct PointGraph::Hierarchy {
+	std::vector<unsigned int> clusterOf;
+	std::vector<unsigned int> reverseStarts;
+	std::vector<Link> reverseLinks;
+	std::vector<unsigned int> boundaryNodes;
+	// Abstract ids of the boundary nodes in each cluster, in CSR form
+	std::vector<unsigned int> clusterBoundaryStarts;
+	std::vector<unsigned int> clusterBoundaries;
+	std::vector<unsigned int> abstractStarts;
+	std::vector<Link> abstractLinks;
+};
+
+// The graph's own links, optionally only between nodes of one cluster
+struct PointGraph::ForwardLinks {
+	const PointGraph& graph;
+	const unsigned int* clusterOf;
+	unsigned int cluster;
+
+	size_t size() const { return graph.points.size(); }
+
+	double heuristic(unsigned int nodeId, unsigned int goalNodeId) const {
+		return graph.getHeuristicScore(graph.points[nodeId],
+		                               graph.points[goalNodeId]);
+	}
+
+	template <typename Func>
+	void forEachLink(unsigned int nodeId, Func&& func) const {
+		const Link* linksEnd = graph.links.data() + graph.linkStarts[nodeId + 1];
+		for (const Link* link = graph.links.data() + graph.linkStarts[nodeId];
+		     link != linksEnd; link++) {
+			if (!clusterOf || clusterOf[link->toId] == cluster) {
+				func(link->toId, link->cost);
+			}
+		}
+	}
+};
+
+// The graph's links backwards within one cluster, for costs towards a node
+struct PointGraph::ReverseLinks {
+	const PointGraph& graph;
+	const Hierarchy& hierarchy;
+	unsigned int cluster;
+
+	size_t size() const { return graph.points.size(); }
+
+	double heuristic(unsigned int nodeId, unsigned int goalNodeId) const {
+		return 0.;
+	}
+
+	template <typename Func>
+	void forEachLink(unsigned int nodeId, Func&& func) const {
+		const Link* linksEnd =
+		    hierarchy.reverseLinks.data() + hierarchy.reverseStarts[nodeId + 1];
+		for (const Link* link =
+		         hierarchy.reverseLinks.data() + hierarchy.reverseStarts[nodeId];
+		     link != linksEnd; link++) {
+			if (hierarchy.clusterOf[link->toId] == cluster) {
+				func(link->toId, link->cost);
+			}
+		}
+	}
+};
+
+// The abstract graph plus two ids past the boundary nodes standing for the
+// start and goal, linked in using searches within their clusters
+struct PointGraph::AbstractLinks {
+	const PointGraph& graph;
+	const Hierarchy& hierarchy;
+	unsigned int startNodeId;
+	unsigned int goalNodeId;
+	const SearchScratch& fromStart;
+	const SearchScratch& toGoal;
+
+	unsigned int startId() const { return hierarchy.boundaryNodes.size(); }
+	unsigned int goalId() const { return hierarchy.boundaryNodes.size() + 1; }
+	size_t size() const { return hierarchy.boundaryNodes.size() + 2; }
+
+	unsigned int nodeOf(unsigned int id) const {
+		if (id == startId()) return startNodeId;
+		if (id == goalId()) return goalNodeId;
+		return hierarchy.boundaryNodes[id];
 	}
-}
 
-static inline std::vector<unsigned int> reconstructPath(
-    std::unordered_map<unsigned int, unsigned int>& cameFrom,
-    unsigned int currentNodeId) {
-	std::vector<unsigned int> path{currentNodeId};
-	while (true) {
-		const auto search = cameFrom.find(currentNodeId);
-		if (search == cameFrom.end()) {
-			break;
+	double heuristic(unsigned int id, unsigned int goalId) const {
+		return graph.getHeuristicScore(graph.points[nodeOf(id)],
+		                               graph.points[nodeOf(goalId)]);
+	}
+
+	template <typename Func>
+	void forEachLink(unsigned int id, Func&& func) const {
+		if (id == goalId()) {
+			return;
+		}
+
+		if (id == startId()) {
+			const unsigned int cluster = hierarchy.clusterOf[startNodeId];
+			for (unsigned int i = hierarchy.clusterBoundaryStarts[cluster];
+			     i < hierarchy.clusterBoundaryStarts[cluster + 1]; i++) {
+				const unsigned int boundaryId = hierarchy.clusterBoundaries[i];
+				const unsigned int nodeId = hierarchy.boundaryNodes[boundaryId];
+				if (fromStart.has(nodeId)) {
+					func(boundaryId, fromStart.gScores[nodeId]);
+				}
+			}
+			return;
+		}
+
+		for (unsigned int i = hierarchy.abstractStarts[id];
+		     i < hierarchy.abstractStarts[id + 1]; i++) {
+			const Link& link = hierarchy.abstractLinks[i];
+			func(link.toId, link.cost);
 		}
 
-		currentNodeId = search->second;
-		path.insert(path.begin(), currentNodeId);
+		const unsigned int nodeId = hierarchy.boundaryNodes[id];
+		if (hierarchy.clusterOf[nodeId] == hierarchy.clusterOf[goalNodeId] &&
+		    toGoal.has(nodeId)) {
+			func(goalId(), toGoal.gScores[nodeId]);
+		}
 	}
-	return path;
+};
+
+// Open set entries are (f, node) pairs, smallest f first
+static inline bool compareOpenEntries(
+    const std::pair<double, unsigned int>& a,
+    const std::pair<double, unsigned int>& b) {
+	return a.first > b.first;
 }
 
 // https://en.wikipedia.org/wiki/A*_search_algorithm
-sol::object PointGraph::findShortestPath(unsigned int startNodeId,
-                                         unsigned int goalNodeId,
-                                         sol::this_state s) const {
-	sol::state_view lua(s);
+// With goalNodeId as noNode this is Dijkstra over everything reachable, and
+// afterwards the scores of every node visited are final.
+template <typename Links>
+static bool search(const Links& graph, unsigned int startNodeId,
+                   unsigned int goalNodeId, SearchScratch& scratch) {
+	scratch.begin(graph.size());
+	const uint32_t generation = scratch.generation;
+	auto& openSet = scratch.openSet;
 
-	const Node& goalNode = nodes.at(goalNodeId);
+	auto heuristic = [&](unsigned int nodeId) {
+		return goalNodeId == noNode ? 0. : graph.heuristic(nodeId, goalNodeId);
+	};
 
 	// For node n, gScores[n] is the cost of the cheapest path from start to n
-	// currently known.
-	std::unordered_map<unsigned int, double> gScores;
-	gScores.insert({startNodeId, 0.});
+	// currently known, and cameFrom[n] is the node before it on that path.
+	scratch.stamps[startNodeId] = generation;
+	scratch.gScores[startNodeId] = 0.;
+	scratch.hScores[startNodeId] = heuristic(startNodeId);
+	scratch.cameFrom[startNodeId] = noNode;
 
-	auto compare = [&gScores](unsigned int a, unsigned int b) -> bool {
-		return gScores.at(a) > gScores.at(b);
-	};
+	openSet.emplace_back(scratch.hScores[startNodeId], startNodeId);
+
+	while (!openSet.empty()) {
+		std::pop_heap(openSet.begin(), openSet.end(), compareOpenEntries);
+		const auto [fScore, currentNodeId] = openSet.back();
+		openSet.pop_back();
+
+		// Improving a node pushes it again rather than updating it in place, so
+		// entries that no longer match its best score are stale
+		const double currentGScore = scratch.gScores[currentNodeId];
+		if (fScore > currentGScore + scratch.hScores[currentNodeId]) {
+			continue;
+		}
 
-	// The set of discovered nodes that may need to be (re-)expanded.
-	// Initially, only the start node is known.
-	std::priority_queue<unsigned int, std::vector<unsigned int>,
-	                    decltype(compare)>
-	    openSet(compare);
+		if (currentNodeId == goalNodeId) {
+			return true;
+		}
 
-	openSet.push(startNodeId);
+		graph.forEachLink(currentNodeId, [&](unsigned int neighborId,
+		                                     double cost) {
+			const double tentativeGScore = currentGScore + cost;
 
-	// For node n, cameFrom[n] is the node immediately preceding it on the
-	// cheapest path from start to n currently known.
-	std::unordered_map<unsigned int, unsigned int> cameFrom;
+			if (scratch.stamps[neighborId] != generation) {
+				scratch.stamps[neighborId] = generation;
+				scratch.hScores[neighborId] = heuristic(neighborId);
+			} else if (tentativeGScore >= scratch.gScores[neighborId]) {
+				return;
+			}
 
-	// For node n, fScores[n] := gScores[n] + h(n). fScores[n] represents our
-	// current best guess as to how short a path from start to finish can be if it
-	// goes through n.
-	std::unordered_map<unsigned int, double> fScores;
-	fScores.insert(
-	    {startNodeId, getHeuristicScore(nodes.at(startNodeId), goalNode,
-	                                    numCachedSquareRoots, squareRootCache)});
+			// This path to neighbor is better than any previous one. Record it!
+			scratch.gScores[neighborId] = tentativeGScore;
+			scratch.cameFrom[neighborId] = currentNodeId;
 
-	std::unordered_set<unsigned int> hasVisited;
+			openSet.emplace_back(tentativeGScore + scratch.hScores[neighborId],
+			                     neighborId);
+			std::push_heap(openSet.begin(), openSet.end(), compareOpenEntries);
+		});
+	}
 
-	while (!openSet.empty()) {
-		const unsigned int currentNodeId = openSet.top();
-		if (currentNodeId == goalNodeId) {
-			const auto path = reconstructPath(cameFrom, currentNodeId);
-			return sol::make_object(lua, sol::as_table(path));
+	return goalNodeId == noNode;
+}
+
+// Appends the path searched to nodeId, leaving out its first node if path
+// already ends with it
+static void appendPath(const SearchScratch& scratch, unsigned int nodeId,
+                       std::vector<unsigned int>& path) {
+	const size_t begin = path.size();
+	for (unsigned int id = nodeId; id != noNode; id = scratch.cameFrom[id]) {
+		path.push_back(id);
+	}
+	std::reverse(path.begin() + begin, path.end());
+
+	if (begin != 0 && path[begin - 1] == path[begin]) {
+		path.erase(path.begin() + begin);
+	}
+}
+
+void PointGraph::buildHierarchy(unsigned int clusterSize) {
+	checkNotSealed();
+	if (clusterSize == 0) {
+		throw std::invalid_argument("Cluster size must be positive");
+	}
+	freeze();
+
+	auto newHierarchy = std::make_unique<Hierarchy>();
+	Hierarchy& hierarchy = *newHierarchy;
+	const size_t numNodes = points.size();
+
+	std::unordered_map<uint64_t, unsigned int> clusterByCell;
+	hierarchy.clusterOf.resize(numNodes);
+	for (size_t i = 0; i < numNodes; i++) {
+		const int64_t cellX = std::floor((double)points[i].x / clusterSize);
+		const int64_t cellZ = std::floor((double)points[i].z / clusterSize);
+		const uint64_t cell = ((uint64_t)cellX << 32) ^ (uint32_t)cellZ;
+		hierarchy.clusterOf[i] =
+		    clusterByCell.emplace(cell, clusterByCell.size()).first->second;
+	}
+	const size_t numClusters = clusterByCell.size();
+
+	hierarchy.reverseStarts.assign(numNodes + 1, 0);
+	for (const Link& link : links) {
+		hierarchy.reverseStarts[link.toId + 1]++;
+	}
+	for (size_t i = 0; i < numNodes; i++) {
+		hierarchy.reverseStarts[i + 1] += hierarchy.reverseStarts[i];
+	}
+	hierarchy.reverseLinks.resize(links.size());
+	std::vector<unsigned int> cursors(hierarchy.reverseStarts.begin(),
+	                                  hierarchy.reverseStarts.end() - 1);
+	for (unsigned int i = 0; i < numNodes; i++) {
+		for (unsigned int l = linkStarts[i]; l < linkStarts[i + 1]; l++) {
+			hierarchy.reverseLinks[cursors[links[l].toId]++] =
+			    Link(i, links[l].cost);
 		}
-		openSet.pop();
+	}
 
-		if (hasVisited.count(currentNodeId)) {
-			continue;
+	std::vector<unsigned int> abstractIdOf(numNodes, noNode);
+	for (unsigned int i = 0; i < numNodes; i++) {
+		for (unsigned int l = linkStarts[i]; l < linkStarts[i + 1]; l++) {
+			const unsigned int toId = links[l].toId;
+			if (hierarchy.clusterOf[i] != hierarchy.clusterOf[toId]) {
+				abstractIdOf[i] = 0;
+				abstractIdOf[toId] = 0;
+			}
+		}
+	}
+	hierarchy.clusterBoundaryStarts.assign(numClusters + 1, 0);
+	for (unsigned int i = 0; i < numNodes; i++) {
+		if (abstractIdOf[i] != noNode) {
+			abstractIdOf[i] = hierarchy.boundaryNodes.size();
+			hierarchy.boundaryNodes.push_back(i);
+			hierarchy.clusterBoundaryStarts[hierarchy.clusterOf[i] + 1]++;
+		}
+	}
+	for (size_t i = 0; i < numClusters; i++) {
+		hierarchy.clusterBoundaryStarts[i + 1] +=
+		    hierarchy.clusterBoundaryStarts[i];
+	}
+	hierarchy.clusterBoundaries.resize(hierarchy.boundaryNodes.size());
+	cursors.assign(hierarchy.clusterBoundaryStarts.begin(),
+	               hierarchy.clusterBoundaryStarts.end() - 1);
+	for (unsigned int id = 0; id < hierarchy.boundaryNodes.size(); id++) {
+		const unsigned int cluster =
+		    hierarchy.clusterOf[hierarchy.boundaryNodes[id]];
+		hierarchy.clusterBoundaries[cursors[cluster]++] = id;
+	}
+
+	SearchScratch& scratch = scratches[0];
+	hierarchy.abstractStarts.push_back(0);
+	for (unsigned int id = 0; id < hierarchy.boundaryNodes.size(); id++) {
+		const unsigned int nodeId = hierarchy.boundaryNodes[id];
+		const unsigned int cluster = hierarchy.clusterOf[nodeId];
+
+		search(ForwardLinks{*this, hierarchy.clusterOf.data(), cluster}, nodeId,
+		       noNode, scratch);
+		for (unsigned int i = hierarchy.clusterBoundaryStarts[cluster];
+		     i < hierarchy.clusterBoundaryStarts[cluster + 1]; i++) {
+			const unsigned int otherId = hierarchy.clusterBoundaries[i];
+			const unsigned int otherNodeId = hierarchy.boundaryNodes[otherId];
+			if (otherId != id && scratch.has(otherNodeId)) {
+				hierarchy.abstractLinks.emplace_back(
+				    otherId, (int)scratch.gScores[otherNodeId]);
+			}
 		}
 
-		hasVisited.insert(currentNodeId);
-
-		const Node& currentNode = nodes.at(currentNodeId);
-		for (const Link& link : currentNode.links) {
-			const double tentativeGScore = gScores.at(currentNodeId) + link.cost;
-			const double gScore = getScoreOrInfinity(gScores, link.toId);
-			if (tentativeGScore < gScore) {
-				// This path to neighbor is better than any previous one. Record it!
-				cameFrom.insert({link.toId, currentNodeId});
-				gScores.insert({link.toId, tentativeGScore});
-				fScores.insert(
-				    {link.toId,
-				     tentativeGScore +
-				         getHeuristicScore(nodes.at(link.toId), currentNode,
-				                           numCachedSquareRoots, squareRootCache)});
-				openSet.push(link.toId);
+		for (unsigned int l = linkStarts[nodeId]; l < linkStarts[nodeId + 1];
+		     l++) {
+			const Link& link = links[l];
+			if (hierarchy.clusterOf[link.toId] != cluster) {
+				hierarchy.abstractLinks.emplace_back(abstractIdOf[link.toId],
+				                                     link.cost);
 			}
 		}
+
+		hierarchy.abstractStarts.push_back(hierarchy.abstractLinks.size());
+	}
+
+	this->hierarchy = std::move(newHierarchy);
+	pathCache.clear();
+}
+
+bool PointGraph::findHierarchicalPath(unsigned int startNodeId,
+                                      unsigned int goalNodeId,
+                                      std::vector<unsigned int>& path) const {
+	const Hierarchy& hierarchy = *this->hierarchy;
+	const unsigned int* clusterOf = hierarchy.clusterOf.data();
+	auto& [fromStart, toGoal, abstract, refine] = scratches;
+
+	search(ForwardLinks{*this, clusterOf, clusterOf[startNodeId]}, startNodeId,
+	       noNode, fromStart);
+	search(ReverseLinks{*this, hierarchy, clusterOf[goalNodeId]}, goalNodeId,
+	       noNode, toGoal);
+
+	AbstractLinks abstractGraph{*this,      hierarchy, startNodeId,
+	                            goalNodeId, fromStart, toGoal};
+	if (!search(abstractGraph, abstractGraph.startId(), abstractGraph.goalId(),
+	            abstract)) {
+		return false;
+	}
+
+	// Start and goal are in different clusters, so the route always has at
+	// least one boundary node from each
+	std::vector<unsigned int> route;
+	appendPath(abstract, abstractGraph.goalId(), route);
+
+	path.clear();
+	appendPath(fromStart, hierarchy.boundaryNodes[route[1]], path);
+
+	for (size_t i = 1; i + 2 < route.size(); i++) {
+		const unsigned int fromNodeId = hierarchy.boundaryNodes[route[i]];
+		const unsigned int toNodeId = hierarchy.boundaryNodes[route[i + 1]];
+		const unsigned int cluster = clusterOf[fromNodeId];
+
+		if (clusterOf[toNodeId] != cluster) {
+			path.push_back(toNodeId);
+			continue;
+		}
+
+		search(ForwardLinks{*this, clusterOf, cluster}, fromNodeId, toNodeId,
+		       refine);
+		appendPath(refine, toNodeId, path);
+	}
+
+	// Searched backwards, so each node came from the next one towards the goal
+	const unsigned int lastNodeId =
+	    hierarchy.boundaryNodes[route[route.size() - 2]];
+	for (unsigned int id = toGoal.cameFrom[lastNodeId]; id != noNode;
+	     id = toGoal.cameFrom[id]) {
+		path.push_back(id);
+	}
+
+	return true;
+}
+
+bool PointGraph::findPath(unsigned int startNodeId, unsigned int goalNodeId,
+                          std::vector<unsigned int>& path) const {
+	points.at(startNodeId);
+	points.at(goalNodeId);
+
+	const uint64_t key = ((uint64_t)startNodeId << 32) | goalNodeId;
+	bool found;
+	if (pathCache.find(key, path, found)) {
+		return found;
+	}
+
+	if (hierarchy &&
+	    hierarchy->clusterOf[startNodeId] != hierarchy->clusterOf[goalNodeId]) {
+		found = findHierarchicalPath(startNodeId, goalNodeId, path);
+	} else {
+		SearchScratch& scratch = scratches[0];
+		found = search(ForwardLinks{*this, nullptr, 0}, startNodeId, goalNodeId,
+		               scratch);
+		if (found) {
+			path.clear();
+			appendPath(scratch, goalNodeId, path);
+		}
+	}
+
+	pathCache.insert(key, found ? path : std::vector<unsigned int>());
+	return found;
+}
+
+sol::object PointGraph::findShortestPath(unsigned int startNodeId,
+                                         unsigned int goalNodeId,
+                                         sol::this_state s) {
+	sol::state_view lua(s);
+	freeze();
+
+	std::vector<unsigned int> path;
+	if (findPath(startNodeId, goalNodeId, path)) {
+		return sol::make_object(lua, sol::as_table(path));
 	}
 
 	return sol::make_object(lua, sol::nil);
 }
+
+void PointGraph::save(const std::string& fileName) {
+	freeze();
+
+	GraphFileHeader header;
+	std::memcpy(header.magic, graphFileMagic, sizeof(header.magic));
+	header.version = graphFileVersion;
+	header.numNodes = points.size();
+	header.numLinks = links.size();
+
+	std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		throw std::runtime_error(errorOpen);
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(points.data()),
+	           sizeof(NodePoint) * points.size());
+	file.write(reinterpret_cast<const char*>(linkStarts.data()),
+	           sizeof(unsigned int) * linkStarts.size());
+	file.write(reinterpret_cast<const char*>(links.data()),
+	           sizeof(Link) * links.size());
+
+	if (!file) {
+		throw std::runtime_error(errorWrite);
+	}
+}
+
+std::shared_ptr<PointGraph> PointGraph::load(const std::string& fileName,
+                                             unsigned int squareRootCacheSize) {
+	int fd = open(fileName.c_str(), O_RDONLY);
+	if (fd == -1) {
+		throw std::runtime_error(errorOpen);
+	}
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) == -1 ||
+	    (size_t)fileStat.st_size < sizeof(GraphFileHeader)) {
+		close(fd);
+		throw std::runtime_error(errorFormat);
+	}
+
+	const size_t fileSize = fileStat.st_size;
+	void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED) {
+		throw std::runtime_error(errorOpen);
+	}
+
+	const char* data = static_cast<const char*>(mapped);
+	GraphFileHeader header;
+	std::memcpy(&header, data, sizeof(header));
+
+	const size_t pointsOffset = sizeof(header);
+	const size_t linkStartsOffset =
+	    pointsOffset + sizeof(NodePoint) * (size_t)header.numNodes;
+	const size_t linksOffset =
+	    linkStartsOffset + sizeof(unsigned int) * ((size_t)header.numNodes + 1);
+	const size_t expectedSize =
+	    linksOffset + sizeof(Link) * (size_t)header.numLinks;
+
+	if (std::memcmp(header.magic, graphFileMagic, sizeof(header.magic)) ||
+	    header.version != graphFileVersion || fileSize != expectedSize) {
+		munmap(mapped, fileSize);
+		throw std::runtime_error(errorFormat);
+	}
+
+	auto graph = create(squareRootCacheSize);
+
+	auto pointsBegin = reinterpret_cast<const NodePoint*>(data + pointsOffset);
+	graph->points.assign(pointsBegin, pointsBegin + header.numNodes);
+
+	auto startsBegin =
+	    reinterpret_cast<const unsigned int*>(data + linkStartsOffset);
+	graph->linkStarts.assign(startsBegin, startsBegin + header.numNodes + 1);
+
+	auto linksBegin = reinterpret_cast<const Link*>(data + linksOffset);
+	graph->links.assign(linksBegin, linksBegin + header.numLinks);
+
+	munmap(mapped, fileSize);
+
+	// Searches index these arrays without checking, so a corrupt file must not
+	// get through
+	if (graph->linkStarts.front() != 0 ||
+	    graph->linkStarts.back() != header.numLinks ||
+	    !std::is_sorted(graph->linkStarts.begin(), graph->linkStarts.end())) {
+		throw std::runtime_error(errorFormat);
+	}
+	for (const Link& link : graph->links) {
+		if (link.toId >= header.numNodes) {
+			throw std::runtime_error(errorFormat);
+		}
+	}
+
+	graph->nodeIdByPoint.reserve(header.numNodes);
+	for (unsigned int i = 0; i < header.numNodes; i++) {
+		graph->nodeIdByPoint.insert({graph->points[i], i});
+	}
+
+	return graph;
+}
+
+static std::mutex sharedGraphsMutex;
+static std::unordered_map<std::string, std::shared_ptr<PointGraph>>
+    sharedGraphs;
+
+void PointGraph::share(const std::string& name) {
+	seal();
+
+	std::lock_guard<std::mutex> guard(sharedGraphsMutex);
+	sharedGraphs[name] = shared_from_this();
+}
+
+std::shared_ptr<PointGraph> PointGraph::getShared(const std::string& name) {
+	std::lock_guard<std::mutex> guard(sharedGraphsMutex);
+	const auto search = sharedGraphs.find(name);
+	if (search != sharedGraphs.end()) {
+		return search->second;
+	}
+	return nullptr;
+}
@@ -1,5 +1,9 @@
 #pragma once
 #include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <tuple>
 #include <unordered_map>
 #include <vector>
@@ -9,6 +13,7 @@
 struct Link {
 	unsigned int toId;
 	int cost;
+	Link() = default;
 	Link(unsigned int toId, int cost) : toId(toId), cost(cost){};
 };
 
@@ -30,27 +35,95 @@ struct hash<NodePoint> {
 };
 }  // namespace std
 
-struct Node {
-	NodePoint point;
-	std::vector<Link> links;
-	Node(NodePoint& point) : point(point){};
+// Per-node search state, sized to the graph and reused between searches.
+// A node's entries are only valid while its stamp matches the current
+// generation, so starting a search doesn't have to clear anything.
+struct SearchScratch {
+	std::vector<uint32_t> stamps;
+	std::vector<double> gScores;
+	std::vector<double> hScores;
+	std::vector<unsigned int> cameFrom;
+	std::vector<std::pair<double, unsigned int>> openSet;
+	uint32_t generation = 0;
+
+	void begin(size_t numNodes);
+	bool has(unsigned int nodeId) const { return stamps[nodeId] == generation; }
 };
 
-class PointGraph {
-	std::vector<Node> nodes;
+// Least recently used search results keyed by start and goal, with an empty
+// path for no path. Holds nothing while its capacity is zero.
+class PathCache {
+	std::mutex mutex;
+	size_t capacity = 0;
+	std::list<std::pair<uint64_t, std::vector<unsigned int>>> entries;
+	std::unordered_map<uint64_t, decltype(entries)::iterator> entryByKey;
+
+ public:
+	bool find(uint64_t key, std::vector<unsigned int>& path, bool& found);
+	void insert(uint64_t key, const std::vector<unsigned int>& path);
+	void clear();
+	void setCapacity(size_t newCapacity);
+};
+
+// Links are stored in compressed sparse row form: the links of node n are
+// links[linkStarts[n]] up to links[linkStarts[n + 1]]. Links added after that
+// are held in pendingLinks until the next freeze, which merges them in.
+//
+// Once sealed a graph can't be changed any more, and can be searched from any
+// number of threads and Lua states at the same time.
+//
+// Changing the graph clears the path cache and drops the hierarchy, which has
+// to be built again.
+class PointGraph : public std::enable_shared_from_this<PointGraph> {
+	struct Hierarchy;
+	struct ForwardLinks;
+	struct ReverseLinks;
+	struct AbstractLinks;
+
+	std::vector<NodePoint> points;
+	std::vector<unsigned int> linkStarts{0};
+	std::vector<Link> links;
+	std::vector<std::pair<unsigned int, Link>> pendingLinks;
 	std::unordered_map<NodePoint, unsigned int> nodeIdByPoint;
 	double* squareRootCache;
 	unsigned int numCachedSquareRoots;
+	bool sealed = false;
+	std::unique_ptr<Hierarchy> hierarchy;
+	mutable PathCache pathCache;
+
+	void checkNotSealed() const;
+	void invalidateSearches();
+	double getHeuristicScore(const NodePoint& point,
+	                         const NodePoint& goalPoint) const;
+	bool findHierarchicalPath(unsigned int startNodeId, unsigned int goalNodeId,
+	                          std::vector<unsigned int>& path) const;
 
  public:
 	PointGraph(unsigned int squareRootCacheSize);
+	PointGraph(const PointGraph&) = delete;
 	~PointGraph();
+	static std::shared_ptr<PointGraph> create(unsigned int squareRootCacheSize);
 	int getSize() const;
 	void addNode(int x, int y, int z);
 	std::tuple<int, int, int> getNodePoint(unsigned int index) const;
 	void addLink(unsigned int fromId, unsigned int toId, int cost);
+	void freeze();
+	void seal();
+	bool isSealed() const;
+	void setPathCacheSize(unsigned int size);
+	// Groups nodes into square clusters for searching between clusters faster
+	void buildHierarchy(unsigned int clusterSize);
 	sol::object getNodeByPoint(int x, int y, int z, sol::this_state s) const;
+	// Ignores links that haven't been frozen yet. Uses a scratch buffer per
+	// thread, so is safe to call from several threads once the graph is sealed.
+	bool findPath(unsigned int startNodeId, unsigned int goalNodeId,
+	              std::vector<unsigned int>& path) const;
 	sol::object findShortestPath(unsigned int startNodeId,
-	                             unsigned int goalNodeId,
-	                             sol::this_state s) const;
+	                             unsigned int goalNodeId, sol::this_state s);
+	void save(const std::string& fileName);
+	static std::shared_ptr<PointGraph> load(const std::string& fileName,
+	                                        unsigned int squareRootCacheSize);
+	// Seals the graph and makes it available to every state by name
+	void share(const std::string& name);
+	static std::shared_ptr<PointGraph> getShared(const std::string& name);
 };
@@ -0,0 +1,206 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "api.h"
+#include "console.h"
+#include "hooks.h"
+
+namespace Profiler {
+std::atomic<bool> enabled = false;
+
+static Histogram histograms[Hooks::EnableKeys::SIZE][PHASE_SIZE];
+static Histogram tickHistogram;
+
+static constexpr const char* phaseNames[PHASE_SIZE] = {"pre", "original",
+                                                       "post"};
+
+static inline int bucketIndex(uint64_t value) {
+	if (value < Histogram::subBucketCount) {
+		return value;
+	}
+
+	int magnitude = 63 - __builtin_clzll(value);
+	if (magnitude > Histogram::maxMagnitude) {
+		return Histogram::bucketCount - 1;
+	}
+
+	int shift = magnitude - Histogram::subBucketBits;
+	return ((shift + 1) << Histogram::subBucketBits) +
+	       ((value >> shift) & (Histogram::subBucketCount - 1));
+}
+
+// Highest value which falls into the bucket
+static inline uint64_t bucketValue(int index) {
+	if (index < Histogram::subBucketCount) {
+		return index;
+	}
+
+	int shift = (index >> Histogram::subBucketBits) - 1;
+	int subBucket = index & (Histogram::subBucketCount - 1);
+	return ((uint64_t)(Histogram::subBucketCount + subBucket + 1) << shift) - 1;
+}
+
+void Histogram::record(uint64_t nanoseconds) {
+	buckets[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	total.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+	uint64_t currentMax = max.load(std::memory_order_relaxed);
+	while (nanoseconds > currentMax &&
+	       !max.compare_exchange_weak(currentMax, nanoseconds,
+	                                  std::memory_order_relaxed)) {
+	}
+}
+
+void Histogram::reset() {
+	for (auto& bucket : buckets) {
+		bucket.store(0, std::memory_order_relaxed);
+	}
+	count.store(0, std::memory_order_relaxed);
+	total.store(0, std::memory_order_relaxed);
+	max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::getCount() const {
+	return count.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::getTotal() const {
+	return total.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::getMax() const {
+	return max.load(std::memory_order_relaxed);
+}
+
+uint64_t Histogram::getPercentile(double percentile) const {
+	uint64_t totalCount = getCount();
+	if (totalCount == 0) {
+		return 0;
+	}
+
+	percentile = std::clamp(percentile, 0.0, 100.0);
+	uint64_t target = std::max<uint64_t>(1, totalCount * percentile / 100.0);
+
+	uint64_t seen = 0;
+	for (int i = 0; i < bucketCount; i++) {
+		seen += buckets[i].load(std::memory_order_relaxed);
+		if (seen >= target) {
+			return std::min(bucketValue(i), getMax());
+		}
+	}
+
+	return getMax();
+}
+
+Histogram& getHistogram(int key, Phase phase) { return histograms[key][phase]; }
+
+Histogram& getTickHistogram() { return tickHistogram; }
+
+void markTick() {
+	static std::chrono::steady_clock::time_point lastTick;
+
+	auto now = std::chrono::steady_clock::now();
+	if (enabled.load(std::memory_order_relaxed) &&
+	    lastTick != std::chrono::steady_clock::time_point()) {
+		tickHistogram.record(
+		    std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastTick)
+		        .count());
+	}
+	lastTick = now;
+}
+
+void reset() {
+	for (auto& key : histograms) {
+		for (auto& histogram : key) {
+			histogram.reset();
+		}
+	}
+	tickHistogram.reset();
+}
+
+static void writeRow(std::ostringstream& stream, const std::string& name,
+                     const char* phase, const Histogram& histogram) {
+	uint64_t count = histogram.getCount();
+
+	stream << std::left << std::setw(28) << name << std::setw(10) << phase
+	       << std::right << std::setw(10) << count << std::setw(12)
+	       << (histogram.getTotal() / count / 1000.0) << std::setw(12)
+	       << (histogram.getPercentile(50) / 1000.0) << std::setw(12)
+	       << (histogram.getPercentile(99) / 1000.0) << std::setw(12)
+	       << (histogram.getMax() / 1000.0) << '\n';
+}
+
+std::string report() {
+	struct Row {
+		std::string name;
+		Phase phase;
+		const Histogram* histogram;
+	};
+
+	std::vector<Row> rows;
+	for (const auto& [name, key] : Hooks::enableNames) {
+		for (int phase = 0; phase < PHASE_SIZE; phase++) {
+			const auto& histogram = histograms[key][phase];
+			if (histogram.getCount()) {
+				rows.push_back({name, (Phase)phase, &histogram});
+			}
+		}
+	}
+
+	std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+		return a.histogram->getTotal() > b.histogram->getTotal();
+	});
+
+	std::ostringstream stream;
+	stream << RS_PREFIX "Profiler is "
+	       << (enabled ? "enabled" : "disabled") << ", times in microseconds\n";
+	stream << std::fixed << std::setprecision(1);
+	stream << std::left << std::setw(28) << "hook" << std::setw(10) << "phase"
+	       << std::right << std::setw(10) << "count" << std::setw(12) << "mean"
+	       << std::setw(12) << "p50" << std::setw(12) << "p99" << std::setw(12)
+	       << "max" << '\n';
+
+	if (tickHistogram.getCount()) {
+		writeRow(stream, "(tick)", "", tickHistogram);
+	}
+	for (const auto& row : rows) {
+		writeRow(stream, row.name, phaseNames[row.phase], *row.histogram);
+	}
+
+	return stream.str();
+}
+
+bool handleConsoleCommand(const std::string& command) {
+	static constexpr std::string_view name = "profiler";
+
+	if (command.rfind(name, 0) != 0 ||
+	    (command.size() > name.size() && command[name.size()] != ' ')) {
+		return false;
+	}
+
+	std::string argument =
+	    command.size() > name.size() ? command.substr(name.size() + 1) : "";
+
+	if (argument == "on") {
+		enabled = true;
+		Console::log(RS_PREFIX "Profiler enabled.\n");
+	} else if (argument == "off") {
+		enabled = false;
+		Console::log(RS_PREFIX "Profiler disabled.\n");
+	} else if (argument == "reset") {
+		reset();
+		Console::log(RS_PREFIX "Profiler reset.\n");
+	} else if (argument.empty()) {
+		Console::log(report());
+	} else {
+		Console::log(RS_PREFIX "Usage: profiler [on|off|reset]\n");
+	}
+
+	return true;
+}
+}  // namespace Profiler
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace Profiler {
+enum Phase { Pre, Original, Post, PHASE_SIZE };
+
+// Log-linear latency histogram in nanoseconds. Each power of two is split
+// into 8 sub-buckets, so any reported value is within 12.5% of the real one.
+// Safe to record from any thread.
+class Histogram {
+ public:
+	static constexpr int subBucketBits = 3;
+	static constexpr int subBucketCount = 1 << subBucketBits;
+	// Values past 2^36 ns (about 68 seconds) land in the last bucket
+	static constexpr int maxMagnitude = 36;
+	static constexpr int bucketCount =
+	    (maxMagnitude - subBucketBits + 2) * subBucketCount;
+
+	void record(uint64_t nanoseconds);
+	void reset();
+	uint64_t getCount() const;
+	uint64_t getTotal() const;
+	uint64_t getMax() const;
+	uint64_t getPercentile(double percentile) const;
+
+ private:
+	std::atomic<uint64_t> buckets[bucketCount] = {};
+	std::atomic<uint64_t> count = 0;
+	std::atomic<uint64_t> total = 0;
+	std::atomic<uint64_t> max = 0;
+};
+
+extern std::atomic<bool> enabled;
+
+Histogram& getHistogram(int key, Phase phase);
+// Time between consecutive logic ticks
+Histogram& getTickHistogram();
+void markTick();
+void reset();
+std::string report();
+bool handleConsoleCommand(const std::string& command);
+
+// Records the lifetime of the scope into a hook's histogram, doing nothing
+// when the profiler is disabled or the key is negative.
+class Scope {
+	Histogram* histogram;
+	std::chrono::steady_clock::time_point start;
+
+ public:
+	Scope(int key, Phase phase)
+	    : histogram(key >= 0 && enabled.load(std::memory_order_relaxed)
+	                    ? &getHistogram(key, phase)
+	                    : nullptr) {
+		if (histogram) start = std::chrono::steady_clock::now();
+	}
+	~Scope() {
+		if (histogram) {
+			histogram->record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			                      std::chrono::steady_clock::now() - start)
+			                      .count());
+		}
+	}
+	Scope(const Scope&) = delete;
+	Scope& operator=(const Scope&) = delete;
+};
+}  // namespace Profiler
@@ -0,0 +1,327 @@
+#include "recorder.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include "api.h"
+#include "console.h"
+#include "lz4impl.h"
+#include "serializer.h"
+#include "worldsnapshot.h"
+
+static constexpr char fileMagic[4] = {'R', 'S', 'R', 'C'};
+static constexpr uint32_t flagKeyframe = 1;
+// Bounds what a corrupt size can make getTick allocate
+static constexpr size_t maxTickSize = 1 << 26;
+// LZ4 can't expand a block more than this
+static constexpr size_t maxCompressionRatio = 255;
+
+static constexpr const char* errorAlreadyRecording = "Already recording";
+static constexpr const char* errorInvalidInterval =
+    "Keyframe interval must be at least 1";
+static constexpr const char* errorNotOpen = "Recording is not open";
+static constexpr const char* errorNotRecording = "Not a recording";
+static constexpr const char* errorOutOfRange = "Tick index out of range";
+static constexpr const char* errorMalformed = "Malformed recording";
+
+[[noreturn]] static void throwErrno() {
+	throw std::runtime_error(strerror(errno));
+}
+
+namespace Recorder {
+// How much of the file is mapped at once
+static constexpr size_t windowSize = 4 << 20;
+
+static int fileDescriptor = -1;
+static char* window = nullptr;
+// Where the window starts in the file, and how much of it has been written
+static size_t windowOffset = 0;
+static size_t windowUsed = 0;
+
+static uint32_t tickCount = 0;
+static uint32_t keyframeInterval = defaultKeyframeInterval;
+static std::unique_ptr<WorldSnapshot> snapshot;
+
+// Reused between ticks so recording doesn't allocate once they've grown
+static std::string tickBody;
+static std::string compressed;
+
+static void mapWindow(size_t offset) {
+	if (window) {
+		munmap(window, windowSize);
+		window = nullptr;
+	}
+
+	if (ftruncate(fileDescriptor, offset + windowSize) == -1) throwErrno();
+
+	void* mapping = mmap(nullptr, windowSize, PROT_READ | PROT_WRITE,
+	                     MAP_SHARED, fileDescriptor, offset);
+	if (mapping == MAP_FAILED) throwErrno();
+
+	window = static_cast<char*>(mapping);
+	windowOffset = offset;
+	windowUsed = 0;
+}
+
+static void append(const void* data, size_t size) {
+	auto bytes = static_cast<const char*>(data);
+	while (size) {
+		if (windowUsed == windowSize) {
+			mapWindow(windowOffset + windowSize);
+		}
+
+		size_t count = std::min(size, windowSize - windowUsed);
+		std::memcpy(window + windowUsed, bytes, count);
+		windowUsed += count;
+		bytes += count;
+		size -= count;
+	}
+}
+
+static void appendRecord(RecordType type, const void* data, size_t size) {
+	tickBody.push_back(type);
+	Serializer::detail::writeVarint(tickBody, size);
+	tickBody.append(static_cast<const char*>(data), size);
+}
+
+void start(std::string_view fileName, sol::optional<int> interval) {
+	if (fileDescriptor != -1) {
+		throw std::runtime_error(errorAlreadyRecording);
+	}
+	if (interval && interval.value() < 1) {
+		throw std::invalid_argument(errorInvalidInterval);
+	}
+
+	fileDescriptor = open(std::string(fileName).c_str(),
+	                      O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fileDescriptor == -1) throwErrno();
+
+	try {
+		mapWindow(0);
+	} catch (...) {
+		::close(fileDescriptor);
+		fileDescriptor = -1;
+		throw;
+	}
+
+	keyframeInterval = interval.value_or(defaultKeyframeInterval);
+	tickCount = 0;
+	tickBody.clear();
+	snapshot = std::make_unique<WorldSnapshot>(false);
+
+	RecordingHeader header{};
+	std::memcpy(header.magic, fileMagic, sizeof(fileMagic));
+	header.version = fileVersion;
+	header.keyframeInterval = keyframeInterval;
+	append(&header, sizeof(header));
+}
+
+void stop() {
+	if (fileDescriptor == -1) return;
+
+	size_t fileSize = windowOffset + windowUsed;
+	munmap(window, windowSize);
+	window = nullptr;
+
+	// Drops the unwritten end of the last window
+	ftruncate(fileDescriptor, fileSize);
+	::close(fileDescriptor);
+	fileDescriptor = -1;
+
+	snapshot.reset();
+	tickBody.clear();
+	tickBody.shrink_to_fit();
+	compressed.clear();
+	compressed.shrink_to_fit();
+}
+
+bool isRecording() { return fileDescriptor != -1; }
+
+uint32_t getTickCount() { return tickCount; }
+
+void recordPacket(const void* data, size_t size) {
+	if (fileDescriptor == -1) return;
+	appendRecord(RecordPacket, data, size);
+}
+
+void recordCommand(std::string_view command) {
+	if (fileDescriptor == -1) return;
+	appendRecord(RecordCommand, command.data(), command.size());
+}
+
+void endTick() {
+	if (fileDescriptor == -1) return;
+
+	bool keyframe = tickCount % keyframeInterval == 0;
+	std::string state = snapshot->capture();
+	if (keyframe) state = snapshot->getKeyframe();
+	appendRecord(RecordSnapshot, state.data(), state.size());
+
+	compressed.clear();
+	Lua::lz4::compressTo(compressed, tickBody);
+
+	TickHeader header{(uint32_t)compressed.size(), (uint32_t)tickBody.size(),
+	                  tickCount, keyframe ? flagKeyframe : 0};
+	try {
+		append(&header, sizeof(header));
+		append(compressed.data(), compressed.size());
+	} catch (std::exception& e) {
+		// Most likely out of disk space, which shouldn't take the server down
+		Console::log(std::string(RS_PREFIX "Recording stopped: ") + e.what() +
+		             "\n");
+		stop();
+		return;
+	}
+
+	tickCount++;
+	tickBody.clear();
+}
+};  // namespace Recorder
+
+Recording::Recording(std::string_view fileName) {
+	fileDescriptor = open(std::string(fileName).c_str(), O_RDONLY | O_CLOEXEC);
+	if (fileDescriptor == -1) throwErrno();
+
+	struct stat info;
+	if (fstat(fileDescriptor, &info) == -1) {
+		int error = errno;
+		::close(fileDescriptor);
+		errno = error;
+		throwErrno();
+	}
+	size = info.st_size;
+
+	Recorder::RecordingHeader header;
+	if (size < sizeof(header)) {
+		::close(fileDescriptor);
+		throw std::runtime_error(errorNotRecording);
+	}
+
+	void* mapping =
+	    mmap(nullptr, size, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+	if (mapping == MAP_FAILED) {
+		int error = errno;
+		::close(fileDescriptor);
+		errno = error;
+		throwErrno();
+	}
+	data = static_cast<const char*>(mapping);
+
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, fileMagic, sizeof(fileMagic)) ||
+	    header.version != Recorder::fileVersion) {
+		close();
+		throw std::runtime_error(errorNotRecording);
+	}
+	keyframeInterval = header.keyframeInterval;
+
+	// A recording still being written ends in zeroes, and maybe a block that
+	// isn't all there yet
+	size_t offset = sizeof(header);
+	while (size - offset >= sizeof(Recorder::TickHeader)) {
+		Recorder::TickHeader tick;
+		std::memcpy(&tick, data + offset, sizeof(tick));
+		if (!tick.compressedSize ||
+		    size - offset - sizeof(tick) < tick.compressedSize) {
+			break;
+		}
+
+		tickOffsets.push_back(offset);
+		offset += sizeof(tick) + tick.compressedSize;
+	}
+}
+
+Recording::~Recording() {
+	if (data) close();
+}
+
+void Recording::close() {
+	checkOpen();
+
+	munmap(const_cast<char*>(data), size);
+	::close(fileDescriptor);
+	data = nullptr;
+	fileDescriptor = -1;
+	tickOffsets.clear();
+}
+
+void Recording::checkOpen() const {
+	if (!data) {
+		throw std::runtime_error(errorNotOpen);
+	}
+}
+
+void Recording::checkIndex(int index) const {
+	checkOpen();
+	if (index < 0 || (size_t)index >= tickOffsets.size()) {
+		throw std::out_of_range(errorOutOfRange);
+	}
+}
+
+int Recording::findKeyframe(int index) const {
+	checkIndex(index);
+
+	for (; index >= 0; index--) {
+		Recorder::TickHeader tick;
+		std::memcpy(&tick, data + tickOffsets[index], sizeof(tick));
+		if (tick.flags & flagKeyframe) return index;
+	}
+	return -1;
+}
+
+sol::table Recording::getTick(int index, sol::this_state s) const {
+	checkIndex(index);
+	sol::state_view lua(s);
+
+	Recorder::TickHeader tick;
+	const char* block = data + tickOffsets[index];
+	std::memcpy(&tick, block, sizeof(tick));
+
+	if (tick.uncompressedSize > maxTickSize ||
+	    tick.uncompressedSize > tick.compressedSize * maxCompressionRatio) {
+		throw std::runtime_error(errorMalformed);
+	}
+
+	std::string body(tick.uncompressedSize, '\0');
+	int bodySize = LZ4_decompress_safe(block + sizeof(tick), body.data(),
+	                                   tick.compressedSize, body.size());
+	if (bodySize != (int)tick.uncompressedSize) {
+		throw std::runtime_error(errorMalformed);
+	}
+
+	sol::table result = lua.create_table();
+	sol::table packets = lua.create_table();
+	sol::table commands = lua.create_table();
+	result["tick"] = tick.tick;
+	result["keyframe"] = (tick.flags & flagKeyframe) != 0;
+	result["packets"] = packets;
+	result["commands"] = commands;
+
+	Serializer::detail::Reader reader{body.data(), body.data() + body.size()};
+	while (reader.cursor != reader.end) {
+		uint8_t type = reader.byte();
+		size_t length = reader.varint();
+		std::string_view record(reader.bytes(length), length);
+
+		switch (type) {
+			case Recorder::RecordPacket:
+				packets.add(record);
+				break;
+			case Recorder::RecordCommand:
+				commands.add(record);
+				break;
+			case Recorder::RecordSnapshot:
+				result["snapshot"] = record;
+				break;
+		}
+	}
+
+	return result;
+}
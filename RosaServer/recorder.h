@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "sol/sol.hpp"
+
+// Appends what each logic tick received to a memory-mapped file: packets,
+// console commands and a WorldSnapshot delta, with a full keyframe every
+// keyframeInterval ticks so readers can start anywhere.
+//
+// The file is a RecordingHeader followed by one block per tick. A block is a
+// TickHeader and an LZ4 compressed body of records, each a type byte, a
+// varint length and the data. Only a window of the file is mapped at once, so
+// memory stays bounded however long the recording runs.
+namespace Recorder {
+static constexpr uint32_t fileVersion = 1;
+static constexpr int defaultKeyframeInterval = 600;
+
+enum RecordType : uint8_t { RecordPacket = 1, RecordCommand, RecordSnapshot };
+
+struct RecordingHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t keyframeInterval;
+	uint32_t reserved;
+};
+
+struct TickHeader {
+	uint32_t compressedSize;
+	uint32_t uncompressedSize;
+	uint32_t tick;
+	// 1 if the snapshot is a keyframe
+	uint32_t flags;
+};
+
+void start(std::string_view fileName, sol::optional<int> keyframeInterval);
+void stop();
+bool isRecording();
+uint32_t getTickCount();
+
+// Called from the hooks, doing nothing unless recording
+void recordPacket(const void* data, size_t size);
+void recordCommand(std::string_view command);
+void endTick();
+};  // namespace Recorder
+
+// Reads a file written by Recorder, which may still be being written
+class Recording {
+	int fileDescriptor = -1;
+	const char* data = nullptr;
+	size_t size = 0;
+	uint32_t keyframeInterval = 0;
+	std::vector<size_t> tickOffsets;
+
+	void checkOpen() const;
+	void checkIndex(int index) const;
+
+ public:
+	Recording(std::string_view fileName);
+	~Recording();
+	Recording(const Recording&) = delete;
+
+	void close();
+	int getTickCount() const { return tickOffsets.size(); }
+	int getKeyframeInterval() const { return keyframeInterval; }
+	// Returns the last tick at or before index whose snapshot is a keyframe
+	int findKeyframe(int index) const;
+	// Returns {tick, keyframe, packets, commands, snapshot}, where snapshot can
+	// be passed to decodeSnapshot
+	sol::table getTick(int index, sol::this_state s) const;
+};
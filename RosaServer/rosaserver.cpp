@@ -147,6 +147,15 @@ void defineThreadSafeAPIs(sol::state* state) {
 		meta["getRGBA"] = &Image::getRGBA;
 		meta["setPixel"] = sol::overload(&Image::setRGB, &Image::setRGBA);
 		meta["getPNG"] = &Image::getPNG;
+		meta["getRow"] = &Image::getRow;
+		meta["setRow"] = &Image::setRow;
+		meta["getDataAddress"] = &Image::getDataAddress;
+		meta["fill"] = &Image::fill;
+		meta["fillRect"] = &Image::fillRect;
+		meta["blit"] = &Image::blit;
+		meta["resize"] = &Image::resize;
+		meta["quantize"] = &Image::quantize;
+		meta["renderToComputer"] = &Image::renderToComputer;
 	}
 
 	{
@@ -162,13 +171,22 @@ void defineThreadSafeAPIs(sol::state* state) {
 
 	{
 		auto meta = state->new_usertype<PointGraph>(
-		    "PointGraph", sol::constructors<PointGraph(unsigned int)>());
+		    "PointGraph", sol::factories(&PointGraph::create));
 		meta["getSize"] = &PointGraph::getSize;
 		meta["addNode"] = &PointGraph::addNode;
 		meta["getNodePoint"] = &PointGraph::getNodePoint;
 		meta["addLink"] = &PointGraph::addLink;
+		meta["freeze"] = &PointGraph::freeze;
+		meta["seal"] = &PointGraph::seal;
+		meta["isSealed"] = &PointGraph::isSealed;
+		meta["setPathCacheSize"] = &PointGraph::setPathCacheSize;
+		meta["buildHierarchy"] = &PointGraph::buildHierarchy;
 		meta["getNodeByPoint"] = &PointGraph::getNodeByPoint;
 		meta["findShortestPath"] = &PointGraph::findShortestPath;
+		meta["save"] = &PointGraph::save;
+		meta["load"] = &PointGraph::load;
+		meta["share"] = &PointGraph::share;
+		meta["getShared"] = &PointGraph::getShared;
 	}
 
 	{
@@ -176,6 +194,7 @@ void defineThreadSafeAPIs(sol::state* state) {
 		meta["addWatch"] = &FileWatcher::addWatch;
 		meta["removeWatch"] = &FileWatcher::removeWatch;
 		meta["receiveEvent"] = &FileWatcher::receiveEvent;
+		meta["receiveEvents"] = &FileWatcher::receiveEvents;
 	}
 
 	{
@@ -183,17 +202,51 @@ void defineThreadSafeAPIs(sol::state* state) {
 		    "SQLite", sol::constructors<SQLite(const char*)>());
 		meta["close"] = &SQLite::close;
 		meta["query"] = &SQLite::query;
+		meta["rows"] = &SQLite::rows;
+		meta["startWriter"] = &SQLite::startWriter;
+		meta["hasWriter"] = &SQLite::hasWriter;
+	}
+
+	{
+		auto meta = state->new_usertype<SQLiteRows>("new", sol::no_constructor);
+		meta[sol::meta_function::call] = &SQLiteRows::next;
+		meta["close"] = &SQLiteRows::close;
+		meta["getColumnCount"] = &SQLiteRows::getColumnCount;
+		meta["getColumnName"] = &SQLiteRows::getColumnName;
+		meta["get"] = &SQLiteRows::get;
+		meta["toTable"] = &SQLiteRows::toTable;
+	}
+
+	{
+		auto meta = state->new_usertype<Recording>(
+		    "Recording", sol::constructors<Recording(std::string_view)>());
+		meta["close"] = &Recording::close;
+		meta["getTickCount"] = &Recording::getTickCount;
+		meta["getKeyframeInterval"] = &Recording::getKeyframeInterval;
+		meta["findKeyframe"] = &Recording::findKeyframe;
+		meta["getTick"] = &Recording::getTick;
+		meta["decodeSnapshot"] = &WorldSnapshot::decode;
 	}
 
 	{
 		auto meta = state->new_usertype<TCPClient>(
 		    "TCPClient",
-		    sol::constructors<TCPClient(std::string_view, std::string_view)>());
+		    sol::constructors<TCPClient(std::string_view, std::string_view)>(),
+		    sol::base_classes, sol::bases<TCPSocket>());
 		meta["close"] = &TCPClient::close;
 		meta["send"] = &TCPClient::send;
+		meta["sendMessage"] = &TCPClient::sendMessage;
+		meta["flush"] = &TCPClient::flush;
 		meta["receive"] = &TCPClient::receive;
+		meta["receiveMessage"] = &TCPClient::receiveMessage;
+		meta["setFraming"] = &TCPClient::setFraming;
+		meta["getBufferedSize"] = &TCPClient::getBufferedSize;
+		meta["getQueuedSize"] = &TCPClient::getQueuedSize;
 
 		meta["isOpen"] = sol::property(&TCPClient::isOpen);
+		meta["isWritable"] = sol::property(&TCPClient::isWritable);
+		meta["highWaterMark"] = sol::property(&TCPClient::getHighWaterMark,
+		                                      &TCPClient::setHighWaterMark);
 	}
 
 	{
@@ -201,18 +254,29 @@ void defineThreadSafeAPIs(sol::state* state) {
 		    "TCPServer", sol::constructors<TCPServer(unsigned short)>());
 		meta["close"] = &TCPServer::close;
 		meta["accept"] = &TCPServer::accept;
+		meta["poll"] = &TCPServer::poll;
 
 		meta["isOpen"] = sol::property(&TCPServer::isOpen);
 	}
 
 	{
-		auto meta =
-		    state->new_usertype<TCPServerConnection>("new", sol::no_constructor);
+		auto meta = state->new_usertype<TCPServerConnection>(
+		    "new", sol::no_constructor, sol::base_classes, sol::bases<TCPSocket>());
 		meta["close"] = &TCPServerConnection::close;
 		meta["send"] = &TCPServerConnection::send;
+		meta["sendMessage"] = &TCPServerConnection::sendMessage;
+		meta["flush"] = &TCPServerConnection::flush;
 		meta["receive"] = &TCPServerConnection::receive;
+		meta["receiveMessage"] = &TCPServerConnection::receiveMessage;
+		meta["setFraming"] = &TCPServerConnection::setFraming;
+		meta["getBufferedSize"] = &TCPServerConnection::getBufferedSize;
+		meta["getQueuedSize"] = &TCPServerConnection::getQueuedSize;
 
 		meta["isOpen"] = sol::property(&TCPServerConnection::isOpen);
+		meta["isWritable"] = sol::property(&TCPServerConnection::isWritable);
+		meta["highWaterMark"] =
+		    sol::property(&TCPServerConnection::getHighWaterMark,
+		                  &TCPServerConnection::setHighWaterMark);
 		meta["port"] = sol::property(&TCPServerConnection::getPort);
 		meta["address"] = sol::property(&TCPServerConnection::getAddress);
 	}
@@ -241,6 +305,29 @@ void defineThreadSafeAPIs(sol::state* state) {
 		(*state)["lz4"] = lz4table;
 		lz4table["compress"] = Lua::lz4::_compress;
 		lz4table["uncompress"] = Lua::lz4::_uncompress;
+		lz4table["compressFrame"] = Lua::lz4::_compressFrame;
+		lz4table["uncompressFrame"] = Lua::lz4::_uncompressFrame;
+	}
+
+	{
+		auto meta = state->new_usertype<LZ4Compressor>(
+		    "LZ4Compressor",
+		    sol::constructors<LZ4Compressor(sol::optional<int>)>());
+		meta["compress"] = &LZ4Compressor::compress;
+		meta["reset"] = &LZ4Compressor::reset;
+	}
+
+	{
+		auto meta = state->new_usertype<LZ4Decompressor>("LZ4Decompressor");
+		meta["uncompress"] = &LZ4Decompressor::uncompress;
+		meta["reset"] = &LZ4Decompressor::reset;
+	}
+
+	{
+		auto serializerTable = state->create_table();
+		(*state)["serializer"] = serializerTable;
+		serializerTable["encode"] = Lua::serializer::encode;
+		serializerTable["decode"] = Lua::serializer::decode;
 	}
 
 	{
@@ -248,6 +335,16 @@ void defineThreadSafeAPIs(sol::state* state) {
 		(*state)["crypto"] = cryptoTable;
 		cryptoTable["md5"] = Lua::crypto::md5;
 		cryptoTable["sha256"] = Lua::crypto::sha256;
+		cryptoTable["hmacSha256"] = Lua::crypto::hmacSha256;
+		cryptoTable["toHex"] = Lua::crypto::toHex;
+		cryptoTable["md5new"] = Lua::crypto::md5New;
+		cryptoTable["sha256new"] = Lua::crypto::sha256New;
+	}
+
+	{
+		auto meta = state->new_usertype<Hasher>("Hasher", sol::no_constructor);
+		meta["update"] = &Hasher::update;
+		meta["final"] = &Hasher::final;
 	}
 
 	(*state)["FILE_WATCH_ACCESS"] = IN_ACCESS;
@@ -279,52 +376,24 @@ void luaInit(bool redo) {
 	std::lock_guard<std::mutex> guard(stateResetMutex);
 
 	Hooks::run = sol::nil;
+	Hooks::clearHandlers();
 
 	if (redo) {
 		Console::log(LUA_PREFIX "Resetting state...\n");
 		delete server;
 
-		for (int i = 0; i < maxNumberOfAccounts; i++) {
-			if (accountDataTables[i]) {
-				delete accountDataTables[i];
-				accountDataTables[i] = nullptr;
-			}
-		}
-
-		for (int i = 0; i < maxNumberOfPlayers; i++) {
-			if (playerDataTables[i]) {
-				delete playerDataTables[i];
-				playerDataTables[i] = nullptr;
-			}
-		}
-
-		for (int i = 0; i < maxNumberOfHumans; i++) {
-			if (humanDataTables[i]) {
-				delete humanDataTables[i];
-				humanDataTables[i] = nullptr;
-			}
-		}
+		accountDataTables.reset();
+		playerDataTables.reset();
+		humanDataTables.reset();
+		itemDataTables.reset();
+		vehicleDataTables.reset();
+		bodyDataTables.reset();
 
-		for (int i = 0; i < maxNumberOfItems; i++) {
-			if (itemDataTables[i]) {
-				delete itemDataTables[i];
-				itemDataTables[i] = nullptr;
-			}
-		}
-
-		for (int i = 0; i < maxNumberOfVehicles; i++) {
-			if (vehicleDataTables[i]) {
-				delete vehicleDataTables[i];
-				vehicleDataTables[i] = nullptr;
-			}
-		}
-
-		for (int i = 0; i < maxNumberOfRigidBodies; i++) {
-			if (bodyDataTables[i]) {
-				delete bodyDataTables[i];
-				bodyDataTables[i] = nullptr;
-			}
-		}
+		clearActiveObjects();
+		clearHTTPCallbacks();
+		clearThreadCallbacks();
+		clearSQLiteCallbacks();
+		BlockRegion::clear();
 
 		delete lua;
 	} else {
@@ -332,9 +401,33 @@ void luaInit(bool redo) {
 	}
 
 	lua = new sol::state();
+	GCScheduler::reset();
 
 	Console::log(LUA_PREFIX "Defining...\n");
 	defineThreadSafeAPIs(lua);
+	ScriptCache::install(*lua);
+
+	{
+		sol::table httpTable = (*lua)["http"];
+		httpTable["get"] = Lua::http::get;
+		httpTable["post"] = Lua::http::post;
+	}
+
+	{
+		auto threadsTable = lua->create_table();
+		(*lua)["threads"] = threadsTable;
+		threadsTable["load"] = Lua::threads::load;
+		threadsTable["submit"] = Lua::threads::submit;
+		threadsTable["getCount"] = Lua::threads::getCount;
+		threadsTable["getPending"] = Lua::threads::getPending;
+
+		// Results come back through the main state's thread callbacks
+		sol::usertype<PointGraph> pointGraphMeta = (*lua)["PointGraph"];
+		pointGraphMeta["findShortestPaths"] = Lua::threads::findShortestPaths;
+
+		sol::usertype<SQLite> sqliteMeta = (*lua)["SQLite"];
+		sqliteMeta["queryAsync"] = Lua::sqlite::queryAsync;
+	}
 
 	{
 		auto meta = lua->new_usertype<Server>("new", sol::no_constructor);
@@ -907,22 +1000,77 @@ void luaInit(bool redo) {
 		meta["stop"] = &Worker::stop;
 		meta["sendMessage"] = &Worker::sendMessage;
 		meta["receiveMessage"] = &Worker::receiveMessage;
+		meta["receiveMessages"] = &Worker::receiveMessages;
+		meta["send"] = &Worker::send;
+		meta["receive"] = &Worker::receive;
+		meta["getSendOverflowCount"] = &Worker::getSendOverflowCount;
+		meta["getReceiveOverflowCount"] = &Worker::getReceiveOverflowCount;
 	}
 
 	{
 		auto meta = lua->new_usertype<ChildProcess>(
 		    "ChildProcess",
-		    sol::constructors<ChildProcess(const char*, sol::optional<int>)>());
+		    sol::constructors<ChildProcess(const char*, sol::optional<int>,
+		                                   sol::optional<size_t>)>());
 		meta["isRunning"] = &ChildProcess::isRunning;
 		meta["terminate"] = &ChildProcess::terminate;
 		meta["getExitCode"] = &ChildProcess::getExitCode;
 		meta["receiveMessage"] = &ChildProcess::receiveMessage;
 		meta["sendMessage"] = &ChildProcess::sendMessage;
+		meta["receive"] = &ChildProcess::receive;
+		meta["send"] = &ChildProcess::send;
+		meta["flush"] = &ChildProcess::flush;
+		meta["getQueuedSize"] = &ChildProcess::getQueuedSize;
 		meta["setCPULimit"] = &ChildProcess::setCPULimit;
 		meta["setMemoryLimit"] = &ChildProcess::setMemoryLimit;
 		meta["setFileSizeLimit"] = &ChildProcess::setFileSizeLimit;
 		meta["getPriority"] = &ChildProcess::getPriority;
 		meta["setPriority"] = &ChildProcess::setPriority;
+		meta["getResidentSize"] = &ChildProcess::getResidentSize;
+	}
+
+	{
+		auto meta = lua->new_usertype<SatellitePool>(
+		    "SatellitePool",
+		    sol::constructors<SatellitePool(std::string, int,
+		                                    sol::optional<sol::table>)>());
+		meta["submit"] = &SatellitePool::submit;
+		meta["close"] = &SatellitePool::close;
+		meta["getSize"] = &SatellitePool::getSize;
+		meta["getIdleCount"] = &SatellitePool::getIdleCount;
+		meta["getQueuedCount"] = &SatellitePool::getQueuedCount;
+		meta["getRecycledCount"] = &SatellitePool::getRecycledCount;
+	}
+
+	{
+		auto meta = lua->new_usertype<WorldSnapshot>(
+		    "WorldSnapshot",
+		    sol::constructors<WorldSnapshot(sol::optional<bool>)>());
+		meta["capture"] = &WorldSnapshot::capture;
+		meta["getKeyframe"] = &WorldSnapshot::getKeyframe;
+		meta["publish"] = &WorldSnapshot::publish;
+		meta["addConnection"] = &WorldSnapshot::addConnection;
+		meta["addFile"] = &WorldSnapshot::addFile;
+		meta["clearSinks"] = &WorldSnapshot::clearSinks;
+		meta["getSinkCount"] = &WorldSnapshot::getSinkCount;
+		meta["getSequence"] = &WorldSnapshot::getSequence;
+		meta["decode"] = &WorldSnapshot::decode;
+	}
+
+	{
+		auto meta = lua->new_usertype<OpusPipeline>(
+		    "OpusPipeline",
+		    sol::constructors<OpusPipeline(sol::optional<opus_int32>)>());
+		meta["bitRate"] =
+		    sol::property(&OpusPipeline::getBitRate, &OpusPipeline::setBitRate);
+		meta["addSource"] = &OpusPipeline::addSource;
+		meta["removeSource"] = &OpusPipeline::removeSource;
+		meta["setSourceVolume"] = &OpusPipeline::setSourceVolume;
+		meta["hasSource"] = &OpusPipeline::hasSource;
+		meta["getSourceCount"] = &OpusPipeline::getSourceCount;
+		meta["isReady"] = &OpusPipeline::isReady;
+		meta["nextFrame"] = &OpusPipeline::nextFrame;
+		meta["writeVoices"] = &OpusPipeline::writeVoices;
 	}
 
 	{
@@ -1101,9 +1249,66 @@ void luaInit(bool redo) {
 		hookTable["enable"] = Lua::hook::enable;
 		hookTable["disable"] = Lua::hook::disable;
 		hookTable["clear"] = Lua::hook::clear;
+		hookTable["on"] = Lua::hook::on;
+		hookTable["off"] = Lua::hook::off;
 		Lua::hook::clear();
 	}
 
+	{
+		auto profilerTable = lua->create_table();
+		(*lua)["profiler"] = profilerTable;
+		profilerTable["enable"] = Lua::profiler::enable;
+		profilerTable["disable"] = Lua::profiler::disable;
+		profilerTable["isEnabled"] = Lua::profiler::isEnabled;
+		profilerTable["reset"] = Lua::profiler::reset;
+		profilerTable["getStats"] = Lua::profiler::getStats;
+	}
+
+	{
+		auto bandwidthTable = lua->create_table();
+		(*lua)["bandwidth"] = bandwidthTable;
+		bandwidthTable["getStats"] = Bandwidth::getStats;
+		bandwidthTable["reset"] = Bandwidth::reset;
+		bandwidthTable["setBudget"] = Bandwidth::setBudget;
+		bandwidthTable["getBudget"] = Bandwidth::getBudget;
+	}
+
+	{
+		auto recorderTable = lua->create_table();
+		(*lua)["recorder"] = recorderTable;
+		recorderTable["start"] = Recorder::start;
+		recorderTable["stop"] = Recorder::stop;
+		recorderTable["isRecording"] = Recorder::isRecording;
+		recorderTable["getTickCount"] = Recorder::getTickCount;
+	}
+
+	{
+		auto modulesTable = lua->create_table();
+		(*lua)["modules"] = modulesTable;
+		modulesTable["reload"] = ScriptCache::reload;
+		modulesTable["getFileName"] = ScriptCache::getFileName;
+		modulesTable["getCacheStats"] = ScriptCache::getStats;
+		modulesTable["clearCache"] = ScriptCache::clear;
+	}
+
+	{
+		auto consoleTable = lua->create_table();
+		(*lua)["console"] = consoleTable;
+		consoleTable["addLogFile"] = Lua::console::addLogFile;
+		consoleTable["removeLogFile"] = Console::removeLogFile;
+		consoleTable["flush"] = Console::flushLog;
+		consoleTable["getDroppedCount"] = Console::getDroppedLogCount;
+	}
+
+	{
+		auto gcSchedulerTable = lua->create_table();
+		(*lua)["gcScheduler"] = gcSchedulerTable;
+		gcSchedulerTable["enable"] = GCScheduler::enable;
+		gcSchedulerTable["disable"] = GCScheduler::disable;
+		gcSchedulerTable["isEnabled"] = GCScheduler::isEnabled;
+		gcSchedulerTable["getStats"] = GCScheduler::getStats;
+	}
+
 	{
 		auto physicsTable = lua->create_table();
 		(*lua)["physics"] = physicsTable;
@@ -1117,11 +1322,16 @@ void luaInit(bool redo) {
 		physicsTable["lineIntersectVehicleQuick"] =
 		    Lua::physics::lineIntersectVehicleQuick;
 		physicsTable["lineIntersectAnyQuick"] = Lua::physics::lineIntersectAnyQuick;
+		physicsTable["lineIntersectAnyBatch"] = Lua::physics::lineIntersectAnyBatch;
 		physicsTable["lineIntersectTriangle"] = Lua::physics::lineIntersectTriangle;
 		physicsTable["garbageCollectBullets"] = Lua::physics::garbageCollectBullets;
 		physicsTable["createBlock"] = Lua::physics::createBlock;
 		physicsTable["getBlock"] = Lua::physics::getBlock;
 		physicsTable["deleteBlock"] = Lua::physics::deleteBlock;
+		physicsTable["setBlockRegion"] = BlockRegion::set;
+		physicsTable["getBlockRegion"] = BlockRegion::get;
+		physicsTable["queueBlockRegion"] = BlockRegion::queue;
+		physicsTable["getQueuedBlockRegionCount"] = BlockRegion::getQueuedCount;
 		physicsTable["levelGenerateTrainRaceTrack"] =
 		    Lua::physics::levelGenerateTrainRaceTrack;
 		physicsTable["levelGenerateRaceTrack"] =
@@ -1154,6 +1364,8 @@ void luaInit(bool redo) {
 		(*lua)["players"] = playersTable;
 		playersTable["getCount"] = Lua::players::getCount;
 		playersTable["getAll"] = Lua::players::getAll;
+		playersTable["iter"] = Lua::players::iter;
+		playersTable["next"] = Lua::players::next;
 		playersTable["getByPhone"] = Lua::players::getByPhone;
 		playersTable["getNonBots"] = Lua::players::getNonBots;
 		playersTable["getBots"] = Lua::players::getBots;
@@ -1170,6 +1382,10 @@ void luaInit(bool redo) {
 		(*lua)["humans"] = humansTable;
 		humansTable["getCount"] = Lua::humans::getCount;
 		humansTable["getAll"] = Lua::humans::getAll;
+		humansTable["iter"] = Lua::humans::iter;
+		humansTable["next"] = Lua::humans::next;
+		humansTable["getInRadius"] = Lua::humans::getInRadius;
+		humansTable["getInBox"] = Lua::humans::getInBox;
 		humansTable["create"] = Lua::humans::create;
 
 		sol::table _meta = lua->create_table();
@@ -1196,6 +1412,8 @@ void luaInit(bool redo) {
 		(*lua)["items"] = itemsTable;
 		itemsTable["getCount"] = Lua::items::getCount;
 		itemsTable["getAll"] = Lua::items::getAll;
+		itemsTable["iter"] = Lua::items::iter;
+		itemsTable["next"] = Lua::items::next;
 		itemsTable["create"] =
 		    sol::overload(Lua::items::create, Lua::items::createVel);
 		itemsTable["createRope"] = Lua::items::createRope;
@@ -1224,8 +1442,12 @@ void luaInit(bool redo) {
 		(*lua)["vehicles"] = vehiclesTable;
 		vehiclesTable["getCount"] = Lua::vehicles::getCount;
 		vehiclesTable["getAll"] = Lua::vehicles::getAll;
+		vehiclesTable["iter"] = Lua::vehicles::iter;
+		vehiclesTable["next"] = Lua::vehicles::next;
 		vehiclesTable["getNonTrafficCars"] = Lua::vehicles::getNonTrafficCars;
 		vehiclesTable["getTrafficCars"] = Lua::vehicles::getTrafficCars;
+		vehiclesTable["getInRadius"] = Lua::vehicles::getInRadius;
+		vehiclesTable["getInBox"] = Lua::vehicles::getInBox;
 		vehiclesTable["create"] =
 		    sol::overload(Lua::vehicles::create, Lua::vehicles::createVel);
 
@@ -1241,6 +1463,9 @@ void luaInit(bool redo) {
 		bulletsTable["getCount"] = Lua::bullets::getCount;
 		bulletsTable["getAll"] = Lua::bullets::getAll;
 		bulletsTable["create"] = Lua::bullets::create;
+		bulletsTable["setBatchedHits"] = BulletHits::setBatching;
+		bulletsTable["isBatchingHits"] = BulletHits::isBatching;
+		bulletsTable["setHitRules"] = BulletHits::setRules;
 	}
 
 	{
@@ -1248,6 +1473,8 @@ void luaInit(bool redo) {
 		(*lua)["rigidBodies"] = rigidBodiesTable;
 		rigidBodiesTable["getCount"] = Lua::rigidBodies::getCount;
 		rigidBodiesTable["getAll"] = Lua::rigidBodies::getAll;
+		rigidBodiesTable["iter"] = Lua::rigidBodies::iter;
+		rigidBodiesTable["next"] = Lua::rigidBodies::next;
 
 		sol::table _meta = lua->create_table();
 		rigidBodiesTable[sol::metatable_key] = _meta;
@@ -1399,6 +1626,8 @@ void luaInit(bool redo) {
 		memoryTable["writeFloat"] = Lua::memory::writeFloat;
 		memoryTable["writeDouble"] = Lua::memory::writeDouble;
 		memoryTable["writeBytes"] = Lua::memory::writeBytes;
+		memoryTable["getStructDefinitions"] = FFIViews::getStructDefinitions;
+		memoryTable["getArrayAddresses"] = FFIViews::getArrayAddresses;
 	}
 
 	(*lua)["RESET_REASON_BOOT"] = RESET_REASON_BOOT;
@@ -1420,7 +1649,9 @@ void luaInit(bool redo) {
 
 	Console::log(LUA_PREFIX "Running " LUA_ENTRY_FILE "...\n");
 
-	sol::load_result load = lua->load_file(LUA_ENTRY_FILE);
+	int status = ScriptCache::loadFile(*lua, LUA_ENTRY_FILE);
+	sol::load_result load(*lua, lua_absindex(*lua, -1), 1, 1,
+	                      static_cast<sol::load_status>(status));
 	if (noLuaCallError(&load)) {
 		sol::protected_function_result res = load();
 		if (noLuaCallError(&res)) {
@@ -1678,9 +1909,30 @@ static inline void installHook(
 	}
 }
 
-#define INSTALL(name)                                               \
-	installHook(#name "Hook", Hooks::name##Hook, (void*)Engine::name, \
-	            (void*)Hooks::name);
+// Hooks engine functions with a trampoline when subhook can relocate the
+// prologue, and points the Engine:: pointer at it so Hooks::ScopedOriginal
+// never has to patch code at runtime.
+template <typename Func>
+static inline void installEngineHook(const char* name, subhook::Hook& hook,
+                                     Func& source, void* destination) {
+	installHook(name, hook, (void*)source, destination,
+	            (subhook::HookFlags)(subhook::HookFlags::HookFlag64BitOffset |
+	                                 subhook::HookFlags::HookFlagTrampoline));
+
+	void* trampoline = hook.GetTrampoline();
+	if (trampoline) {
+		source = (Func)trampoline;
+	} else {
+		std::ostringstream stream;
+		stream << RS_PREFIX "Hook " << name
+		       << " has no trampoline, falling back to removal\n";
+		Console::log(stream.str());
+	}
+}
+
+#define INSTALL(name)                                                \
+	installEngineHook(#name "Hook", Hooks::name##Hook, Engine::name, \
+	                  (void*)Hooks::name);
 
 static inline void installHooks() {
 	INSTALL(subRosaPuts);
@@ -5,16 +5,25 @@
 #include <thread>
 
 #include "api.h"
+#include "bandwidth.h"
+#include "blockregion.h"
+#include "bullethits.h"
 #include "childprocess.h"
 #include "console.h"
 #include "crypto.h"
 #include "engine.h"
+#include "ffiviews.h"
 #include "filewatcher.h"
+#include "gcscheduler.h"
 #include "hooks.h"
 #include "image.h"
 #include "lz4impl.h"
 #include "opusencoder.h"
+#include "opuspipeline.h"
 #include "pointgraph.h"
+#include "recorder.h"
+#include "satellitepool.h"
+#include "scriptcache.h"
 #include "server.h"
 #include "sol/sol.hpp"
 #include "sqlite.h"
@@ -22,3 +31,4 @@
 #include "tcpclient.h"
 #include "tcpserver.h"
 #include "worker.h"
+#include "worldsnapshot.h"
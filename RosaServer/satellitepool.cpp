@@ -0,0 +1,179 @@
+#include "satellitepool.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "api.h"
+#include "engineuserdata.h"
+
+static constexpr const char* errorExited = "Satellite exited during the job";
+static constexpr const char* errorMalformedResult =
+    "Satellite sent a malformed result";
+static constexpr const char* errorInvalidSize = "Pool size must be at least 1";
+
+static std::unordered_set<SatellitePool*> pools;
+
+static std::optional<std::pair<rlim_t, rlim_t>> readLimit(sol::table& options,
+                                                          const char* soft,
+                                                          const char* hard) {
+	auto softLimit = options.get<sol::optional<rlim_t>>(soft);
+	auto hardLimit = options.get<sol::optional<rlim_t>>(hard);
+	if (!softLimit && !hardLimit) return std::nullopt;
+
+	// Only giving a soft limit leaves the hard one open
+	return std::make_pair(softLimit.value_or(hardLimit.value()),
+	                      hardLimit.value_or(RLIM_INFINITY));
+}
+
+SatellitePool::SatellitePool(std::string fileName, int size,
+                             sol::optional<sol::table> options)
+    : fileName(std::move(fileName)) {
+	if (size < 1) {
+		throw std::invalid_argument(errorInvalidSize);
+	}
+
+	if (options) {
+		sharedMemorySize = options->get<sol::optional<size_t>>("sharedMemorySize");
+		recycleMemory = options->get_or<size_t>("recycleMemory", 0);
+
+		cpuLimit = readLimit(*options, "cpuSoftLimit", "cpuHardLimit");
+		memoryLimit = readLimit(*options, "memorySoftLimit", "memoryHardLimit");
+	}
+
+	satellites.resize(size);
+	for (auto& satellite : satellites) {
+		spawn(satellite);
+	}
+
+	pools.insert(this);
+}
+
+SatellitePool::~SatellitePool() {
+	pools.erase(this);
+	close();
+}
+
+void SatellitePool::spawn(Satellite& satellite) {
+	satellite.process = std::make_unique<ChildProcess>(
+	    fileName.c_str(), sol::nullopt, sharedMemorySize, true);
+
+	if (cpuLimit) {
+		satellite.process->setCPULimit(cpuLimit->first, cpuLimit->second);
+	}
+	if (memoryLimit) {
+		satellite.process->setMemoryLimit(memoryLimit->first, memoryLimit->second);
+	}
+}
+
+void SatellitePool::recycle(Satellite& satellite) {
+	satellite.process.reset();
+	recycledCount++;
+	spawn(satellite);
+}
+
+// Jobs that haven't finished are dropped without calling their callbacks
+void SatellitePool::close() {
+	// Destroying the processes terminates them
+	satellites.clear();
+	queuedJobs.clear();
+}
+
+size_t SatellitePool::getIdleCount() const {
+	return std::count_if(
+	    satellites.begin(), satellites.end(),
+	    [](const Satellite& satellite) { return !satellite.busy; });
+}
+
+bool SatellitePool::submit(std::string_view functionName, sol::object argument,
+                           sol::protected_function callback) {
+	size_t pending = queuedJobs.size() + satellites.size() - getIdleCount();
+	if (pending >= maxPending) {
+		return false;
+	}
+
+	unsigned int id = nextJobID++;
+	queuedJobs.push_back(
+	    {id,
+	     Channel::encodeJob(id, functionName,
+	                        Serializer::encode<EngineUserdata>(argument)),
+	     std::move(callback)});
+	return true;
+}
+
+namespace {
+struct Finished {
+	sol::protected_function callback;
+	bool success;
+	std::string value;
+};
+};  // namespace
+
+void SatellitePool::update() {
+	std::vector<Finished> finished;
+
+	for (auto& satellite : satellites) {
+		if (satellite.busy) {
+			std::string message;
+			if (satellite.process->readMessage(message)) {
+				Channel::JobResult result;
+				if (!Channel::decodeJobResult(message, result) ||
+				    result.id != satellite.job.id) {
+					finished.push_back(
+					    {std::move(satellite.job.callback), false, errorMalformedResult});
+					satellite.busy = false;
+					recycle(satellite);
+				} else {
+					finished.push_back({std::move(satellite.job.callback),
+					                    result.success, std::string(result.value)});
+					satellite.busy = false;
+
+					if (recycleMemory &&
+					    satellite.process->getResidentSize() > recycleMemory) {
+						recycle(satellite);
+					}
+				}
+			} else if (!satellite.process->isRunning()) {
+				finished.push_back(
+				    {std::move(satellite.job.callback), false, errorExited});
+				satellite.busy = false;
+				recycle(satellite);
+			}
+		}
+
+		if (!satellite.busy && !queuedJobs.empty()) {
+			if (!satellite.process->isRunning()) {
+				recycle(satellite);
+			}
+
+			satellite.job = std::move(queuedJobs.front());
+			queuedJobs.pop_front();
+			satellite.busy = true;
+			satellite.process->sendMessage(satellite.job.message);
+			satellite.job.message.clear();
+		}
+	}
+
+	// Called last, since a callback can close or collect this pool
+	for (auto& job : finished) {
+		// Failed jobs pass nil and the error message instead
+		if (job.success) {
+			sol::object value =
+			    Serializer::decode<EngineUserdata>(lua->lua_state(), job.value);
+			auto res = job.callback(value);
+			noLuaCallError(&res);
+		} else {
+			auto res = job.callback(sol::nil, job.value);
+			noLuaCallError(&res);
+		}
+	}
+}
+
+void SatellitePool::updateAll() {
+	// Callbacks can create and destroy pools
+	std::vector<SatellitePool*> current(pools.begin(), pools.end());
+	for (auto pool : current) {
+		if (pools.count(pool)) {
+			pool->update();
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <sys/resource.h>
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "childprocess.h"
+#include "sol/sol.hpp"
+
+// Satellites that stay running between jobs, so a job doesn't pay for
+// starting a process and loading a script. Jobs name a global function from
+// the pool's script and carry one serialized argument, like ThreadPool tasks.
+//
+// Satellites are started up front, and replaced when they exit or grow past
+// the recycle threshold. CPU limits count a satellite's whole life, not one
+// job, so a satellite that reaches it is killed and replaced.
+class SatellitePool {
+	// Jobs that were submitted but haven't finished yet
+	static constexpr size_t maxPending = 4096;
+
+	struct Job {
+		unsigned int id;
+		std::string message;
+		sol::protected_function callback;
+	};
+
+	struct Satellite {
+		std::unique_ptr<ChildProcess> process;
+		bool busy = false;
+		Job job;
+	};
+
+	std::string fileName;
+	sol::optional<size_t> sharedMemorySize;
+	std::optional<std::pair<rlim_t, rlim_t>> cpuLimit;
+	std::optional<std::pair<rlim_t, rlim_t>> memoryLimit;
+	// Resident bytes after a job that get a satellite replaced, 0 for never
+	size_t recycleMemory = 0;
+
+	std::vector<Satellite> satellites;
+	std::deque<Job> queuedJobs;
+	unsigned int nextJobID = 1;
+	unsigned int recycledCount = 0;
+
+	void spawn(Satellite& satellite);
+	void recycle(Satellite& satellite);
+	void update();
+
+ public:
+	SatellitePool(std::string fileName, int size,
+	              sol::optional<sol::table> options);
+	~SatellitePool();
+	SatellitePool(const SatellitePool&) = delete;
+
+	// Returns false without queueing if maxPending jobs are already pending
+	bool submit(std::string_view functionName, sol::object argument,
+	            sol::protected_function callback);
+	void close();
+	size_t getSize() const { return satellites.size(); }
+	size_t getIdleCount() const;
+	size_t getQueuedCount() const { return queuedJobs.size(); }
+	unsigned int getRecycledCount() const { return recycledCount; }
+
+	// Collects finished jobs, calls their callbacks and hands out queued jobs
+	// for every pool
+	static void updateAll();
+};
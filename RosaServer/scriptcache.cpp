@@ -0,0 +1,345 @@
+#include "scriptcache.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cinttypes>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "api.h"
+
+static constexpr char entryMagic[4] = {'R', 'S', 'B', 'C'};
+// Files written again this soon can keep the same modification time
+static constexpr int64_t racyNanoseconds = 2'000'000'000LL;
+
+namespace ScriptCache {
+struct EntryHeader {
+	char magic[4];
+	// Bytecode only loads in the LuaJIT version that wrote it
+	uint32_t version;
+	int64_t modifiedTime;
+	uint64_t sourceSize;
+	uint64_t sourceHash;
+};
+
+static unsigned int hitCount = 0;
+static unsigned int missCount = 0;
+
+struct LoadedModule {
+	std::string name;
+	// As package.path spelled it, which its cache entry and chunk name use
+	std::string fileName;
+};
+
+// Real paths of the files modules were loaded from, and the other way around
+static std::unordered_map<std::string, LoadedModule> fileModules;
+static std::unordered_map<std::string, std::string> moduleFiles;
+
+// FNV-1a, which only has to be stable between runs
+static uint64_t hash(std::string_view data) {
+	uint64_t value = 0xcbf29ce484222325;
+	for (unsigned char c : data) {
+		value = (value ^ c) * 0x100000001b3;
+	}
+	return value;
+}
+
+static std::string getEntryName(const std::string& fileName) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016" PRIx64 ".bc", hash(fileName));
+	return std::string(cacheDirectory) + '/' + name;
+}
+
+static bool readFile(const std::string& fileName, std::string& out) {
+	int descriptor = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor == -1) return false;
+
+	struct stat info;
+	if (fstat(descriptor, &info) == -1) {
+		close(descriptor);
+		return false;
+	}
+
+	out.resize(info.st_size);
+	size_t offset = 0;
+	while (offset < out.size()) {
+		ssize_t count = read(descriptor, out.data() + offset, out.size() - offset);
+		if (count <= 0) break;
+		offset += count;
+	}
+	out.resize(offset);
+
+	close(descriptor);
+	return true;
+}
+
+static bool readEntry(const std::string& entryName, std::string& entry,
+                      EntryHeader& header) {
+	if (!readFile(entryName, entry) || entry.size() <= sizeof(header)) {
+		return false;
+	}
+
+	std::memcpy(&header, entry.data(), sizeof(header));
+	return !std::memcmp(header.magic, entryMagic, sizeof(entryMagic)) &&
+	       header.version == LUAJIT_VERSION_NUM;
+}
+
+// Written beside the entry and renamed over it, so a reader never sees half
+static void writeEntry(const std::string& entryName, const EntryHeader& header,
+                       std::string_view bytecode) {
+	mkdir(cacheDirectory, 0755);
+
+	std::string temporaryName = entryName + ".tmp";
+	FILE* file = fopen(temporaryName.c_str(), "wb");
+	if (!file) return;
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+	               fwrite(bytecode.data(), 1, bytecode.size(), file) ==
+	                   bytecode.size();
+	if (fclose(file) != 0 || !written ||
+	    rename(temporaryName.c_str(), entryName.c_str()) != 0) {
+		unlink(temporaryName.c_str());
+	}
+}
+
+// Times too recent to tell apart from the next write are stored as 0, so the
+// source is hashed until a load after they've settled
+static int64_t getTrustedTime(int64_t modifiedTime) {
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	int64_t nowTime = now.tv_sec * 1'000'000'000LL + now.tv_nsec;
+	return nowTime - modifiedTime < racyNanoseconds ? 0 : modifiedTime;
+}
+
+static int dumpWriter(lua_State*, const void* data, size_t size, void* out) {
+	static_cast<std::string*>(out)->append(static_cast<const char*>(data), size);
+	return 0;
+}
+
+int loadFile(lua_State* L, const std::string& fileName) {
+	struct stat info;
+	if (stat(fileName.c_str(), &info) == -1) {
+		// Leaves the error message to Lua
+		return luaL_loadfile(L, fileName.c_str());
+	}
+
+	std::string chunkName = '@' + fileName;
+	int64_t modifiedTime =
+	    info.st_mtim.tv_sec * 1'000'000'000LL + info.st_mtim.tv_nsec;
+
+	std::string entryName = getEntryName(fileName);
+	std::string entry;
+	EntryHeader header;
+	bool haveEntry = readEntry(entryName, entry, header);
+	std::string_view bytecode;
+	if (haveEntry) {
+		bytecode = std::string_view(entry).substr(sizeof(header));
+	}
+
+	if (haveEntry && header.modifiedTime == modifiedTime &&
+	    header.sourceSize == (uint64_t)info.st_size) {
+		int status = luaL_loadbuffer(L, bytecode.data(), bytecode.size(),
+		                             chunkName.c_str());
+		if (status == 0) {
+			hitCount++;
+			return status;
+		}
+		lua_pop(L, 1);
+	}
+
+	std::string source;
+	if (!readFile(fileName, source)) {
+		return luaL_loadfile(L, fileName.c_str());
+	}
+	uint64_t sourceHash = hash(source);
+
+	// Touched but not changed, like after a checkout
+	if (haveEntry && header.sourceSize == source.size() &&
+	    header.sourceHash == sourceHash) {
+		int status = luaL_loadbuffer(L, bytecode.data(), bytecode.size(),
+		                             chunkName.c_str());
+		if (status == 0) {
+			int64_t trustedTime = getTrustedTime(modifiedTime);
+			if (header.modifiedTime != trustedTime) {
+				header.modifiedTime = trustedTime;
+				writeEntry(entryName, header, bytecode);
+			}
+			hitCount++;
+			return status;
+		}
+		lua_pop(L, 1);
+	}
+
+	// luaL_loadfile skips a #! line, keeping the line numbers the same
+	std::string_view text(source);
+	if (!text.empty() && text[0] == '#') {
+		size_t end = text.find('\n');
+		text.remove_prefix(end == std::string_view::npos ? text.size() : end);
+	}
+
+	missCount++;
+	int status = luaL_loadbuffer(L, text.data(), text.size(), chunkName.c_str());
+	if (status != 0) return status;
+
+	std::string dumped;
+	if (lua_dump(L, dumpWriter, &dumped) == 0) {
+		EntryHeader newHeader{};
+		std::memcpy(newHeader.magic, entryMagic, sizeof(entryMagic));
+		newHeader.version = LUAJIT_VERSION_NUM;
+		newHeader.modifiedTime = getTrustedTime(modifiedTime);
+		newHeader.sourceSize = source.size();
+		newHeader.sourceHash = sourceHash;
+		writeEntry(entryName, newHeader, dumped);
+	}
+
+	return status;
+}
+
+static std::string getRealPath(const std::string& fileName) {
+	char path[PATH_MAX];
+	if (!realpath(fileName.c_str(), path)) return fileName;
+	return path;
+}
+
+// Finds the module in package.path, and pushes either its chunk or where it
+// looked. Returns false with the message pushed if the file doesn't compile.
+static bool search(lua_State* L, const std::string& moduleName) {
+	lua_getglobal(L, "package");
+	lua_getfield(L, -1, "path");
+	const char* pathField = lua_tostring(L, -1);
+	std::string path = pathField ? pathField : "";
+	lua_pop(L, 2);
+
+	std::string fileTemplate = moduleName;
+	for (char& c : fileTemplate) {
+		if (c == '.') c = '/';
+	}
+
+	std::string notFound;
+	size_t start = 0;
+	while (start <= path.size()) {
+		size_t end = path.find(';', start);
+		if (end == std::string::npos) end = path.size();
+		std::string fileName = path.substr(start, end - start);
+		start = end + 1;
+		if (fileName.empty()) continue;
+
+		for (size_t mark = fileName.find('?'); mark != std::string::npos;
+		     mark = fileName.find('?', mark + fileTemplate.size())) {
+			fileName.replace(mark, 1, fileTemplate);
+		}
+
+		if (access(fileName.c_str(), R_OK) != 0) {
+			notFound += "\n\tno file '" + fileName + "'";
+			continue;
+		}
+
+		if (loadFile(L, fileName) != 0) {
+			std::string error = "error loading module '" + moduleName +
+			                    "' from file '" + fileName + "':\n\t" +
+			                    lua_tostring(L, -1);
+			lua_pop(L, 1);
+			lua_pushlstring(L, error.data(), error.size());
+			return false;
+		}
+
+		std::string realPath = getRealPath(fileName);
+		moduleFiles[moduleName] = realPath;
+		fileModules[realPath] = {moduleName, fileName};
+		return true;
+	}
+
+	lua_pushlstring(L, notFound.data(), notFound.size());
+	return true;
+}
+
+static int searcher(lua_State* L) {
+	bool loaded;
+	{
+		std::string moduleName = luaL_checkstring(L, 1);
+		loaded = search(L, moduleName);
+	}
+	// Raised out here so nothing is left to destroy
+	if (!loaded) return lua_error(L);
+	return 1;
+}
+
+void install(sol::state& state) {
+	fileModules.clear();
+	moduleFiles.clear();
+
+	// The second loader is the one for Lua files
+	sol::table loaders = state["package"]["loaders"];
+	loaders[2] = &searcher;
+}
+
+bool reload(std::string_view fileName) {
+	auto found = fileModules.find(getRealPath(std::string(fileName)));
+	if (found == fileModules.end()) return false;
+
+	lua_State* L = lua->lua_state();
+	if (loadFile(L, found->second.fileName) != 0) {
+		std::string error = lua_tostring(L, -1);
+		lua_pop(L, 1);
+		throw std::runtime_error(error);
+	}
+
+	std::string moduleName = found->second.name;
+	auto chunk = sol::stack::pop<sol::protected_function>(L);
+	sol::protected_function_result result = chunk(moduleName);
+	if (!result.valid()) {
+		sol::error error = result;
+		throw std::runtime_error(error.what());
+	}
+
+	// The same as require stores
+	sol::table loaded = (*lua)["package"]["loaded"];
+	sol::object value = result.get<sol::object>();
+	if (value.get_type() == sol::type::lua_nil) {
+		loaded[moduleName] = true;
+	} else {
+		loaded[moduleName] = value;
+	}
+	return true;
+}
+
+sol::object getFileName(std::string_view moduleName, sol::this_state s) {
+	sol::state_view lua(s);
+
+	auto found = moduleFiles.find(std::string(moduleName));
+	if (found == moduleFiles.end()) {
+		return sol::make_object(lua, sol::nil);
+	}
+	return sol::make_object(lua, found->second);
+}
+
+sol::table getStats(sol::this_state s) {
+	sol::state_view lua(s);
+
+	sol::table table = lua.create_table();
+	table["hits"] = hitCount;
+	table["misses"] = missCount;
+	table["modules"] = moduleFiles.size();
+	return table;
+}
+
+void clear() {
+	DIR* directory = opendir(cacheDirectory);
+	if (!directory) return;
+
+	while (auto entry = readdir(directory)) {
+		std::string_view name = entry->d_name;
+		if (name.size() > 3 && name.substr(name.size() - 3) == ".bc") {
+			unlink((std::string(cacheDirectory) + '/' + entry->d_name).c_str());
+		}
+	}
+	closedir(directory);
+}
+};  // namespace ScriptCache
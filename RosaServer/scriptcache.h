@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "sol/sol.hpp"
+
+// Keeps the LuaJIT bytecode of every script the main state loads in
+// cacheDirectory, so resetting the state doesn't parse them all again.
+//
+// Each entry is named after a hash of the script's path, and starts with the
+// modification time, size and hash of the source it was compiled from. An
+// entry is used as is when the time and size still match, and after hashing
+// the source when only the time changed. Times from the last couple of
+// seconds aren't trusted, since a file written again that soon can keep it.
+namespace ScriptCache {
+static constexpr const char* cacheDirectory = ".luacache";
+
+// Like luaL_loadfile, pushing the chunk or an error message and returning the
+// status
+int loadFile(lua_State* L, const std::string& fileName);
+
+// Replaces the state's Lua file searcher with one that loads through the
+// cache and remembers which module came from which file
+void install(sol::state& state);
+
+// Runs the module loaded from fileName again and replaces its entry in
+// package.loaded. Returns false if no module was loaded from it.
+bool reload(std::string_view fileName);
+sol::object getFileName(std::string_view moduleName, sol::this_state s);
+sol::table getStats(sol::this_state s);
+// Deletes every entry
+void clear();
+};  // namespace ScriptCache
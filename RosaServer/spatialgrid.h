@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "structs.h"
+
+// Uniform grid over the XZ plane holding a bounding box for each object, used
+// to cull candidates before running exact engine intersection routines.
+//
+// Cells are hashed into a fixed number of buckets so the grid covers the whole
+// map without being sized to it. Hash collisions and objects spanning several
+// cells only produce extra candidates, which the box tests filter out.
+template <size_t N>
+class SpatialGrid {
+	static constexpr float cellSize = 16.f;
+	static constexpr int bucketBits = 12;
+	static constexpr int bucketCount = 1 << bucketBits;
+
+	struct Box {
+		Vector min;
+		Vector max;
+	};
+
+	Box boxes[N];
+	int objects[N];
+	int numObjects = 0;
+
+	int bucketStart[bucketCount + 1] = {};
+	std::vector<int> entries;
+
+	uint32_t stamps[N] = {};
+	uint32_t stamp = 0;
+
+	bool built = false;
+	uint32_t builtVersion = 0;
+
+	static int cellOf(float coordinate) {
+		float cell = std::floor(coordinate / cellSize);
+		if (cell < INT_MIN / 2) return INT_MIN / 2;
+		if (cell > INT_MAX / 2) return INT_MAX / 2;
+		return (int)cell;
+	}
+
+	static int bucketOf(int cellX, int cellZ) {
+		uint32_t hash = (uint32_t)cellX * 73856093u ^ (uint32_t)cellZ * 19349663u;
+		return hash & (bucketCount - 1);
+	}
+
+	template <typename Func>
+	void forEachCell(const Box& box, Func&& func) const {
+		int minX = cellOf(box.min.x);
+		int maxX = cellOf(box.max.x);
+		int minZ = cellOf(box.min.z);
+		int maxZ = cellOf(box.max.z);
+		for (int x = minX; x <= maxX; x++) {
+			for (int z = minZ; z <= maxZ; z++) {
+				func(bucketOf(x, z));
+			}
+		}
+	}
+
+	static bool overlaps(const Box& a, const Box& b) {
+		return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y &&
+		       a.max.y >= b.min.y && a.min.z <= b.max.z && a.max.z >= b.min.z;
+	}
+
+	static bool clipSlab(float start, float delta, float min, float max,
+	                     float& enter, float& exit) {
+		if (std::fabs(delta) < 1e-9f) {
+			return start >= min && start <= max;
+		}
+
+		float near = (min - start) / delta;
+		float far = (max - start) / delta;
+		if (near > far) std::swap(near, far);
+		if (near > enter) enter = near;
+		if (far < exit) exit = far;
+		return enter <= exit;
+	}
+
+	static bool segmentHits(const Vector& a, const Vector& b, const Box& box,
+	                        float margin) {
+		float enter = 0.f;
+		float exit = 1.f;
+		return clipSlab(a.x, b.x - a.x, box.min.x - margin, box.max.x + margin,
+		                enter, exit) &&
+		       clipSlab(a.y, b.y - a.y, box.min.y - margin, box.max.y + margin,
+		                enter, exit) &&
+		       clipSlab(a.z, b.z - a.z, box.min.z - margin, box.max.z + margin,
+		                enter, exit);
+	}
+
+	static long long cellSpan(const Box& box) {
+		return ((long long)cellOf(box.max.x) - cellOf(box.min.x) + 1) *
+		       ((long long)cellOf(box.max.z) - cellOf(box.min.z) + 1);
+	}
+
+	void nextStamp() {
+		if (++stamp == 0) {
+			for (size_t i = 0; i < N; i++) {
+				stamps[i] = 0;
+			}
+			stamp = 1;
+		}
+	}
+
+	template <typename Func>
+	void visitBucket(int bucket, Func&& func) {
+		for (int e = bucketStart[bucket]; e < bucketStart[bucket + 1]; e++) {
+			int index = entries[e];
+			if (stamps[index] != stamp) {
+				stamps[index] = stamp;
+				func(index);
+			}
+		}
+	}
+
+ public:
+	// Starts a rebuild, discarding every object added so far
+	void clear() {
+		numObjects = 0;
+		built = false;
+	}
+
+	void add(int index, const Vector& pos, float radius) {
+		boxes[index] = {{pos.x - radius, pos.y - radius, pos.z - radius},
+		                {pos.x + radius, pos.y + radius, pos.z + radius}};
+		objects[numObjects++] = index;
+	}
+
+	// Sorts the added objects into buckets. Version is stored so callers can
+	// tell when objects have been created since.
+	void build(uint32_t version) {
+		for (int i = 0; i <= bucketCount; i++) {
+			bucketStart[i] = 0;
+		}
+
+		for (int i = 0; i < numObjects; i++) {
+			forEachCell(boxes[objects[i]],
+			            [this](int bucket) { bucketStart[bucket + 1]++; });
+		}
+
+		for (int i = 0; i < bucketCount; i++) {
+			bucketStart[i + 1] += bucketStart[i];
+		}
+
+		entries.resize(bucketStart[bucketCount]);
+
+		std::vector<int> cursor(bucketStart, bucketStart + bucketCount);
+		for (int i = 0; i < numObjects; i++) {
+			int index = objects[i];
+			forEachCell(boxes[index], [this, &cursor, index](int bucket) {
+				entries[cursor[bucket]++] = index;
+			});
+		}
+
+		built = true;
+		builtVersion = version;
+	}
+
+	bool isBuilt(uint32_t version) const {
+		return built && builtVersion == version;
+	}
+
+	// Calls func once for every object whose box overlaps [min, max]
+	template <typename Func>
+	void queryBox(const Vector& min, const Vector& max, Func&& func) {
+		Box query = {min, max};
+		nextStamp();
+
+		if (cellSpan(query) > bucketCount) {
+			for (int i = 0; i < numObjects; i++) {
+				if (overlaps(boxes[objects[i]], query)) func(objects[i]);
+			}
+			return;
+		}
+
+		forEachCell(query, [this, &query, &func](int bucket) {
+			visitBucket(bucket, [this, &query, &func](int index) {
+				if (overlaps(boxes[index], query)) func(index);
+			});
+		});
+	}
+
+	// Calls func once for every object whose box, grown by margin, is crossed
+	// by the segment from a to b
+	template <typename Func>
+	void queryRay(const Vector& a, const Vector& b, float margin, Func&& func) {
+		auto test = [this, &a, &b, margin, &func](int index) {
+			if (segmentHits(a, b, boxes[index], margin)) func(index);
+		};
+
+		Box bounds = {{std::min(a.x, b.x) - margin, std::min(a.y, b.y) - margin,
+		               std::min(a.z, b.z) - margin},
+		              {std::max(a.x, b.x) + margin, std::max(a.y, b.y) + margin,
+		               std::max(a.z, b.z) + margin}};
+
+		int startX = cellOf(a.x);
+		int startZ = cellOf(a.z);
+		int endX = cellOf(b.x);
+		int endZ = cellOf(b.z);
+		long long steps = std::llabs((long long)endX - startX) +
+		                  std::llabs((long long)endZ - startZ);
+
+		nextStamp();
+
+		// A margin reaches into cells the segment itself doesn't cross, so those
+		// rays fall back to the cells under their bounds
+		if (margin > 0.f || steps >= bucketCount) {
+			if (cellSpan(bounds) > bucketCount) {
+				for (int i = 0; i < numObjects; i++) {
+					test(objects[i]);
+				}
+			} else {
+				forEachCell(bounds, [this, &test](int bucket) {
+					visitBucket(bucket, test);
+				});
+			}
+			return;
+		}
+
+		// Walk the cells crossed by the segment in order
+		float deltaX = b.x - a.x;
+		float deltaZ = b.z - a.z;
+		int stepX = deltaX > 0 ? 1 : -1;
+		int stepZ = deltaZ > 0 ? 1 : -1;
+		float infinity = std::numeric_limits<float>::infinity();
+		float tDeltaX = deltaX != 0 ? cellSize / std::fabs(deltaX) : infinity;
+		float tDeltaZ = deltaZ != 0 ? cellSize / std::fabs(deltaZ) : infinity;
+		float tMaxX =
+		    deltaX != 0 ? ((startX + (stepX > 0)) * cellSize - a.x) / deltaX
+		                : infinity;
+		float tMaxZ =
+		    deltaZ != 0 ? ((startZ + (stepZ > 0)) * cellSize - a.z) / deltaZ
+		                : infinity;
+
+		int x = startX;
+		int z = startZ;
+		visitBucket(bucketOf(x, z), test);
+		for (long long i = 0; i < steps; i++) {
+			if (x != endX && (tMaxX < tMaxZ || z == endZ)) {
+				x += stepX;
+				tMaxX += tDeltaX;
+			} else {
+				z += stepZ;
+				tMaxZ += tDeltaZ;
+			}
+			visitBucket(bucketOf(x, z), test);
+		}
+	}
+};
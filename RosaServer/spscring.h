@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. Values are moved in and out, and a full ring refuses new values
+// instead of overwriting old ones.
+template <typename T, size_t Capacity>
+class SPSCRing {
+	static_assert((Capacity & (Capacity - 1)) == 0,
+	              "Capacity must be a power of two");
+	static constexpr size_t mask = Capacity - 1;
+
+	T slots[Capacity];
+
+	// Kept on separate cache lines so the two threads don't contend on them
+	alignas(64) std::atomic<size_t> head = 0;
+	alignas(64) std::atomic<size_t> tail = 0;
+
+ public:
+	// Producer only
+	bool push(T&& value) {
+		size_t currentTail = tail.load(std::memory_order_relaxed);
+		if (currentTail - head.load(std::memory_order_acquire) == Capacity) {
+			return false;
+		}
+
+		slots[currentTail & mask] = std::move(value);
+		tail.store(currentTail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only
+	bool pop(T& value) {
+		size_t currentHead = head.load(std::memory_order_relaxed);
+		if (currentHead == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		value = std::move(slots[currentHead & mask]);
+		head.store(currentHead + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const {
+		return head.load(std::memory_order_acquire) ==
+		       tail.load(std::memory_order_acquire);
+	}
+};
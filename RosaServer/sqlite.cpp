@@ -1,6 +1,22 @@
 #include "sqlite.h"
 
-SQLite::SQLite(const char* fileName) {
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <queue>
+
+static constexpr const char* errorOutOfRange = "Column out of range";
+static constexpr const char* errorNotOnRow = "No current row";
+static constexpr const char* errorNotRows = "Expected SQLiteRows";
+static constexpr const char* errorNoWriter = "Writer hasn't been started";
+static constexpr const char* errorWriterMemory =
+    "In-memory databases can't have a writer";
+static constexpr const char* errorTransactionEnded =
+    "Batch transaction ended early";
+static constexpr int busyTimeoutMs = 5000;
+
+SQLite::SQLite(const char* fileName) : fileName(fileName) {
 	int res = sqlite3_open(fileName, &handle);
 	if (res != SQLITE_OK || handle == nullptr) {
 		close();
@@ -11,12 +27,149 @@ SQLite::SQLite(const char* fileName) {
 SQLite::~SQLite() { close(); }
 
 void SQLite::close() {
+	writer.reset();
+
+	for (auto& [sql, statement] : cachedStatements) {
+		sqlite3_finalize(statement);
+	}
+	cachedStatements.clear();
+	cachedStatementBySQL.clear();
+
 	if (handle) {
-		sqlite3_close(handle);
+		// Defers closing until any open row iterators are finalized
+		sqlite3_close_v2(handle);
 		handle = nullptr;
 	}
 }
 
+// Statements are kept prepared between queries, and reset after each use
+int SQLite::prepare(const char* sql, sqlite3_stmt*& statement) {
+	if (!handle) {
+		return SQLITE_ERROR;
+	}
+
+	const auto search = cachedStatementBySQL.find(sql);
+	if (search != cachedStatementBySQL.end()) {
+		cachedStatements.splice(cachedStatements.begin(), cachedStatements,
+		                        search->second);
+		statement = search->second->second;
+		return SQLITE_OK;
+	}
+
+	int res = sqlite3_prepare_v2(handle, sql, -1, &statement, nullptr);
+	if (res != SQLITE_OK) {
+		return res;
+	}
+
+	// Blank SQL prepares to no statement at all
+	if (!statement) {
+		return SQLITE_MISUSE;
+	}
+
+	cachedStatements.emplace_front(sql, statement);
+	cachedStatementBySQL[cachedStatements.front().first] =
+	    cachedStatements.begin();
+
+	if (cachedStatements.size() > maxCachedStatements) {
+		auto& [oldestSQL, oldestStatement] = cachedStatements.back();
+		sqlite3_finalize(oldestStatement);
+		cachedStatementBySQL.erase(oldestSQL);
+		cachedStatements.pop_back();
+	}
+
+	return SQLITE_OK;
+}
+
+// Integral numbers bind as integers so they match INTEGER columns exactly,
+// including rowid lookups
+static inline bool isInteger(double number) {
+	return number == std::floor(number) && std::fabs(number) < 0x1p63;
+}
+
+SQLiteValue toSQLiteValue(const sol::object& value) {
+	switch (value.get_type()) {
+		case sol::type::string:
+			return value.as<std::string>();
+		case sol::type::number: {
+			double number = value.as<double>();
+			if (isInteger(number)) {
+				return (sqlite3_int64)number;
+			}
+			return number;
+		}
+		case sol::type::boolean:
+			return (sqlite3_int64)(value.as<bool>() ? 1 : 0);
+		default:
+			return nullptr;
+	}
+}
+
+static int bindArgument(sqlite3_stmt* statement, int index,
+                        const sol::object& arg,
+                        sqlite3_destructor_type lifetime = SQLITE_STATIC) {
+	switch (arg.get_type()) {
+		case sol::type::nil:
+			return sqlite3_bind_null(statement, index);
+		case sol::type::string: {
+			// Query arguments outlive the statement's use, which ends with a reset
+			auto string = arg.as<std::string_view>();
+			return sqlite3_bind_text(statement, index, string.data(),
+			                         string.length(), lifetime);
+		}
+		case sol::type::number: {
+			double number = arg.as<double>();
+			if (isInteger(number)) {
+				return sqlite3_bind_int64(statement, index, (sqlite3_int64)number);
+			}
+			return sqlite3_bind_double(statement, index, number);
+		}
+		case sol::type::boolean:
+			return sqlite3_bind_int(statement, index, arg.as<bool>() ? 1 : 0);
+		default:
+			return SQLITE_OK;
+	}
+}
+
+static int bindValue(sqlite3_stmt* statement, int index,
+                     const SQLiteValue& value) {
+	if (auto integer = std::get_if<sqlite3_int64>(&value)) {
+		return sqlite3_bind_int64(statement, index, *integer);
+	}
+	if (auto number = std::get_if<double>(&value)) {
+		return sqlite3_bind_double(statement, index, *number);
+	}
+	if (auto string = std::get_if<std::string>(&value)) {
+		return sqlite3_bind_text(statement, index, string->data(),
+		                         string->length(), SQLITE_STATIC);
+	}
+	return sqlite3_bind_null(statement, index);
+}
+
+static void pushColumn(lua_State* L, sqlite3_stmt* statement, int column) {
+	switch (sqlite3_column_type(statement, column)) {
+		case SQLITE_INTEGER:
+			lua_pushnumber(L, (lua_Number)sqlite3_column_int64(statement, column));
+			break;
+		case SQLITE_FLOAT:
+			lua_pushnumber(L, sqlite3_column_double(statement, column));
+			break;
+		case SQLITE_BLOB:
+		case SQLITE_TEXT: {
+			auto data = sqlite3_column_blob(statement, column);
+			if (data) {
+				auto size = sqlite3_column_bytes(statement, column);
+				lua_pushlstring(L, reinterpret_cast<const char*>(data), size);
+			} else {
+				lua_pushliteral(L, "");
+			}
+			break;
+		}
+		default:
+			lua_pushnil(L);
+			break;
+	}
+}
+
 std::tuple<sol::object, sol::object> SQLite::query(const char* sql,
                                                    sol::variadic_args arguments,
                                                    sol::this_state s) {
@@ -24,11 +177,7 @@ std::tuple<sol::object, sol::object> SQLite::query(const char* sql,
 	sqlite3_stmt* statement;
 
 	{
-		int res = SQLITE_ERROR;
-		if (handle) {
-			res = sqlite3_prepare_v2(handle, sql, -1, &statement, nullptr);
-		}
-
+		int res = prepare(sql, statement);
 		if (res != SQLITE_OK) {
 			return std::make_tuple(
 			    sol::make_object(lua, sol::nil),
@@ -37,36 +186,22 @@ std::tuple<sol::object, sol::object> SQLite::query(const char* sql,
 		}
 	}
 
+	auto fail = [&]() {
+		auto result =
+		    std::make_tuple(sol::make_object(lua, sol::nil),
+		                    sol::make_object(lua, sqlite3_errmsg(handle)));
+		sqlite3_reset(statement);
+		sqlite3_clear_bindings(statement);
+		return result;
+	};
+
 	int index = 0;
 
 	for (sol::object arg : arguments) {
 		index++;
 
-		int res;
-		switch (arg.get_type()) {
-			case sol::type::nil:
-				res = sqlite3_bind_null(statement, index);
-				break;
-			case sol::type::string: {
-				auto string = arg.as<std::string>();
-				res = sqlite3_bind_text(statement, index, string.data(),
-				                        string.length(), SQLITE_TRANSIENT);
-			} break;
-			case sol::type::number:
-				res = sqlite3_bind_double(statement, index, arg.as<double>());
-				break;
-			case sol::type::boolean:
-				res = sqlite3_bind_int(statement, index, arg.as<bool>() ? 1 : 0);
-				break;
-			default:
-				res = SQLITE_OK;
-				break;
-		}
-
-		if (res != SQLITE_OK) {
-			sqlite3_finalize(statement);
-			return std::make_tuple(sol::make_object(lua, sol::nil),
-			                       sol::make_object(lua, sqlite3_errmsg(handle)));
+		if (bindArgument(statement, index, arg) != SQLITE_OK) {
+			return fail();
 		}
 	}
 
@@ -76,6 +211,9 @@ std::tuple<sol::object, sol::object> SQLite::query(const char* sql,
 		rows = lua.create_table();
 	}
 
+	lua_State* L = s;
+	int numRows = 0;
+
 	while (true) {
 		int res = sqlite3_step(statement);
 		if (res == SQLITE_DONE) {
@@ -83,41 +221,21 @@ std::tuple<sol::object, sol::object> SQLite::query(const char* sql,
 		}
 
 		if (res != SQLITE_ROW) {
-			sqlite3_finalize(statement);
-			return std::make_tuple(sol::make_object(lua, sol::nil),
-			                       sol::make_object(lua, sqlite3_errmsg(handle)));
+			return fail();
 		}
 
-		sol::table row = lua.create_table(numColumns);
+		rows.push();
+		lua_createtable(L, numColumns, 0);
 		for (int i = 0; i < numColumns; i++) {
-			switch (sqlite3_column_type(statement, i)) {
-				case SQLITE_INTEGER:
-					row.set(i + 1, sqlite3_column_int64(statement, i));
-					break;
-				case SQLITE_FLOAT:
-					row.set(i + 1, sqlite3_column_double(statement, i));
-					break;
-				case SQLITE_BLOB:
-				case SQLITE_TEXT: {
-					auto data = sqlite3_column_blob(statement, i);
-					if (data) {
-						auto size = sqlite3_column_bytes(statement, i);
-						std::string blob(reinterpret_cast<const char*>(data), size);
-						row.set(i + 1, blob);
-					} else {
-						row.set(i + 1, "");
-					}
-					break;
-				}
-				default:
-					row.set(i + 1, sol::nil);
-					break;
-			}
+			pushColumn(L, statement, i);
+			lua_rawseti(L, -2, i + 1);
 		}
-		rows.add(row);
+		lua_rawseti(L, -2, ++numRows);
+		lua_pop(L, 1);
 	}
 
-	sqlite3_finalize(statement);
+	sqlite3_reset(statement);
+	sqlite3_clear_bindings(statement);
 
 	if (numColumns) {
 		return std::make_tuple(sol::make_object(lua, rows),
@@ -127,3 +245,312 @@ std::tuple<sol::object, sol::object> SQLite::query(const char* sql,
 	return std::make_tuple(sol::make_object(lua, sqlite3_changes(handle)),
 	                       sol::make_object(lua, sol::nil));
 }
+
+std::tuple<sol::object, sol::object> SQLite::rows(const char* sql,
+                                                  sol::variadic_args arguments,
+                                                  sol::this_state s) {
+	sol::state_view lua(s);
+
+	// Not cached, since it stays in use until the iterator is done with it
+	sqlite3_stmt* statement = nullptr;
+	int res = SQLITE_ERROR;
+	if (handle) {
+		res = sqlite3_prepare_v2(handle, sql, -1, &statement, nullptr);
+	}
+
+	if (res != SQLITE_OK || !statement) {
+		return std::make_tuple(
+		    sol::make_object(lua, sol::nil),
+		    sol::make_object(
+		        lua, handle ? sqlite3_errmsg(handle) : sqlite3_errstr(res)));
+	}
+
+	int index = 0;
+
+	for (sol::object arg : arguments) {
+		index++;
+
+		if (bindArgument(statement, index, arg, SQLITE_TRANSIENT) != SQLITE_OK) {
+			auto result =
+			    std::make_tuple(sol::make_object(lua, sol::nil),
+			                    sol::make_object(lua, sqlite3_errmsg(handle)));
+			sqlite3_finalize(statement);
+			return result;
+		}
+	}
+
+	return std::make_tuple(sol::make_object(lua, SQLiteRows(statement)),
+	                       sol::make_object(lua, sol::nil));
+}
+
+SQLiteRows::SQLiteRows(sqlite3_stmt* statement)
+    : statement(statement), numColumns(sqlite3_column_count(statement)) {}
+
+SQLiteRows::SQLiteRows(SQLiteRows&& other)
+    : statement(other.statement),
+      numColumns(other.numColumns),
+      onRow(other.onRow) {
+	other.statement = nullptr;
+	other.onRow = false;
+}
+
+SQLiteRows::~SQLiteRows() { close(); }
+
+void SQLiteRows::close() {
+	if (statement) {
+		sqlite3_finalize(statement);
+		statement = nullptr;
+	}
+	onRow = false;
+}
+
+int SQLiteRows::getColumnCount() const { return numColumns; }
+
+std::string SQLiteRows::getColumnName(int column) const {
+	if (!statement || column < 1 || column > numColumns) {
+		throw std::invalid_argument(errorOutOfRange);
+	}
+	return sqlite3_column_name(statement, column - 1);
+}
+
+sol::object SQLiteRows::next(sol::this_state s) {
+	sol::state_view lua(s);
+
+	if (!statement) {
+		return sol::make_object(lua, sol::nil);
+	}
+
+	int res = sqlite3_step(statement);
+	if (res == SQLITE_ROW) {
+		onRow = true;
+		// Called as self(), so this is the rows object itself
+		return sol::object(s, 1);
+	}
+
+	std::string error =
+	    res == SQLITE_DONE ? "" : sqlite3_errmsg(sqlite3_db_handle(statement));
+	close();
+	if (!error.empty()) {
+		throw std::runtime_error(error);
+	}
+	return sol::make_object(lua, sol::nil);
+}
+
+// The raw functions get no type checking from sol, so self is checked here
+static SQLiteRows* checkRows(lua_State* L) {
+	auto rows = sol::stack::check_get<SQLiteRows*>(L, 1);
+	if (!rows || !*rows) {
+		luaL_argerror(L, 1, errorNotRows);
+		return nullptr;
+	}
+	return *rows;
+}
+
+int SQLiteRows::get(lua_State* L) {
+	auto& rows = *checkRows(L);
+	int column = luaL_checkinteger(L, 2);
+	if (!rows.onRow || column < 1 || column > rows.numColumns) {
+		return luaL_argerror(L, 2, errorOutOfRange);
+	}
+
+	pushColumn(L, rows.statement, column - 1);
+	return 1;
+}
+
+int SQLiteRows::toTable(lua_State* L) {
+	auto& rows = *checkRows(L);
+	if (!rows.onRow) {
+		return luaL_error(L, errorNotOnRow);
+	}
+
+	lua_createtable(L, rows.numColumns, 0);
+	for (int i = 0; i < rows.numColumns; i++) {
+		pushColumn(L, rows.statement, i);
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
+}
+
+void SQLite::startWriter(int intervalMs, int maxBatch) {
+	if (!handle) {
+		throw std::runtime_error(sqlite3_errstr(SQLITE_MISUSE));
+	}
+	if (fileName.empty() || fileName == ":memory:") {
+		throw std::invalid_argument(errorWriterMemory);
+	}
+	if (writer) {
+		return;
+	}
+
+	int res = sqlite3_exec(handle, "PRAGMA journal_mode=WAL;", nullptr, nullptr,
+	                       nullptr);
+	if (res != SQLITE_OK) {
+		throw std::runtime_error(sqlite3_errmsg(handle));
+	}
+
+	// Reads on this connection can run alongside the writer's transactions in
+	// WAL mode, but writes made here may still have to wait for them
+	sqlite3_busy_timeout(handle, busyTimeoutMs);
+
+	writer = std::make_unique<SQLiteWriter>(fileName.c_str(), intervalMs,
+	                                        maxBatch);
+}
+
+bool SQLite::hasWriter() const { return (bool)writer; }
+
+void SQLite::queueWrite(SQLiteWrite&& write) {
+	if (!writer) {
+		throw std::runtime_error(errorNoWriter);
+	}
+	writer->push(std::move(write));
+}
+
+static std::mutex writeResultQueueMutex;
+static std::queue<SQLiteWriteResult> writeResultQueue;
+
+SQLiteWriter::SQLiteWriter(const char* fileName, int intervalMs, int maxBatch)
+    : connection(fileName),
+      intervalMs(std::max(0, intervalMs)),
+      maxBatch(std::max(1, maxBatch)) {
+	sqlite3_busy_timeout(connection.handle, busyTimeoutMs);
+	thread = std::thread(&SQLiteWriter::run, this);
+}
+
+SQLiteWriter::~SQLiteWriter() {
+	{
+		std::lock_guard<std::mutex> guard(queueMutex);
+		stopping = true;
+	}
+	queueCondition.notify_one();
+	thread.join();
+}
+
+void SQLiteWriter::push(SQLiteWrite&& write) {
+	bool notify;
+	{
+		std::lock_guard<std::mutex> guard(queueMutex);
+		queue.push_back(std::move(write));
+		notify = queue.size() == 1 || queue.size() >= maxBatch;
+	}
+	if (notify) {
+		queueCondition.notify_one();
+	}
+}
+
+SQLiteWriteResult SQLiteWriter::perform(const SQLiteWrite& write) {
+	SQLiteWriteResult result{write.id, false, 0};
+
+	sqlite3_stmt* statement;
+	int res = connection.prepare(write.sql.c_str(), statement);
+	if (res != SQLITE_OK) {
+		result.error = sqlite3_errmsg(connection.handle);
+		return result;
+	}
+
+	for (size_t i = 0; i < write.arguments.size(); i++) {
+		if (bindValue(statement, i + 1, write.arguments[i]) != SQLITE_OK) {
+			result.error = sqlite3_errmsg(connection.handle);
+			sqlite3_reset(statement);
+			sqlite3_clear_bindings(statement);
+			return result;
+		}
+	}
+
+	while ((res = sqlite3_step(statement)) == SQLITE_ROW)
+		;
+
+	if (res == SQLITE_DONE) {
+		result.success = true;
+		result.changes = sqlite3_changes(connection.handle);
+	} else {
+		result.error = sqlite3_errmsg(connection.handle);
+	}
+
+	sqlite3_reset(statement);
+	sqlite3_clear_bindings(statement);
+	return result;
+}
+
+void SQLiteWriter::run() {
+	std::vector<SQLiteWrite> batch;
+	std::vector<SQLiteWriteResult> results;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this] { return stopping || !queue.empty(); });
+
+			// Give more writes a chance to join the transaction
+			queueCondition.wait_for(
+			    lock, std::chrono::milliseconds(intervalMs),
+			    [this] { return stopping || queue.size() >= maxBatch; });
+
+			if (queue.empty() && stopping) {
+				break;
+			}
+
+			size_t count = std::min(queue.size(), maxBatch);
+			std::move(queue.begin(), queue.begin() + count,
+			          std::back_inserter(batch));
+			queue.erase(queue.begin(), queue.begin() + count);
+		}
+
+		bool inTransaction = sqlite3_exec(connection.handle, "BEGIN;", nullptr,
+		                                  nullptr, nullptr) == SQLITE_OK;
+
+		// Some errors make SQLite roll the transaction back on its own, undoing
+		// every write before them, and the rest would run outside it
+		bool rolledBack = false;
+		std::string error;
+		for (const auto& write : batch) {
+			if (rolledBack) {
+				results.push_back({write.id, false, 0, error});
+				continue;
+			}
+
+			results.push_back(perform(write));
+			if (inTransaction && sqlite3_get_autocommit(connection.handle)) {
+				rolledBack = true;
+				error = results.back().error.empty() ? errorTransactionEnded
+				                                     : results.back().error;
+			}
+		}
+
+		if (!rolledBack && inTransaction &&
+		    sqlite3_exec(connection.handle, "COMMIT;", nullptr, nullptr,
+		                 nullptr) != SQLITE_OK) {
+			rolledBack = true;
+			error = sqlite3_errmsg(connection.handle);
+			if (!sqlite3_get_autocommit(connection.handle)) {
+				sqlite3_exec(connection.handle, "ROLLBACK;", nullptr, nullptr,
+				             nullptr);
+			}
+		}
+
+		if (rolledBack) {
+			for (auto& result : results) {
+				result.success = false;
+				result.error = error;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(writeResultQueueMutex);
+			for (auto& result : results) {
+				writeResultQueue.push(std::move(result));
+			}
+		}
+
+		batch.clear();
+		results.clear();
+	}
+}
+
+bool SQLiteWriter::popResult(SQLiteWriteResult& result) {
+	std::lock_guard<std::mutex> guard(writeResultQueueMutex);
+	if (writeResultQueue.empty()) return false;
+
+	result = std::move(writeResultQueue.front());
+	writeResultQueue.pop();
+	return true;
+}
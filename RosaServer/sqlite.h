@@ -1,11 +1,77 @@
 #pragma once
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <tuple>
+#include <unordered_map>
+#include <variant>
+#include <vector>
 
 #include "sol/sol.hpp"
 #include "sqlite3.h"
 
+using SQLiteValue =
+    std::variant<std::nullptr_t, sqlite3_int64, double, std::string>;
+
+// Converts the way query binds arguments
+SQLiteValue toSQLiteValue(const sol::object& value);
+
+struct SQLiteWrite {
+	unsigned int id;
+	std::string sql;
+	std::vector<SQLiteValue> arguments;
+};
+
+struct SQLiteWriteResult {
+	unsigned int id;
+	bool success;
+	int changes;
+	std::string error;
+};
+
+class SQLiteWriter;
+
+// Steps a statement one row at a time. Used directly as the iterator of a
+// generic for loop, which gets the same object back for every row; columns
+// are read from it while it's on that row.
+class SQLiteRows {
+	sqlite3_stmt* statement;
+	int numColumns;
+	bool onRow = false;
+
+ public:
+	SQLiteRows(sqlite3_stmt* statement);
+	SQLiteRows(SQLiteRows&& other);
+	SQLiteRows(const SQLiteRows&) = delete;
+	~SQLiteRows();
+	// Finalizes the statement, which also happens after the last row
+	void close();
+	int getColumnCount() const;
+	std::string getColumnName(int column) const;
+	sol::object next(sol::this_state s);
+	static int get(lua_State* L);
+	static int toTable(lua_State* L);
+};
+
 class SQLite {
+	static constexpr size_t maxCachedStatements = 32;
+
+	std::string fileName;
 	sqlite3* handle;
+	// Most recently used first. The map's keys point into the list's strings.
+	std::list<std::pair<std::string, sqlite3_stmt*>> cachedStatements;
+	std::unordered_map<std::string_view, decltype(cachedStatements)::iterator>
+	    cachedStatementBySQL;
+	std::unique_ptr<SQLiteWriter> writer;
+
+	int prepare(const char* sql, sqlite3_stmt*& statement);
+
+	friend class SQLiteWriter;
 
  public:
 	SQLite(const char* fileName);
@@ -14,4 +80,37 @@ class SQLite {
 	std::tuple<sol::object, sol::object> query(const char* sql,
 	                                           sol::variadic_args arguments,
 	                                           sol::this_state s);
+	std::tuple<sol::object, sol::object> rows(const char* sql,
+	                                          sol::variadic_args arguments,
+	                                          sol::this_state s);
+	// Switches to WAL and starts a writer thread with its own connection.
+	// Queued writes are committed together once maxBatch are waiting, or
+	// intervalMs after the first of them was queued.
+	void startWriter(int intervalMs, int maxBatch);
+	bool hasWriter() const;
+	void queueWrite(SQLiteWrite&& write);
+};
+
+class SQLiteWriter {
+	SQLite connection;
+	int intervalMs;
+	size_t maxBatch;
+
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::deque<SQLiteWrite> queue;
+	bool stopping = false;
+
+	std::thread thread;
+
+	void run();
+	SQLiteWriteResult perform(const SQLiteWrite& write);
+
+ public:
+	SQLiteWriter(const char* fileName, int intervalMs, int maxBatch);
+	// Commits everything still queued before returning
+	~SQLiteWriter();
+	void push(SQLiteWrite&& write);
+	// Finished writes from every writer, for the main thread
+	static bool popResult(SQLiteWriteResult& result);
 };
@@ -12,71 +12,8 @@
 #include <cstring>
 #include <stdexcept>
 
-static constexpr const char* errorNotOpen = "Socket is not open";
-
-static inline void throwSafe() {
-	char error[256];
-	throw std::runtime_error(strerror_r(errno, error, sizeof(error)));
-}
-
-ssize_t TCPClient::send(std::string_view data) const {
-	if (socketDescriptor == -1) {
-		throw std::runtime_error(errorNotOpen);
-	}
-
-	if (data.empty()) {
-		throw std::runtime_error("Data is empty");
-	}
-
-	auto bytesWritten = write(socketDescriptor, data.data(), data.size());
-	if (bytesWritten == -1) {
-		if (errno == EAGAIN || errno == EWOULDBLOCK) {
-			return 0;
-		}
-		throwSafe();
-	}
-
-	return bytesWritten;
-}
-
-sol::object TCPClient::receive(size_t size, sol::this_state s) {
-	// Console::log("TCPClient::receive\n");
-	if (socketDescriptor == -1) {
-		throw std::runtime_error(errorNotOpen);
-	}
-
-	sol::state_view lua(s);
-
-	constexpr auto maxToRecv = sizeof(receiveBuffer);
-	std::ostringstream stream;
-
-	stream << "maxToRecv: " << maxToRecv << ", size: " << size << '\n';
-	// Console::log(stream.str());
-
-	auto bytesRead =
-	    read(socketDescriptor, receiveBuffer, std::min(size, maxToRecv));
-
-	stream.clear();
-	stream << "bytesRead: " << bytesRead << '\n';
-	// Console::log(stream.str());
-	stream.clear();
-
-	if (bytesRead == -1) {
-		if (errno == EAGAIN || errno == EWOULDBLOCK) {
-			return sol::make_object(lua, sol::nil);
-		}
-		throwSafe();
-	}
-
-	if (bytesRead == 0) {
-		close();
-	}
-
-	std::string data(receiveBuffer, bytesRead);
-	return sol::make_object(lua, data);
-}
-
-TCPClient::TCPClient(std::string_view address, std::string_view port) {
+TCPClient::TCPClient(std::string_view address, std::string_view port)
+    : TCPSocket(-1) {
 	addrinfo hintInfo{};
 	hintInfo.ai_family = AF_UNSPEC;
 	hintInfo.ai_socktype = SOCK_STREAM;
@@ -108,21 +45,9 @@ TCPClient::TCPClient(std::string_view address, std::string_view port) {
 		::close(socketDescriptor);
 	}
 
-	if (addrIter == nullptr) throw std::runtime_error("Failed to connect!");
-	freeaddrinfo(resultAddress);
-}
-
-void TCPClient::close() {
-	if (socketDescriptor == -1) {
-		throw std::runtime_error(errorNotOpen);
-	}
-
-	::close(socketDescriptor);
-	socketDescriptor = -1;
-}
-
-TCPClient::~TCPClient() {
-	if (socketDescriptor != -1) {
-		close();
+	if (addrIter == nullptr) {
+		socketDescriptor = -1;
+		throw std::runtime_error("Failed to connect!");
 	}
+	freeaddrinfo(resultAddress);
 }
@@ -2,6 +2,7 @@
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -15,66 +16,6 @@ static inline void throwSafe() {
 	throw std::runtime_error(strerror_r(errno, error, sizeof(error)));
 }
 
-void TCPServerConnection::close() {
-	if (socketDescriptor == -1) {
-		throw std::runtime_error(errorNotOpen);
-	}
-
-	::close(socketDescriptor);
-	socketDescriptor = -1;
-}
-
-TCPServerConnection::~TCPServerConnection() {
-	if (socketDescriptor != -1) {
-		close();
-	}
-}
-
-ssize_t TCPServerConnection::send(std::string_view data) const {
-	if (socketDescriptor == -1) {
-		throw std::runtime_error(errorNotOpen);
-	}
-
-	if (data.empty()) {
-		throw std::runtime_error("Data is empty");
-	}
-
-	auto bytesWritten = write(socketDescriptor, data.data(), data.size());
-	if (bytesWritten == -1) {
-		if (errno == EAGAIN || errno == EWOULDBLOCK) {
-			return 0;
-		}
-		throwSafe();
-	}
-
-	return bytesWritten;
-}
-
-sol::object TCPServerConnection::receive(size_t size, sol::this_state s) {
-	if (socketDescriptor == -1) {
-		throw std::runtime_error(errorNotOpen);
-	}
-
-	sol::state_view lua(s);
-
-	constexpr auto maxToRecv = sizeof(receiveBuffer);
-	auto bytesRead =
-	    read(socketDescriptor, receiveBuffer, std::min(size, maxToRecv));
-	if (bytesRead == -1) {
-		if (errno == EAGAIN || errno == EWOULDBLOCK) {
-			return sol::make_object(lua, sol::nil);
-		}
-		throwSafe();
-	}
-
-	if (bytesRead == 0) {
-		close();
-	}
-
-	std::string data(receiveBuffer, bytesRead);
-	return sol::make_object(lua, data);
-}
-
 TCPServer::TCPServer(unsigned short port) {
 	socketDescriptor = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
 	if (socketDescriptor == -1) {
@@ -102,6 +43,20 @@ TCPServer::TCPServer(unsigned short port) {
 	if (listen(socketDescriptor, listenBacklog) == -1) {
 		throwSafe();
 	}
+
+	epollDescriptor = epoll_create1(EPOLL_CLOEXEC);
+	if (epollDescriptor == -1) {
+		throwSafe();
+	}
+
+	// The listening socket is the only one registered without a pointer
+	epoll_event event{};
+	event.events = EPOLLIN;
+	event.data.ptr = nullptr;
+	if (epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, socketDescriptor, &event) ==
+	    -1) {
+		throwSafe();
+	}
 }
 
 void TCPServer::closeConnections() {
@@ -111,12 +66,14 @@ void TCPServer::closeConnections() {
 		}
 	}
 	connections.clear();
+	withInput.clear();
 }
 
 void TCPServer::clearClosedConnections() {
 	auto it = connections.begin();
 	while (it != connections.end()) {
 		if ((*it)->socketDescriptor == -1) {
+			withInput.erase(it->get());
 			it = connections.erase(it);
 		} else {
 			++it;
@@ -133,6 +90,9 @@ void TCPServer::close() {
 
 	::close(socketDescriptor);
 	socketDescriptor = -1;
+
+	::close(epollDescriptor);
+	epollDescriptor = -1;
 }
 
 TCPServer::~TCPServer() {
@@ -141,13 +101,7 @@ TCPServer::~TCPServer() {
 	}
 }
 
-sol::object TCPServer::accept(sol::this_state s) {
-	if (socketDescriptor == -1) {
-		throw std::runtime_error(errorNotOpen);
-	}
-
-	sol::state_view lua(s);
-
+std::shared_ptr<TCPServerConnection> TCPServer::acceptConnection() {
 	sockaddr_in address;
 	socklen_t addressLength = sizeof(address);
 
@@ -156,7 +110,7 @@ sol::object TCPServer::accept(sol::this_state s) {
 	            &addressLength, SOCK_NONBLOCK);
 	if (clientDescriptor == -1) {
 		if (errno == EAGAIN || errno == EWOULDBLOCK) {
-			return sol::make_object(lua, sol::nil);
+			return nullptr;
 		}
 		throwSafe();
 	}
@@ -167,7 +121,104 @@ sol::object TCPServer::accept(sol::this_state s) {
 	auto connection = std::make_shared<TCPServerConnection>(
 	    clientDescriptor, ntohs(address.sin_port), std::string(addressString));
 
-	clearClosedConnections();
+	// Connections stay in the list until closed, so the pointer outlives any
+	// event for it. Closing the socket also unregisters it.
+	epoll_event event{};
+	event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	event.data.ptr = connection.get();
+	if (epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, clientDescriptor, &event) ==
+	    -1) {
+		throwSafe();
+	}
+
 	connections.push_back(connection);
+	return connection;
+}
+
+sol::object TCPServer::accept(sol::this_state s) {
+	if (socketDescriptor == -1) {
+		throw std::runtime_error(errorNotOpen);
+	}
+
+	sol::state_view lua(s);
+
+	clearClosedConnections();
+	auto connection = acceptConnection();
+	if (!connection) {
+		return sol::make_object(lua, sol::nil);
+	}
+
 	return sol::make_object(lua, connection);
 }
+
+std::tuple<sol::table, sol::table> TCPServer::poll(
+    sol::optional<int> timeoutMs, sol::this_state s) {
+	if (socketDescriptor == -1) {
+		throw std::runtime_error(errorNotOpen);
+	}
+
+	sol::state_view lua(s);
+	clearClosedConnections();
+
+	epoll_event events[maxPollEvents];
+	int numEvents =
+	    epoll_wait(epollDescriptor, events, maxPollEvents, timeoutMs.value_or(0));
+	if (numEvents == -1) {
+		if (errno != EINTR) {
+			throwSafe();
+		}
+		numEvents = 0;
+	}
+
+	auto readable = lua.create_table();
+	auto accepted = lua.create_table();
+	bool canAccept = false;
+
+	std::unordered_set<TCPServerConnection*> candidates;
+	candidates.swap(withInput);
+
+	for (int i = 0; i < numEvents; i++) {
+		auto connection = static_cast<TCPServerConnection*>(events[i].data.ptr);
+		if (!connection) {
+			canAccept = true;
+			continue;
+		}
+
+		if (connection->socketDescriptor == -1) {
+			continue;
+		}
+
+		if (events[i].events & EPOLLOUT) {
+			connection->flushQueue();
+		}
+
+		if (events[i].events & ~EPOLLOUT) {
+			connection->readAvailable();
+			candidates.insert(connection);
+		}
+	}
+
+	for (auto connection : candidates) {
+		if (connection->socketDescriptor == -1) {
+			continue;
+		}
+
+		// Reading stopped at maxBufferedSize last time
+		if (connection->moreToRead) {
+			connection->readAvailable();
+		}
+
+		if (!connection->receiveBuffer.empty() || connection->peerClosed) {
+			readable.add(connection->shared_from_this());
+			withInput.insert(connection);
+		}
+	}
+
+	if (canAccept) {
+		while (auto connection = acceptConnection()) {
+			accepted.add(connection);
+		}
+	}
+
+	return std::make_tuple(readable, accepted);
+}
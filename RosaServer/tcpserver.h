@@ -2,29 +2,26 @@
 
 #include <memory>
 #include <string>
+#include <tuple>
+#include <unordered_set>
 #include <vector>
 
 #include "sol/sol.hpp"
+#include "tcpsocket.h"
 
 static constexpr int listenBacklog = 128;
-static constexpr size_t maxServerReadSize = 16384;
+static constexpr int maxPollEvents = 64;
 
-class TCPServerConnection {
-	int socketDescriptor;
+class TCPServerConnection
+    : public TCPSocket,
+      public std::enable_shared_from_this<TCPServerConnection> {
 	uint16_t port;
 	std::string address;
-	char receiveBuffer[maxServerReadSize];
 
  public:
 	TCPServerConnection(int socketDescriptor, uint16_t port, std::string address)
-	    : socketDescriptor(socketDescriptor), port(port), address(address) {}
-	~TCPServerConnection();
-
-	void close();
-	ssize_t send(std::string_view data) const;
-	sol::object receive(size_t size, sol::this_state state);
+	    : TCPSocket(socketDescriptor), port(port), address(address) {}
 
-	bool isOpen() const { return socketDescriptor != -1; }
 	uint16_t getPort() const { return port; }
 	std::string getAddress() const { return address; }
 
@@ -33,10 +30,15 @@ class TCPServerConnection {
 
 class TCPServer {
 	int socketDescriptor;
+	int epollDescriptor;
 	std::vector<std::shared_ptr<TCPServerConnection>> connections;
+	// Reported by the last poll with input left over. Edge triggered events
+	// only come with new data, so these are checked again on every poll.
+	std::unordered_set<TCPServerConnection*> withInput;
 
 	void closeConnections();
 	void clearClosedConnections();
+	std::shared_ptr<TCPServerConnection> acceptConnection();
 
  public:
 	TCPServer(unsigned short port);
@@ -44,6 +46,12 @@ class TCPServer {
 
 	void close();
 	sol::object accept(sol::this_state s);
+	// Waits up to timeoutMs (default 0) for activity, then returns the
+	// connections with data waiting or closed by the peer, and the ones
+	// accepted.
+	// Connections that became writable again flush their queues.
+	std::tuple<sol::table, sol::table> poll(sol::optional<int> timeoutMs,
+	                                        sol::this_state s);
 
 	bool isOpen() const { return socketDescriptor != -1; }
 };
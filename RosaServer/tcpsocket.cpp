@@ -0,0 +1,285 @@
+#include "tcpsocket.h"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <stdexcept>
+
+static constexpr const char* errorNotOpen = "Socket is not open";
+static constexpr const char* errorMessageTooLarge = "Message is too large";
+static constexpr const char* errorNoFraming = "No framing set";
+static constexpr int maxPiecesPerWrite = 64;
+static constexpr size_t lengthPrefixSize = 4;
+// A framed message and its prefix have to fit in the receive buffer
+static constexpr size_t maxMessageSize = maxBufferedSize - lengthPrefixSize;
+
+static inline void throwSafe() {
+	char error[256];
+	throw std::runtime_error(strerror_r(errno, error, sizeof(error)));
+}
+
+TCPSocket::~TCPSocket() {
+	if (socketDescriptor != -1) {
+		close();
+	}
+}
+
+void TCPSocket::checkOpen() const {
+	if (socketDescriptor == -1) {
+		throw std::runtime_error(errorNotOpen);
+	}
+}
+
+void TCPSocket::close() {
+	checkOpen();
+
+	::close(socketDescriptor);
+	socketDescriptor = -1;
+	receiveBuffer.clear();
+	moreToRead = false;
+	sendQueue.clear();
+	sendOffset = 0;
+	queuedSize = 0;
+}
+
+bool TCPSocket::readAvailable() {
+	if (peerClosed) {
+		return false;
+	}
+
+	size_t sizeBefore = receiveBuffer.size();
+	auto res = receiveBuffer.readFrom(socketDescriptor, maxBufferedSize);
+
+	moreToRead = res > 0;
+	if (res == 0 || (res == -1 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+		// Errors like a reset are the peer going away too
+		peerClosed = true;
+		return true;
+	}
+
+	return receiveBuffer.size() != sizeBefore;
+}
+
+void TCPSocket::queue(std::string_view data) {
+	// Small sends are merged so a flush doesn't need a piece for each
+	if (!sendQueue.empty() && sendQueue.back().size() < maxReadSize) {
+		sendQueue.back().append(data);
+	} else {
+		sendQueue.emplace_back(data);
+	}
+	queuedSize += data.size();
+}
+
+void TCPSocket::flushQueue() {
+	while (!sendQueue.empty()) {
+		iovec pieces[maxPiecesPerWrite];
+		int numPieces = 0;
+		for (auto it = sendQueue.begin();
+		     it != sendQueue.end() && numPieces < maxPiecesPerWrite; it++) {
+			size_t offset = numPieces == 0 ? sendOffset : 0;
+			pieces[numPieces].iov_base = it->data() + offset;
+			pieces[numPieces].iov_len = it->size() - offset;
+			numPieces++;
+		}
+
+		msghdr message{};
+		message.msg_iov = pieces;
+		message.msg_iovlen = numPieces;
+
+		auto bytesWritten = sendmsg(socketDescriptor, &message, MSG_NOSIGNAL);
+		if (bytesWritten == -1) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return;
+			}
+			if (errno == EPIPE || errno == ECONNRESET) {
+				peerClosed = true;
+				sendQueue.clear();
+				sendOffset = 0;
+				queuedSize = 0;
+				return;
+			}
+			throwSafe();
+		}
+
+		queuedSize -= bytesWritten;
+		size_t remaining = bytesWritten + sendOffset;
+		while (!sendQueue.empty() && remaining >= sendQueue.front().size()) {
+			remaining -= sendQueue.front().size();
+			sendQueue.pop_front();
+		}
+		sendOffset = remaining;
+	}
+}
+
+ssize_t TCPSocket::send(std::string_view data) {
+	checkOpen();
+
+	if (data.empty()) {
+		throw std::runtime_error("Data is empty");
+	}
+
+	flushQueue();
+	if (queuedSize >= highWaterMark) {
+		return 0;
+	}
+
+	queue(data);
+	flushQueue();
+	return data.size();
+}
+
+bool TCPSocket::sendMessage(std::string_view data) {
+	checkOpen();
+
+	flushQueue();
+	if (queuedSize >= highWaterMark) {
+		return false;
+	}
+
+	switch (framing) {
+		case Framing::Line:
+			queue(data);
+			queue("\n");
+			break;
+		case Framing::Length: {
+			if (data.size() > maxMessageSize) {
+				throw std::invalid_argument(errorMessageTooLarge);
+			}
+			char prefix[lengthPrefixSize] = {
+			    (char)(data.size() >> 24), (char)(data.size() >> 16),
+			    (char)(data.size() >> 8), (char)data.size()};
+			queue(std::string_view(prefix, sizeof(prefix)));
+			queue(data);
+			break;
+		}
+		default:
+			throw std::runtime_error(errorNoFraming);
+	}
+
+	flushQueue();
+	return true;
+}
+
+void TCPSocket::flush() {
+	checkOpen();
+	flushQueue();
+}
+
+static void pushRange(lua_State* L, const ByteRing& ring, size_t offset,
+                      size_t count) {
+	luaL_Buffer buffer;
+	luaL_buffinit(L, &buffer);
+	ring.forEachPiece(offset, count, [&buffer](std::string_view piece) {
+		luaL_addlstring(&buffer, piece.data(), piece.size());
+	});
+	luaL_pushresult(&buffer);
+}
+
+sol::object TCPSocket::receive(size_t size, sol::this_state s) {
+	checkOpen();
+	flushQueue();
+
+	sol::state_view lua(s);
+
+	if (receiveBuffer.empty() || moreToRead) {
+		readAvailable();
+	}
+
+	if (receiveBuffer.empty()) {
+		if (peerClosed) {
+			close();
+			return sol::make_object(lua, "");
+		}
+		return sol::make_object(lua, sol::nil);
+	}
+
+	lua_State* L = s;
+	size_t count = std::min({size, maxReadSize, receiveBuffer.size()});
+	pushRange(L, receiveBuffer, 0, count);
+	receiveBuffer.consume(count);
+
+	return sol::stack::pop<sol::object>(L);
+}
+
+bool TCPSocket::pushMessage(lua_State* L) {
+	switch (framing) {
+		case Framing::Line: {
+			size_t end = receiveBuffer.find('\n');
+			if (end == ByteRing::npos) return false;
+
+			size_t length = end;
+			if (length) {
+				char last;
+				receiveBuffer.copy(length - 1, &last, 1);
+				if (last == '\r') length--;
+			}
+			pushRange(L, receiveBuffer, 0, length);
+			receiveBuffer.consume(end + 1);
+			return true;
+		}
+		case Framing::Length: {
+			if (receiveBuffer.size() < lengthPrefixSize) return false;
+
+			unsigned char prefix[lengthPrefixSize];
+			receiveBuffer.copy(0, reinterpret_cast<char*>(prefix), sizeof(prefix));
+			size_t length = ((size_t)prefix[0] << 24) | ((size_t)prefix[1] << 16) |
+			                ((size_t)prefix[2] << 8) | prefix[3];
+			if (length > maxMessageSize) {
+				throw std::runtime_error(errorMessageTooLarge);
+			}
+
+			if (receiveBuffer.size() - lengthPrefixSize < length) return false;
+
+			pushRange(L, receiveBuffer, lengthPrefixSize, length);
+			receiveBuffer.consume(lengthPrefixSize + length);
+			return true;
+		}
+		default:
+			throw std::runtime_error(errorNoFraming);
+	}
+}
+
+sol::object TCPSocket::receiveMessage(sol::this_state s) {
+	checkOpen();
+	flushQueue();
+
+	sol::state_view lua(s);
+	lua_State* L = s;
+
+	// Only read from the socket once the buffered messages run out, so
+	// draining them doesn't cost a read each
+	if (pushMessage(L)) {
+		return sol::stack::pop<sol::object>(L);
+	}
+
+	if (moreToRead || !peerClosed) {
+		readAvailable();
+		if (pushMessage(L)) {
+			return sol::stack::pop<sol::object>(L);
+		}
+	}
+
+	if (framing == Framing::Line && receiveBuffer.size() >= maxBufferedSize) {
+		throw std::runtime_error(errorMessageTooLarge);
+	}
+
+	// Whatever is left can never become a whole message
+	if (peerClosed) {
+		close();
+	}
+	return sol::make_object(lua, sol::nil);
+}
+
+void TCPSocket::setFraming(std::string_view mode) {
+	if (mode == "none") {
+		framing = Framing::None;
+	} else if (mode == "line") {
+		framing = Framing::Line;
+	} else if (mode == "length") {
+		framing = Framing::Length;
+	} else {
+		throw std::invalid_argument("Unknown framing mode");
+	}
+}
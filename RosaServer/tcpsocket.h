@@ -0,0 +1,73 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <string_view>
+
+#include "bytering.h"
+#include "sol/sol.hpp"
+
+static constexpr size_t maxReadSize = 16384;
+// Reading stops once this much is waiting for Lua, until it receives some.
+// Also the largest message framing accepts.
+static constexpr size_t maxBufferedSize = 1 << 20;
+static constexpr size_t defaultHighWaterMark = 1 << 20;
+
+// How receiveMessage splits the stream: none, "line" for newline terminated
+// messages, or "length" for a 4 byte big endian length before each one
+enum class Framing { None, Line, Length };
+
+// Non-blocking stream socket with buffered input and output. Sends that the
+// kernel can't take right away are queued and flushed later, and input is
+// read ahead into a ring so messages can be framed without Lua's help.
+class TCPSocket {
+ protected:
+	int socketDescriptor;
+	ByteRing receiveBuffer;
+	// The kernel may have more than fitted in the buffer
+	bool moreToRead = false;
+	bool peerClosed = false;
+
+	std::deque<std::string> sendQueue;
+	// How much of the front of the queue has already been written
+	size_t sendOffset = 0;
+	size_t queuedSize = 0;
+	size_t highWaterMark = defaultHighWaterMark;
+
+	Framing framing = Framing::None;
+
+	TCPSocket(int socketDescriptor) : socketDescriptor(socketDescriptor) {}
+
+	void checkOpen() const;
+	// Reads everything the socket has. Returns true if there's anything new
+	// for Lua, including the peer closing.
+	bool readAvailable();
+	void queue(std::string_view data);
+	void flushQueue();
+	// Pushes the next whole message in the receive buffer, if there is one
+	bool pushMessage(lua_State* L);
+
+ public:
+	TCPSocket(const TCPSocket&) = delete;
+	virtual ~TCPSocket();
+
+	void close();
+	bool isOpen() const { return socketDescriptor != -1; }
+
+	// Returns how many bytes were taken, which is all of them unless the
+	// queue is already past the high-water mark, when it's 0
+	ssize_t send(std::string_view data);
+	// Frames the data the same way receiveMessage expects
+	bool sendMessage(std::string_view data);
+	void flush();
+	sol::object receive(size_t size, sol::this_state s);
+	// Returns the next whole message, or nil if there isn't one yet
+	sol::object receiveMessage(sol::this_state s);
+
+	void setFraming(std::string_view mode);
+	size_t getBufferedSize() const { return receiveBuffer.size(); }
+	size_t getQueuedSize() const { return queuedSize; }
+	size_t getHighWaterMark() const { return highWaterMark; }
+	void setHighWaterMark(size_t size) { highWaterMark = size; }
+	bool isWritable() const { return queuedSize < highWaterMark; }
+};
@@ -0,0 +1,236 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+#include "api.h"
+#include "engineuserdata.h"
+
+namespace ThreadPool {
+static constexpr const char* errorNotFunction = "Task function not found: ";
+
+// Each thread takes from the front of its own queue, and steals from the back
+// of the others' when it runs dry
+struct Queue {
+	std::mutex mutex;
+	std::deque<Task> tasks;
+};
+
+static int threadCount = 0;
+static std::unique_ptr<Queue[]> queues;
+static std::once_flag startFlag;
+static std::atomic<unsigned int> nextQueue = 0;
+
+static std::mutex wakeMutex;
+static std::condition_variable wakeCondition;
+// Tasks sitting in a queue, guarded by wakeMutex when incremented. Signed
+// since a task can be taken just before its increment lands.
+static std::atomic<int> queuedTasks = 0;
+
+static std::mutex scriptMutex;
+static std::string scriptFileName;
+static std::atomic<unsigned int> scriptGeneration = 0;
+
+static std::mutex resultQueueMutex;
+static std::queue<Result> resultQueue;
+
+static std::atomic<size_t> pending = 0;
+
+static std::unique_ptr<sol::state> createState() {
+	std::string fileName;
+	{
+		std::lock_guard<std::mutex> guard(scriptMutex);
+		fileName = scriptFileName;
+	}
+
+	auto state = std::make_unique<sol::state>();
+	defineThreadSafeAPIs(state.get());
+
+	if (!fileName.empty()) {
+		sol::load_result load = state->load_file(fileName);
+		if (noLuaCallError(&load)) {
+			sol::protected_function_result res = load();
+			noLuaCallError(&res);
+		}
+	}
+
+	return state;
+}
+
+static bool takeTask(int self, Task& task) {
+	{
+		Queue& own = queues[self];
+		std::lock_guard<std::mutex> guard(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.front());
+			own.tasks.pop_front();
+			return true;
+		}
+	}
+
+	for (int i = 1; i < threadCount; i++) {
+		Queue& victim = queues[(self + i) % threadCount];
+		std::lock_guard<std::mutex> guard(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.back());
+			victim.tasks.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static Result runTask(sol::state& state, Task& task) {
+	Result result;
+	result.id = task.id;
+	result.success = false;
+
+	sol::object function = state[task.functionName];
+	if (function.get_type() != sol::type::function) {
+		result.value = errorNotFunction + task.functionName;
+		return result;
+	}
+
+	try {
+		sol::object argument =
+		    Serializer::decode<EngineUserdata>(state.lua_state(), task.argument);
+
+		sol::protected_function_result res =
+		    function.as<sol::protected_function>()(argument);
+		if (!res.valid()) {
+			sol::error err = res;
+			result.value = err.what();
+			return result;
+		}
+
+		sol::object value = res;
+		result.value = Serializer::encode<EngineUserdata>(value);
+		result.success = true;
+	} catch (std::exception& e) {
+		result.value = e.what();
+	}
+
+	return result;
+}
+
+// Returns false if the work finished without a result
+static bool runWork(Task& task, Result& result) {
+	result.id = task.id;
+	try {
+		if (!task.work(result.value)) return false;
+		result.success = true;
+	} catch (std::exception& e) {
+		result.success = false;
+		result.value = e.what();
+	}
+	return true;
+}
+
+static void threadMain(int self) {
+	std::unique_ptr<sol::state> state;
+	unsigned int loadedGeneration = 0;
+
+	while (true) {
+		unsigned int generation = scriptGeneration;
+		if (!state || generation != loadedGeneration) {
+			loadedGeneration = generation;
+			state = createState();
+		}
+
+		Task task;
+		if (takeTask(self, task)) {
+			queuedTasks--;
+
+			Result result;
+			if (task.work) {
+				if (!runWork(task, result)) {
+					pending--;
+					continue;
+				}
+			} else {
+				result = runTask(*state, task);
+			}
+
+			std::lock_guard<std::mutex> guard(resultQueueMutex);
+			resultQueue.push(std::move(result));
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(wakeMutex);
+		wakeCondition.wait(lock, [loadedGeneration] {
+			return queuedTasks > 0 || scriptGeneration != loadedGeneration;
+		});
+	}
+}
+
+static void start() {
+	threadCount = std::max(1u, std::thread::hardware_concurrency());
+	queues = std::make_unique<Queue[]>(threadCount);
+
+	for (int i = 0; i < threadCount; i++) {
+		std::thread thread(threadMain, i);
+		thread.detach();
+	}
+}
+
+void load(const std::string& fileName) {
+	{
+		std::lock_guard<std::mutex> guard(scriptMutex);
+		scriptFileName = fileName;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(wakeMutex);
+		scriptGeneration++;
+	}
+	wakeCondition.notify_all();
+
+	std::call_once(startFlag, start);
+}
+
+bool submit(Task&& task) {
+	size_t count = pending.load();
+	do {
+		if (count >= maxPending) return false;
+	} while (!pending.compare_exchange_weak(count, count + 1));
+
+	std::call_once(startFlag, start);
+
+	{
+		Queue& queue = queues[nextQueue++ % threadCount];
+		std::lock_guard<std::mutex> guard(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(wakeMutex);
+		queuedTasks++;
+	}
+	wakeCondition.notify_one();
+	return true;
+}
+
+bool popResult(Result& result) {
+	std::lock_guard<std::mutex> guard(resultQueueMutex);
+	if (resultQueue.empty()) return false;
+
+	result = std::move(resultQueue.front());
+	resultQueue.pop();
+	pending--;
+	return true;
+}
+
+int getThreadCount() {
+	std::call_once(startFlag, start);
+	return threadCount;
+}
+
+size_t getPending() { return pending; }
+}  // namespace ThreadPool
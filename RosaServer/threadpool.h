@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// Fixed pool of threads sized to the machine, each with its own Lua state
+// that stays loaded between tasks. Tasks name a global function from the
+// pool's script and carry one serialized argument; serialized results are
+// popped on the main thread.
+namespace ThreadPool {
+// Tasks that were submitted but whose results haven't been popped yet
+static constexpr size_t maxPending = 4096;
+
+struct Task {
+	unsigned int id;
+	std::string functionName;
+	std::string argument;
+	// Native work run instead of a script function. Writes the serialized
+	// result and returns true, or returns false to finish without a result.
+	std::function<bool(std::string& value)> work;
+};
+
+struct Result {
+	unsigned int id;
+	bool success;
+	// The serialized return value, or on failure the error message
+	std::string value;
+};
+
+// Reloads every pool thread's state with the given script, starting the pool
+// if needed
+void load(const std::string& fileName);
+// Returns false without queueing if maxPending tasks are already pending
+bool submit(Task&& task);
+bool popResult(Result& result);
+int getThreadCount();
+size_t getPending();
+};  // namespace ThreadPool
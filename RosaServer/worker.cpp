@@ -1,114 +1,186 @@
 #include "worker.h"
 
+#include <chrono>
 #include <iostream>
+#include <limits>
 #include <thread>
 
 #include "api.h"
+#include "engineuserdata.h"
 
-Worker::Worker(std::string fileName) {
-	stopped = new std::atomic_bool(false);
-
-	std::thread thread(&Worker::runThread, this, fileName);
+Worker::Worker(std::string fileName) : channel(std::make_shared<Channel>()) {
+	std::thread thread(&Worker::runThread, channel, fileName);
 	thread.detach();
 }
 
-Worker::~Worker() {
-	std::lock_guard<std::mutex> guard(destructionMutex);
-	stop();
+Worker::~Worker() { stop(); }
+
+void Worker::Channel::wake() {
+	// Pairs with the fence in waitFor, so either the waiter sees the new message
+	// or we see that it's waiting
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (!waiting) return;
+
+	{ std::lock_guard<std::mutex> guard(wakeMutex); }
+	wakeCondition.notify_all();
+}
+
+// Blocks until ready() is true, the worker is stopped, or the timeout passes.
+// With no timeout it waits indefinitely.
+template <typename Ready>
+void Worker::Channel::waitFor(sol::optional<unsigned int> timeoutMs,
+                              Ready&& ready) {
+	std::unique_lock<std::mutex> lock(wakeMutex);
+	waiting = true;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	auto predicate = [this, &ready] { return stopped || ready(); };
+	if (timeoutMs) {
+		wakeCondition.wait_for(lock, std::chrono::milliseconds(*timeoutMs),
+		                       predicate);
+	} else {
+		wakeCondition.wait(lock, predicate);
+	}
+
+	waiting = false;
 }
 
-void Worker::runThread(std::string fileName) {
-	std::atomic_bool* _stopped = stopped;
+template <typename Queue>
+static sol::object popMessage(Queue& queue, sol::this_state s) {
+	sol::state_view state(s);
+
+	std::string message;
+	if (!queue.pop(message)) {
+		return sol::make_object(state, sol::nil);
+	}
+
+	return sol::make_object(state, message);
+}
 
+template <typename Queue>
+static sol::object popValue(Queue& queue, sol::this_state s) {
+	std::string message;
+	if (!queue.pop(message)) {
+		return sol::make_object(sol::state_view(s), sol::nil);
+	}
+
+	return Serializer::decode<EngineUserdata>(s, message);
+}
+
+template <typename Queue>
+static sol::table popMessages(Queue& queue, sol::optional<int> max,
+                              sol::this_state s) {
+	sol::state_view state(s);
+	sol::table messages = state.create_table();
+
+	int limit = max.value_or(std::numeric_limits<int>::max());
+	std::string message;
+	for (int i = 1; i <= limit && queue.pop(message); i++) {
+		messages.raw_set(i, message);
+	}
+
+	return messages;
+}
+
+void Worker::runThread(std::shared_ptr<Channel> channel,
+                       std::string fileName) {
 	sol::state state;
 	defineThreadSafeAPIs(&state);
 
-	state["sendMessage"] = [this](std::string message) {
-		this->l_sendMessage(message);
+	state["sendMessage"] = [channel](std::string message) {
+		if (!channel->receiveMessageQueue.push(std::move(message))) {
+			channel->receiveOverflowCount++;
+			return false;
+		}
+		return true;
 	};
 
-	state["receiveMessage"] = [this](sol::this_state s) {
-		return this->l_receiveMessage(s);
+	state["receiveMessage"] = [channel](sol::this_state s) {
+		return popMessage(channel->sendMessageQueue, s);
 	};
 
-	destructionMutex.lock();
-
-	state["sleep"] = [this, &_stopped](unsigned int ms) -> bool {
-		// Allow this to be deconstructed while sleeping
-		this->destructionMutex.unlock();
-		std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+	state["receiveMessages"] = [channel](sol::optional<int> max,
+	                                     sol::this_state s) {
+		return popMessages(channel->sendMessageQueue, max, s);
+	};
 
-		if (*_stopped) return true;
+	// Same as the message functions, but for any value the serializer supports
+	state["send"] = [channel](sol::object value) {
+		if (!channel->receiveMessageQueue.push(
+		        Serializer::encode<EngineUserdata>(value))) {
+			channel->receiveOverflowCount++;
+			return false;
+		}
+		return true;
+	};
 
-		this->destructionMutex.lock();
-		return false;
+	state["receive"] = [channel](sol::this_state s) {
+		return popValue(channel->sendMessageQueue, s);
 	};
 
-	{
-		sol::load_result load = state.load_file(fileName);
-		if (noLuaCallError(&load)) {
-			sol::protected_function_result res = load();
-			noLuaCallError(&res);
-		}
-	}
+	// Returns the next message, or nil if the timeout passed first, and whether
+	// the worker has been stopped
+	state["waitMessage"] = [channel](sol::optional<unsigned int> timeoutMs,
+	                                 sol::this_state s) {
+		channel->waitFor(timeoutMs,
+		                 [&channel] { return !channel->sendMessageQueue.empty(); });
+		return std::make_tuple(popMessage(channel->sendMessageQueue, s),
+		                       (bool)channel->stopped);
+	};
 
-	if (!*_stopped) {
-		destructionMutex.unlock();
-	}
+	// Returns true if the worker was stopped, which also cuts the sleep short
+	state["sleep"] = [channel](unsigned int ms) -> bool {
+		channel->waitFor(ms, [] { return false; });
+		return channel->stopped;
+	};
 
-	while (!*_stopped) {
-		std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+	sol::load_result load = state.load_file(fileName);
+	if (noLuaCallError(&load)) {
+		sol::protected_function_result res = load();
+		noLuaCallError(&res);
 	}
-
-	delete _stopped;
 }
 
-void Worker::l_sendMessage(std::string message) {
-	std::lock_guard<std::mutex> guard(receiveMessageQueueMutex);
-	receiveMessageQueue.push(message);
-	if (receiveMessageQueue.size() > 2047) receiveMessageQueue.pop();
+void Worker::stop() {
+	if (!channel->stopped) {
+		channel->stopped = true;
+		{ std::lock_guard<std::mutex> guard(channel->wakeMutex); }
+		channel->wakeCondition.notify_all();
+	}
 }
 
-sol::object Worker::l_receiveMessage(sol::this_state s) {
-	sol::state_view state(s);
+bool Worker::sendMessage(std::string message) {
+	if (channel->stopped) return false;
 
-	sendMessageQueueMutex.lock();
-	if (sendMessageQueue.empty()) {
-		sendMessageQueueMutex.unlock();
-		return sol::make_object(state, sol::nil);
+	if (!channel->sendMessageQueue.push(std::move(message))) {
+		channel->sendOverflowCount++;
+		return false;
 	}
 
-	auto message = sendMessageQueue.front();
-	sendMessageQueue.pop();
-	sendMessageQueueMutex.unlock();
-	return sol::make_object(state, message);
+	channel->wake();
+	return true;
 }
 
-void Worker::stop() {
-	if (stopped && !*stopped) {
-		*stopped = true;
-	}
+sol::object Worker::receiveMessage(sol::this_state s) {
+	return popMessage(channel->receiveMessageQueue, s);
 }
 
-void Worker::sendMessage(std::string message) {
-	if (stopped && *stopped) return;
+sol::table Worker::receiveMessages(sol::optional<int> max, sol::this_state s) {
+	return popMessages(channel->receiveMessageQueue, max, s);
+}
 
-	std::lock_guard<std::mutex> guard(sendMessageQueueMutex);
-	sendMessageQueue.push(message);
-	if (sendMessageQueue.size() > 2047) sendMessageQueue.pop();
+bool Worker::send(sol::object value) {
+	return sendMessage(Serializer::encode<EngineUserdata>(value));
 }
 
-sol::object Worker::receiveMessage(sol::this_state s) {
-	sol::state_view state(s);
+sol::object Worker::receive(sol::this_state s) {
+	return popValue(channel->receiveMessageQueue, s);
+}
 
-	receiveMessageQueueMutex.lock();
-	if (receiveMessageQueue.empty()) {
-		receiveMessageQueueMutex.unlock();
-		return sol::make_object(state, sol::nil);
-	}
+uint64_t Worker::getSendOverflowCount() const {
+	return channel->sendOverflowCount;
+}
 
-	auto message = receiveMessageQueue.front();
-	receiveMessageQueue.pop();
-	receiveMessageQueueMutex.unlock();
-	return sol::make_object(state, message);
+uint64_t Worker::getReceiveOverflowCount() const {
+	return channel->receiveOverflowCount;
 }
@@ -1,29 +1,52 @@
 #pragma once
 #include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <string>
 
 #include "sol/sol.hpp"
+#include "spscring.h"
 
 class Worker {
-	std::atomic_bool* stopped = nullptr;
-	std::mutex destructionMutex;
+	static constexpr size_t queueCapacity = 2048;
 
-	std::queue<std::string> sendMessageQueue;
-	std::mutex sendMessageQueueMutex;
+	// Shared with the worker thread, which can outlive the Worker
+	struct Channel {
+		std::atomic_bool stopped = false;
 
-	std::queue<std::string> receiveMessageQueue;
-	std::mutex receiveMessageQueueMutex;
+		std::mutex wakeMutex;
+		std::condition_variable wakeCondition;
+		std::atomic_bool waiting = false;
 
-	void runThread(std::string fileName);
-	void l_sendMessage(std::string message);
-	sol::object l_receiveMessage(sol::this_state s);
+		// Main thread to worker thread
+		SPSCRing<std::string, queueCapacity> sendMessageQueue;
+		std::atomic<uint64_t> sendOverflowCount = 0;
+
+		// Worker thread to main thread
+		SPSCRing<std::string, queueCapacity> receiveMessageQueue;
+		std::atomic<uint64_t> receiveOverflowCount = 0;
+
+		void wake();
+		template <typename Ready>
+		void waitFor(sol::optional<unsigned int> timeoutMs, Ready&& ready);
+	};
+
+	std::shared_ptr<Channel> channel;
+
+	static void runThread(std::shared_ptr<Channel> channel,
+	                      std::string fileName);
 
  public:
 	Worker(std::string fileName);
 	~Worker();
 	void stop();
-	void sendMessage(std::string message);
+	bool sendMessage(std::string message);
 	sol::object receiveMessage(sol::this_state s);
+	sol::table receiveMessages(sol::optional<int> max, sol::this_state s);
+	bool send(sol::object value);
+	sol::object receive(sol::this_state s);
+	uint64_t getSendOverflowCount() const;
+	uint64_t getReceiveOverflowCount() const;
 };
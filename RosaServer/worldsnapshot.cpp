@@ -0,0 +1,420 @@
+#include "worldsnapshot.h"
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include "api.h"
+#include "lz4impl.h"
+#include "serializer.h"
+
+static constexpr uint8_t flagKeyframe = 1;
+static constexpr uint8_t flagCompressed = 2;
+// Bounds what a corrupt size can make decode allocate
+static constexpr size_t maxUncompressedSize = 1 << 26;
+static constexpr size_t nameSize = 32;
+
+static constexpr const char* errorMalformed = "Malformed snapshot";
+static constexpr const char* errorOpenFile = "Couldn't open snapshot file";
+static constexpr const char* errorWriteFile = "Couldn't write snapshot file";
+
+using FieldType = WorldSnapshot::FieldType;
+using Field = WorldSnapshot::Field;
+using Serializer::detail::writeVarint;
+
+#define FIELD(type, member, fieldType) \
+	{ #member, offsetof(type, member), FieldType::fieldType }
+
+static const Field playerFields[] = {
+    FIELD(Player, name, Name),
+    FIELD(Player, subRosaID, Unsigned),
+    FIELD(Player, phoneNumber, Unsigned),
+    FIELD(Player, accountID, Unsigned),
+    FIELD(Player, isAdmin, Integer),
+    FIELD(Player, money, Integer),
+    FIELD(Player, corporateRating, Integer),
+    FIELD(Player, criminalRating, Integer),
+    FIELD(Player, team, Unsigned),
+    FIELD(Player, humanID, Integer),
+    FIELD(Player, isBot, Integer),
+    FIELD(Player, isZombie, Integer),
+};
+
+static const Field humanFields[] = {
+    FIELD(Human, playerID, Integer),
+    FIELD(Human, accountID, Integer),
+    FIELD(Human, vehicleID, Integer),
+    FIELD(Human, vehicleSeat, Integer),
+    FIELD(Human, movementState, Integer),
+    FIELD(Human, isStanding, Integer),
+    FIELD(Human, isOnGround, Integer),
+    FIELD(Human, damage, Integer),
+    FIELD(Human, health, Integer),
+    FIELD(Human, bloodLevel, Integer),
+    FIELD(Human, pos, Vector),
+    FIELD(Human, viewYaw, Float),
+    FIELD(Human, viewPitch, Float),
+    FIELD(Human, inputFlags, Unsigned),
+};
+
+static const Field vehicleFields[] = {
+    FIELD(Vehicle, type, Unsigned),
+    FIELD(Vehicle, health, Integer),
+    FIELD(Vehicle, color, Unsigned),
+    FIELD(Vehicle, isLocked, Integer),
+    FIELD(Vehicle, lastDriverPlayerID, Integer),
+    FIELD(Vehicle, trafficCarID, Integer),
+    FIELD(Vehicle, pos, Vector),
+    FIELD(Vehicle, rot, RotMatrix),
+    FIELD(Vehicle, vel, Vector),
+};
+
+static const Field itemFields[] = {
+    FIELD(Item, type, Integer),
+    FIELD(Item, isStatic, Integer),
+    FIELD(Item, parentHumanID, Integer),
+    FIELD(Item, parentItemID, Integer),
+    FIELD(Item, parentSlot, Integer),
+    FIELD(Item, vehicleID, Integer),
+    FIELD(Item, bullets, Integer),
+    FIELD(Item, pos, Vector),
+    FIELD(Item, vel, Vector),
+    FIELD(Item, rot, RotMatrix),
+};
+
+#undef FIELD
+
+template <size_t N>
+static constexpr int countFields(const Field (&)[N]) {
+	static_assert(N < 32, "Field masks are 32 bits");
+	return N;
+}
+
+// In the order kinds appear in a delta
+static const struct {
+	const char* name;
+	const Field* fields;
+	int numFields;
+	size_t count;
+} kindInfos[] = {
+    {"players", playerFields, countFields(playerFields), maxNumberOfPlayers},
+    {"humans", humanFields, countFields(humanFields), maxNumberOfHumans},
+    {"vehicles", vehicleFields, countFields(vehicleFields),
+     maxNumberOfVehicles},
+    {"items", itemFields, countFields(itemFields), maxNumberOfItems},
+};
+
+static size_t fieldSize(FieldType type) {
+	switch (type) {
+		case FieldType::Vector:
+			return sizeof(Vector);
+		case FieldType::RotMatrix:
+			return sizeof(RotMatrix);
+		case FieldType::Name:
+			return nameSize;
+		default:
+			return 4;
+	}
+}
+
+static void encodeField(FieldType type, const char* bytes, std::string& out) {
+	switch (type) {
+		case FieldType::Integer: {
+			int32_t value;
+			std::memcpy(&value, bytes, sizeof(value));
+			writeVarint(out, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+			return;
+		}
+		case FieldType::Unsigned: {
+			uint32_t value;
+			std::memcpy(&value, bytes, sizeof(value));
+			writeVarint(out, value);
+			return;
+		}
+		case FieldType::Name: {
+			size_t length = strnlen(bytes, nameSize);
+			writeVarint(out, length);
+			out.append(bytes, length);
+			return;
+		}
+		default:
+			out.append(bytes, fieldSize(type));
+			return;
+	}
+}
+
+static void encodeFields(const WorldSnapshot::Kind& kind, const char* record,
+                         uint32_t mask, std::string& out) {
+	for (int i = 0; i < kind.numFields; i++) {
+		FieldType type = kind.fields[i].type;
+		if (mask & (1u << i)) {
+			encodeField(type, record, out);
+		}
+		record += fieldSize(type);
+	}
+}
+
+WorldSnapshot::Kind::Kind(const char* name, const Field* fields,
+                          int numFields, size_t count)
+    : name(name), fields(fields), numFields(numFields), recordSize(0) {
+	for (int i = 0; i < numFields; i++) {
+		recordSize += fieldSize(fields[i].type);
+	}
+	records.resize(recordSize * count);
+	states.resize(count);
+}
+
+template <typename T, size_t N>
+static void diff(WorldSnapshot::Kind& kind, const T* array,
+                 ActiveList<T, N>& list, std::string& out) {
+	for (int index : kind.activeIndices) {
+		kind.states[index] = 2;
+	}
+
+	std::string entries;
+	size_t numEntries = 0;
+	std::vector<int> activeIndices;
+
+	for (int i = list.next(array, 0); i != -1; i = list.next(array, i + 1)) {
+		activeIndices.push_back(i);
+		bool wasActive = kind.states[i] != 0;
+		kind.states[i] = 1;
+
+		char* record = &kind.records[i * kind.recordSize];
+		auto source = reinterpret_cast<const char*>(&array[i]);
+
+		uint32_t mask = 0;
+		size_t recordOffset = 0;
+		for (int f = 0; f < kind.numFields; f++) {
+			const Field& field = kind.fields[f];
+			size_t size = fieldSize(field.type);
+			if (!wasActive || std::memcmp(record + recordOffset,
+			                              source + field.offset, size)) {
+				std::memcpy(record + recordOffset, source + field.offset, size);
+				mask |= 1u << f;
+			}
+			recordOffset += size;
+		}
+
+		if (mask) {
+			writeVarint(entries, i);
+			writeVarint(entries, mask);
+			encodeFields(kind, record, mask, entries);
+			numEntries++;
+		}
+	}
+
+	for (int index : kind.activeIndices) {
+		if (kind.states[index] == 2) {
+			kind.states[index] = 0;
+			writeVarint(entries, index);
+			writeVarint(entries, 0);
+			numEntries++;
+		}
+	}
+
+	kind.activeIndices = std::move(activeIndices);
+	writeVarint(out, numEntries);
+	out.append(entries);
+}
+
+WorldSnapshot::WorldSnapshot(sol::optional<bool> compress)
+    : compress(compress.value_or(false)) {
+	for (const auto& info : kindInfos) {
+		kinds.emplace_back(info.name, info.fields, info.numFields, info.count);
+	}
+}
+
+std::string WorldSnapshot::finish(std::string&& body, bool keyframe) const {
+	uint8_t flags = keyframe ? flagKeyframe : 0;
+	if (!compress) {
+		body.insert(body.begin(), (char)flags);
+		return std::move(body);
+	}
+
+	std::string out;
+	out.push_back(flags | flagCompressed);
+	Lua::lz4::compressFrameTo(out, body);
+	return out;
+}
+
+std::string WorldSnapshot::capture() {
+	std::string body;
+	writeVarint(body, ++sequence);
+
+	diff(kinds[0], Engine::players, activePlayers, body);
+	diff(kinds[1], Engine::humans, activeHumans, body);
+	diff(kinds[2], Engine::vehicles, activeVehicles, body);
+	diff(kinds[3], Engine::items, activeItems, body);
+
+	return finish(std::move(body), false);
+}
+
+std::string WorldSnapshot::getKeyframe() const {
+	std::string body;
+	writeVarint(body, sequence);
+
+	for (const auto& kind : kinds) {
+		uint32_t mask = (1u << kind.numFields) - 1;
+		writeVarint(body, kind.activeIndices.size());
+		for (int index : kind.activeIndices) {
+			writeVarint(body, index);
+			writeVarint(body, mask);
+			encodeFields(kind, &kind.records[index * kind.recordSize], mask, body);
+		}
+	}
+
+	return finish(std::move(body), true);
+}
+
+// Returns false if the sink is gone
+bool WorldSnapshot::write(Sink& sink, const std::string& data) {
+	if (sink.file) {
+		uint32_t length = data.size();
+		sink.file->write(reinterpret_cast<const char*>(&length), sizeof(length));
+		sink.file->write(data.data(), data.size());
+		sink.file->flush();
+		if (!*sink.file) {
+			throw std::runtime_error(errorWriteFile);
+		}
+		sink.needsKeyframe = false;
+		return true;
+	}
+
+	auto connection = sink.connection.lock();
+	if (!connection || !connection->isOpen()) {
+		return false;
+	}
+
+	// A full queue means this delta is lost to them
+	sink.needsKeyframe = !connection->sendMessage(data);
+	return true;
+}
+
+size_t WorldSnapshot::publish() {
+	std::string delta = capture();
+	std::string keyframe;
+
+	for (auto it = sinks.begin(); it != sinks.end();) {
+		bool kept;
+		if (it->needsKeyframe) {
+			if (keyframe.empty()) keyframe = getKeyframe();
+			kept = write(*it, keyframe);
+		} else {
+			kept = write(*it, delta);
+		}
+
+		if (kept) {
+			it++;
+		} else {
+			it = sinks.erase(it);
+		}
+	}
+
+	return delta.size();
+}
+
+void WorldSnapshot::addConnection(TCPServerConnection* connection) {
+	connection->setFraming("length");
+
+	Sink sink;
+	sink.connection = connection->shared_from_this();
+	sinks.push_back(std::move(sink));
+}
+
+void WorldSnapshot::addFile(std::string_view fileName) {
+	auto file = std::make_unique<std::ofstream>(
+	    std::string(fileName), std::ios::binary | std::ios::app);
+	if (!*file) {
+		throw std::runtime_error(errorOpenFile);
+	}
+
+	Sink sink;
+	sink.file = std::move(file);
+	sinks.push_back(std::move(sink));
+}
+
+static sol::object decodeField(sol::state_view& lua, FieldType type,
+                               Serializer::detail::Reader& reader) {
+	switch (type) {
+		case FieldType::Integer: {
+			uint32_t zigzag = reader.varint();
+			int32_t value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+			return sol::make_object(lua, value);
+		}
+		case FieldType::Unsigned:
+			return sol::make_object(lua, (uint32_t)reader.varint());
+		case FieldType::Float:
+			return sol::make_object(lua, reader.raw<float>());
+		case FieldType::Vector:
+			return sol::make_object(lua, reader.raw<Vector>());
+		case FieldType::RotMatrix:
+			return sol::make_object(lua, reader.raw<RotMatrix>());
+		case FieldType::Name: {
+			size_t length = reader.varint();
+			if (length > nameSize) throw std::runtime_error(errorMalformed);
+			return sol::make_object(lua,
+			                        std::string_view(reader.bytes(length), length));
+		}
+	}
+
+	throw std::runtime_error(errorMalformed);
+}
+
+sol::table WorldSnapshot::decode(std::string_view data, sol::this_state s) {
+	sol::state_view lua(s);
+
+	if (data.empty()) {
+		throw std::runtime_error(errorMalformed);
+	}
+
+	uint8_t flags = data[0];
+	std::string uncompressed;
+	Serializer::detail::Reader reader{data.data() + 1, data.data() + data.size()};
+
+	if (flags & flagCompressed) {
+		uncompressed = Lua::lz4::uncompressFrame(
+		    std::string_view(reader.cursor, reader.end - reader.cursor),
+		    maxUncompressedSize);
+		reader = {uncompressed.data(), uncompressed.data() + uncompressed.size()};
+	}
+
+	sol::table result = lua.create_table();
+	result["keyframe"] = (flags & flagKeyframe) != 0;
+	result["sequence"] = (double)reader.varint();
+
+	for (const auto& info : kindInfos) {
+		sol::table objects = lua.create_table();
+		result[info.name] = objects;
+
+		size_t numEntries = reader.varint();
+		for (size_t i = 0; i < numEntries; i++) {
+			size_t index = reader.varint();
+			uint32_t mask = reader.varint();
+			if (index >= info.count || mask >> info.numFields) {
+				throw std::runtime_error(errorMalformed);
+			}
+
+			// Gone objects are false, so they can be told apart from unchanged ones
+			if (!mask) {
+				objects[index] = false;
+				continue;
+			}
+
+			sol::table object = lua.create_table();
+			for (int f = 0; f < info.numFields; f++) {
+				if (mask & (1u << f)) {
+					object[info.fields[f].name] =
+					    decodeField(lua, info.fields[f].type, reader);
+				}
+			}
+			objects[index] = object;
+		}
+	}
+
+	if (reader.cursor != reader.end) {
+		throw std::runtime_error(errorMalformed);
+	}
+
+	return result;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "sol/sol.hpp"
+#include "tcpserver.h"
+
+// Copies a fixed set of fields out of the engine's players, humans, vehicles
+// and items each capture, and encodes only what changed since the last one.
+//
+// A delta starts with a flags byte (1 = keyframe, 2 = LZ4 compressed, which
+// adds a varint of the uncompressed size). The body is a varint sequence
+// number, then for each kind in that order a varint count of entries. Each
+// entry is a varint index and a varint mask of the fields that follow in
+// order, where a mask of 0 means the object is gone. A keyframe lists every
+// active object with all of its fields.
+class WorldSnapshot {
+ public:
+	enum class FieldType : uint8_t {
+		Integer,
+		Unsigned,
+		Float,
+		Vector,
+		RotMatrix,
+		Name
+	};
+
+	struct Field {
+		const char* name;
+		size_t offset;
+		FieldType type;
+	};
+
+	// What was last captured for one of the engine arrays
+	struct Kind {
+		const char* name;
+		const Field* fields;
+		int numFields;
+		size_t recordSize;
+
+		std::vector<char> records;
+		// 0 if inactive, 1 if active, 2 while finding which ones went away
+		std::vector<uint8_t> states;
+		std::vector<int> activeIndices;
+
+		Kind(const char* name, const Field* fields, int numFields, size_t count);
+	};
+
+ private:
+	struct Sink {
+		std::weak_ptr<TCPServerConnection> connection;
+		std::unique_ptr<std::ofstream> file;
+		// New sinks, and ones that missed a delta, start over from a keyframe
+		bool needsKeyframe = true;
+	};
+
+	bool compress;
+	uint64_t sequence = 0;
+	std::vector<Kind> kinds;
+	std::vector<Sink> sinks;
+
+	std::string finish(std::string&& body, bool keyframe) const;
+	bool write(Sink& sink, const std::string& data);
+
+ public:
+	WorldSnapshot(sol::optional<bool> compress);
+
+	// Diffs against the last capture and returns the delta
+	std::string capture();
+	// Returns every object as of the last capture
+	std::string getKeyframe() const;
+	// Captures, then writes the delta to every sink. Returns its size.
+	size_t publish();
+
+	// Deltas are sent as messages, so the connection's framing is set to length
+	void addConnection(TCPServerConnection* connection);
+	// Appends each delta with a 4 byte native length before it
+	void addFile(std::string_view fileName);
+	void clearSinks() { sinks.clear(); }
+	size_t getSinkCount() const { return sinks.size(); }
+	uint64_t getSequence() const { return sequence; }
+
+	static sol::table decode(std::string_view data, sol::this_state s);
+};
@@ -0,0 +1,227 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#include "git_version.h"
+
+static constexpr const char* defaultOutput = "benchmark-micro.json";
+static constexpr int defaultSamples = 20;
+static constexpr int defaultSampleMs = 10;
+// Stops calibrating runaway cases, like ones the compiler emptied out
+static constexpr uint64_t maxIterations = 1ull << 32;
+
+static constexpr const char* usage =
+    "Usage: rosaserverbenchmark [--filter text] [--out file] [--samples n] "
+    "[--sample-ms ms]\n";
+
+namespace {
+struct Options {
+	std::string filter;
+	std::string output = defaultOutput;
+	int samples = defaultSamples;
+	int sampleMs = defaultSampleMs;
+};
+
+struct Result {
+	const Benchmark::Case* benchmarkCase;
+	uint64_t iterations;
+	// Nanoseconds per operation, sorted
+	std::vector<double> samples;
+
+	double percentile(double percentile) const {
+		size_t rank = std::ceil(percentile / 100 * samples.size());
+		return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+	}
+
+	double mean() const {
+		double total = 0;
+		for (double sample : samples) total += sample;
+		return total / samples.size();
+	}
+};
+};  // namespace
+
+static std::vector<Benchmark::Case>& getCases() {
+	static std::vector<Benchmark::Case> cases;
+	return cases;
+}
+
+static double timeIterations(const Benchmark::Case& benchmarkCase,
+                             uint64_t iterations) {
+	auto start = std::chrono::steady_clock::now();
+	benchmarkCase.body(iterations);
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// Doubles the iteration count until one sample takes at least sampleMs, which
+// also warms up caches and any lazily created state
+static uint64_t calibrate(const Benchmark::Case& benchmarkCase, int sampleMs) {
+	const double target = sampleMs * 1e6;
+	uint64_t iterations = 1;
+
+	while (iterations < maxIterations) {
+		double elapsed = timeIterations(benchmarkCase, iterations);
+		if (elapsed >= target) break;
+
+		uint64_t next = elapsed > 0 ? iterations * target / elapsed * 1.2 : 0;
+		iterations = std::clamp(next, iterations * 2, iterations * 100);
+	}
+
+	return std::min(iterations, maxIterations);
+}
+
+static Result runCase(const Benchmark::Case& benchmarkCase,
+                      const Options& options) {
+	Result result{&benchmarkCase, calibrate(benchmarkCase, options.sampleMs)};
+
+	result.samples.reserve(options.samples);
+	for (int i = 0; i < options.samples; i++) {
+		result.samples.push_back(timeIterations(benchmarkCase, result.iterations) /
+		                         result.iterations);
+	}
+	std::sort(result.samples.begin(), result.samples.end());
+
+	return result;
+}
+
+static std::string escape(std::string_view text) {
+	std::string escaped;
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			escaped += '\\';
+			escaped += c;
+		} else if ((unsigned char)c < 0x20) {
+			char code[7];
+			std::snprintf(code, sizeof(code), "\\u%04x", c);
+			escaped += code;
+		} else {
+			escaped += c;
+		}
+	}
+	return escaped;
+}
+
+static std::string getCommit() {
+	// Generated as "git version: <hash>"
+	std::string_view hash = gitCommitHash;
+	auto space = hash.rfind(' ');
+	return std::string(space == std::string_view::npos ? hash
+	                                                    : hash.substr(space + 1));
+}
+
+static void writeJSON(std::ostream& stream, const std::vector<Result>& results,
+                      const Options& options) {
+	stream << std::setprecision(6);
+	stream << "{\n";
+	stream << "  \"commit\": \"" << escape(getCommit()) << "\",\n";
+	stream << "  \"samples\": " << options.samples << ",\n";
+	stream << "  \"benchmarks\": [";
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result& result = results[i];
+		const Benchmark::Case& benchmarkCase = *result.benchmarkCase;
+		double median = result.percentile(50);
+
+		stream << (i ? ",\n" : "\n");
+		stream << "    {\n";
+		stream << "      \"name\": \"" << escape(benchmarkCase.name) << "\",\n";
+		stream << "      \"iterations\": " << result.iterations << ",\n";
+		stream << "      \"nsPerOperation\": {";
+		stream << "\"min\": " << result.samples.front() << ", ";
+		stream << "\"mean\": " << result.mean() << ", ";
+		stream << "\"p50\": " << median << ", ";
+		stream << "\"p90\": " << result.percentile(90) << ", ";
+		stream << "\"p99\": " << result.percentile(99) << ", ";
+		stream << "\"max\": " << result.samples.back() << "}";
+		if (benchmarkCase.bytesPerOperation) {
+			stream << ",\n      \"bytesPerSecond\": "
+			       << benchmarkCase.bytesPerOperation * 1e9 / median;
+		}
+		if (benchmarkCase.itemsPerOperation) {
+			stream << ",\n      \"itemsPerSecond\": "
+			       << benchmarkCase.itemsPerOperation * 1e9 / median;
+		}
+		stream << "\n    }";
+	}
+
+	stream << "\n  ]\n";
+	stream << "}\n";
+}
+
+static void printResult(const Result& result) {
+	std::cout << std::left << std::setw(44) << result.benchmarkCase->name
+	          << std::right << std::fixed << std::setprecision(1)
+	          << std::setw(14) << result.percentile(50) << " ns/op"
+	          << std::setw(14) << result.percentile(90) << " p90\n";
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+	for (int i = 1; i < argc; i++) {
+		std::string_view argument = argv[i];
+		if (i + 1 >= argc) return false;
+		const char* value = argv[++i];
+
+		if (argument == "--filter") {
+			options.filter = value;
+		} else if (argument == "--out") {
+			options.output = value;
+		} else if (argument == "--samples") {
+			options.samples = std::atoi(value);
+		} else if (argument == "--sample-ms") {
+			options.sampleMs = std::atoi(value);
+		} else {
+			return false;
+		}
+	}
+
+	return options.samples > 0 && options.sampleMs > 0;
+}
+
+namespace Benchmark {
+void add(Case&& benchmarkCase) {
+	getCases().push_back(std::move(benchmarkCase));
+}
+
+int run(int argc, char** argv) {
+	// Released when done, before anything the cases use goes away
+	std::vector<Case> cases = std::move(getCases());
+	getCases().clear();
+
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		std::cerr << usage;
+		return 1;
+	}
+
+	std::vector<Result> results;
+	for (const Case& benchmarkCase : cases) {
+		if (benchmarkCase.name.find(options.filter) == std::string::npos) continue;
+
+		results.push_back(runCase(benchmarkCase, options));
+		printResult(results.back());
+	}
+
+	std::ofstream file(options.output);
+	if (!file) {
+		std::cerr << "Could not open " << options.output << ": "
+		          << std::strerror(errno) << '\n';
+		return 1;
+	}
+	writeJSON(file, results, options);
+
+	std::cout << "Wrote " << results.size() << " results to " << options.output
+	          << '\n';
+	return 0;
+}
+};  // namespace Benchmark
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Minimal microbenchmark runner. Each case is timed in samples of many
+// iterations, with the iteration count grown until a sample takes long
+// enough to time reliably, and reported per operation.
+namespace Benchmark {
+struct Case {
+	std::string name;
+	// Runs the operation this many times
+	std::function<void(uint64_t iterations)> body;
+	// What one operation processes, for reporting throughput
+	uint64_t bytesPerOperation = 0;
+	uint64_t itemsPerOperation = 0;
+};
+
+void add(Case&& benchmarkCase);
+// Runs every case matching --filter, prints a summary and writes the results
+// as JSON to --out. Returns the process exit code.
+int run(int argc, char** argv);
+
+// Keeps the compiler from optimising a result away
+template <typename T>
+inline void doNotOptimize(const T& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+};  // namespace Benchmark
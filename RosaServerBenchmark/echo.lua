@@ -0,0 +1,13 @@
+-- Worker for the message benchmark, sends every message straight back
+
+while true do
+	local message, stopped = waitMessage(1000)
+	if stopped then
+		break
+	end
+
+	while message do
+		sendMessage(message)
+		message = receiveMessage()
+	end
+end
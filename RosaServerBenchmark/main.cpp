@@ -0,0 +1,258 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#include "benchmark.h"
+#include "crypto.h"
+#include "lz4impl.h"
+#include "pointgraph.h"
+#include "sol/sol.hpp"
+#include "sqlite.h"
+#include "tcpclient.h"
+#include "tcpserver.h"
+#include "worker.h"
+
+static constexpr unsigned short tcpPort = 27182;
+static constexpr size_t tcpChunkSize = 16384;
+static constexpr int workerBatchSize = 256;
+static constexpr int gridSize = 64;
+static constexpr unsigned int connectTimeoutMs = 1000;
+
+static constexpr const char* errorAcceptTimeout =
+    "Timed out accepting the benchmark connection";
+
+using Benchmark::doNotOptimize;
+
+// Text that compresses about as well as typical serialized game state
+static std::string makeCompressibleInput(size_t size) {
+	std::string input;
+	input.reserve(size + 64);
+	for (int i = 0; input.size() < size; i++) {
+		input += "human " + std::to_string(i) + " pos " +
+		         std::to_string(i * 7919 % 1000) + " " +
+		         std::to_string(i * 104729 % 100) + " health 100\n";
+	}
+	input.resize(size);
+	return input;
+}
+
+// A square grid with links between neighbours and a wall down the middle
+// with a single gap, so paths have to detour
+static std::shared_ptr<PointGraph> makeGrid() {
+	auto graph = PointGraph::create(gridSize * gridSize * 2);
+	for (int y = 0; y < gridSize; y++) {
+		for (int x = 0; x < gridSize; x++) {
+			graph->addNode(x, y, 0);
+		}
+	}
+
+	auto isWall = [](int x, int y) { return x == gridSize / 2 && y != 0; };
+	auto link = [&](int fromX, int fromY, int toX, int toY) {
+		if (toX >= gridSize || toY >= gridSize) return;
+		if (isWall(fromX, fromY) || isWall(toX, toY)) return;
+		unsigned int from = fromY * gridSize + fromX;
+		unsigned int to = toY * gridSize + toX;
+		graph->addLink(from, to, 1);
+		graph->addLink(to, from, 1);
+	};
+
+	for (int y = 0; y < gridSize; y++) {
+		for (int x = 0; x < gridSize; x++) {
+			link(x, y, x + 1, y);
+			link(x, y, x, y + 1);
+		}
+	}
+
+	graph->freeze();
+	return graph;
+}
+
+static void addPointGraphBenchmarks(lua_State* L) {
+	const unsigned int goal = gridSize * gridSize - 1;
+
+	auto graph = makeGrid();
+	auto search = [=](uint64_t n) {
+		for (uint64_t i = 0; i < n; i++) {
+			doNotOptimize(graph->findShortestPath(0, goal, sol::this_state{L}));
+		}
+	};
+	Benchmark::add({"pointGraph.findShortestPath/grid64", search});
+
+	auto hierarchical = makeGrid();
+	hierarchical->buildHierarchy(8);
+	auto hierarchicalSearch = [=](uint64_t n) {
+		for (uint64_t i = 0; i < n; i++) {
+			doNotOptimize(
+			    hierarchical->findShortestPath(0, goal, sol::this_state{L}));
+		}
+	};
+	Benchmark::add(
+	    {"pointGraph.findShortestPath/grid64Hierarchy", hierarchicalSearch});
+}
+
+// Calls query with its arguments on the Lua stack, the same as a call from Lua
+template <typename... Args>
+static std::tuple<sol::object, sol::object> query(SQLite& db, lua_State* L,
+                                                  const char* sql,
+                                                  Args&&... args) {
+	int top = lua_gettop(L);
+	(sol::stack::push(L, std::forward<Args>(args)), ...);
+	auto result =
+	    db.query(sql, sol::variadic_args(L, top + 1), sol::this_state{L});
+	lua_settop(L, top);
+
+	auto& error = std::get<1>(result);
+	if (error.get_type() == sol::type::string) {
+		throw std::runtime_error(error.as<std::string>());
+	}
+	return result;
+}
+
+static void addSQLiteBenchmarks(lua_State* L) {
+	auto db = std::make_shared<SQLite>(":memory:");
+	query(*db, L, "CREATE TABLE entries (id INTEGER PRIMARY KEY, value TEXT)");
+	query(*db, L,
+	      "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE "
+	      "i < 1000) INSERT INTO entries SELECT i, 'value ' || i FROM n");
+
+	auto selectOne = [=](uint64_t n) {
+		for (uint64_t i = 0; i < n; i++) {
+			doNotOptimize(query(*db, L, "SELECT value FROM entries WHERE id = ?",
+			                    (int)(i % 1000) + 1));
+		}
+	};
+	Benchmark::add({"sqlite.query/selectOne", selectOne});
+
+	auto selectMany = [=](uint64_t n) {
+		for (uint64_t i = 0; i < n; i++) {
+			doNotOptimize(
+			    query(*db, L, "SELECT id, value FROM entries WHERE id <= 100"));
+		}
+	};
+	Benchmark::add({"sqlite.query/select100", selectMany, 0, 100});
+}
+
+static void addLZ4Benchmarks() {
+	auto input = std::make_shared<std::string>(makeCompressibleInput(65536));
+
+	auto compress = [=](uint64_t n) {
+		for (uint64_t i = 0; i < n; i++) {
+			doNotOptimize(Lua::lz4::_compress(*input, sol::nullopt));
+		}
+	};
+	Benchmark::add({"lz4.compress/64KB", compress, input->size()});
+
+	auto compressHC = [=](uint64_t n) {
+		for (uint64_t i = 0; i < n; i++) {
+			doNotOptimize(Lua::lz4::_compress(*input, 9));
+		}
+	};
+	Benchmark::add({"lz4.compress/64KBHighCompression", compressHC,
+	                input->size()});
+}
+
+static void addCryptoBenchmarks() {
+	for (auto [size, label] : {std::pair{64, "64B"}, std::pair{65536, "64KB"}}) {
+		auto input = std::make_shared<std::string>(makeCompressibleInput(size));
+
+		auto hash = [=](uint64_t n) {
+			for (uint64_t i = 0; i < n; i++) {
+				doNotOptimize(Lua::crypto::sha256(*input, true));
+			}
+		};
+		Benchmark::add(
+		    {std::string("crypto.sha256/") + label, hash, input->size()});
+	}
+}
+
+// Sends a batch of messages to a worker which echoes them back, and waits for
+// all of them
+static void addWorkerBenchmarks(lua_State* L) {
+	auto worker = std::make_shared<Worker>(ECHO_WORKER_FILE);
+	const std::string message(64, 'x');
+
+	auto roundTrip = [=](uint64_t n) {
+		for (uint64_t i = 0; i < n; i++) {
+			for (int sent = 0; sent < workerBatchSize; sent++) {
+				worker->sendMessage(message);
+			}
+
+			for (int received = 0; received < workerBatchSize;) {
+				sol::object reply = worker->receiveMessage(sol::this_state{L});
+				if (reply.get_type() == sol::type::string) {
+					received++;
+				} else {
+					std::this_thread::yield();
+				}
+			}
+		}
+	};
+	Benchmark::add(
+	    {"worker.messageRoundTrip/batch256", roundTrip, 0, workerBatchSize});
+}
+
+static std::shared_ptr<TCPServerConnection> acceptConnection(TCPServer& server,
+                                                             lua_State* L) {
+	auto deadline = std::chrono::steady_clock::now() +
+	                std::chrono::milliseconds(connectTimeoutMs);
+	while (std::chrono::steady_clock::now() < deadline) {
+		sol::object connection = server.accept(sol::this_state{L});
+		if (connection.get_type() == sol::type::userdata) {
+			return connection.as<std::shared_ptr<TCPServerConnection>>();
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	throw std::runtime_error(errorAcceptTimeout);
+}
+
+// Sends a chunk over loopback and reads it back out of the server side
+static void addTCPBenchmarks(lua_State* L) {
+	auto server = std::make_shared<TCPServer>(tcpPort);
+	auto client =
+	    std::make_shared<TCPClient>("127.0.0.1", std::to_string(tcpPort));
+	auto connection = acceptConnection(*server, L);
+	const std::string chunk(tcpChunkSize, 'x');
+
+	auto receive = [=](uint64_t n) {
+		for (uint64_t i = 0; i < n; i++) {
+			client->send(chunk);
+			client->flush();
+
+			for (size_t received = 0; received < chunk.size();) {
+				sol::object data =
+				    connection->receive(tcpChunkSize, sol::this_state{L});
+				if (data.get_type() == sol::type::string) {
+					received += data.as<std::string_view>().size();
+				}
+			}
+		}
+	};
+	Benchmark::add({"tcp.receive/16KB", receive, tcpChunkSize});
+}
+
+int main(int argc, char** argv) {
+	sol::state lua;
+	lua.open_libraries(sol::lib::base);
+	lua_State* L = lua.lua_state();
+
+	try {
+		addPointGraphBenchmarks(L);
+		addSQLiteBenchmarks(L);
+		addLZ4Benchmarks();
+		addCryptoBenchmarks();
+		addWorkerBenchmarks(L);
+		addTCPBenchmarks(L);
+
+		return Benchmark::run(argc, argv);
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+}
@@ -1,19 +1,32 @@
+#include <poll.h>
 #include <unistd.h>
 
 #include <chrono>
+#include <cstring>
+#include <memory>
 #include <thread>
 
+#include "channel.h"
+#include "serializer.h"
 #include "sol/sol.hpp"
 
 static constexpr int CODE_INVALID_USAGE = 1;
 static constexpr int CODE_FILE_INVALID = 2;
 static constexpr int CODE_FILE_RUNTIME_ERROR = 3;
 
-static constexpr const char* ERR_WRITING_MESSAGE =
-    "Couldn't write full message to pipe";
+static constexpr const char* ERR_PARENT_GONE = "Parent process is gone";
+static constexpr const char* ERR_NOT_FUNCTION = "Job function not found: ";
+
+// How often a blocked send checks whether the parent is still there
+static constexpr int PARENT_CHECK_MS = 1000;
 
 static int fdFromParent;
 static int fdToParent;
+static pid_t parentPID;
+
+// Set when the parent passed shared memory instead of pipes
+static std::unique_ptr<Channel::SharedTransport> shared;
+static Channel::Assembler incoming;
 
 static double l_os_realClock() {
 	auto now = std::chrono::steady_clock::now();
@@ -23,45 +36,145 @@ static double l_os_realClock() {
 	return value.count() / 1000.;
 }
 
+static bool readMessage(std::string& message) {
+	if (incoming.next(message)) {
+		return true;
+	}
+
+	if (shared) {
+		shared->receive(incoming);
+	} else {
+		Channel::readPipe(fdFromParent, incoming);
+	}
+
+	return incoming.next(message);
+}
+
+// Returns false on timeout, or if the pipe was closed with nothing left
+static bool waitReadable(int timeoutMs) {
+	if (shared) {
+		return shared->wait(timeoutMs);
+	}
+
+	pollfd fd{fdFromParent, POLLIN, 0};
+	int res = poll(&fd, 1, timeoutMs);
+	if (res == -1 && errno != EINTR) {
+		throw std::runtime_error(strerror(errno));
+	}
+	return res > 0 && (fd.revents & POLLIN);
+}
+
+// Blocks until the parent has room for everything sent so far
+static void flushShared() {
+	while (!shared->flush()) {
+		if (!shared->wait(PARENT_CHECK_MS) && getppid() != parentPID) {
+			throw std::runtime_error(ERR_PARENT_GONE);
+		}
+	}
+}
+
 static sol::object l_receiveMessage(sol::this_state s) {
 	sol::state_view lua(s);
 
-	unsigned int length;
+	std::string message;
+	if (readMessage(message)) {
+		return sol::make_object(lua, message);
+	}
 
-	auto bytesRead = read(fdFromParent, &length, sizeof(length));
-	if (bytesRead == -1) {
-		if (errno != EAGAIN) {
-			throw std::runtime_error(strerror(errno));
-		}
-	} else if (bytesRead == sizeof(length)) {
-		std::string message(length, ' ');
-		bytesRead = read(fdFromParent, message.data(), length);
-		if (bytesRead == -1) {
-			if (errno != EAGAIN) {
-				throw std::runtime_error(strerror(errno));
+	return sol::make_object(lua, sol::nil);
+}
+
+// There are no Vector or RotMatrix types here, so those arrive as tables
+static sol::object l_receive(sol::this_state s) {
+	std::string message;
+	if (readMessage(message)) {
+		return Serializer::decode(s, message);
+	}
+
+	return sol::make_object(sol::state_view(s), sol::nil);
+}
+
+// Returns the next message, or nil if none arrives within the timeout
+static sol::object l_waitMessage(int timeoutMs, sol::this_state s) {
+	sol::state_view lua(s);
+
+	auto deadline =
+	    std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+	std::string message;
+	while (!readMessage(message)) {
+		auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+		                     deadline - std::chrono::steady_clock::now())
+		                     .count();
+		if (remaining <= 0 || !waitReadable(remaining)) {
+			if (readMessage(message)) {
+				break;
 			}
-		} else if (bytesRead == length) {
-			return sol::make_object(lua, message);
+			return sol::make_object(lua, sol::nil);
 		}
 	}
 
-	return sol::make_object(lua, sol::nil);
+	return sol::make_object(lua, message);
 }
 
-static void l_sendMessage(std::string message) {
-	unsigned int length = static_cast<unsigned int>(message.length());
-
-	auto bytesWritten = write(fdToParent, &length, sizeof(length));
-	if (bytesWritten == -1) {
-		throw std::runtime_error(strerror(errno));
-	} else if (bytesWritten != sizeof(length)) {
-		throw std::runtime_error(ERR_WRITING_MESSAGE);
+static void l_sendMessage(std::string_view message) {
+	if (shared) {
+		if (!shared->send(message)) {
+			flushShared();
+		}
 	} else {
-		bytesWritten = write(fdToParent, message.data(), length);
-		if (bytesWritten == -1) {
-			throw std::runtime_error(strerror(errno));
-		} else if (bytesWritten != length) {
-			throw std::runtime_error(ERR_WRITING_MESSAGE);
+		Channel::writePipe(fdToParent, message);
+	}
+}
+
+static void l_send(sol::object value) {
+	l_sendMessage(Serializer::encode(value));
+}
+
+// Runs jobs from a SatellitePool until the parent goes away, keeping the
+// state and everything the script loaded between them
+static void serveJobs(sol::state& lua) {
+	std::string message;
+	while (true) {
+		if (!readMessage(message)) {
+			if (!waitReadable(PARENT_CHECK_MS) && getppid() != parentPID) {
+				return;
+			}
+			continue;
+		}
+
+		Channel::Job job;
+		if (!Channel::decodeJob(message, job)) continue;
+
+		bool success = false;
+		std::string value;
+
+		sol::object function = lua[job.functionName];
+		if (function.get_type() != sol::type::function) {
+			value = std::string(ERR_NOT_FUNCTION).append(job.functionName);
+		} else {
+			try {
+				sol::object argument = Serializer::decode(lua, job.argument);
+				sol::protected_function_result res =
+				    function.as<sol::protected_function>()(argument);
+				if (res.valid()) {
+					sol::object result = res;
+					value = Serializer::encode(result);
+					success = true;
+				} else {
+					sol::error err = res;
+					value = err.what();
+				}
+			} catch (std::exception& e) {
+				value = e.what();
+			}
+		}
+
+		try {
+			l_sendMessage(Channel::encodeJobResult(job.id, success, value));
+		} catch (std::exception&) {
+			// The parent went away while waiting for room
+			return;
 		}
 	}
 }
@@ -86,6 +199,20 @@ int main(int argc, const char* argv[]) {
 	fdFromParent = atoi(argv[1]);
 	fdToParent = atoi(argv[2]);
 	const char* fileName = argv[3];
+	parentPID = getppid();
+
+	// Either "script", or "jobs" to serve a SatellitePool once the script has
+	// loaded
+	bool isPoolMember = argc >= 5 && strcmp(argv[4], "jobs") == 0;
+
+	// Shared memory descriptor, ring capacity, then the parent and child
+	// wakeup eventfds
+	if (argc >= 9) {
+		Channel::SharedDescriptors descriptors{atoi(argv[5]), atoi(argv[7]),
+		                                       atoi(argv[8])};
+		shared = std::make_unique<Channel::SharedTransport>();
+		shared->open(descriptors, strtoull(argv[6], nullptr, 10), false);
+	}
 
 	sol::state lua;
 
@@ -110,6 +237,9 @@ int main(int argc, const char* argv[]) {
 
 	lua["receiveMessage"] = l_receiveMessage;
 	lua["sendMessage"] = l_sendMessage;
+	lua["receive"] = l_receive;
+	lua["send"] = l_send;
+	lua["waitMessage"] = l_waitMessage;
 
 	lua["sleep"] = [](unsigned int ms) {
 		std::this_thread::sleep_for(std::chrono::milliseconds(ms));
@@ -121,6 +251,10 @@ int main(int argc, const char* argv[]) {
 		if (!res.valid()) {
 			return CODE_FILE_RUNTIME_ERROR;
 		}
+
+		if (isPoolMember) {
+			serveJobs(lua);
+		}
 	} else {
 		return CODE_FILE_INVALID;
 	}
@@ -0,0 +1,421 @@
+#pragma once
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Length prefixed messages between ChildProcess and the satellite, over
+// either a pair of pipes or a pair of rings in shared memory. Both ends
+// include this so the two sides can't disagree on the format.
+//
+// Each message is a native unsigned int length followed by that many bytes.
+namespace Channel {
+using Length = unsigned int;
+
+static constexpr size_t pipeReadSize = 65536;
+static constexpr uint64_t minRingCapacity = 4096;
+static constexpr uint64_t maxRingCapacity = 1 << 30;
+
+static constexpr const char* errorWritingMessage =
+    "Couldn't write full message to pipe";
+
+[[noreturn]] inline void throwErrno() {
+	throw std::runtime_error(strerror(errno));
+}
+
+// Bytes received so far, split into messages as they complete. Input can
+// arrive in pieces of any size, so a message is only handed out once all of
+// it is here.
+class Assembler {
+	std::string buffer;
+	size_t offset = 0;
+
+ public:
+	// Returns the buffer to append new input to
+	std::string& prepare() {
+		if (offset) {
+			buffer.erase(0, offset);
+			offset = 0;
+		}
+		return buffer;
+	}
+
+	bool next(std::string& message) {
+		Length length;
+		size_t available = buffer.size() - offset;
+		if (available < sizeof(length)) return false;
+
+		std::memcpy(&length, buffer.data() + offset, sizeof(length));
+		if (available - sizeof(length) < length) return false;
+
+		message.assign(buffer, offset + sizeof(length), length);
+		offset += sizeof(length) + length;
+		return true;
+	}
+};
+
+inline void appendFrame(std::string& out, std::string_view message) {
+	Length length = static_cast<Length>(message.size());
+	out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+	out.append(message);
+}
+
+// Reads everything a non-blocking pipe has into the assembler
+inline void readPipe(int fd, Assembler& assembler) {
+	std::string& buffer = assembler.prepare();
+	while (true) {
+		size_t size = buffer.size();
+		buffer.resize(size + pipeReadSize);
+
+		auto bytesRead = read(fd, buffer.data() + size, pipeReadSize);
+		buffer.resize(size + std::max<ssize_t>(bytesRead, 0));
+
+		if (bytesRead == -1) {
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+			throwErrno();
+		}
+		if ((size_t)bytesRead < pipeReadSize) return;
+	}
+}
+
+// Writes the length and message with one call where the pipe allows it
+inline void writePipe(int fd, std::string_view message) {
+	Length length = static_cast<Length>(message.size());
+	iovec pieces[2] = {{&length, sizeof(length)},
+	                   {const_cast<char*>(message.data()), message.size()}};
+	size_t remaining = sizeof(length) + message.size();
+
+	iovec* piece = pieces;
+	int numPieces = 2;
+	while (remaining) {
+		auto bytesWritten = writev(fd, piece, numPieces);
+		if (bytesWritten == -1) {
+			if (errno == EINTR) continue;
+			throwErrno();
+		}
+		if (bytesWritten == 0) throw std::runtime_error(errorWritingMessage);
+
+		remaining -= bytesWritten;
+		while (numPieces && (size_t)bytesWritten >= piece->iov_len) {
+			bytesWritten -= piece->iov_len;
+			piece++;
+			numPieces--;
+		}
+		if (numPieces) {
+			piece->iov_base = static_cast<char*>(piece->iov_base) + bytesWritten;
+			piece->iov_len -= bytesWritten;
+		}
+	}
+}
+
+// Satellite pool jobs are the job id and function name's length and bytes,
+// then the serialized argument. Results are the job id and whether it
+// succeeded, then the serialized return value or the error message.
+struct Job {
+	uint32_t id;
+	std::string_view functionName;
+	std::string_view argument;
+};
+
+struct JobResult {
+	uint32_t id;
+	bool success;
+	std::string_view value;
+};
+
+inline std::string encodeJob(uint32_t id, std::string_view functionName,
+                             std::string_view argument) {
+	uint32_t nameLength = static_cast<uint32_t>(functionName.size());
+
+	std::string out;
+	out.reserve(sizeof(id) + sizeof(nameLength) + functionName.size() +
+	            argument.size());
+	out.append(reinterpret_cast<const char*>(&id), sizeof(id));
+	out.append(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength));
+	out.append(functionName);
+	out.append(argument);
+	return out;
+}
+
+inline bool decodeJob(std::string_view message, Job& job) {
+	uint32_t nameLength;
+	if (message.size() < sizeof(job.id) + sizeof(nameLength)) return false;
+
+	std::memcpy(&job.id, message.data(), sizeof(job.id));
+	std::memcpy(&nameLength, message.data() + sizeof(job.id),
+	            sizeof(nameLength));
+	message.remove_prefix(sizeof(job.id) + sizeof(nameLength));
+	if (message.size() < nameLength) return false;
+
+	job.functionName = message.substr(0, nameLength);
+	job.argument = message.substr(nameLength);
+	return true;
+}
+
+inline std::string encodeJobResult(uint32_t id, bool success,
+                                   std::string_view value) {
+	std::string out;
+	out.reserve(sizeof(id) + 1 + value.size());
+	out.append(reinterpret_cast<const char*>(&id), sizeof(id));
+	out.push_back(success);
+	out.append(value);
+	return out;
+}
+
+inline bool decodeJobResult(std::string_view message, JobResult& result) {
+	if (message.size() < sizeof(result.id) + 1) return false;
+
+	std::memcpy(&result.id, message.data(), sizeof(result.id));
+	result.success = message[sizeof(result.id)];
+	result.value = message.substr(sizeof(result.id) + 1);
+	return true;
+}
+
+// Positions only ever increase, and wrap into the data with a mask
+struct RingHeader {
+	alignas(64) std::atomic<uint64_t> head;
+	alignas(64) std::atomic<uint64_t> tail;
+	// Set by a writer that ran out of space, so the reader wakes it
+	alignas(64) std::atomic<uint32_t> writerWaiting;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<uint32_t>::is_always_lock_free,
+              "Ring atomics have to work across processes");
+
+// Byte stream in shared memory with exactly one writer and one reader
+class Ring {
+	RingHeader* header = nullptr;
+	char* data = nullptr;
+	uint64_t capacity = 0;
+
+ public:
+	static size_t regionSize(uint64_t capacity) {
+		return sizeof(RingHeader) + capacity;
+	}
+
+	void attach(char* region, uint64_t capacity) {
+		header = reinterpret_cast<RingHeader*>(region);
+		data = region + sizeof(RingHeader);
+		this->capacity = capacity;
+	}
+
+	// Writes as much as fits and returns how much that was. caughtUp is set if
+	// the reader had already read everything before this, so it may be
+	// waiting to be woken.
+	size_t write(const char* bytes, size_t size, bool& caughtUp) {
+		uint64_t tail = header->tail.load(std::memory_order_relaxed);
+		uint64_t head = header->head.load(std::memory_order_acquire);
+		size_t count = std::min<uint64_t>(size, capacity - (tail - head));
+
+		size_t start = tail & (capacity - 1);
+		size_t first = std::min<uint64_t>(count, capacity - start);
+		std::memcpy(data + start, bytes, first);
+		std::memcpy(data, bytes + first, count - first);
+
+		header->tail.store(tail + count, std::memory_order_seq_cst);
+		// Checked after publishing, so a reader that saw the old tail and went
+		// to sleep is always seen here
+		caughtUp = header->head.load(std::memory_order_seq_cst) >= tail;
+		return count;
+	}
+
+	// Appends everything readable and returns how much that was
+	size_t read(std::string& out) {
+		uint64_t head = header->head.load(std::memory_order_relaxed);
+		uint64_t tail = header->tail.load(std::memory_order_acquire);
+		size_t count = tail - head;
+		if (!count) return 0;
+
+		size_t start = head & (capacity - 1);
+		size_t first = std::min<uint64_t>(count, capacity - start);
+		out.append(data + start, first);
+		out.append(data, count - first);
+
+		header->head.store(tail, std::memory_order_seq_cst);
+		return count;
+	}
+
+	void setWriterWaiting() {
+		header->writerWaiting.store(1, std::memory_order_seq_cst);
+	}
+
+	bool takeWriterWaiting() {
+		return header->writerWaiting.exchange(0, std::memory_order_seq_cst);
+	}
+};
+
+// Descriptors the parent creates before forking, which the child is passed
+// on its command line
+struct SharedDescriptors {
+	int memory;
+	// Written to wake the parent or the child
+	int wakeParent;
+	int wakeChild;
+};
+
+// Clamps to the supported range and rounds up to a power of two
+inline uint64_t ringCapacityFor(uint64_t size) {
+	uint64_t capacity = minRingCapacity;
+	while (capacity < size && capacity < maxRingCapacity) capacity *= 2;
+	return capacity;
+}
+
+// Two rings in one shared mapping, one for each direction. Wakeups go through
+// eventfds, and only when the other side may be asleep, so a burst of
+// messages costs one wakeup rather than one each.
+class SharedTransport {
+	SharedDescriptors descriptors{-1, -1, -1};
+	int selfWake = -1;
+	int peerWake = -1;
+	void* mapping = MAP_FAILED;
+	size_t mappingSize = 0;
+
+	Ring outbound;
+	Ring inbound;
+
+	// Framed bytes that didn't fit in the outbound ring yet
+	std::string backlog;
+	size_t backlogOffset = 0;
+
+	static void wake(int fd) {
+		uint64_t one = 1;
+		// A full counter already means a pending wakeup
+		while (::write(fd, &one, sizeof(one)) == -1 && errno == EINTR)
+			;
+	}
+
+ public:
+	SharedTransport() = default;
+	SharedTransport(const SharedTransport&) = delete;
+	SharedTransport& operator=(const SharedTransport&) = delete;
+
+	~SharedTransport() {
+		if (mapping != MAP_FAILED) munmap(mapping, mappingSize);
+		for (int fd :
+		     {descriptors.memory, descriptors.wakeParent, descriptors.wakeChild}) {
+			if (fd != -1) ::close(fd);
+		}
+	}
+
+	// Creates the shared memory and eventfds without close-on-exec, so a
+	// forked child can be told their numbers
+	static SharedDescriptors create(uint64_t capacity) {
+		SharedDescriptors created{-1, -1, -1};
+
+		created.memory = memfd_create("rosaserver-channel", 0);
+		if (created.memory == -1) throwErrno();
+
+		created.wakeParent = eventfd(0, EFD_NONBLOCK);
+		created.wakeChild = eventfd(0, EFD_NONBLOCK);
+		if (created.wakeParent == -1 || created.wakeChild == -1 ||
+		    ftruncate(created.memory, Ring::regionSize(capacity) * 2) == -1) {
+			int error = errno;
+			for (int fd : {created.memory, created.wakeParent, created.wakeChild}) {
+				if (fd != -1) ::close(fd);
+			}
+			errno = error;
+			throwErrno();
+		}
+
+		return created;
+	}
+
+	// Takes ownership of the descriptors
+	void open(const SharedDescriptors& shared, uint64_t capacity,
+	          bool isParent) {
+		descriptors = shared;
+		mappingSize = Ring::regionSize(capacity) * 2;
+		mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+		               shared.memory, 0);
+		if (mapping == MAP_FAILED) throwErrno();
+
+		char* region = static_cast<char*>(mapping);
+		Ring toChild;
+		Ring toParent;
+		toChild.attach(region, capacity);
+		toParent.attach(region + Ring::regionSize(capacity), capacity);
+
+		outbound = isParent ? toChild : toParent;
+		inbound = isParent ? toParent : toChild;
+		selfWake = isParent ? shared.wakeParent : shared.wakeChild;
+		peerWake = isParent ? shared.wakeChild : shared.wakeParent;
+	}
+
+	// Returns true once nothing is left in the backlog
+	bool flush() {
+		while (backlogOffset < backlog.size()) {
+			bool caughtUp;
+			size_t written =
+			    outbound.write(backlog.data() + backlogOffset,
+			                   backlog.size() - backlogOffset, caughtUp);
+			backlogOffset += written;
+			if (written && caughtUp) wake(peerWake);
+
+			if (backlogOffset < backlog.size()) {
+				if (written) continue;
+
+				// Try once more after asking to be woken, in case the reader made
+				// room before it could see the flag
+				outbound.setWriterWaiting();
+				written = outbound.write(backlog.data() + backlogOffset,
+				                         backlog.size() - backlogOffset, caughtUp);
+				backlogOffset += written;
+				if (written && caughtUp) wake(peerWake);
+				if (!written) return false;
+			}
+		}
+
+		backlog.clear();
+		backlogOffset = 0;
+		return true;
+	}
+
+	// Never blocks. Whatever doesn't fit is kept until a later flush.
+	bool send(std::string_view message) {
+		if (backlogOffset) {
+			backlog.erase(0, backlogOffset);
+			backlogOffset = 0;
+		}
+		appendFrame(backlog, message);
+		return flush();
+	}
+
+	void receive(Assembler& assembler) {
+		if (inbound.read(assembler.prepare()) && inbound.takeWriterWaiting()) {
+			wake(peerWake);
+		}
+	}
+
+	size_t getBacklogSize() const { return backlog.size() - backlogOffset; }
+
+	// Sleeps until the other side writes or makes room, or the timeout passes.
+	// Returns false on timeout.
+	bool wait(int timeoutMs) {
+		pollfd fd{selfWake, POLLIN, 0};
+		int res = poll(&fd, 1, timeoutMs);
+		if (res == -1) {
+			if (errno == EINTR) return true;
+			throwErrno();
+		}
+		if (res == 0) return false;
+
+		uint64_t count;
+		while (::read(selfWake, &count, sizeof(count)) == -1 && errno == EINTR)
+			;
+		return true;
+	}
+};
+};  // namespace Channel
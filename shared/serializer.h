@@ -0,0 +1,365 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "sol/sol.hpp"
+
+// Compact binary encoding of Lua values, shared by RosaServer and the
+// satellite so structured data can cross thread and process boundaries
+// without going through strings in Lua.
+//
+// Supports nil, booleans, numbers, strings, nested tables and vector/rotation
+// matrix userdata. How userdata is recognised and recreated is up to the
+// Userdata parameter, since only RosaServer has the real types.
+namespace Serializer {
+static constexpr int maxDepth = 128;
+
+static constexpr const char* errorMalformed = "Malformed serialized data";
+static constexpr const char* errorTooDeep =
+    "Value is nested too deeply to serialize (cyclic table?)";
+static constexpr const char* errorUnsupported =
+    "Cannot serialize a value of type ";
+
+enum Tag : uint8_t {
+	TagNil,
+	TagFalse,
+	TagTrue,
+	TagInteger,
+	TagDouble,
+	TagString,
+	TagTable,
+	TagVector,
+	TagRotMatrix
+};
+
+static constexpr int vectorFloats = 3;
+static constexpr int rotMatrixFloats = 9;
+
+// Used where the engine types don't exist: nothing is recognised as userdata,
+// and vectors and rotation matrices decode to plain tables of their fields
+struct TableUserdata {
+	static Tag read(lua_State* L, int index, float* floats) { return TagNil; }
+
+	static void pushVector(lua_State* L, const float* floats) {
+		static constexpr const char* fields[] = {"x", "y", "z"};
+		pushFields(L, fields, floats, vectorFloats);
+	}
+
+	static void pushRotMatrix(lua_State* L, const float* floats) {
+		static constexpr const char* fields[] = {"x1", "y1", "z1", "x2", "y2",
+		                                         "z2", "x3", "y3", "z3"};
+		pushFields(L, fields, floats, rotMatrixFloats);
+	}
+
+ private:
+	static void pushFields(lua_State* L, const char* const* fields,
+	                       const float* floats, int count) {
+		lua_createtable(L, 0, count);
+		for (int i = 0; i < count; i++) {
+			lua_pushnumber(L, floats[i]);
+			lua_setfield(L, -2, fields[i]);
+		}
+	}
+};
+
+namespace detail {
+inline void writeVarint(std::string& out, uint64_t value) {
+	while (value >= 0x80) {
+		out.push_back((char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((char)value);
+}
+
+template <typename T>
+inline void writeRaw(std::string& out, T value) {
+	out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+struct Reader {
+	const char* cursor;
+	const char* end;
+
+	uint8_t byte() {
+		if (cursor == end) throw std::runtime_error(errorMalformed);
+		return *cursor++;
+	}
+
+	uint64_t varint() {
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			uint8_t b = byte();
+			value |= (uint64_t)(b & 0x7f) << shift;
+			if (!(b & 0x80)) return value;
+		}
+		throw std::runtime_error(errorMalformed);
+	}
+
+	template <typename T>
+	T raw() {
+		if ((size_t)(end - cursor) < sizeof(T)) {
+			throw std::runtime_error(errorMalformed);
+		}
+		T value;
+		std::memcpy(&value, cursor, sizeof(T));
+		cursor += sizeof(T);
+		return value;
+	}
+
+	const char* bytes(size_t length) {
+		if ((size_t)(end - cursor) < length) {
+			throw std::runtime_error(errorMalformed);
+		}
+		const char* start = cursor;
+		cursor += length;
+		return start;
+	}
+};
+
+inline void writeNumber(std::string& out, double number) {
+	// Whole numbers that fit in a double's mantissa are stored as zigzag
+	// varints, which is 1-3 bytes for most ids, counts and indices
+	if (number == std::floor(number) && std::fabs(number) <= 9007199254740992.) {
+		int64_t value = (int64_t)number;
+		out.push_back(TagInteger);
+		writeVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+	} else {
+		out.push_back(TagDouble);
+		writeRaw(out, number);
+	}
+}
+
+template <typename Userdata>
+void encodeValue(lua_State* L, int index, std::string& out, int depth);
+
+template <typename Userdata>
+void encodeTable(lua_State* L, int index, std::string& out, int depth) {
+	if (depth >= maxDepth) throw std::runtime_error(errorTooDeep);
+	luaL_checkstack(L, 3, nullptr);
+
+	size_t arraySize = 0;
+	while (true) {
+		lua_rawgeti(L, index, arraySize + 1);
+		bool present = !lua_isnil(L, -1);
+		lua_pop(L, 1);
+		if (!present) break;
+		arraySize++;
+	}
+
+	out.push_back(TagTable);
+	writeVarint(out, arraySize);
+
+	// Patched once the rest of the table has been walked
+	size_t hashCountOffset = out.size();
+	writeRaw<uint32_t>(out, 0);
+
+	for (size_t i = 1; i <= arraySize; i++) {
+		lua_rawgeti(L, index, i);
+		encodeValue<Userdata>(L, lua_gettop(L), out, depth + 1);
+		lua_pop(L, 1);
+	}
+
+	uint32_t hashCount = 0;
+	lua_pushnil(L);
+	while (lua_next(L, index)) {
+		int keyIndex = lua_gettop(L) - 1;
+		if (lua_type(L, keyIndex) == LUA_TNUMBER) {
+			lua_Number key = lua_tonumber(L, keyIndex);
+			if (key >= 1 && key <= arraySize && key == std::floor(key)) {
+				lua_pop(L, 1);
+				continue;
+			}
+		}
+
+		encodeValue<Userdata>(L, keyIndex, out, depth + 1);
+		encodeValue<Userdata>(L, keyIndex + 1, out, depth + 1);
+		hashCount++;
+		lua_pop(L, 1);
+	}
+
+	std::memcpy(&out[hashCountOffset], &hashCount, sizeof(hashCount));
+}
+
+template <typename Userdata>
+void encodeValue(lua_State* L, int index, std::string& out, int depth) {
+	switch (lua_type(L, index)) {
+		case LUA_TNIL:
+			out.push_back(TagNil);
+			return;
+		case LUA_TBOOLEAN:
+			out.push_back(lua_toboolean(L, index) ? TagTrue : TagFalse);
+			return;
+		case LUA_TNUMBER:
+			writeNumber(out, lua_tonumber(L, index));
+			return;
+		case LUA_TSTRING: {
+			size_t length;
+			const char* data = lua_tolstring(L, index, &length);
+			out.push_back(TagString);
+			writeVarint(out, length);
+			out.append(data, length);
+			return;
+		}
+		case LUA_TTABLE:
+			encodeTable<Userdata>(L, index, out, depth);
+			return;
+		case LUA_TUSERDATA: {
+			float floats[rotMatrixFloats];
+			Tag tag = Userdata::read(L, index, floats);
+			if (tag == TagVector || tag == TagRotMatrix) {
+				out.push_back(tag);
+				out.append(reinterpret_cast<const char*>(floats),
+				           sizeof(float) *
+				               (tag == TagVector ? vectorFloats : rotMatrixFloats));
+				return;
+			}
+			break;
+		}
+	}
+
+	throw std::runtime_error(std::string(errorUnsupported) +
+	                         lua_typename(L, lua_type(L, index)));
+}
+
+template <typename Userdata>
+void decodeValue(lua_State* L, Reader& reader, int depth) {
+	if (depth >= maxDepth) throw std::runtime_error(errorTooDeep);
+	luaL_checkstack(L, 3, nullptr);
+
+	switch (reader.byte()) {
+		case TagNil:
+			lua_pushnil(L);
+			return;
+		case TagFalse:
+			lua_pushboolean(L, false);
+			return;
+		case TagTrue:
+			lua_pushboolean(L, true);
+			return;
+		case TagInteger: {
+			uint64_t zigzag = reader.varint();
+			int64_t value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+			lua_pushnumber(L, (lua_Number)value);
+			return;
+		}
+		case TagDouble:
+			lua_pushnumber(L, reader.raw<double>());
+			return;
+		case TagString: {
+			size_t length = reader.varint();
+			lua_pushlstring(L, reader.bytes(length), length);
+			return;
+		}
+		case TagTable: {
+			uint64_t arraySize = reader.varint();
+			uint32_t hashCount = reader.raw<uint32_t>();
+			// Each entry takes at least a byte, so this bounds the preallocation
+			if (arraySize > (uint64_t)(reader.end - reader.cursor) ||
+			    hashCount > (uint64_t)(reader.end - reader.cursor)) {
+				throw std::runtime_error(errorMalformed);
+			}
+
+			lua_createtable(L, (int)arraySize, (int)hashCount);
+			for (uint64_t i = 1; i <= arraySize; i++) {
+				decodeValue<Userdata>(L, reader, depth + 1);
+				lua_rawseti(L, -2, (int)i);
+			}
+			for (uint32_t i = 0; i < hashCount; i++) {
+				decodeValue<Userdata>(L, reader, depth + 1);
+				if (lua_isnil(L, -1)) throw std::runtime_error(errorMalformed);
+				decodeValue<Userdata>(L, reader, depth + 1);
+				lua_rawset(L, -3);
+			}
+			return;
+		}
+		case TagVector: {
+			float floats[vectorFloats];
+			std::memcpy(floats, reader.bytes(sizeof(floats)), sizeof(floats));
+			Userdata::pushVector(L, floats);
+			return;
+		}
+		case TagRotMatrix: {
+			float floats[rotMatrixFloats];
+			std::memcpy(floats, reader.bytes(sizeof(floats)), sizeof(floats));
+			Userdata::pushRotMatrix(L, floats);
+			return;
+		}
+	}
+
+	throw std::runtime_error(errorMalformed);
+}
+};  // namespace detail
+
+// For encoding values natively without a Lua state. A table header must be
+// followed by arraySize values, then hashCount key and value pairs.
+inline void writeBoolean(std::string& out, bool value) {
+	out.push_back(value ? TagTrue : TagFalse);
+}
+
+inline void writeNumber(std::string& out, double number) {
+	detail::writeNumber(out, number);
+}
+
+inline void writeTableHeader(std::string& out, size_t arraySize,
+                             uint32_t hashCount) {
+	out.push_back(TagTable);
+	detail::writeVarint(out, arraySize);
+	detail::writeRaw(out, hashCount);
+}
+
+template <typename Userdata = TableUserdata>
+std::string encode(lua_State* L, int index) {
+	if (index < 0) index = lua_gettop(L) + index + 1;
+
+	std::string out;
+	// Tables leave their keys and values on the stack if a nested value throws
+	int top = lua_gettop(L);
+	try {
+		detail::encodeValue<Userdata>(L, index, out, 0);
+	} catch (...) {
+		lua_settop(L, top);
+		throw;
+	}
+	return out;
+}
+
+template <typename Userdata = TableUserdata>
+std::string encode(const sol::object& value) {
+	lua_State* L = value.lua_state();
+	int top = lua_gettop(L);
+	value.push();
+	try {
+		std::string out = encode<Userdata>(L, -1);
+		lua_settop(L, top);
+		return out;
+	} catch (...) {
+		lua_settop(L, top);
+		throw;
+	}
+}
+
+// Pushes the decoded value onto the stack. The whole input must be one value.
+template <typename Userdata = TableUserdata>
+void push(lua_State* L, std::string_view data) {
+	detail::Reader reader{data.data(), data.data() + data.size()};
+	int top = lua_gettop(L);
+	try {
+		detail::decodeValue<Userdata>(L, reader, 0);
+		if (reader.cursor != reader.end) throw std::runtime_error(errorMalformed);
+	} catch (...) {
+		lua_settop(L, top);
+		throw;
+	}
+}
+
+template <typename Userdata = TableUserdata>
+sol::object decode(lua_State* L, std::string_view data) {
+	push<Userdata>(L, data);
+	return sol::stack::pop<sol::object>(L);
+}
+};  // namespace Serializer
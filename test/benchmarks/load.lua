@@ -0,0 +1,205 @@
+-- Tick load benchmark, run by ../bench instead of the tests.
+--
+-- Spawns bots with humans, vehicles and items, lets the server settle, then
+-- times every tick and the hooks run in it, and writes the results as JSON.
+
+local function numberFromEnv(name, default)
+	return tonumber(os.getenv(name)) or default
+end
+
+local config = {
+	bots = numberFromEnv("BENCHMARK_BOTS", 32),
+	vehicles = numberFromEnv("BENCHMARK_VEHICLES", 32),
+	items = numberFromEnv("BENCHMARK_ITEMS", 64),
+	warmupTicks = numberFromEnv("BENCHMARK_WARMUP_TICKS", 60),
+	ticks = numberFromEnv("BENCHMARK_TICKS", 600),
+	output = os.getenv("BENCHMARK_OUTPUT") or "benchmark-load.json",
+}
+
+local function log(...)
+	local prefix = "\27[35;1m[Benchmark]\27[0m "
+	print(prefix .. string.format(...))
+end
+
+local function encodeJSON(value)
+	local valueType = type(value)
+
+	if valueType == "table" then
+		local parts = {}
+		if #value > 0 then
+			for _, element in ipairs(value) do
+				table.insert(parts, encodeJSON(element))
+			end
+			return "[" .. table.concat(parts, ",") .. "]"
+		end
+
+		-- Sorted so runs can be diffed
+		local keys = {}
+		for key in pairs(value) do
+			table.insert(keys, tostring(key))
+		end
+		table.sort(keys)
+
+		for _, key in ipairs(keys) do
+			table.insert(parts, encodeJSON(key) .. ":" .. encodeJSON(value[key]))
+		end
+		return "{" .. table.concat(parts, ",") .. "}"
+	elseif valueType == "string" then
+		return '"' .. value:gsub('[%c"\\]', function(c)
+			return string.format("\\u%04x", c:byte())
+		end) .. '"'
+	elseif valueType == "number" then
+		-- JSON has no infinity or NaN
+		if value ~= value or value == math.huge or value == -math.huge then
+			return "null"
+		end
+		return string.format("%.17g", value)
+	elseif valueType == "boolean" then
+		return tostring(value)
+	end
+
+	return "null"
+end
+
+-- Nearest rank, of a sorted list
+local function percentile(sorted, percent)
+	local rank = math.max(1, math.ceil(percent / 100 * #sorted))
+	return sorted[rank]
+end
+
+local function summarize(times)
+	local sorted = {}
+	local total = 0
+	for i, time in ipairs(times) do
+		sorted[i] = time
+		total = total + time
+	end
+	table.sort(sorted)
+
+	return {
+		count = #sorted,
+		mean = total / #sorted,
+		min = sorted[1],
+		p50 = percentile(sorted, 50),
+		p90 = percentile(sorted, 90),
+		p99 = percentile(sorted, 99),
+		max = sorted[#sorted],
+	}
+end
+
+local function spawn()
+	local rot = RotMatrix(1, 0, 0, 0, 1, 0, 0, 0, 1)
+	local spawned = { bots = 0, vehicles = 0, items = 0 }
+
+	-- Spread out on a grid so they don't all settle into each other
+	local function gridPos(index, spacing, height)
+		local x = index % 16
+		local z = math.floor(index / 16)
+		return Vector(100 + x * spacing, height, 100 + z * spacing)
+	end
+
+	for i = 0, config.bots - 1 do
+		local bot = players.createBot()
+		if not bot then
+			break
+		end
+		if humans.create(gridPos(i, 4, 50), rot, bot) then
+			spawned.bots = spawned.bots + 1
+		end
+	end
+
+	for i = 0, config.vehicles - 1 do
+		if not vehicles.create(vehicleTypes[0], gridPos(i, 10, 60), rot, i % 8) then
+			break
+		end
+		spawned.vehicles = spawned.vehicles + 1
+	end
+
+	for i = 0, config.items - 1 do
+		if not items.create(itemTypes[0], gridPos(i, 2, 55), rot) then
+			break
+		end
+		spawned.items = spawned.items + 1
+	end
+
+	return spawned
+end
+
+local function writeResults(results)
+	local file = assert(io.open(config.output, "w"))
+	file:write(encodeJSON(results), "\n")
+	file:close()
+end
+
+local tick = 0
+local spawned
+local tickStart
+-- Milliseconds per measured tick, from the start of Logic to the end of
+-- PostLogic
+local tickTimes = {}
+local startClock
+
+local function finish()
+	local duration = os.realClock() - startClock
+	local stats = profiler.getStats()
+	local tickStats = summarize(tickTimes)
+	profiler.disable()
+
+	writeResults({
+		serverVersion = server.version,
+		config = config,
+		spawned = spawned,
+		counts = {
+			players = players.getCount(),
+			humans = humans.getCount(),
+			vehicles = vehicles.getCount(),
+			items = items.getCount(),
+		},
+		ticksPerSecond = #tickTimes / duration,
+		-- Milliseconds
+		tick = tickStats,
+		-- Microseconds, from the profiler
+		tickInterval = stats.tick,
+		hooks = stats.hooks,
+		luaMemoryKB = collectgarbage("count"),
+	})
+
+	log("%i ticks, p50 %.3f ms, p99 %.3f ms", tickStats.count, tickStats.p50, tickStats.p99)
+	log("Wrote %s", config.output)
+	os.exit(0)
+end
+
+hook.on("Logic", function()
+	tick = tick + 1
+	tickStart = os.realClock()
+
+	if tick == 1 then
+		local success, result = pcall(spawn)
+		if not success then
+			log("Spawning failed: %s", tostring(result))
+			os.exit(1)
+		end
+		spawned = result
+		log("Spawned %i bots, %i vehicles and %i items", spawned.bots, spawned.vehicles, spawned.items)
+	end
+
+	if tick == config.warmupTicks + 1 then
+		profiler.reset()
+		profiler.enable()
+		startClock = tickStart
+	end
+end)
+
+hook.on("PostLogic", function()
+	if tick <= config.warmupTicks then
+		return
+	end
+
+	table.insert(tickTimes, (os.realClock() - tickStart) * 1000)
+
+	if #tickTimes >= config.ticks then
+		finish()
+	end
+end)
+
+log("Running %i ticks after %i to warm up", config.ticks, config.warmupTicks)
@@ -1,3 +1,9 @@
+-- Set by ../bench to run the load benchmark instead of the tests
+if os.getenv("ROSASERVER_BENCHMARK") then
+	require("benchmarks.load")
+	return
+end
+
 local function log(...)
 	local prefix = "\27[34;1m[Test]\27[0m "
 	print(prefix .. string.format(...))
@@ -11,29 +17,47 @@ end
 
 local function runTests()
 	requireTest("tests.accounts")
+	requireTest("tests.bandwidth")
+	requireTest("tests.blockRegion")
 	requireTest("tests.bonds")
 	requireTest("tests.bullets")
 	requireTest("tests.chat")
+	requireTest("tests.childProcess")
+	requireTest("tests.console")
 	requireTest("tests.crypto")
+	requireTest("tests.dataTables")
 	requireTest("tests.events")
+	requireTest("tests.ffiViews")
 	requireTest("tests.fileWatcher")
+	requireTest("tests.gcScheduler")
+	requireTest("tests.hook")
 	requireTest("tests.http")
 	requireTest("tests.humans")
 	requireTest("tests.image")
 	requireTest("tests.items")
 	requireTest("tests.itemTypes")
 	requireTest("tests.memory")
+	requireTest("tests.modules")
+	requireTest("tests.opusPipeline")
 	requireTest("tests.os")
 	requireTest("tests.physics")
 	requireTest("tests.players")
+	requireTest("tests.pointGraph")
+	requireTest("tests.profiler")
+	requireTest("tests.recorder")
 	requireTest("tests.rigidBodies")
 	requireTest("tests.rotMatrix")
+	requireTest("tests.satellitePool")
+	requireTest("tests.serializer")
 	requireTest("tests.server")
 	requireTest("tests.sqlite")
 	requireTest("tests.streets")
+	requireTest("tests.tcp")
+	requireTest("tests.threads")
 	requireTest("tests.vector")
 	requireTest("tests.vehicles")
 	requireTest("tests.worker")
+	requireTest("tests.worldSnapshot")
 	requireTest("tests.lz4")
 end
 
@@ -53,6 +77,7 @@ end
 local handlers = {}
 
 local tick = 0
+local resetStarted = false
 
 hook.enable("Logic")
 function hook.run(event, ...)
@@ -62,8 +87,13 @@ function hook.run(event, ...)
 		log("Tick %i...", tick)
 
 		if tick == 1 then
+			if hook.persistentMode == "tests.reset" then
+				protectedFailCall(require("tests.reset").after)
+				testsPassed()
+			end
+
 			protectedFailCall(runTests)
-		else
+		elseif not resetStarted then
 			for i = #handlers, 1, -1 do
 				local handler = handlers[i]
 				handler.ticksToWait = handler.ticksToWait - 1
@@ -73,8 +103,10 @@ function hook.run(event, ...)
 				end
 			end
 
+			-- Last, since it replaces this state
 			if #handlers == 0 then
-				testsPassed()
+				resetStarted = true
+				protectedFailCall(require("tests.reset").before)
 			end
 		end
 	end
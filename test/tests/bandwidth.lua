@@ -0,0 +1,56 @@
+local function isCounter(counter)
+	return type(counter.packets) == "number" and type(counter.bytes) == "number"
+end
+
+return function()
+	bandwidth.reset()
+
+	local stats = bandwidth.getStats()
+	assert(stats.total.sent.packets == 0)
+	assert(stats.total.received.bytes == 0)
+	assert(isCounter(stats.lastTick.sent))
+	assert(type(stats.types) == "table")
+	assert(type(stats.connections) == "table")
+
+	do
+		local bot = assert(players.createBot())
+
+		-- Only run when the engine gave the bot a connection, which a headless
+		-- test server may not
+		local connection = bot.connection
+		if connection then
+			assert(bandwidth.getBudget(connection) == nil)
+			bandwidth.setBudget(connection, 4096)
+			assert(bandwidth.getBudget(connection) == 4096)
+			bandwidth.setBudget(connection, 8192)
+			assert(bandwidth.getBudget(connection) == 8192)
+
+			assert(not pcall(bandwidth.setBudget, connection, 0))
+			assert(not pcall(bandwidth.setBudget, connection, -1))
+			assert(bandwidth.getBudget(connection) == 8192)
+
+			bandwidth.setBudget(connection, nil)
+			assert(bandwidth.getBudget(connection) == nil)
+		end
+
+		assert(not pcall(bandwidth.setBudget, nil, 4096))
+		assert(not pcall(bandwidth.getBudget, nil))
+
+		bot:remove()
+	end
+
+	nextTick(function()
+		local later = bandwidth.getStats()
+		assert(later.lastTick.sent.bytes <= later.total.sent.bytes)
+		assert(later.lastTick.received.packets <= later.total.received.packets)
+
+		for _, totals in pairs(later.types) do
+			assert(isCounter(totals.sent))
+			assert(isCounter(totals.received))
+		end
+		for _, connection in pairs(later.connections) do
+			assert(isCounter(connection.sent))
+			assert(isCounter(connection.dropped))
+		end
+	end)
+end
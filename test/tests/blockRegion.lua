@@ -0,0 +1,51 @@
+local function pack(sizeX, sizeY, sizeZ, flags)
+	return string.rep(string.char(flags, flags, flags, flags), sizeX * sizeY * sizeZ)
+end
+
+return function()
+	local x, y, z = 0, 0, 0
+	local original = physics.getBlockRegion(x, y, z, 4, 2, 3)
+	assert(#original == 4 * 2 * 3 * 4)
+
+	-- Leaving every block unchanged touches nothing
+	local created, deleted = physics.setBlockRegion(x, y, z, 4, 2, 3, pack(4, 2, 3, 255))
+	assert(created == 0)
+	assert(deleted == 0)
+	assert(physics.getBlockRegion(x, y, z, 4, 2, 3) == original)
+
+	assert(not pcall(physics.setBlockRegion, x, y, z, 4, 2, 3, "short"))
+	assert(not pcall(physics.getBlockRegion, x, y, z, 0, 1, 1))
+
+	local events = 0
+	assert(hook.on("AreaBlockRegion", function(_, _, _, sizeX)
+		events = events + 1
+		-- Cancels the edit
+		return sizeX == 1
+	end))
+	assert(hook.on("PostAreaBlockRegion", function(_, _, _, _, _, _, createdCount, deletedCount)
+		assert(createdCount == 0)
+		assert(deletedCount == 0)
+		events = events + 1
+	end))
+
+	physics.setBlockRegion(x, y, z, 4, 2, 3, pack(4, 2, 3, 255))
+	assert(events == 2)
+	physics.setBlockRegion(x, y, z, 1, 1, 1, pack(1, 1, 1, 255))
+	assert(events == 3)
+
+	assert(not physics.queueBlockRegion(x, y, z, 1, 1, 1, pack(1, 1, 1, 255), 1))
+	assert(physics.queueBlockRegion(x, y, z, 4, 2, 3, pack(4, 2, 3, 255), 1, function(createdCount, deletedCount)
+		assert(createdCount == 0)
+		assert(deletedCount == 0)
+		assert(events == 6)
+
+		assert(hook.off("AreaBlockRegion"))
+		assert(hook.off("PostAreaBlockRegion"))
+	end))
+	assert(physics.getQueuedBlockRegionCount() == 1)
+
+	nextTick(function()
+		assert(physics.getQueuedBlockRegionCount() == 0)
+		assert(physics.getBlockRegion(x, y, z, 4, 2, 3) == original)
+	end)
+end
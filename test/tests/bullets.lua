@@ -1,5 +1,107 @@
+local maxTicks = 10
+
+-- Fires a bullet through the pelvis from a few metres away, fast enough to
+-- reach it in one tick
+local function fireAt(man, shooter)
+	local target = man:getBone(0).pos
+	local from = Vector(target.x - 3, target.y, target.z)
+	return assert(bullets.create(0, from, Vector(4, 0, 0), shooter))
+end
+
 return function()
 	assert(#bullets.getAll() == 0)
 	assert(bullets.getCount() == 0)
 	assert(#bullets == 0)
+
+	assert(not bullets.isBatchingHits())
+	bullets.setBatchedHits(true)
+	assert(bullets.isBatchingHits())
+	bullets.setBatchedHits(false)
+	assert(not bullets.isBatchingHits())
+
+	bullets.setHitRules({ teamDamage = false, godMode = true, ignoredBones = { 15 } })
+	bullets.setHitRules(nil)
+	assert(not pcall(bullets.setHitRules, { ignoredBones = { 40 } }))
+	assert(not pcall(bullets.setHitRules, { ignoredBones = { -1 } }))
+
+	local rot = RotMatrix(1, 0, 0, 0, 1, 0, 0, 0, 1)
+	local target = assert(players.createBot())
+	local shooter = assert(players.createBot())
+	-- Bots start on the same team
+	assert(target.team == shooter.team)
+	local man = assert(humans.create(Vector(30, 30, 30), rot, target))
+
+	local received = {}
+	assert(hook.on("BulletHits", function(hits)
+		for _, hit in ipairs(hits) do
+			table.insert(received, hit)
+		end
+	end))
+	bullets.setBatchedHits(true)
+
+	local allBones = {}
+	for bone = 0, 31 do
+		table.insert(allBones, bone)
+	end
+
+	-- Each is fired with its rules, and the last has to get through
+	local cases = {
+		{ rules = { ignoredBones = allBones }, hits = false },
+		{ rules = { teamDamage = false }, hits = false },
+		{ rules = nil, hits = true },
+	}
+	local caseIndex = 0
+	local ticks
+
+	local function finish()
+		assert(hook.off("BulletHits"))
+		bullets.setBatchedHits(false)
+		bullets.setHitRules(nil)
+		man:remove()
+		target:remove()
+		shooter:remove()
+	end
+
+	local bulletType
+
+	local function try()
+		local case = cases[caseIndex]
+		if case then
+			ticks = ticks + 1
+
+			if case.hits then
+				if #received == 0 then
+					assert(ticks < maxTicks)
+					nextTick(try)
+					return
+				end
+
+				local hit = received[1]
+				assert(hit.human == man)
+				assert(type(hit.bone) == "number")
+				assert(type(hit.fraction) == "number")
+				assert(hit.pos and hit.normal)
+				-- A copy, which outlives the bullet's slot
+				assert(hit.bullet.type == bulletType)
+				assert(hit.bullet.player == shooter)
+				finish()
+				return
+			end
+
+			-- Vetoed hits never reach BulletHits
+			assert(#received == 0)
+			if ticks < maxTicks / 2 then
+				nextTick(try)
+				return
+			end
+		end
+
+		caseIndex = caseIndex + 1
+		ticks = 0
+		bullets.setHitRules(cases[caseIndex].rules)
+		bulletType = fireAt(man, shooter).type
+		nextTick(try)
+	end
+
+	try()
 end
@@ -0,0 +1,7 @@
+while true do
+	local message = waitMessage(5000)
+	if not message or message == "stop" then
+		break
+	end
+	sendMessage(message)
+end
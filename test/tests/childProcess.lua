@@ -0,0 +1,45 @@
+local function echoTest(process)
+	local large = string.rep("0123456789", 10000)
+	local expected = { "hello", large, "" }
+
+	for _, message in ipairs(expected) do
+		process:sendMessage(message)
+	end
+
+	local maxTicks = 300
+	local ticks = 0
+	local received = 0
+
+	local function try()
+		ticks = ticks + 1
+		assert(ticks < maxTicks)
+
+		while true do
+			local message = process:receiveMessage()
+			if not message then
+				break
+			end
+
+			received = received + 1
+			assert(message == expected[received])
+		end
+
+		if received < #expected or not process:flush() then
+			nextTick(try)
+			return
+		end
+
+		assert(process:getQueuedSize() == 0)
+		process:sendMessage("stop")
+		process:terminate()
+		assert(not process:isRunning())
+	end
+
+	nextTick(try)
+end
+
+return function()
+	echoTest(ChildProcess.new("tests/childProcess.child.lua"))
+	-- The large message is much bigger than the ring, so it goes across in pieces
+	echoTest(ChildProcess.new("tests/childProcess.child.lua", nil, 4096))
+end
@@ -0,0 +1,38 @@
+local function readFile(fileName)
+	local file = io.open(fileName, "r")
+	if not file then
+		return nil
+	end
+	local contents = file:read("*a")
+	file:close()
+	return contents
+end
+
+return function()
+	assert(type(console.getDroppedCount()) == "number")
+
+	local fileName = os.tmpname()
+	assert(console.addLogFile(fileName, 256, 1))
+
+	print("\27[31mlogged to a file\27[0m")
+	console.flush()
+
+	local contents = assert(readFile(fileName))
+	assert(contents:find("logged to a file\n", 1, true))
+	assert(not contents:find("\27", 1, true))
+
+	for i = 1, 20 do
+		print("filling the log file " .. i)
+	end
+	console.flush()
+
+	assert(#readFile(fileName) <= 256)
+	assert(readFile(fileName .. ".1"))
+	assert(not readFile(fileName .. ".2"))
+
+	assert(console.removeLogFile(fileName))
+	assert(not console.removeLogFile(fileName))
+
+	os.remove(fileName)
+	os.remove(fileName .. ".1")
+end
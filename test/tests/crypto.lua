@@ -6,4 +6,21 @@ return function()
 
 	assert(crypto.sha256("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855")
 	assert(crypto.sha256(testString) == "912ec5ff4fa90ca4b3fe0b3a65ea46d0c4a9e3c3b16171bd7380ce74424581f3")
+
+	local binary = crypto.sha256(testString, true)
+	assert(#binary == 32)
+	assert(crypto.toHex(binary) == crypto.sha256(testString))
+	assert(crypto.toHex("\0\255") == "00ff")
+
+	local hasher = crypto.sha256new()
+	assert(hasher:update(testString:sub(1, 10)):update(testString:sub(11)):final() == crypto.sha256(testString))
+	-- Finishing starts the hasher over
+	assert(hasher:final() == crypto.sha256(""))
+	assert(crypto.md5new():update(testString):final() == crypto.md5(testString))
+
+	assert(
+		crypto.hmacSha256("key", "The quick brown fox jumps over the lazy dog")
+			== "f7bc83f430538424b13298e6aa6fb143ef4d59a14946175997479dbc2d1a3cd8"
+	)
+	assert(#crypto.hmacSha256("key", testString, true) == 32)
 end
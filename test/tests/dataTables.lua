@@ -0,0 +1,20 @@
+return function()
+	local bot = assert(players.createBot())
+	local index = bot.index
+
+	assert(bot.data == bot.data)
+	bot.data.value = 1
+	assert(players[index].data.value == 1)
+
+	bot:remove()
+
+	-- A new object in the same slot starts with an empty table
+	local newBot = assert(players.createBot())
+	assert(newBot.index == index)
+	assert(newBot.data.value == nil)
+	newBot:remove()
+
+	assert(accounts[0].data == accounts[0].data)
+	assert(accounts[0].data ~= accounts[1].data)
+	assert(rigidBodies[0].data ~= humans[0].data)
+end
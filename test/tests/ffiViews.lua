@@ -0,0 +1,33 @@
+local ffi = require("ffi")
+
+return function()
+	ffi.cdef(memory.getStructDefinitions())
+
+	local arrays = memory.getArrayAddresses()
+	for _, name in ipairs({ "players", "humans", "items", "vehicles", "bodies" }) do
+		local array = assert(arrays[name])
+		assert(array.count > 0)
+		assert(ffi.sizeof(array.type) == array.size)
+	end
+
+	assert(arrays.players.address == memory.getAddress(players[0]))
+	assert(arrays.items.address == memory.getAddress(items[0]))
+	assert(arrays.humans.address + arrays.humans.size == memory.getAddress(humans[1]))
+
+	local ffiPlayers = ffi.cast("rs_Player*", arrays.players.address)
+
+	local bot = assert(players.createBot())
+	local index = bot.index
+	assert(ffiPlayers[index].active == 1)
+
+	bot.money = 1234
+	assert(ffiPlayers[index].money == 1234)
+	ffiPlayers[index].money = 4321
+	assert(bot.money == 4321)
+
+	bot.name = "FFI"
+	assert(ffi.string(ffiPlayers[index].name) == "FFI")
+
+	bot:remove()
+	assert(ffiPlayers[index].active == 0)
+end
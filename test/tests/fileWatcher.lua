@@ -44,4 +44,69 @@ return function()
 	end
 
 	assert(watcher:removeWatch("."))
+	assert(not watcher:removeWatch("."))
+
+	local directory = "fileWatcherTest"
+	local subDirectory = directory .. "/sub"
+	assert(os.createDirectory(directory))
+
+	watcher:addWatch(directory, bit32.bor(FILE_WATCH_CREATE, FILE_WATCH_MODIFY), true)
+	assert(#watcher:receiveEvents() == 0)
+
+	-- Created after the watch, so it's picked up from the event
+	assert(os.createDirectory(subDirectory))
+
+	do
+		local events = watcher:receiveEvents()
+		assert(#events == 1)
+		assert(events[1].descriptor == directory)
+		assert(events[1].name == "sub")
+		assert(events[1].mask == bit32.bor(FILE_WATCH_CREATE, FILE_WATCH_ISDIR))
+	end
+
+	do
+		local file = assert(io.open(subDirectory .. "/" .. fileName, "w"))
+		for _ = 1, 10 do
+			file:write("hello")
+			file:flush()
+		end
+		file:close()
+	end
+
+	do
+		local events = watcher:receiveEvents()
+		assert(#events == 2)
+		assert(events[1].descriptor == subDirectory)
+		assert(events[1].mask == FILE_WATCH_CREATE)
+		assert(events[2].descriptor == subDirectory)
+		assert(events[2].mask == FILE_WATCH_MODIFY)
+	end
+
+	assert(watcher:removeWatch(directory))
+	assert(not watcher:removeWatch(subDirectory))
+
+	assert(os.remove(subDirectory .. "/" .. fileName))
+	assert(os.remove(subDirectory))
+	assert(os.remove(directory))
+
+	-- Repeats are only dropped next to each other, so this keeps its order
+	watcher:addWatch(".", bit32.bor(FILE_WATCH_CREATE, FILE_WATCH_DELETE))
+
+	assert(io.open(fileName, "w")):close()
+	assert(os.remove(fileName))
+	assert(io.open(fileName, "w")):close()
+
+	do
+		local events = watcher:receiveEvents()
+		assert(#events == 3)
+		assert(events[1].mask == FILE_WATCH_CREATE)
+		assert(events[2].mask == FILE_WATCH_DELETE)
+		assert(events[3].mask == FILE_WATCH_CREATE)
+		for _, event in ipairs(events) do
+			assert(event.name == fileName)
+		end
+	end
+
+	assert(watcher:removeWatch("."))
+	assert(os.remove(fileName))
 end
@@ -0,0 +1,27 @@
+return function()
+	assert(not gcScheduler.isEnabled())
+	assert(not pcall(gcScheduler.enable, { maxSliceMs = -1 }))
+
+	gcScheduler.enable({ maxSliceMs = 2, reserveMs = 1 })
+	assert(gcScheduler.isEnabled())
+
+	local stats = gcScheduler.getStats()
+	assert(stats.enabled)
+	assert(stats.heapSize > 0)
+	assert(stats.stepSize > 0)
+
+	for i = 1, 10000 do
+		local garbage = { i }
+	end
+
+	nextTick(function()
+		local later = gcScheduler.getStats()
+		assert(later.slices > stats.slices)
+		assert(later.steps > stats.steps)
+		assert(later.totalMs >= later.lastSliceMs)
+
+		gcScheduler.disable()
+		assert(not gcScheduler.isEnabled())
+		assert(not gcScheduler.getStats().enabled)
+	end)
+end
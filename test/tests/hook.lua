@@ -0,0 +1,18 @@
+return function()
+	assert(not hook.on("NotAnEvent", function() end))
+	assert(not hook.off("NotAnEvent"))
+
+	local calls = 0
+	assert(hook.on("PostLogic", function()
+		calls = calls + 1
+	end))
+
+	nextTick(function()
+		assert(calls == 1)
+		assert(hook.off("PostLogic"))
+
+		nextTick(function()
+			assert(calls == 1)
+		end)
+	end)
+end
@@ -13,4 +13,28 @@ return function()
 		end
 	end
 	assert(foundContentType)
+
+	local asyncRes
+	assert(http.get("https://github.com", "/robots.txt", {}, function(res)
+		asyncRes = res or false
+	end))
+
+	local maxTicks = 600
+	local ticks = 0
+
+	local function try()
+		ticks = ticks + 1
+
+		if asyncRes == nil then
+			assert(ticks < maxTicks)
+			nextTick(try)
+			return
+		end
+
+		assert(asyncRes)
+		assert(asyncRes.status >= 200 and asyncRes.status <= 299)
+		assert(asyncRes.body == res.body)
+	end
+
+	nextTick(try)
 end
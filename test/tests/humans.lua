@@ -14,6 +14,32 @@ return function()
 	assert(humans.getCount() == 1)
 	assert(#humans == 1)
 
+	do
+		local count = 0
+		for index, human in humans.iter() do
+			assert(index == 0)
+			assert(human == man)
+			count = count + 1
+		end
+		assert(count == 1)
+
+		local all = { "stale", "entries" }
+		assert(humans.getAll(all) == all)
+		assert(#all == 1)
+		assert(all[1] == man)
+	end
+
+	do
+		local near = humans.getInRadius(Vector(), 5)
+		assert(#near == 1)
+		assert(near[1] == man)
+		assert(#humans.getInRadius(Vector(100, 0, 100), 5) == 0)
+
+		local inBox = humans.getInBox(Vector(-1, -1, -1), Vector(1, 1, 1))
+		assert(#inBox == 1)
+		assert(inBox[1] == man)
+	end
+
 	man:teleport(Vector(0, 30, 0))
 
 	assertAddsEvent(function()
@@ -12,5 +12,38 @@ return function()
 	assert(green == 7)
 	assert(blue == 52)
 
+	local row = image:getRow(132)
+	assert(#row == 256 * 3)
+	assert(row:byte(132 * 3 + 1) == 86)
+
+	local fast = image:getPNG(true)
+	assert(fast:sub(2, 4) == "PNG")
+	assert(#fast > #image:getPNG())
+
+	local canvas = Image.new()
+	canvas:loadBlank(64, 32, 4)
+	canvas:fill(0, 0, 255)
+	assert(select(4, canvas:getRGBA(10, 10)) == 255)
+	canvas:fillRect(-4, -4, 8, 8, 255, 0, 0, 128)
+	assert(canvas:getRGBA(3, 3) == 255)
+	assert(select(3, canvas:getRGBA(4, 4)) == 255)
+
+	canvas:setRow(31, ("\1\2\3\4"):rep(64))
+	assert(canvas:getRow(31) == ("\1\2\3\4"):rep(64))
+	assert(not pcall(canvas.setRow, canvas, 31, "short"))
+
+	canvas:blit(image, -132, -132)
+	assert(canvas:getRGBA(0, 0) == 86)
+
+	local palette = { { 0, 0, 0 }, { 255, 255, 255 }, { 86, 7, 52 } }
+	local indices = canvas:quantize(palette)
+	assert(#indices == 64 * 32)
+	assert(indices:byte(1) == 2)
+
+	canvas:resize(32, 16)
+	assert(canvas.width == 32)
+	assert(canvas.height == 16)
+
 	image:free()
+	canvas:free()
 end
@@ -6,4 +6,30 @@ return function()
 
 	local uncompressed = lz4.uncompress(compressed, #testString)
 	assert(uncompressed == testString)
+
+	local hc = lz4.compress(testString, 12)
+	assert(#hc <= #compressed)
+	assert(lz4.uncompress(hc, #testString) == testString)
+	assert(not pcall(lz4.compress, testString, 13))
+
+	local frame = lz4.compressFrame(testString)
+	assert(lz4.uncompressFrame(frame) == testString)
+	assert(lz4.uncompressFrame(lz4.compressFrame("")) == "")
+	assert(not pcall(lz4.uncompressFrame, frame, 16))
+
+	for _, level in ipairs({ 0, 9 }) do
+		local compressor = LZ4Compressor.new(level)
+		local decompressor = LZ4Decompressor.new()
+
+		-- Later chunks refer back to earlier ones, so repeats get much smaller
+		local first = compressor:compress(testString)
+		local second = compressor:compress(testString)
+		assert(#second < #first)
+		assert(decompressor:uncompress(first) == testString)
+		assert(decompressor:uncompress(second) == testString)
+
+		compressor:reset()
+		decompressor:reset()
+		assert(decompressor:uncompress(compressor:compress(testString)) == testString)
+	end
 end
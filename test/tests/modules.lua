@@ -0,0 +1,44 @@
+local function writeFile(fileName, contents)
+	local file = assert(io.open(fileName, "w"))
+	file:write(contents)
+	file:close()
+end
+
+return function()
+	local fileName = os.tmpname()
+	local moduleName = fileName:match("[^/]+$")
+	local directory = fileName:sub(1, -#moduleName - 1)
+
+	-- Spelled differently from the real path, which reloads have to keep using
+	local spelledName = directory .. "./" .. moduleName
+	local oldPath = package.path
+	package.path = directory .. "./?;" .. oldPath
+
+	writeFile(fileName, "return { value = 1 }")
+	local misses = modules.getCacheStats().misses
+	assert(require(moduleName).value == 1)
+	assert(modules.getCacheStats().misses == misses + 1)
+	assert(modules.getFileName(moduleName))
+
+	-- Unchanged, so it comes from the cache
+	local hits = modules.getCacheStats().hits
+	assert(modules.reload(fileName))
+	assert(modules.getCacheStats().hits == hits + 1)
+
+	writeFile(fileName, "return { value = 2 }")
+	assert(modules.reload(fileName))
+	assert(package.loaded[moduleName].value == 2)
+	assert(require(moduleName).value == 2)
+
+	writeFile(fileName, "return {")
+	local success, err = pcall(modules.reload, fileName)
+	assert(not success)
+	assert(err:find(spelledName, 1, true))
+
+	assert(not modules.reload(fileName .. ".missing"))
+	assert(modules.getFileName(moduleName .. ".missing") == nil)
+
+	package.loaded[moduleName] = nil
+	package.path = oldPath
+	os.remove(fileName)
+end
@@ -0,0 +1,54 @@
+return function()
+	local fileName = "tests/opusPipeline.pcm"
+	local file = assert(io.open(fileName, "wb"))
+	-- 10 frames of a quiet square wave
+	for i = 1, 960 * 10 do
+		file:write(i % 100 < 50 and "\0\16" or "\0\240")
+	end
+	file:close()
+
+	local pipeline = OpusPipeline.new(24000)
+	assert(pipeline.bitRate == 24000)
+	assert(not pcall(function()
+		pipeline.bitRate = 0
+	end))
+
+	local once = pipeline:addSource(fileName)
+	local looped = pipeline:addSource(fileName, 0.5, true)
+	assert(pipeline:hasSource(once))
+	assert(pipeline:setSourceVolume(looped, 0.25))
+	assert(not pipeline:setSourceVolume(-1, 0))
+
+	local maxTicks = 300
+	local ticks = 0
+	local frames = 0
+
+	local function try()
+		ticks = ticks + 1
+		assert(ticks < maxTicks)
+
+		while pipeline:isReady() do
+			if frames % 2 == 0 then
+				local frame = pipeline:nextFrame()
+				assert(#frame > 0)
+			else
+				assert(pipeline:writeVoices({}, 0, 1))
+			end
+			frames = frames + 1
+		end
+
+		-- The looped source keeps going after the other one runs out
+		if frames < 20 then
+			nextTick(try)
+			return
+		end
+
+		assert(not pipeline:hasSource(once))
+		assert(pipeline:removeSource(looped))
+		assert(pipeline:getSourceCount() == 0)
+		assert(not pcall(pipeline.writeVoices, pipeline, {}, 64, 1))
+		os.remove(fileName)
+	end
+
+	nextTick(try)
+end
@@ -15,6 +15,32 @@ return function()
 		assert(fraction == 0.5)
 	end
 
+	do
+		local ffi = require("ffi")
+		local rays = ffi.new("float[12]", {
+			0, airLevel, 0, 0, 0, 0,
+			0, airLevel, 0, 0, airLevel + 10, 0,
+		})
+		local results = ffi.new("struct { float fraction; int type; int index; }[2]")
+
+		local numHits = physics.lineIntersectAnyBatch(
+			tonumber(ffi.cast("uintptr_t", rays)),
+			tonumber(ffi.cast("uintptr_t", results)),
+			2,
+			nil,
+			0.0,
+			false,
+			4.0
+		)
+
+		assert(numHits == 1)
+		assert(results[0].type == 1)
+		assert(results[0].index == -1)
+		assert(results[0].fraction == 0.5)
+		assert(results[1].type == 0)
+		assert(results[1].fraction == 1)
+	end
+
 	nextTick(function()
 		do
 			local bot = players.createBot()
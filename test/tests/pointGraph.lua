@@ -0,0 +1,106 @@
+return function()
+	local graph = PointGraph.new(1024)
+	graph:addNode(0, 0, 0)
+	graph:addNode(10, 0, 0)
+	graph:addNode(5, 0, 5)
+	graph:addNode(20, 0, 0)
+	graph:addNode(50, 0, 50)
+	assert(graph:getSize() == 5)
+
+	-- The direct link to 1 is found first but the detour through 2 is cheaper
+	graph:addLink(0, 1, 100)
+	graph:addLink(0, 2, 6)
+	graph:addLink(2, 1, 6)
+	graph:addLink(1, 3, 10)
+
+	assert(graph:getNodeByPoint(5, 0, 5) == 2)
+	assert(graph:getNodeByPoint(1, 2, 3) == nil)
+
+	-- Scratch state is reused, so searching twice must give the same result
+	for _ = 1, 2 do
+		local path = graph:findShortestPath(0, 3)
+		assert(#path == 4)
+		assert(path[1] == 0)
+		assert(path[2] == 2)
+		assert(path[3] == 1)
+		assert(path[4] == 3)
+	end
+
+	local trivial = graph:findShortestPath(3, 3)
+	assert(#trivial == 1 and trivial[1] == 3)
+
+	assert(graph:findShortestPath(0, 4) == nil)
+	assert(graph:findShortestPath(3, 0) == nil)
+	assert(not pcall(graph.findShortestPath, graph, 0, 5))
+
+	-- Links added after a search are merged in on the next one
+	graph:addLink(3, 4, 80)
+	local extended = graph:findShortestPath(0, 4)
+	assert(#extended == 5 and extended[5] == 4)
+
+	-- Hierarchical and cached searches must find the same paths
+	graph:buildHierarchy(16)
+	graph:setPathCacheSize(16)
+	for _ = 1, 2 do
+		local path = graph:findShortestPath(0, 4)
+		assert(#path == #extended)
+		for i = 1, #extended do
+			assert(path[i] == extended[i])
+		end
+		assert(graph:findShortestPath(4, 0) == nil)
+	end
+
+	local fileName = "test.graph"
+	os.remove(fileName)
+	graph:save(fileName)
+
+	local loaded = PointGraph.load(fileName, 1024)
+	assert(loaded:getSize() == graph:getSize())
+	assert(loaded:getNodeByPoint(20, 0, 0) == 3)
+	local x, y, z = loaded:getNodePoint(4)
+	assert(x == 50 and y == 0 and z == 50)
+
+	local loadedPath = loaded:findShortestPath(0, 4)
+	assert(#loadedPath == #extended)
+	for i = 1, #extended do
+		assert(loadedPath[i] == extended[i])
+	end
+
+	assert(os.remove(fileName))
+	assert(not pcall(PointGraph.load, fileName, 1024))
+
+	assert(not loaded:isSealed())
+	assert(not pcall(loaded.findShortestPaths, loaded, { { 0, 3 } }, function() end))
+	assert(not loaded:isSealed())
+
+	loaded:share("tests.pointGraph")
+	assert(loaded:isSealed())
+	assert(not pcall(loaded.addNode, loaded, 1, 2, 3))
+	assert(PointGraph.getShared("tests.pointGraph"):getSize() == loaded:getSize())
+	assert(PointGraph.getShared("tests.missing") == nil)
+
+	local batchPaths
+	assert(loaded:findShortestPaths({ { 0, 3 }, { 0, 4 }, { 4, 0 } }, function(paths)
+		batchPaths = paths
+	end))
+
+	local maxTicks = 60
+	local ticks = 0
+
+	local function try()
+		ticks = ticks + 1
+
+		if not batchPaths then
+			assert(ticks < maxTicks)
+			nextTick(try)
+			return
+		end
+
+		assert(#batchPaths == 3)
+		assert(#batchPaths[1] == 4 and batchPaths[1][2] == 2)
+		assert(#batchPaths[2] == #extended)
+		assert(batchPaths[3] == false)
+	end
+
+	nextTick(try)
+end
@@ -0,0 +1,22 @@
+return function()
+	assert(not profiler.isEnabled())
+	profiler.enable()
+	assert(profiler.isEnabled())
+
+	nextTick(function()
+		local stats = profiler.getStats()
+		assert(stats.tick.count == 1)
+		assert(stats.tick.max >= stats.tick.p50)
+
+		local logic = assert(stats.hooks.Logic)
+		assert(logic.original.count == 1)
+		assert(logic.post.count == 1)
+
+		profiler.reset()
+		assert(profiler.getStats().tick.count == 0)
+		assert(not profiler.getStats().hooks.Logic)
+
+		profiler.disable()
+		assert(not profiler.isEnabled())
+	end)
+end
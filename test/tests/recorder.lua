@@ -0,0 +1,64 @@
+return function()
+	local fileName = "tests/recorder.bin"
+
+	assert(not recorder.isRecording())
+	recorder.start(fileName, 2)
+	assert(recorder.isRecording())
+	assert(not pcall(recorder.start, fileName))
+
+	local ticks = 0
+	local function try()
+		ticks = ticks + 1
+		if ticks < 5 then
+			nextTick(try)
+			return
+		end
+
+		-- Files still being written can be read up to the last whole tick
+		local partial = Recording.new(fileName)
+		assert(partial:getTickCount() == recorder.getTickCount())
+		partial:close()
+
+		recorder.stop()
+		assert(not recorder.isRecording())
+
+		local recording = Recording.new(fileName)
+		assert(recording:getKeyframeInterval() == 2)
+		assert(recording:getTickCount() >= 4)
+
+		local first = recording:getTick(0)
+		assert(first.tick == 0)
+		assert(first.keyframe)
+		assert(not recording:getTick(1).keyframe)
+		assert(recording:findKeyframe(1) == 0)
+		assert(recording:findKeyframe(3) == 2)
+		assert(type(first.packets) == "table")
+		assert(type(first.commands) == "table")
+
+		local snapshot = Recording.decodeSnapshot(first.snapshot)
+		assert(snapshot.keyframe)
+		assert(not pcall(recording.getTick, recording, recording:getTickCount()))
+
+		recording:close()
+
+		-- A corrupt size mustn't be trusted with an allocation
+		local file = assert(io.open(fileName, "rb"))
+		local contents = file:read("*a")
+		file:close()
+		os.remove(fileName)
+
+		-- The first tick's uncompressed size follows the 16 byte file header and
+		-- its compressed size
+		local corruptName = "tests/recorder.corrupt.bin"
+		file = assert(io.open(corruptName, "wb"))
+		file:write(contents:sub(1, 20), "\255\255\255\255", contents:sub(25))
+		file:close()
+
+		local corrupt = Recording.new(corruptName)
+		assert(not pcall(corrupt.getTick, corrupt, 0))
+		corrupt:close()
+		os.remove(corruptName)
+	end
+
+	nextTick(try)
+end
@@ -0,0 +1,17 @@
+-- Replaces the Lua state, so runs after every other test. The new state
+-- checks that nothing which calls back into Lua survived the reset.
+return {
+	before = function()
+		-- Unchanged blocks, far too many to finish in one tick
+		local data = string.rep("\255", 64 * 64 * 64 * 4)
+		assert(physics.queueBlockRegion(0, 0, 0, 64, 64, 64, data, 0.001, function()
+			error("called back into the old state")
+		end))
+		assert(physics.getQueuedBlockRegionCount() == 1)
+
+		flagStateForReset("tests.reset")
+	end,
+	after = function()
+		assert(physics.getQueuedBlockRegionCount() == 0)
+	end,
+}
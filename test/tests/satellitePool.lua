@@ -0,0 +1,67 @@
+return function()
+	local pool = SatellitePool.new("tests/satellitePool.pool.lua", 2, {
+		sharedMemorySize = 65536,
+	})
+	assert(pool:getSize() == 2)
+	assert(pool:getIdleCount() == 2)
+
+	local squares = {}
+	local numDone = 0
+	local maxCalls = 0
+	local function done()
+		numDone = numDone + 1
+	end
+
+	for i = 1, 8 do
+		assert(pool:submit("square", i, function(result, err)
+			assert(not err)
+			squares[i] = result.square
+			maxCalls = math.max(maxCalls, result.calls)
+			done()
+		end))
+	end
+
+	assert(pool:submit("fail", nil, function(result, err)
+		assert(result == nil)
+		assert(err:find("failed on purpose"))
+		done()
+	end))
+
+	assert(pool:submit("missing", nil, function(result, err)
+		assert(result == nil)
+		assert(err:find("missing"))
+		done()
+	end))
+
+	assert(pool:submit("crash", nil, function(result, err)
+		assert(result == nil)
+		assert(err)
+		done()
+	end))
+
+	local maxTicks = 600
+	local ticks = 0
+
+	local function try()
+		ticks = ticks + 1
+		assert(ticks < maxTicks)
+
+		if numDone < 11 then
+			nextTick(try)
+			return
+		end
+
+		for i = 1, 8 do
+			assert(squares[i] == i * i)
+		end
+		-- States stay loaded between jobs
+		assert(maxCalls > 1)
+		assert(pool:getRecycledCount() == 1)
+		assert(pool:getQueuedCount() == 0)
+
+		pool:close()
+		assert(pool:getSize() == 0)
+	end
+
+	nextTick(try)
+end
@@ -0,0 +1,14 @@
+local calls = 0
+
+function square(number)
+	calls = calls + 1
+	return { square = number * number, calls = calls }
+end
+
+function fail()
+	error("failed on purpose")
+end
+
+function crash()
+	os.exit(1)
+end
@@ -0,0 +1,39 @@
+return function()
+	local value = {
+		1,
+		2.5,
+		"three",
+		nested = { flag = true, off = false, big = 2 ^ 40, negative = -7 },
+		pos = Vector(1, 2, 3),
+		rot = RotMatrix(1, 0, 0, 0, 1, 0, 0, 0, 1),
+		[10] = "sparse",
+	}
+
+	local encoded = serializer.encode(value)
+	assert(type(encoded) == "string")
+
+	local decoded = serializer.decode(encoded)
+	assert(#decoded == 3)
+	assert(decoded[1] == 1)
+	assert(decoded[2] == 2.5)
+	assert(decoded[3] == "three")
+	assert(decoded[10] == "sparse")
+	assert(decoded.nested.flag == true)
+	assert(decoded.nested.off == false)
+	assert(decoded.nested.big == 2 ^ 40)
+	assert(decoded.nested.negative == -7)
+	assert(decoded.pos.class == "Vector")
+	assert(decoded.pos:dist(Vector(1, 2, 3)) == 0)
+	assert(decoded.rot.class == "RotMatrix")
+	assert(decoded.rot.y2 == 1)
+
+	assert(serializer.decode(serializer.encode(nil)) == nil)
+	assert(serializer.decode(serializer.encode("a\0b")) == "a\0b")
+
+	assert(not pcall(serializer.encode, print))
+	assert(not pcall(serializer.decode, "\255"))
+
+	local cyclic = {}
+	cyclic.self = cyclic
+	assert(not pcall(serializer.encode, cyclic))
+end
@@ -44,5 +44,136 @@ return function()
 		assert(row[4] == "ACGT\0ACGT\1")
 	end
 
+	do
+		-- Repeated queries reuse the prepared statement with new bindings
+		for age = 50, 51 do
+			local rows = assert(db:query("select name from people where age = ?;", age))
+			assert(#rows == (age == 50 and 1 or 0))
+		end
+
+		local rows = assert(db:query("select typeof(?), typeof(?), typeof(?);", 3, 2.5, "x"))
+		assert(rows[1][1] == "integer")
+		assert(rows[1][2] == "real")
+		assert(rows[1][3] == "text")
+
+		local numChanges = assert(db:query("update people set age = ? where rowid = ?;", 26, 2))
+		assert(numChanges == 1)
+	end
+
+	do
+		local count = 0
+		for row in db:rows("select age, name from people where age > ? order by age;", 0) do
+			count = count + 1
+			assert(row:getColumnCount() == 2)
+			assert(row:getColumnName(2) == "name")
+			if count == 1 then
+				assert(row:get(1) == 26)
+				assert(row:get(2) == nil)
+			else
+				local values = row:toTable()
+				assert(values[1] == 50)
+				assert(values[2] == "John Smith")
+			end
+		end
+		assert(count == 2)
+
+		local rows = assert(db:rows("select name from people;"))
+		assert(rows() == rows)
+		assert(not pcall(rows.get, 1))
+		assert(not pcall(rows.toTable, "rows"))
+		rows:close()
+		assert(rows() == nil)
+
+		local missing, err = db:rows("select * from missing;")
+		assert(missing == nil)
+		assert(err == "no such table: missing")
+	end
+
+	assert(not pcall(db.startWriter, db, 10, 16))
 	db:close()
+
+	local fileName = "test.db"
+	local function removeFiles()
+		os.remove(fileName)
+		os.remove(fileName .. "-wal")
+		os.remove(fileName .. "-shm")
+	end
+	removeFiles()
+
+	local fileDb = SQLite.new(fileName)
+	assert(not fileDb:hasWriter())
+	assert(not pcall(fileDb.queryAsync, fileDb, "select 1;"))
+
+	fileDb:startWriter(10, 16)
+	assert(fileDb:hasWriter())
+
+	local numDone = 0
+	local writeError
+
+	fileDb:queryAsync("create table scores (name text, score integer);", nil, function(numChanges)
+		assert(numChanges == 0)
+		numDone = numDone + 1
+	end)
+	for i = 1, 20 do
+		fileDb:queryAsync("insert into scores values (?, ?);", { "player" .. i, i }, function(numChanges)
+			assert(numChanges == 1)
+			numDone = numDone + 1
+		end)
+	end
+	fileDb:queryAsync("insert into missing values (1);", nil, function(numChanges, err)
+		assert(numChanges == nil)
+		writeError = err
+		numDone = numDone + 1
+	end)
+
+	local maxTicks = 120
+	local ticks = 0
+
+	local function try()
+		ticks = ticks + 1
+
+		if numDone < 22 then
+			assert(ticks < maxTicks)
+			nextTick(try)
+			return
+		end
+
+		assert(writeError:find("no such table"))
+
+		local rows = assert(fileDb:query("select count(*), sum(score) from scores;"))
+		assert(rows[1][1] == 20)
+		assert(rows[1][2] == 210)
+
+		-- Ending the batch's transaction undoes the writes before it, so none of
+		-- them are reported as done
+		local numFailed = 0
+		local function expectFailure(numChanges, err)
+			assert(numChanges == nil)
+			assert(type(err) == "string")
+			numFailed = numFailed + 1
+		end
+		fileDb:queryAsync("insert into scores values ('undone', 1);", nil, expectFailure)
+		fileDb:queryAsync("rollback;", nil, expectFailure)
+
+		ticks = 0
+		local function tryRollback()
+			ticks = ticks + 1
+
+			if numFailed < 2 then
+				assert(ticks < maxTicks)
+				nextTick(tryRollback)
+				return
+			end
+
+			local rows = assert(fileDb:query("select count(*) from scores;"))
+			assert(rows[1][1] == 20)
+
+			fileDb:close()
+			removeFiles()
+		end
+
+		nextTick(tryRollback)
+	end
+
+	nextTick(try)
 end
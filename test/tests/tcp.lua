@@ -0,0 +1,101 @@
+return function()
+	local port = 27181
+	local server = TCPServer.new(port)
+	local client = TCPClient.new("127.0.0.1", tostring(port))
+
+	local connection
+	local framed = false
+	-- Bigger than one receive, so it's read over several polls
+	local bulkSize = 40000
+	local bulkReceived
+	local bulkPolls = 0
+	local maxTicks = 120
+	local ticks = 0
+
+	local function try()
+		ticks = ticks + 1
+		assert(ticks < maxTicks)
+
+		local readable, accepted = server:poll()
+
+		if not connection then
+			if #accepted == 0 then
+				nextTick(try)
+				return
+			end
+
+			assert(#accepted == 1)
+			connection = accepted[1]
+			assert(connection.isOpen)
+			assert(connection.address == "127.0.0.1")
+
+			assert(client:send("hello") == 5)
+			nextTick(try)
+			return
+		end
+
+		if #readable == 0 then
+			nextTick(try)
+			return
+		end
+
+		assert(#readable == 1)
+		assert(readable[1].port == connection.port)
+
+		if not framed then
+			assert(connection:getBufferedSize() == 5)
+			assert(connection:receive(3) == "hel")
+			assert(connection:receive(16) == "lo")
+			assert(connection:receive(16) == nil)
+
+			client:setFraming("length")
+			connection:setFraming("length")
+			assert(client:sendMessage("first"))
+			assert(client:sendMessage(""))
+			assert(client:getQueuedSize() == 0)
+			assert(client.isWritable)
+
+			framed = true
+			nextTick(try)
+			return
+		end
+
+		if not bulkReceived then
+			assert(connection:receiveMessage() == "first")
+			assert(connection:receiveMessage() == "")
+			assert(connection:receiveMessage() == nil)
+
+			assert(client:send(string.rep("x", bulkSize)) == bulkSize)
+			bulkReceived = 0
+			nextTick(try)
+			return
+		end
+
+		if bulkReceived < bulkSize then
+			-- Reported again while data is left over, without new data arriving
+			local data = assert(connection:receive(bulkSize))
+			assert(#data <= 16384)
+			bulkReceived = bulkReceived + #data
+			bulkPolls = bulkPolls + 1
+			if bulkReceived < bulkSize then
+				nextTick(try)
+				return
+			end
+			assert(bulkPolls >= 3)
+		end
+
+		client:setFraming("line")
+		connection:setFraming("line")
+		assert(connection:sendMessage("reply"))
+		assert(connection:send("partial") == 7)
+
+		client.highWaterMark = 0
+		assert(not client.isWritable)
+		assert(client:send("dropped") == 0)
+
+		client:close()
+		server:close()
+	end
+
+	nextTick(try)
+end
@@ -0,0 +1,45 @@
+return function()
+	threads.load("tests/threads.pool.lua")
+	assert(threads.getCount() >= 1)
+
+	local results = {}
+	local errorMessage
+
+	for i = 1, 16 do
+		assert(threads.submit("double", i, function(result)
+			results[i] = result
+		end))
+	end
+
+	local sumResult
+	assert(threads.submit("sum", { 2, 3, pos = Vector(1, 2, 3) }, function(result)
+		sumResult = result
+	end))
+
+	assert(threads.submit("fail", nil, function(result, err)
+		assert(result == nil)
+		errorMessage = err
+	end))
+
+	local maxTicks = 60
+	local ticks = 0
+
+	local function try()
+		ticks = ticks + 1
+
+		if threads.getPending() > 0 then
+			assert(ticks < maxTicks)
+			nextTick(try)
+			return
+		end
+
+		for i = 1, 16 do
+			assert(results[i] == i * 2)
+		end
+		assert(sumResult.total == 5)
+		assert(sumResult.pos:dist(Vector(1, 2, 3)) == 0)
+		assert(errorMessage:find("expected failure"))
+	end
+
+	nextTick(try)
+end
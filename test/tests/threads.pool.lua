@@ -0,0 +1,11 @@
+function double(argument)
+	return argument * 2
+end
+
+function sum(argument)
+	return { total = argument[1] + argument[2], pos = argument.pos }
+end
+
+function fail()
+	error("expected failure")
+end
@@ -12,6 +12,18 @@ return function()
 	vehicle.color = 2
 	assert(vehicle.color == 2)
 
+	do
+		local near = vehicles.getInRadius(Vector(100, 50, 100), 5)
+		assert(#near == 1)
+		assert(near[1] == vehicle)
+		assert(#vehicles.getInRadius(Vector(), 5) == 0)
+
+		local inBox = vehicles.getInBox(Vector(90, 40, 90), Vector(110, 60, 110))
+		assert(#inBox == 1)
+		assert(inBox[1] == vehicle)
+		assert(#vehicles.getInBox(Vector(-10, -10, -10), Vector(10, 10, 10)) == 0)
+	end
+
 	assertAddsEvent(function()
 		vehicle:updateType()
 	end)
@@ -0,0 +1,10 @@
+assert(not sleep(1))
+
+local message, stopped = waitMessage(5000)
+assert(message == "hi" and not stopped)
+
+-- Nothing else is sent, so this times out
+message, stopped = waitMessage(1)
+assert(message == nil and not stopped)
+
+sendMessage("hello")
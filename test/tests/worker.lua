@@ -1,10 +1,9 @@
-return function()
-	local worker = assert(Worker.new("tests/worker.worker.lua"))
+local maxTicks = 10
 
-	assert(not worker:receiveMessage())
-	worker:sendMessage("hi")
+local function testWaitMessage()
+	local worker = assert(Worker.new("tests/waitMessage.worker.lua"))
+	assert(worker:sendMessage("hi"))
 
-	local maxTicks = 10
 	local ticks = 0
 
 	local function try()
@@ -13,10 +12,53 @@ return function()
 		local message = worker:receiveMessage()
 		if message then
 			assert(message == "hello")
-		else
-			assert(ticks < maxTicks)
-			nextTick(try)
+			return
 		end
+
+		assert(ticks < maxTicks)
+		nextTick(try)
+	end
+
+	nextTick(try)
+end
+
+return function()
+	local worker = assert(Worker.new("tests/worker.worker.lua"))
+
+	assert(not worker:receiveMessage())
+	assert(worker:sendMessage("hi"))
+
+	local ticks = 0
+	local gotHello = false
+
+	local function try()
+		ticks = ticks + 1
+
+		if not gotHello then
+			local message = worker:receiveMessage()
+			if message then
+				assert(message == "hello")
+				gotHello = true
+			end
+		end
+
+		if gotHello then
+			local messages = worker:receiveMessages(10)
+			if #messages > 0 then
+				assert(#messages == 1)
+				assert(messages[1] == "world")
+				assert(#worker:receiveMessages() == 0)
+
+				assert(worker:getSendOverflowCount() == 0)
+				assert(worker:getReceiveOverflowCount() == 0)
+
+				testWaitMessage()
+				return
+			end
+		end
+
+		assert(ticks < maxTicks)
+		nextTick(try)
 	end
 
 	nextTick(try)
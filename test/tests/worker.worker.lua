@@ -1,6 +1,7 @@
 while true do
 	if receiveMessage() == "hi" then
 		sendMessage("hello")
+		assert(sendMessage("world"))
 		break
 	end
 	sleep(8)
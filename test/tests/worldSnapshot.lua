@@ -0,0 +1,46 @@
+local function countEntries(objects)
+	local count = 0
+	for _ in pairs(objects) do
+		count = count + 1
+	end
+	return count
+end
+
+return function()
+	for _, compress in ipairs({ false, true }) do
+		local snapshot = WorldSnapshot.new(compress)
+
+		local first = WorldSnapshot.decode(snapshot:capture())
+		assert(not first.keyframe)
+		assert(first.sequence == 1)
+
+		local vehicle = assert(
+			vehicles.create(vehicleTypes[0], Vector(100, 50, 100), RotMatrix(1, 0, 0, 0, 1, 0, 0, 0, 1), 4)
+		)
+
+		local added = WorldSnapshot.decode(snapshot:capture())
+		assert(added.sequence == 2)
+		local state = added.vehicles[vehicle.index]
+		assert(state)
+		assert(state.color == 4)
+		assert(state.pos.x == 100)
+		assert(state.type == 0)
+
+		assert(countEntries(WorldSnapshot.decode(snapshot:capture()).vehicles) == 0)
+
+		vehicle.color = 2
+		local changed = WorldSnapshot.decode(snapshot:capture()).vehicles[vehicle.index]
+		assert(changed.color == 2)
+		assert(changed.type == nil)
+
+		local keyframe = WorldSnapshot.decode(snapshot:getKeyframe())
+		assert(keyframe.keyframe)
+		assert(keyframe.sequence == 4)
+		assert(keyframe.vehicles[vehicle.index].color == 2)
+		assert(keyframe.vehicles[vehicle.index].type == 0)
+
+		local index = vehicle.index
+		vehicle:remove()
+		assert(WorldSnapshot.decode(snapshot:capture()).vehicles[index] == false)
+	end
+end